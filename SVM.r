@@ -20,6 +20,26 @@ resource 'STR#' (1100) {					/* custom error messages */
 		"Wave does not exist.",
 		/* [3] */
 		"This function requires a 3D wave.",
+		/* [4] */
+		"There is no SVM model with this ID.",
+		/* [5] */
+		"The model does not have a linear kernel.",
+		/* [6] */
+		"The kernel matrix needs a column for each training sample (PRECOMPUTED kernels).",
+		/* [7] */
+		"Only models with a POLY, RBF or SIGMOID kernel and dense support vectors can be quantized.",
+		/* [8] */
+		"Only models with a POLY, RBF or SIGMOID kernel and a positive definite kernel matrix can be reduced.",
+		/* [9] */
+		"The data file is not in libSVM format or doesn't fit the /RAW layout.",
+		/* [10] */
+		"No held out sample has a class of the model",
+		/* [11] */
+		"The data file has more than 2147483647 samples.",
+		/* [12] */
+		"Input must be a 1D sample, 2D matrix or 3D image stack.",
+		/* [13] */
+		"Only models with a LINEAR, POLY, RBF or SIGMOID kernel and dense support vectors can classify dense samples (/DENSE).",
 	}
 };
 
@@ -39,6 +59,22 @@ resource 'XOPC' (1100) {
         XOPOp + dataOp + compilableOp,
         "SVMClassify",
         XOPOp + dataOp + compilableOp,
+        "SVMModelLoad",
+        XOPOp + utilOp + compilableOp,
+        "SVMModelFree",
+        XOPOp + utilOp + compilableOp,
+        "SVMModelSave",
+        XOPOp + utilOp + compilableOp,
+        "SVMModelWeights",
+        XOPOp + dataOp + compilableOp,
+        "SVMGridSearch",
+        XOPOp + dataOp + compilableOp,
+        "SVMKernelMatrix",
+        XOPOp + dataOp + compilableOp,
+        "SVMModelQuantize",
+        XOPOp + utilOp + compilableOp,
+        "SVMModelReduce",
+        XOPOp + utilOp + compilableOp,
     }
     
 };
@@ -0,0 +1,447 @@
+/*	SVMBatch.cpp -- blocked batch prediction for dense samples
+
+	svm_predict_values() evaluates the kernel between one sample and one support vector at a time, walking the index/value pairs of both.
+	For dense samples the kernel values of a block of samples against all support vectors are computed here from a feature-major
+	copy of the support vectors instead: the innermost loop runs over a chunk of support vectors with independent accumulators,
+	which the compiler vectorizes, and the chunk stays in cache for all samples of the block.
+	The accumulators add the terms in ascending feature order like Kernel::k_function(), so the kernel values agree with libSVM up
+	to the rounding of fused multiply-adds. That is also why the RBF kernel sums the squared differences instead of expanding
+	|x|^2+|sv|^2-2x.sv with precomputed norms, which cancels badly for nearby points.
+	The decision values and the voting are the same as in svm_predict_values().
+	
+	With a LINEAR kernel every decision function is w·x-rho, w being the sum of the support vectors weighted with their coefficients.
+	Those models are collapsed to one dense w per decision function, prediction then costs features x decision functions instead of
+	support vectors x features. The decision values agree with libSVM up to rounding, the sum is taken in a different order.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "SVMBatch.h"
+#include "SVMQuantize.h"
+
+#define Malloc(type,n) (type *)malloc((n)*sizeof(type)) //from libSVM
+
+/*
+ same as powi() in svm.cpp
+ */
+
+double svmPowi(double base, int times){
+    double tmp=base, ret=1.0;
+    for (int t=times; t>0; t/=2) {
+        if (t%2 == 1) {
+            ret*=tmp;
+        }
+        tmp=tmp*tmp;
+    }
+    return ret;
+}
+
+/*
+ helper function to add the weighted support vectors [first, first+count) to w.
+ */
+
+static void addSupportVectors(const struct svm_model *model, int first, int count, const double *coef, double *w){
+    for (int i=first; i<first+count; i++) {
+        for (const struct svm_node *node=model->SV[i]; node->index != -1; node++) {
+            if (node->index>0) {
+                w[node->index-1]+=coef[i]*node->value;
+            }
+        }
+    }
+}
+
+/*
+ helper function to sum the support vectors of each decision function of a LINEAR model into dense->w, in the order of the decision values of svm_predict_values().
+ */
+
+static int collapseLinearModel(struct SVMDenseModel *dense){
+    const struct svm_model *model=dense->model;
+    size_t dim=dense->dim>0 ? dense->dim : 1;
+    dense->w=(double*)calloc((size_t)dense->numDecisionValues*dim, sizeof(double));
+    if (dense->w == NULL) {
+        return -1;
+    }
+    
+    int svm_type=model->param.svm_type;
+    if (svm_type == ONE_CLASS || svm_type == EPSILON_SVR || svm_type == NU_SVR) {
+        addSupportVectors(model, 0, model->l, model->sv_coef[0], dense->w);
+        return 0;
+    }
+    
+    int p=0;
+    for (int i=0; i<model->nr_class; i++) {
+        for (int j=i+1; j<model->nr_class; j++) {
+            addSupportVectors(model, dense->start[i], model->nSV[i], model->sv_coef[j-1], dense->w+p*dim);
+            addSupportVectors(model, dense->start[j], model->nSV[j], model->sv_coef[i], dense->w+p*dim);
+            p++;
+        }
+    }
+    return 0;
+}
+
+/*
+ builds the dense copy of the support vectors of model, or the weight vectors for a LINEAR kernel. Returns -1 if the kernel is not supported (PRECOMPUTED), if the support vectors are too sparse to be stored densely, or if memory runs out. The caller falls back to svm_predict_values() then.
+ */
+
+int makeDenseModel(const struct svm_model *model, struct SVMDenseModel **dense){
+    int kernel_type=model->param.kernel_type;
+    if (kernel_type != LINEAR && kernel_type != POLY && kernel_type != RBF && kernel_type != SIGMOID) {
+        return -1;
+    }
+    if (model->l<1) {
+        return -1;
+    }
+    
+    int l=model->l;
+    int dim=0;
+    size_t numNodes=0;
+    for (int i=0; i<l; i++) {
+        for (const struct svm_node *node=model->SV[i]; node->index != -1; node++) {
+            if (node->index>dim) {
+                dim=node->index;
+            }
+            numNodes++;
+        }
+    }
+    int svm_type=model->param.svm_type;
+    int numDecisionValues=(svm_type == ONE_CLASS || svm_type == EPSILON_SVR || svm_type == NU_SVR) ? 1 : model->nr_class*(model->nr_class-1)/2;
+    size_t denseSize=kernel_type == LINEAR ? (size_t)dim*numDecisionValues : (size_t)dim*l;
+    if (denseSize>4*numNodes+(size_t)SVM_KERNEL_BUFFER) { // sparse model, the dense copy would be much larger than the model
+        return -1;
+    }
+    
+    struct SVMDenseModel *result=Malloc(struct SVMDenseModel, 1);
+    if (result == NULL) {
+        return -1;
+    }
+    result->model=model;
+    result->l=l;
+    result->dim=dim;
+    result->numDecisionValues=numDecisionValues;
+    result->svT=NULL;
+    result->w=NULL;
+    result->quantization=0;
+    result->qT=NULL;
+    result->scale=NULL;
+    result->start=Malloc(int, model->nr_class>0 ? model->nr_class : 1);
+    if (result->start == NULL) {
+        freeDenseModel(result);
+        return -1;
+    }
+    
+    result->start[0]=0;
+    if (model->nSV != NULL) {
+        for (int i=1; i<model->nr_class; i++) {
+            result->start[i]=result->start[i-1]+model->nSV[i-1];
+        }
+    }
+    
+    if (kernel_type == LINEAR) { // no kernel values needed at all
+        if (collapseLinearModel(result)) {
+            freeDenseModel(result);
+            return -1;
+        }
+        *dense=result;
+        return 0;
+    }
+    
+    if (makeDenseVectors(model->SV, l, dim, &result->svT)) {
+        freeDenseModel(result);
+        return -1;
+    }
+    
+    *dense=result;
+    return 0;
+}
+
+/*
+ copies l sparse vectors x into a feature-major dense matrix *svT (dim x l, feature k of vector s is (*svT)[k*l+s]), for denseDotProducts(). Returns -1 if memory runs out.
+ */
+
+int makeDenseVectors(struct svm_node *const *x, int l, int dim, double **svT){
+    double *matrix=(double*)calloc((size_t)dim*l>0 ? (size_t)dim*l : 1, sizeof(double));
+    if (matrix == NULL) {
+        return -1;
+    }
+    
+    for (int i=0; i<l; i++) {
+        for (const struct svm_node *node=x[i]; node->index != -1; node++) {
+            if (node->index>0 && node->index <= dim) {
+                matrix[(size_t)(node->index-1)*l+i]=node->value;
+            }
+        }
+    }
+    *svT=matrix;
+    return 0;
+}
+
+/*
+ dot products of numSamples samples (row-major, columns values per sample) with the l vectors of svT (dim x l, see makeDenseVectors()), written to dots (numSamples x l, row-major). The products are added in ascending feature order, as dot() in svm.cpp does.
+ */
+
+void denseDotProducts(const double *svT, int l, int dim, const double *samples, size_t numSamples, int columns, double *dots){
+    const int common=columns<dim ? columns : dim;
+    
+    for (int s0=0; s0<l; s0+=SVM_SV_BLOCK) {
+        const int n=l-s0<SVM_SV_BLOCK ? l-s0 : SVM_SV_BLOCK;
+        
+        for (size_t i=0; i<numSamples; i++) {
+            const double *x=samples+i*columns;
+            double *acc=dots+i*l+s0;
+            for (int s=0; s<n; s++) {
+                acc[s]=0;
+            }
+            for (int k=0; k<common; k++) {
+                const double xk=x[k];
+                if (xk == 0) { // libSVM doesn't add products with a missing point either
+                    continue;
+                }
+                const double *sv=svT+(size_t)k*l+s0;
+                for (int s=0; s<n; s++) {
+                    acc[s]+=xk*sv[s];
+                }
+            }
+        }
+    }
+}
+
+void freeDenseModel(struct SVMDenseModel *dense){
+    if (dense == NULL) {
+        return;
+    }
+    free(dense->svT);
+    free(dense->start);
+    free(dense->w);
+    free(dense->qT);
+    free(dense->scale);
+    free(dense);
+}
+
+/*
+ number of samples per call of denseKernelValues(), the kernel buffer needs rows*l doubles.
+ */
+
+size_t denseBatchRows(const struct SVMDenseModel *dense){
+    size_t rows=SVM_KERNEL_BUFFER/(size_t)dense->l;
+    if (rows>64) {
+        rows=64;
+    }
+    return rows>0 ? rows : 1;
+}
+
+/*
+ kernel values of numSamples samples (row-major, columns values per sample) against all support vectors, written to kvalues (numSamples x l, row-major).
+ Sample features beyond dim and support vector features beyond columns are zero, as for the sparse nodes. Quantized models are evaluated on their compact support vectors (SVMQuantize.h).
+ */
+
+void denseKernelValues(const struct SVMDenseModel *dense, const double *samples, size_t numSamples, int columns, double *kvalues){
+    const struct svm_parameter *param=&dense->model->param;
+    const int l=dense->l;
+    const int dim=dense->dim;
+    const int common=columns<dim ? columns : dim;
+    
+    if (param->kernel_type != RBF) { // a function of the dot product
+        if (dense->qT != NULL) { // compact support vectors, see SVMQuantize.cpp
+            quantizedDotProducts(dense, samples, numSamples, columns, kvalues);
+        }
+        else{
+            denseDotProducts(dense->svT, l, dim, samples, numSamples, columns, kvalues);
+        }
+        size_t count=numSamples*l;
+        if (param->kernel_type == POLY) {
+            for (size_t s=0; s<count; s++) {
+                kvalues[s]=svmPowi(param->gamma*kvalues[s]+param->coef0, param->degree);
+            }
+        }
+        else if (param->kernel_type == SIGMOID) {
+            for (size_t s=0; s<count; s++) {
+                kvalues[s]=tanh(param->gamma*kvalues[s]+param->coef0);
+            }
+        }
+        return;
+    }
+    
+    if (dense->qT != NULL) { // squared distances to the compact support vectors
+        quantizedDistances(dense, samples, numSamples, columns, kvalues);
+        size_t count=numSamples*l;
+        for (size_t s=0; s<count; s++) {
+            kvalues[s]=exp(-param->gamma*kvalues[s]);
+        }
+        return;
+    }
+    
+    for (int s0=0; s0<l; s0+=SVM_SV_BLOCK) {
+        const int n=l-s0<SVM_SV_BLOCK ? l-s0 : SVM_SV_BLOCK;
+        
+        for (size_t i=0; i<numSamples; i++) {
+            const double *x=samples+i*columns;
+            double *acc=kvalues+i*l+s0;
+            for (int s=0; s<n; s++) {
+                acc[s]=0;
+            }
+            
+            // sum of squared differences in ascending feature order
+            int k=0;
+            for (; k<common; k++) {
+                const double xk=x[k];
+                const double *sv=dense->svT+(size_t)k*l+s0;
+                for (int s=0; s<n; s++) {
+                    double d=xk-sv[s];
+                    acc[s]+=d*d;
+                }
+            }
+            for (; k<dim; k++) { // features only the support vectors have
+                const double *sv=dense->svT+(size_t)k*l+s0;
+                for (int s=0; s<n; s++) {
+                    acc[s]+=sv[s]*sv[s];
+                }
+            }
+            for (; k<columns; k++) { // features only the sample has
+                const double x2=x[k]*x[k];
+                for (int s=0; s<n; s++) {
+                    acc[s]+=x2;
+                }
+            }
+            for (int s=0; s<n; s++) {
+                acc[s]=exp(-param->gamma*acc[s]);
+            }
+        }
+    }
+}
+
+/*
+ helper function for the one-vs-one voting of svm_predict_values(), returns the label with the most votes. vote needs nr_class ints.
+ */
+
+static double voteLabel(const struct svm_model *model, const double *decisionValues, int *vote){
+    int nr_class=model->nr_class;
+    for (int i=0; i<nr_class; i++) {
+        vote[i]=0;
+    }
+    
+    int p=0;
+    for (int i=0; i<nr_class; i++) {
+        for (int j=i+1; j<nr_class; j++) {
+            if (decisionValues[p]>0) {
+                ++vote[i];
+            }
+            else{
+                ++vote[j];
+            }
+            p++;
+        }
+    }
+    
+    int vote_max_idx=0;
+    for (int i=1; i<nr_class; i++) {
+        if (vote[i]>vote[vote_max_idx]) {
+            vote_max_idx=i;
+        }
+    }
+    return model->label[vote_max_idx];
+}
+
+/*
+ helper function, predicted label from the decision values for all model types, as svm_predict_values() returns it.
+ */
+
+static double predictedLabel(const struct svm_model *model, const double *decisionValues, int *vote){
+    int svm_type=model->param.svm_type;
+    if (svm_type == ONE_CLASS) {
+        return (decisionValues[0]>0) ? 1 : -1;
+    }
+    if (svm_type == EPSILON_SVR || svm_type == NU_SVR) {
+        return decisionValues[0];
+    }
+    return voteLabel(model, decisionValues, vote);
+}
+
+/*
+ decision values and predicted label of one sample from its kernel values, same as svm_predict_values(). vote needs nr_class ints.
+ */
+
+double denseDecisionValues(const struct SVMDenseModel *dense, const double *kvalue, double *decisionValues, int *vote){
+    const struct svm_model *model=dense->model;
+    int svm_type=model->param.svm_type;
+    
+    if (svm_type == ONE_CLASS || svm_type == EPSILON_SVR || svm_type == NU_SVR) {
+        double *sv_coef=model->sv_coef[0];
+        double sum=0;
+        for (int i=0; i<model->l; i++) {
+            sum+=sv_coef[i]*kvalue[i];
+        }
+        sum-=model->rho[0];
+        decisionValues[0]=sum;
+        
+        if (svm_type == ONE_CLASS) {
+            return (sum>0) ? 1 : -1;
+        }
+        return sum;
+    }
+    
+    int nr_class=model->nr_class;
+    int p=0;
+    for (int i=0; i<nr_class; i++) {
+        for (int j=i+1; j<nr_class; j++) {
+            double sum=0;
+            int si=dense->start[i];
+            int sj=dense->start[j];
+            int ci=model->nSV[i];
+            int cj=model->nSV[j];
+            
+            double *coef1=model->sv_coef[j-1];
+            double *coef2=model->sv_coef[i];
+            for (int k=0; k<ci; k++) {
+                sum+=coef1[si+k]*kvalue[si+k];
+            }
+            for (int k=0; k<cj; k++) {
+                sum+=coef2[sj+k]*kvalue[sj+k];
+            }
+            sum-=model->rho[p];
+            decisionValues[p]=sum;
+            p++;
+        }
+    }
+    
+    return voteLabel(model, decisionValues, vote);
+}
+
+/*
+ decision values and predicted label of one dense sample (columns values) with a collapsed LINEAR model, same as svm_predict_values() up to rounding. vote needs nr_class ints.
+ */
+
+double linearDecisionValues(const struct SVMDenseModel *dense, const double *x, int columns, double *decisionValues, int *vote){
+    const struct svm_model *model=dense->model;
+    const int common=columns<dense->dim ? columns : dense->dim;
+    
+    for (int p=0; p<dense->numDecisionValues; p++) {
+        const double *w=dense->w+(size_t)p*dense->dim;
+        double sum=0;
+        for (int k=0; k<common; k++) {
+            sum+=w[k]*x[k];
+        }
+        decisionValues[p]=sum-model->rho[p];
+    }
+    return predictedLabel(model, decisionValues, vote);
+}
+
+/*
+ same as linearDecisionValues() for a sample given as nodes.
+ */
+
+double linearNodeDecisionValues(const struct SVMDenseModel *dense, const struct svm_node *x, double *decisionValues, int *vote){
+    const struct svm_model *model=dense->model;
+    
+    for (int p=0; p<dense->numDecisionValues; p++) {
+        const double *w=dense->w+(size_t)p*dense->dim;
+        double sum=0;
+        for (const struct svm_node *node=x; node->index != -1; node++) {
+            if (node->index>0 && node->index <= dense->dim) {
+                sum+=w[node->index-1]*node->value;
+            }
+        }
+        decisionValues[p]=sum-model->rho[p];
+    }
+    return predictedLabel(model, decisionValues, vote);
+}
@@ -0,0 +1,41 @@
+/*
+	SVMBatch.h -- blocked batch prediction for dense samples
+*/
+
+#ifndef SVM_BATCH_H
+#define SVM_BATCH_H
+
+#include <stddef.h>
+#include "libSVM/svm.h"
+
+enum {
+    SVM_SV_BLOCK=128, // support vectors per chunk
+    SVM_KERNEL_BUFFER=1<<20 // kernel values (doubles) per batch, limits the rows of a batch for large models
+};
+
+// the support vectors of a model as dense matrix, for POLY, RBF and SIGMOID kernels. Models with a LINEAR kernel are collapsed to one weight vector per decision function instead.
+struct SVMDenseModel {
+    const struct svm_model *model; // coefficients, rho and labels are read from the model
+    int l; // number of support vectors
+    int dim; // largest feature index of the support vectors
+    double *svT; // dim x l, feature-major: feature k of support vector s is svT[k*l+s]. NULL for LINEAR kernels
+    int *start; // first support vector of each class
+    int numDecisionValues; // nr_class*(nr_class-1)/2 for classification, 1 otherwise
+    double *w; // numDecisionValues x dim, row-major: decision value p is w[p*dim...]·x-rho[p]. LINEAR kernels only, NULL otherwise
+    int quantization; // one of SVMQuantization (SVMQuantize.h): with SVM_QUANTIZE_NONE the support vectors are in svT, otherwise in qT
+    void *qT; // dim x l like svT, half floats (uint16_t) or int8_t, feature k of support vector s is scale[k]*qT[k*l+s]. NULL if not quantized
+    double *scale; // dim per-feature scales of qT
+};
+
+double svmPowi(double base, int times);
+int makeDenseVectors(struct svm_node *const *x, int l, int dim, double **svT);
+void denseDotProducts(const double *svT, int l, int dim, const double *samples, size_t numSamples, int columns, double *dots);
+int makeDenseModel(const struct svm_model *model, struct SVMDenseModel **dense);
+void freeDenseModel(struct SVMDenseModel *dense);
+size_t denseBatchRows(const struct SVMDenseModel *dense);
+void denseKernelValues(const struct SVMDenseModel *dense, const double *samples, size_t numSamples, int columns, double *kvalues);
+double denseDecisionValues(const struct SVMDenseModel *dense, const double *kvalue, double *decisionValues, int *vote);
+double linearDecisionValues(const struct SVMDenseModel *dense, const double *x, int columns, double *decisionValues, int *vote);
+double linearNodeDecisionValues(const struct SVMDenseModel *dense, const struct svm_node *x, double *decisionValues, int *vote);
+
+#endif
@@ -0,0 +1,499 @@
+/*	SVMBinaryModel.cpp -- versioned binary model files that are mapped into memory instead of parsed
+
+	The text format of svm_save_model() is parsed value by value with strtod, which takes tens of seconds for large models.
+	A binary model file holds the same data in the layout of the libSVM model: the support vectors as one contiguous block of
+	svm_node, the coefficients as (nr_class-1) contiguous rows of l doubles. The file is mapped read-only and the svm_model
+	arrays point straight into the mapping, so loading costs a few pointer assignments per support vector.
+
+	Layout (native byte order, every section starts at a multiple of 16 bytes):
+		SVMBinaryHeader
+		rho				double[nr_class*(nr_class-1)/2]
+		label			int32[nr_class]								(if SVM_BINARY_LABEL)
+		probA, probB	double[nr_class*(nr_class-1)/2]				(if SVM_BINARY_PROBA, SVM_BINARY_PROBB)
+		nSV				int32[nr_class]								(if SVM_BINARY_NSV)
+		sv_coef			double[(nr_class-1)*l]
+		svOffsets		uint64[l], first node of each support vector
+		nodes			svm_node[numNodes], each support vector terminated with index -1
+		featureMap		SVMBinaryFeatureMap, followed by its arrays		(if SVM_BINARY_FEATURE_MAP)
+
+	Files with a feature map (SVMFeatureMap.h) are written as version 2, so versions of the XOP that don't know about
+	feature maps reject them instead of classifying unmapped samples. All other files are still written as version 1.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "SVMBinaryModel.h"
+#include "SVMFeatureMap.h"
+
+#define Malloc(type,n) (type *)malloc((n)*sizeof(type)) //from libSVM
+
+static const char binaryModelMagic[8]={'l','i','b','S','V','M','b','\0'};
+
+enum {
+    SVM_BINARY_VERSION=1,
+    SVM_BINARY_FEATURE_MAP_VERSION=2, // files with a feature map
+    SVM_BINARY_BYTE_ORDER=0x01020304,
+    SVM_BINARY_ALIGNMENT=16
+};
+
+enum { // which optional arrays the file contains
+    SVM_BINARY_LABEL=1,
+    SVM_BINARY_PROBA=2,
+    SVM_BINARY_PROBB=4,
+    SVM_BINARY_NSV=8,
+    SVM_BINARY_FEATURE_MAP=16
+};
+
+// fixed size header, the fields are ordered so that there is no padding
+struct SVMBinaryHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder; // SVM_BINARY_BYTE_ORDER as written, detects files from a machine with different byte order
+    uint32_t nodeSize; // sizeof(struct svm_node) as written
+    int32_t svm_type;
+    int32_t kernel_type;
+    int32_t degree;
+    double gamma;
+    double coef0;
+    int32_t nr_class;
+    int32_t l;
+    uint32_t flags;
+    uint32_t reserved;
+    uint64_t numNodes;
+    uint64_t rhoOffset;
+    uint64_t labelOffset;
+    uint64_t probAOffset;
+    uint64_t probBOffset;
+    uint64_t nSVOffset;
+    uint64_t svCoefOffset;
+    uint64_t svOffsetsOffset;
+    uint64_t nodesOffset;
+    uint64_t fileSize;
+};
+
+// the feature map section, it starts at the first aligned offset after the nodes
+struct SVMBinaryFeatureMap {
+    int32_t type;
+    int32_t inputDim;
+    int32_t numBasis;
+    int32_t outputDim;
+    double gamma;
+    uint64_t basisOffset; // double[inputDim*numBasis]
+    uint64_t phaseOffset; // double[numBasis]
+    uint64_t factorOffset; // double[numBasis*numBasis], Nyström only
+};
+
+static uint64_t alignOffset(uint64_t offset){
+    return (offset+SVM_BINARY_ALIGNMENT-1)/SVM_BINARY_ALIGNMENT*SVM_BINARY_ALIGNMENT;
+}
+
+/*
+ returns 1 if path has the extension of binary model files (.svmb).
+ */
+
+int isBinaryModelPath(const char *path){
+    size_t length=strlen(path);
+    const char *extension=".svmb";
+    size_t extensionLength=strlen(extension);
+    if (length<extensionLength) {
+        return 0;
+    }
+    for (size_t i=0; i<extensionLength; i++) {
+        if (tolower((unsigned char)path[length-extensionLength+i]) != extension[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ returns 1 if the file at path starts with the magic of a binary model, whatever its extension.
+ */
+
+int isBinaryModelFile(const char *path){
+    char magic[sizeof(binaryModelMagic)];
+    FILE *file=fopen(path, "rb");
+    if (file == NULL) {
+        return 0;
+    }
+    size_t read=fread(magic, 1, sizeof(magic), file);
+    fclose(file);
+    return read == sizeof(magic) && memcmp(magic, binaryModelMagic, sizeof(magic)) == 0;
+}
+
+static int writeSection(FILE *file, uint64_t *position, uint64_t offset, const void *data, size_t size){
+    static const char padding[SVM_BINARY_ALIGNMENT]={0};
+    if (offset>*position && fwrite(padding, 1, (size_t)(offset-*position), file) != offset-*position) {
+        return -1;
+    }
+    if (size>0 && fwrite(data, 1, size, file) != size) {
+        return -1;
+    }
+    *position=offset+size;
+    return 0;
+}
+
+/*
+ writes model as binary model file. The values are stored as they are in memory, so a binary file is a lossless copy of the model (unlike the text format, which rounds the support vectors to 8 digits).
+ featureMap is the map the model was trained on (SVMFeatureMap.h), NULL for models on the original samples. Returns 0 on success.
+ */
+
+int saveBinaryModel(const char *path, const struct svm_model *model, const struct SVMFeatureMap *featureMap){
+    struct SVMBinaryHeader header;
+    memset(&header, 0, sizeof(header));
+    
+    int nr_class=model->nr_class;
+    int l=model->l;
+    size_t pairs=(size_t)nr_class*(nr_class-1)/2;
+    
+    memcpy(header.magic, binaryModelMagic, sizeof(binaryModelMagic));
+    header.version=featureMap != NULL ? SVM_BINARY_FEATURE_MAP_VERSION : SVM_BINARY_VERSION;
+    header.byteOrder=SVM_BINARY_BYTE_ORDER;
+    header.nodeSize=sizeof(struct svm_node);
+    header.svm_type=model->param.svm_type;
+    header.kernel_type=model->param.kernel_type;
+    header.degree=model->param.degree;
+    header.gamma=model->param.gamma;
+    header.coef0=model->param.coef0;
+    header.nr_class=nr_class;
+    header.l=l;
+    header.flags=(model->label ? SVM_BINARY_LABEL : 0) | (model->probA ? SVM_BINARY_PROBA : 0) | (model->probB ? SVM_BINARY_PROBB : 0) | (model->nSV ? SVM_BINARY_NSV : 0) | (featureMap ? SVM_BINARY_FEATURE_MAP : 0);
+    
+    uint64_t *svOffsets=Malloc(uint64_t, l>0 ? l : 1);
+    if (svOffsets == NULL) {
+        return -1;
+    }
+    int precomputed=model->param.kernel_type == PRECOMPUTED; // only the serial number, as svm_save_model() does
+    uint64_t numNodes=0;
+    for (int i=0; i<l; i++) {
+        svOffsets[i]=numNodes;
+        const struct svm_node *node=model->SV[i];
+        while (node->index != -1 && !precomputed) {
+            node++;
+        }
+        numNodes+=precomputed ? 2 : node-model->SV[i]+1;
+    }
+    header.numNodes=numNodes;
+    
+    // section layout
+    uint64_t offset=alignOffset(sizeof(header));
+    header.rhoOffset=offset;
+    offset=alignOffset(offset+pairs*sizeof(double));
+    header.labelOffset=offset;
+    offset=alignOffset(offset+(model->label ? nr_class*sizeof(int32_t) : 0));
+    header.probAOffset=offset;
+    offset=alignOffset(offset+(model->probA ? pairs*sizeof(double) : 0));
+    header.probBOffset=offset;
+    offset=alignOffset(offset+(model->probB ? pairs*sizeof(double) : 0));
+    header.nSVOffset=offset;
+    offset=alignOffset(offset+(model->nSV ? nr_class*sizeof(int32_t) : 0));
+    header.svCoefOffset=offset;
+    offset=alignOffset(offset+(uint64_t)(nr_class-1)*l*sizeof(double));
+    header.svOffsetsOffset=offset;
+    offset=alignOffset(offset+(uint64_t)l*sizeof(uint64_t));
+    header.nodesOffset=offset;
+    offset+=numNodes*sizeof(struct svm_node);
+    
+    struct SVMBinaryFeatureMap mapHeader;
+    memset(&mapHeader, 0, sizeof(mapHeader));
+    uint64_t mapOffset=alignOffset(offset);
+    uint64_t basisSize=0;
+    uint64_t factorSize=0;
+    if (featureMap != NULL) {
+        basisSize=(uint64_t)featureMap->inputDim*featureMap->numBasis*sizeof(double);
+        factorSize=featureMap->factor != NULL ? (uint64_t)featureMap->numBasis*featureMap->numBasis*sizeof(double) : 0;
+        mapHeader.type=featureMap->type;
+        mapHeader.inputDim=featureMap->inputDim;
+        mapHeader.numBasis=featureMap->numBasis;
+        mapHeader.outputDim=featureMap->outputDim;
+        mapHeader.gamma=featureMap->gamma;
+        mapHeader.basisOffset=alignOffset(mapOffset+sizeof(mapHeader));
+        mapHeader.phaseOffset=alignOffset(mapHeader.basisOffset+basisSize);
+        mapHeader.factorOffset=alignOffset(mapHeader.phaseOffset+(uint64_t)featureMap->numBasis*sizeof(double));
+        offset=mapHeader.factorOffset+factorSize;
+    }
+    header.fileSize=offset;
+    
+    FILE *file=fopen(path, "wb");
+    if (file == NULL) {
+        free(svOffsets);
+        return -1;
+    }
+    
+    int err=0;
+    uint64_t position=0;
+    err|=writeSection(file, &position, 0, &header, sizeof(header));
+    err|=writeSection(file, &position, header.rhoOffset, model->rho, pairs*sizeof(double));
+    if (model->label) {
+        for (int i=0; i<nr_class && err == 0; i++) {
+            int32_t label=model->label[i];
+            err|=writeSection(file, &position, i == 0 ? header.labelOffset : position, &label, sizeof(label));
+        }
+    }
+    if (model->probA) {
+        err|=writeSection(file, &position, header.probAOffset, model->probA, pairs*sizeof(double));
+    }
+    if (model->probB) {
+        err|=writeSection(file, &position, header.probBOffset, model->probB, pairs*sizeof(double));
+    }
+    if (model->nSV) {
+        for (int i=0; i<nr_class && err == 0; i++) {
+            int32_t count=model->nSV[i];
+            err|=writeSection(file, &position, i == 0 ? header.nSVOffset : position, &count, sizeof(count));
+        }
+    }
+    for (int i=0; i<nr_class-1 && err == 0; i++) {
+        err|=writeSection(file, &position, i == 0 ? header.svCoefOffset : position, model->sv_coef[i], l*sizeof(double));
+    }
+    err|=writeSection(file, &position, header.svOffsetsOffset, svOffsets, l*sizeof(uint64_t));
+    for (int i=0; i<l && err == 0; i++) {
+        const struct svm_node *node=model->SV[i];
+        int last=0;
+        for (int k=0; !last && err == 0; k++) {
+            struct svm_node copy;
+            memset(&copy, 0, sizeof(copy)); // no random padding bytes in the file
+            last=node[k].index == -1 || (precomputed && k == 1);
+            copy.index=last ? -1 : node[k].index;
+            copy.value=last ? 0 : node[k].value;
+            err|=writeSection(file, &position, (i == 0 && k == 0) ? header.nodesOffset : position, &copy, sizeof(copy));
+        }
+    }
+    if (featureMap != NULL && err == 0) {
+        err|=writeSection(file, &position, mapOffset, &mapHeader, sizeof(mapHeader));
+        err|=writeSection(file, &position, mapHeader.basisOffset, featureMap->basisT, (size_t)basisSize);
+        err|=writeSection(file, &position, mapHeader.phaseOffset, featureMap->phase, featureMap->numBasis*sizeof(double));
+        err|=writeSection(file, &position, mapHeader.factorOffset, featureMap->factor, (size_t)factorSize);
+    }
+    
+    free(svOffsets);
+    if (fclose(file) != 0) {
+        err=-1;
+    }
+    return err ? -1 : 0;
+}
+
+/*
+ maps a whole file read-only, *size receives its size. Returns NULL if that fails or the file is empty.
+ */
+
+void *mapFile(const char *path, size_t *size){
+#ifdef _WIN32
+    HANDLE file=CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return NULL;
+    }
+    HANDLE mappingHandle=CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file); // the mapping keeps the file open
+    if (mappingHandle == NULL) {
+        return NULL;
+    }
+    void *mapping=MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mappingHandle); // the view keeps the mapping alive
+    *size=(size_t)fileSize.QuadPart;
+    return mapping;
+#else
+    int file=open(path, O_RDONLY);
+    if (file<0) {
+        return NULL;
+    }
+    struct stat fileInfo;
+    if (fstat(file, &fileInfo) != 0 || fileInfo.st_size == 0) {
+        close(file);
+        return NULL;
+    }
+    void *mapping=mmap(NULL, (size_t)fileInfo.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file); // the mapping keeps the file open
+    if (mapping == MAP_FAILED) {
+        return NULL;
+    }
+    *size=(size_t)fileInfo.st_size;
+    return mapping;
+#endif
+}
+
+void unmapFile(void *mapping, size_t size){
+#ifdef _WIN32
+    UnmapViewOfFile(mapping);
+#else
+    munmap(mapping, size);
+#endif
+}
+
+static int validSection(const struct SVMBinaryHeader *header, uint64_t offset, uint64_t size){
+    return offset%SVM_BINARY_ALIGNMENT == 0 && offset <= header->fileSize && size <= header->fileSize-offset;
+}
+
+/*
+ helper function, validSection() for count elements of elementSize bytes. The counts come from the file, count*elementSize is only computed once it can't wrap around.
+ */
+
+static int validArray(const struct SVMBinaryHeader *header, uint64_t offset, uint64_t count, uint64_t elementSize){
+    return count <= header->fileSize/elementSize && validSection(header, offset, count*elementSize);
+}
+
+/*
+ maps a binary model file and builds a svm_model whose arrays point into the mapping. Only the arrays of row pointers (SV and sv_coef) are allocated, nothing is parsed. A feature map in the file is set up the same way.
+ The model must be released with unmapBinaryModel(), not svm_free_and_destroy_model(). Returns -1 if the file can't be mapped or is not a valid binary model of this version.
+ */
+
+int mapBinaryModel(const char *path, struct SVMMappedModel *mapped){
+    size_t size=0;
+    char *mapping=(char*)mapFile(path, &size);
+    if (mapping == NULL) {
+        return -1;
+    }
+    
+    const struct SVMBinaryHeader *header=(const struct SVMBinaryHeader*)mapping;
+    int valid=size >= sizeof(*header) && memcmp(header->magic, binaryModelMagic, sizeof(binaryModelMagic)) == 0 && (header->version == SVM_BINARY_VERSION || header->version == SVM_BINARY_FEATURE_MAP_VERSION) && header->byteOrder == SVM_BINARY_BYTE_ORDER && header->nodeSize == sizeof(struct svm_node) && header->fileSize == size && header->nr_class >= 2 && header->l >= 0;
+    
+    uint64_t pairs=0;
+    uint64_t nr_class=0;
+    uint64_t l=0;
+    if (valid) {
+        nr_class=(uint64_t)header->nr_class;
+        l=(uint64_t)header->l;
+        pairs=nr_class*(nr_class-1)/2; // both below 2^31, the counts themselves can't wrap around
+        valid=validArray(header, header->rhoOffset, pairs, sizeof(double))
+            && (!(header->flags & SVM_BINARY_LABEL) || validArray(header, header->labelOffset, nr_class, sizeof(int32_t)))
+            && (!(header->flags & SVM_BINARY_PROBA) || validArray(header, header->probAOffset, pairs, sizeof(double)))
+            && (!(header->flags & SVM_BINARY_PROBB) || validArray(header, header->probBOffset, pairs, sizeof(double)))
+            && (!(header->flags & SVM_BINARY_NSV) || validArray(header, header->nSVOffset, nr_class, sizeof(int32_t)))
+            && validArray(header, header->svCoefOffset, (nr_class-1)*l, sizeof(double))
+            && validArray(header, header->svOffsetsOffset, l, sizeof(uint64_t))
+            && validArray(header, header->nodesOffset, header->numNodes, sizeof(struct svm_node));
+    }
+    if (valid && (header->flags & SVM_BINARY_NSV)) { // libSVM finds the support vectors of each class by these counts, they have to add up to l
+        const int32_t *nSV=(const int32_t*)(mapping+header->nSVOffset);
+        uint64_t total=0;
+        for (uint64_t i=0; i<nr_class && valid; i++) {
+            valid=nSV[i] >= 0;
+            total+=valid ? (uint64_t)nSV[i] : 0;
+        }
+        valid=valid && total == l;
+    }
+    
+    const uint64_t *svOffsets=(const uint64_t*)(mapping+(valid ? header->svOffsetsOffset : 0));
+    const struct svm_node *nodes=(const struct svm_node*)(mapping+(valid ? header->nodesOffset : 0));
+    for (uint64_t i=0; i<l && valid; i++) { // every support vector has to end with a terminator inside the node block
+        uint64_t end=i+1<l ? svOffsets[i+1] : header->numNodes;
+        valid=svOffsets[i]<end && end <= header->numNodes && nodes[end-1].index == -1;
+    }
+    
+    const struct SVMBinaryFeatureMap *mapHeader=NULL;
+    if (valid && (header->flags & SVM_BINARY_FEATURE_MAP)) {
+        uint64_t mapOffset=alignOffset(header->nodesOffset+header->numNodes*sizeof(struct svm_node));
+        valid=header->version == SVM_BINARY_FEATURE_MAP_VERSION && validSection(header, mapOffset, sizeof(struct SVMBinaryFeatureMap));
+        if (valid) {
+            mapHeader=(const struct SVMBinaryFeatureMap*)(mapping+mapOffset);
+            uint64_t numBasis=mapHeader->numBasis>0 ? (uint64_t)mapHeader->numBasis : 0;
+            uint64_t inputDim=mapHeader->inputDim >= 0 ? (uint64_t)mapHeader->inputDim : 0;
+            int nystroem=mapHeader->type == SVM_FEATURE_MAP_NYSTROEM;
+            valid=(mapHeader->type == SVM_FEATURE_MAP_RFF || nystroem) && numBasis>0 && mapHeader->inputDim >= 0 && mapHeader->outputDim == mapHeader->numBasis
+                && numBasis <= size/sizeof(double)/numBasis && inputDim <= size/sizeof(double)/numBasis // no overflow below
+                && validSection(header, mapHeader->basisOffset, inputDim*numBasis*sizeof(double))
+                && validSection(header, mapHeader->phaseOffset, numBasis*sizeof(double))
+                && (!nystroem || validSection(header, mapHeader->factorOffset, numBasis*numBasis*sizeof(double)));
+        }
+    }
+    
+    struct svm_model *model=NULL;
+    struct SVMFeatureMap *featureMap=NULL;
+    if (valid && mapHeader != NULL) {
+        featureMap=Malloc(struct SVMFeatureMap, 1);
+        valid=featureMap != NULL;
+    }
+    if (valid) {
+        model=Malloc(struct svm_model, 1);
+        if (model != NULL) {
+            memset(model, 0, sizeof(struct svm_model));
+            model->SV=Malloc(struct svm_node *, l>0 ? l : 1);
+            model->sv_coef=Malloc(double *, nr_class-1);
+        }
+        if (model == NULL || model->SV == NULL || model->sv_coef == NULL) {
+            if (model != NULL) {
+                free(model->SV);
+                free(model->sv_coef);
+                free(model);
+            }
+            model=NULL;
+        }
+    }
+    if (model == NULL) {
+        free(featureMap);
+        unmapFile(mapping, size);
+        return -1;
+    }
+    
+    model->param.svm_type=header->svm_type;
+    model->param.kernel_type=header->kernel_type;
+    model->param.degree=header->degree;
+    model->param.gamma=header->gamma;
+    model->param.coef0=header->coef0;
+    model->nr_class=(int)nr_class;
+    model->l=(int)l;
+    model->rho=(double*)(mapping+header->rhoOffset); // libSVM only reads these, the const cast is safe
+    model->label=(header->flags & SVM_BINARY_LABEL) ? (int*)(mapping+header->labelOffset) : NULL;
+    model->probA=(header->flags & SVM_BINARY_PROBA) ? (double*)(mapping+header->probAOffset) : NULL;
+    model->probB=(header->flags & SVM_BINARY_PROBB) ? (double*)(mapping+header->probBOffset) : NULL;
+    model->nSV=(header->flags & SVM_BINARY_NSV) ? (int*)(mapping+header->nSVOffset) : NULL;
+    for (uint64_t i=0; i<nr_class-1; i++) {
+        model->sv_coef[i]=(double*)(mapping+header->svCoefOffset)+i*l;
+    }
+    for (uint64_t i=0; i<l; i++) {
+        model->SV[i]=(struct svm_node*)nodes+svOffsets[i];
+    }
+    model->sv_indices=NULL;
+    model->free_sv=0;
+    
+    if (featureMap != NULL) {
+        featureMap->type=mapHeader->type;
+        featureMap->inputDim=mapHeader->inputDim;
+        featureMap->numBasis=mapHeader->numBasis;
+        featureMap->outputDim=mapHeader->outputDim;
+        featureMap->gamma=mapHeader->gamma;
+        featureMap->basisT=(double*)(mapping+mapHeader->basisOffset); // only read, as the model arrays
+        featureMap->phase=(double*)(mapping+mapHeader->phaseOffset);
+        featureMap->factor=mapHeader->type == SVM_FEATURE_MAP_NYSTROEM ? (double*)(mapping+mapHeader->factorOffset) : NULL;
+    }
+    
+    mapped->model=model;
+    mapped->featureMap=featureMap;
+    mapped->mapping=mapping;
+    mapped->mappingSize=size;
+    return 0;
+}
+
+/*
+ releases a model created by mapBinaryModel(), its feature map and the mapping.
+ */
+
+void unmapBinaryModel(struct SVMMappedModel *mapped){
+    free(mapped->featureMap); // the arrays are in the mapping
+    mapped->featureMap=NULL;
+    if (mapped->model != NULL) {
+        free(mapped->model->SV);
+        free(mapped->model->sv_coef);
+        free(mapped->model);
+        mapped->model=NULL;
+    }
+    if (mapped->mapping != NULL) {
+        unmapFile(mapped->mapping, mapped->mappingSize);
+        mapped->mapping=NULL;
+    }
+}
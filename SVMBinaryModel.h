@@ -0,0 +1,29 @@
+/*
+	SVMBinaryModel.h -- versioned binary model files that are mapped into memory instead of parsed
+*/
+
+#ifndef SVM_BINARY_MODEL_H
+#define SVM_BINARY_MODEL_H
+
+#include <stddef.h>
+#include "libSVM/svm.h"
+
+struct SVMFeatureMap;
+
+// a model whose arrays point into a mapped binary model file
+struct SVMMappedModel {
+    struct svm_model *model;
+    struct SVMFeatureMap *featureMap; // the feature map of the model (arrays in the mapping as well), NULL if the file has none
+    void *mapping;
+    size_t mappingSize;
+};
+
+int isBinaryModelPath(const char *path);
+int isBinaryModelFile(const char *path);
+int saveBinaryModel(const char *path, const struct svm_model *model, const struct SVMFeatureMap *featureMap);
+int mapBinaryModel(const char *path, struct SVMMappedModel *mapped);
+void unmapBinaryModel(struct SVMMappedModel *mapped);
+void *mapFile(const char *path, size_t *size);
+void unmapFile(void *mapping, size_t size);
+
+#endif
@@ -0,0 +1,378 @@
+/*	SVMCascade.cpp -- cascade training for SVM XOP
+
+	The solver of svm_train() needs time that grows faster than the number of samples, a problem that is several
+	times too large for one run is trained faster in parts. The cascade SVM (Graf et al., NIPS 2004) trains a sub-SVM
+	on each partition of the samples, only the support vectors of a sub-SVM can be support vectors of the complete
+	problem. The support vectors of two sub-SVMs are merged and trained again, layer by layer, until one set is left,
+	the final model is trained on that set. In a feedback pass the support vectors of the final model are added to
+	every partition and the cascade runs again, until the support vectors don't change any more. After a pass whose
+	support vectors don't change the model is the one of the complete problem, earlier passes give an approximation.
+	The sets of one layer are trained concurrently, one svm_train() per worker, the final set is trained with
+	gramTrain() on all workers. The partitions are drawn with a seed (stratified by class for classification), the
+	sets are kept sorted, so the model only depends on the seed and not on the number of workers.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include "SVMCascade.h"
+#include "SVMKernel.h"
+#include "SVMTraining.h"
+#include "SVMThreads.h"
+
+#define Malloc(type,n) (type *)malloc((n)*sizeof(type)) //from libSVM
+
+/*
+ helper function, the sorted union of the sorted sets a (na samples) and b (nb samples). *n receives the size. Returns NULL if memory runs out.
+ */
+
+static int *unionSets(const int *a, int na, const int *b, int nb, int *n){
+    int *merged=Malloc(int, na+nb>0 ? na+nb : 1);
+    if (merged == NULL) {
+        return NULL;
+    }
+    *n=(int)(std::set_union(a, a+na, b, b+nb, merged)-merged);
+    return merged;
+}
+
+/*
+ helper function, deals the samples of prob to the partitions: shuffled with seed, within each class for C_SVC and NU_SVC so every partition gets its share of each class. Partition p are the samples order[p], order[p+partitions], ... Returns -1 if memory runs out.
+ */
+
+static int partitionOrder(const struct svm_problem *prob, const struct svm_parameter *param, unsigned int seed, int *order){
+    int l=prob->l;
+    uint64_t state=randomState(seed);
+    
+    if (param->svm_type == C_SVC || param->svm_type == NU_SVC) {
+        struct SVMClassGroups groups;
+        if (groupClasses(prob, &groups)) {
+            return -1;
+        }
+        for (int c=0; c<groups.nr_class; c++) {
+            int *perm=groups.perm+groups.start[c];
+            int count=groups.count[c];
+            for (int i=0; i<count; i++) {
+                int j=i+(int)(nextRandom(&state)%(uint32_t)(count-i));
+                int tmp=perm[i];
+                perm[i]=perm[j];
+                perm[j]=tmp;
+            }
+        }
+        memcpy(order, groups.perm, l*sizeof(int));
+        freeClassGroups(&groups);
+        return 0;
+    }
+    
+    for (int i=0; i<l; i++) {
+        order[i]=i;
+    }
+    for (int i=0; i<l; i++) {
+        int j=i+(int)(nextRandom(&state)%(uint32_t)(l-i));
+        int tmp=order[i];
+        order[i]=order[j];
+        order[j]=tmp;
+    }
+    return 0;
+}
+
+// trains one set of a cascade layer per task and keeps its support vectors, shared by all workers of SVMParallelFor()
+struct CascadeLayer {
+    const struct svm_problem *prob;
+    struct svm_parameter param; // cache_size is the share of one worker
+    int **sets; // sorted sample indices of each set
+    const int *sizes;
+    int **svs; // receives the sorted support vectors of each set
+    int *numSV;
+    std::atomic<int> failed; // set by a worker that ran out of memory
+    
+    void operator()(size_t begin, size_t end, int){
+        for (size_t i=begin; i<end; i++) {
+            if (trainSet((int)i)) {
+                failed=1;
+            }
+        }
+    }
+    
+    int trainSet(int s){
+        int n=sizes[s];
+        svs[s]=Malloc(int, n>0 ? n : 1);
+        numSV[s]=0;
+        struct svm_problem sub;
+        if (svs[s] == NULL || subsetProblem(prob, sets[s], n, &sub)) {
+            return -1;
+        }
+        
+        if (n == 0) {
+            // nothing to train
+        }
+        else if (svm_check_parameter(&sub, &param) != NULL) { // e.g. nu infeasible for this set, keep all of it for the next layer
+            memcpy(svs[s], sets[s], n*sizeof(int));
+            numSV[s]=n;
+        }
+        else{
+            struct svm_model *model=svm_train(&sub, &param);
+            if (model == NULL) {
+                free(sub.y);
+                free(sub.x);
+                return -1;
+            }
+            for (int i=0; i<model->l; i++) {
+                svs[s][i]=sets[s][model->sv_indices[i]-1];
+            }
+            numSV[s]=model->l;
+            std::sort(svs[s], svs[s]+numSV[s]);
+            svm_free_and_destroy_model(&model);
+        }
+        free(sub.y);
+        free(sub.x);
+        return 0;
+    }
+};
+
+/*
+ helper function, runs the layers of the cascade on the count sets until one set is left, sets[0] receives it. The sets are replaced by the merged support vectors of the layers. Returns -1 if memory runs out.
+ */
+
+static int runLayers(const struct svm_problem *prob, const struct svm_parameter *param, int **sets, int *sizes, int count, int numThreads, double cacheBudget){
+    int *numSV=Malloc(int, count);
+    int **svs=(int **)calloc(count, sizeof(int *));
+    if (numSV == NULL || svs == NULL) {
+        free(numSV);
+        free(svs);
+        return -1;
+    }
+    
+    int failed=0;
+    while (count>1 && !failed) {
+        int workers=SVMNumberOfThreads(numThreads, (size_t)count);
+        CascadeLayer layer;
+        layer.prob=prob;
+        layer.param=*param;
+        layer.param.probability=0;
+        layer.param.cache_size=cacheBudget/workers<1 ? 1 : cacheBudget/workers;
+        layer.sets=sets;
+        layer.sizes=sizes;
+        layer.svs=svs;
+        layer.numSV=numSV;
+        layer.failed=0;
+        SVMParallelFor((size_t)count, 1, workers, layer);
+        failed=layer.failed;
+        
+        int merged=(count+1)/2;
+        for (int j=0; j<merged && !failed; j++) { // set j of the next layer: support vectors of the sets 2j and 2j+1
+            int *set;
+            if (2*j+1<count) {
+                set=unionSets(svs[2*j], numSV[2*j], svs[2*j+1], numSV[2*j+1], &sizes[j]);
+                failed=set == NULL;
+            }
+            else{ // odd one out, its support vectors go on alone
+                set=svs[2*j];
+                sizes[j]=numSV[2*j];
+                svs[2*j]=NULL;
+            }
+            if (!failed) {
+                free(sets[j]);
+                sets[j]=set;
+            }
+        }
+        for (int i=0; i<count; i++) {
+            free(svs[i]);
+            svs[i]=NULL;
+            if (i >= merged && !failed) {
+                free(sets[i]);
+                sets[i]=NULL;
+            }
+        }
+        if (!failed) {
+            count=merged;
+        }
+    }
+    
+    free(numSV);
+    free(svs);
+    return failed ? -1 : 0;
+}
+
+/*
+ trains prob as a cascade: the samples are dealt to partitions (drawn with seed), the sub-SVMs of each layer are trained on up to numThreads workers and their support vectors merged pairwise until one set is left, the model is trained on that set with gramTrain() (gramBudget MB for its kernel rows, 0 for none). cacheBudget (MB) is split between the workers.
+ Then up to feedbackPasses times, the support vectors of the model are added to every partition and the cascade is run again, until they don't change any more. *passes receives the number of feedback passes that were run.
+ The support vectors point into prob and sv_indices refer to prob, as for svm_train(). A probability model would only be fitted to the final set, train with probability=0 and use heldOutProbabilityModel() instead.
+ With less than 2 partitions (at least 2 samples each) this is just gramTrain(). libSVM's print function is called from the workers, the caller has to make sure that is safe. Returns NULL if memory runs out.
+ */
+
+struct svm_model *cascadeTrain(const struct svm_problem *prob, const struct svm_parameter *param, int partitions, int feedbackPasses, unsigned int seed, int numThreads, double cacheBudget, double gramBudget, int *passes){
+    int l=prob->l;
+    *passes=0;
+    if (partitions>l/2) {
+        partitions=l/2;
+    }
+    if (partitions<2) {
+        return gramTrain(prob, param, seed, numThreads, cacheBudget, gramBudget);
+    }
+    
+    int *order=Malloc(int, l);
+    int *partitionSizes=Malloc(int, partitions);
+    int *sizes=Malloc(int, partitions);
+    int **sets=(int **)calloc(partitions, sizeof(int *));
+    int *partitionBuffer=Malloc(int, l);
+    int *feedback=Malloc(int, l); // sorted support vectors of the last pass
+    int numFeedback=0;
+    if (order == NULL || partitionSizes == NULL || sizes == NULL || sets == NULL || partitionBuffer == NULL || feedback == NULL || partitionOrder(prob, param, seed, order)) {
+        free(order);
+        free(partitionSizes);
+        free(sizes);
+        free(sets);
+        free(partitionBuffer);
+        free(feedback);
+        return NULL;
+    }
+    int offset=0;
+    for (int p=0; p<partitions; p++) { // partition p is partitionBuffer[offset...offset+partitionSizes[p]-1], sorted
+        int n=0;
+        for (int i=p; i<l; i+=partitions) {
+            partitionBuffer[offset+n++]=order[i];
+        }
+        std::sort(partitionBuffer+offset, partitionBuffer+offset+n);
+        partitionSizes[p]=n;
+        offset+=n;
+    }
+    free(order);
+    
+    struct svm_model *model=NULL;
+    int failed=0;
+    for (int pass=0; !failed; pass++) {
+        offset=0;
+        for (int p=0; p<partitions && !failed; p++) { // partition p and the support vectors of the last pass
+            sets[p]=unionSets(partitionBuffer+offset, partitionSizes[p], feedback, numFeedback, &sizes[p]);
+            failed=sets[p] == NULL;
+            offset+=partitionSizes[p];
+        }
+        if (failed || runLayers(prob, param, sets, sizes, partitions, numThreads, cacheBudget)) {
+            failed=1;
+            break;
+        }
+        
+        struct svm_problem sub;
+        struct svm_model *passModel=NULL;
+        if (subsetProblem(prob, sets[0], sizes[0], &sub) == 0) {
+            passModel=gramTrain(&sub, param, seed, numThreads, cacheBudget, gramBudget); // the support vectors point into prob, sub only holds pointers
+            if (passModel != NULL) {
+                for (int i=0; i<passModel->l; i++) { // refer to prob instead of the final set
+                    passModel->sv_indices[i]=sets[0][passModel->sv_indices[i]-1]+1;
+                }
+            }
+            free(sub.y);
+            free(sub.x);
+        }
+        free(sets[0]);
+        sets[0]=NULL;
+        if (passModel == NULL) {
+            failed=1;
+            break;
+        }
+        svm_free_and_destroy_model(&model);
+        model=passModel;
+        *passes=pass;
+        
+        int *svs=Malloc(int, model->l>0 ? model->l : 1);
+        if (svs == NULL) {
+            failed=1;
+            break;
+        }
+        for (int i=0; i<model->l; i++) {
+            svs[i]=model->sv_indices[i]-1;
+        }
+        std::sort(svs, svs+model->l);
+        int converged=model->l == numFeedback; // same support vectors as in the last pass
+        for (int i=0; i<model->l && converged; i++) {
+            converged=svs[i] == feedback[i];
+        }
+        memcpy(feedback, svs, model->l*sizeof(int));
+        numFeedback=model->l;
+        free(svs);
+        if (converged || pass >= feedbackPasses) {
+            break;
+        }
+    }
+    
+    if (failed) {
+        svm_free_and_destroy_model(&model);
+    }
+    for (int p=0; p<partitions; p++) {
+        free(sets[p]);
+    }
+    free(partitionBuffer);
+    free(partitionSizes);
+    free(sizes);
+    free(sets);
+    free(feedback);
+    return model;
+}
+
+// predicts the samples of a problem with a model, shared by all workers of SVMParallelFor()
+struct PredictionRows {
+    const struct svm_model *model;
+    const struct svm_problem *prob;
+    double *target;
+    
+    void operator()(size_t begin, size_t end, int){
+        for (size_t i=begin; i<end; i++) {
+            target[i]=svm_predict(model, prob->x[i]);
+        }
+    }
+};
+
+/*
+ compares the cascade model with the model of a direct training run of prob: predicts the training samples with both models on up to numThreads workers and fills report. Returns -1 if memory runs out.
+ */
+
+int cascadeReport(const struct svm_model *cascade, const struct svm_model *direct, const struct svm_problem *prob, int numThreads, struct SVMCascadeReport *report){
+    int l=prob->l;
+    int regression=cascade->param.svm_type == EPSILON_SVR || cascade->param.svm_type == NU_SVR;
+    double *cascadeTarget=Malloc(double, l>0 ? l : 1);
+    double *directTarget=Malloc(double, l>0 ? l : 1);
+    if (cascadeTarget == NULL || directTarget == NULL) {
+        free(cascadeTarget);
+        free(directTarget);
+        return -1;
+    }
+    
+    int workers=SVMNumberOfThreads(numThreads, (size_t)l);
+    PredictionRows rows;
+    rows.prob=prob;
+    rows.model=cascade;
+    rows.target=cascadeTarget;
+    SVMParallelFor((size_t)l, 64, workers, rows);
+    rows.model=direct;
+    rows.target=directTarget;
+    SVMParallelFor((size_t)l, 64, workers, rows);
+    
+    double cascadeScore=0;
+    double directScore=0;
+    double difference=0;
+    for (int i=0; i<l; i++) {
+        if (regression) {
+            cascadeScore+=(cascadeTarget[i]-prob->y[i])*(cascadeTarget[i]-prob->y[i]);
+            directScore+=(directTarget[i]-prob->y[i])*(directTarget[i]-prob->y[i]);
+            difference+=(cascadeTarget[i]-directTarget[i])*(cascadeTarget[i]-directTarget[i]);
+        }
+        else if (cascade->param.svm_type == ONE_CLASS) { // correct: the sample is in the known data, as for the cross validation of SVMTrain
+            cascadeScore+=cascadeTarget[i]>0;
+            directScore+=directTarget[i]>0;
+            difference+=cascadeTarget[i] != directTarget[i];
+        }
+        else{
+            cascadeScore+=cascadeTarget[i] == prob->y[i];
+            directScore+=directTarget[i] == prob->y[i];
+            difference+=cascadeTarget[i] != directTarget[i];
+        }
+    }
+    double scale=l>0 ? (regression ? 1.0/l : 100.0/l) : 0;
+    report->cascadeScore=cascadeScore*scale;
+    report->directScore=directScore*scale;
+    report->difference=difference*scale;
+    
+    free(cascadeTarget);
+    free(directTarget);
+    return 0;
+}
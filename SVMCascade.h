@@ -0,0 +1,25 @@
+/*
+	SVMCascade.h -- cascade training: sub-SVMs on partitions of the problem, merged by their support vectors
+*/
+
+#ifndef SVM_CASCADE_H
+#define SVM_CASCADE_H
+
+#include "libSVM/svm.h"
+
+enum {
+    SVM_CASCADE_PARTITIONS=8, // default number of partitions of the first layer
+    SVM_CASCADE_FEEDBACK=3 // default limit of feedback passes
+};
+
+// how a cascade model compares to the model of a direct training run, on the training samples
+struct SVMCascadeReport {
+    double cascadeScore; // accuracy in % (classification and ONE_CLASS) or mean squared error (regression) of the cascade model
+    double directScore; // same for the direct model
+    double difference; // % of the samples predicted differently (classification and ONE_CLASS) or mean squared difference of the predictions (regression)
+};
+
+struct svm_model *cascadeTrain(const struct svm_problem *prob, const struct svm_parameter *param, int partitions, int feedbackPasses, unsigned int seed, int numThreads, double cacheBudget, double gramBudget, int *passes);
+int cascadeReport(const struct svm_model *cascade, const struct svm_model *direct, const struct svm_problem *prob, int numThreads, struct SVMCascadeReport *report);
+
+#endif
@@ -0,0 +1,364 @@
+/*	SVMDataFile.cpp -- samples from files for SVM XOP
+
+	Samples in a wave are copied once more into the nodes of the problem, so training needs twice the memory of
+	the data, and classification can only handle what fits into an Igor wave. Files are mapped read-only instead
+	(mapFile() in SVMBinaryModel.cpp): their pages are read when they are needed and belong to the file cache,
+	which the system can drop again at any time, so the nodes are the only copy of the samples in memory.
+	A raw binary matrix is described by a SVMDataBlock that points into the mapping, all conversions that read
+	waves read it the same way. A text file in the format of libSVM is indexed once, the offset of each line and
+	the largest index, and lines are converted to nodes in ranges, a few MB at a time for classification
+	(textChunkRows()). Lines are parsed on several threads, numbers with strtod() as svm-train does.
+	Only the nodes are bounded, the index is not: the line offsets of a text file stay resident, 8 bytes per
+	sample, and SVMClassify keeps a node pointer per sample next to them, 16 bytes per sample in all (training
+	holds a pointer and a label per sample in the problem anyway). That is the order of the result waves, which
+	get a value per sample as well, so files are out-of-core for the samples, not for their number.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include "SVMDataFile.h"
+#include "SVMBinaryModel.h"
+#include "SVMThreads.h"
+
+#define Malloc(type,n) (type *)malloc((n)*sizeof(type)) //from libSVM
+
+static int isBlank(char c){
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/*
+ helper function, reads the number in [p, end) up to the next blank, ':' or line end into *value. Returns the position after it, NULL if there is no valid number.
+ */
+
+static const char *readNumber(const char *p, const char *end, double *value){
+    char token[64]; // the mapping has no terminating 0, strtod() reads a copy
+    int n=0;
+    while (p+n<end && !isBlank(p[n]) && p[n] != ':' && p[n] != '\n') {
+        if (n >= (int)sizeof(token)-1) {
+            return NULL;
+        }
+        token[n]=p[n];
+        n++;
+    }
+    if (n == 0) {
+        return NULL;
+    }
+    token[n]=0;
+    char *stop;
+    *value=strtod(token, &stop);
+    return stop == token+n ? p+n : NULL;
+}
+
+/*
+ helper function, parses the line [p, end) "label index:value ...": *label receives the label and nodes (if not NULL) the points, dropping those with |value| <= threshold if sparse, and the terminating node. *largestIndex receives the largest index if it is larger.
+ Index 0 is allowed, it holds the serial number of a sample of a PRECOMPUTED kernel. Returns the number of points, -1 if the line is not valid.
+ */
+
+static int parseLine(const char *p, const char *end, double *label, struct svm_node *nodes, int sparse, double threshold, int *largestIndex){
+    double value;
+    while (p<end && isBlank(*p)) {
+        p++;
+    }
+    if ((p=readNumber(p, end, &value)) == NULL) {
+        return -1;
+    }
+    if (label != NULL) {
+        *label=value;
+    }
+    
+    int count=0;
+    double previous=-1;
+    for (;;) {
+        while (p<end && isBlank(*p)) {
+            p++;
+        }
+        if (p >= end || *p == '\n') {
+            break;
+        }
+        double index;
+        if ((p=readNumber(p, end, &index)) == NULL || p >= end || *p != ':' || index != floor(index) || index <= previous || index>INT_MAX) { // indices ascend, as libSVM expects
+            return -1;
+        }
+        if ((p=readNumber(p+1, end, &value)) == NULL) {
+            return -1;
+        }
+        previous=index;
+        if (sparse && fabs(value) <= threshold) {
+            continue;
+        }
+        if (nodes != NULL) {
+            nodes[count].index=(int)index;
+            nodes[count].value=value;
+        }
+        count++;
+    }
+    
+    if (nodes != NULL) {
+        nodes[count].index=-1;
+        nodes[count].value=0;
+    }
+    if (largestIndex != NULL && previous>*largestIndex) {
+        *largestIndex=(int)previous;
+    }
+    return count;
+}
+
+/*
+ helper function, the start and end of the line of sample row
+ */
+
+static const char *sampleLine(const struct SVMDataFile *file, size_t row, const char **end){
+    const char *data=(const char *)file->mapping;
+    const char *begin=data+file->lines[row];
+    const char *next=data+file->lines[row+1];
+    *end=(const char *)memchr(begin, '\n', next-begin);
+    if (*end == NULL) {
+        *end=next;
+    }
+    return begin;
+}
+
+// checks the lines of a text file and finds the largest index, shared by all workers of SVMParallelFor()
+struct TextLineCheck {
+    const struct SVMDataFile *file;
+    int *largestIndex; // per worker
+    char *invalid; // per worker
+    
+    void operator()(size_t begin, size_t end, int thread){
+        for (size_t i=begin; i<end && !invalid[thread]; i++) {
+            const char *lineEnd;
+            const char *line=sampleLine(file, i, &lineEnd);
+            if (parseLine(line, lineEnd, NULL, NULL, 0, 0, largestIndex+thread)<0) {
+                invalid[thread]=1;
+            }
+        }
+    }
+};
+
+/*
+ maps a text file in the format of libSVM and indexes it: the lines that are not blank are the samples, every one of them is checked on numThreads threads (<1: one per core). columns receives the largest index.
+ Returns -1 if the file can't be mapped or memory runs out, 1 if it is not a valid file. Release the file with unmapDataFile().
+ */
+
+int mapTextDataFile(const char *path, int numThreads, struct SVMDataFile *file){
+    memset(file, 0, sizeof(*file));
+    file->mapping=mapFile(path, &file->size);
+    if (file->mapping == NULL) {
+        return -1;
+    }
+    const char *data=(const char *)file->mapping;
+    const char *end=data+file->size;
+    
+    for (int pass=0; pass<2; pass++) { // count the samples, then note where they start
+        size_t rows=0;
+        for (const char *line=data; line<end; ) {
+            const char *lineEnd=(const char *)memchr(line, '\n', end-line);
+            if (lineEnd == NULL) {
+                lineEnd=end;
+            }
+            const char *p=line;
+            while (p<lineEnd && isBlank(*p)) {
+                p++;
+            }
+            if (p<lineEnd) {
+                if (pass == 1) {
+                    file->lines[rows]=line-data;
+                }
+                rows++;
+            }
+            line=lineEnd<end ? lineEnd+1 : end;
+        }
+        if (pass == 0) {
+            file->rows=rows;
+            file->lines=Malloc(size_t, rows+1);
+            if (file->lines == NULL) {
+                unmapDataFile(file);
+                return -1;
+            }
+        }
+    }
+    file->lines[file->rows]=file->size;
+    if (file->rows == 0) {
+        unmapDataFile(file);
+        return 1;
+    }
+    
+    TextLineCheck check;
+    int workers=SVMNumberOfThreads(numThreads, file->rows);
+    check.file=file;
+    check.largestIndex=(int *)calloc(workers, sizeof(int));
+    check.invalid=(char *)calloc(workers, 1);
+    if (check.largestIndex == NULL || check.invalid == NULL) {
+        free(check.largestIndex);
+        free(check.invalid);
+        unmapDataFile(file);
+        return -1;
+    }
+    SVMParallelFor(file->rows, 1024, workers, check);
+    
+    int invalid=0;
+    file->columns=0;
+    for (int i=0; i<workers; i++) {
+        invalid|=check.invalid[i];
+        if (check.largestIndex[i]>file->columns) {
+            file->columns=check.largestIndex[i];
+        }
+    }
+    free(check.largestIndex);
+    free(check.invalid);
+    if (invalid) {
+        unmapDataFile(file);
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ helper function, bytes per value of a SVMDataType, 0 if it is not supported
+ */
+
+static size_t dataTypeSize(int type){
+    switch (type) {
+        case SVM_DATA_INT8:
+        case SVM_DATA_UINT8:
+            return 1;
+        case SVM_DATA_INT16:
+        case SVM_DATA_UINT16:
+            return 2;
+        case SVM_DATA_FLOAT32:
+        case SVM_DATA_INT32:
+        case SVM_DATA_UINT32:
+            return 4;
+        case SVM_DATA_FLOAT64:
+        case SVM_DATA_INT64:
+        case SVM_DATA_UINT64:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+/*
+ maps a raw binary matrix of samples with columns values of type (one of SVMDataType) each. block describes the samples in the mapping.
+ Returns -1 if the file can't be mapped, 1 if its size is not a multiple of the size of a sample. Release the file with unmapDataFile().
+ */
+
+int mapRawDataFile(const char *path, int type, int columns, struct SVMDataFile *file){
+    memset(file, 0, sizeof(*file));
+    const size_t rowSize=dataTypeSize(type)*(columns>0 ? columns : 0);
+    if (rowSize == 0) {
+        return 1;
+    }
+    file->mapping=mapFile(path, &file->size);
+    if (file->mapping == NULL) {
+        return -1;
+    }
+    if (file->size%rowSize != 0) {
+        unmapDataFile(file);
+        return 1;
+    }
+    file->rows=file->size/rowSize;
+    file->columns=columns;
+    file->block.data=file->mapping;
+    file->block.type=type;
+    file->block.complexStride=1;
+    file->block.rows=file->rows;
+    file->block.columns=columns;
+    file->block.rowStride=columns; // row-major, one sample after the other
+    file->block.columnStride=1;
+    return 0;
+}
+
+void unmapDataFile(struct SVMDataFile *file){
+    if (file->mapping != NULL) {
+        unmapFile(file->mapping, file->size);
+    }
+    free(file->lines);
+    file->mapping=NULL;
+    file->lines=NULL;
+}
+
+/*
+ the number of samples of a text file from firstRow on that take about SVM_FILE_CHUNK bytes, at least one
+ */
+
+size_t textChunkRows(const struct SVMDataFile *file, size_t firstRow){
+    size_t low=firstRow+1; // the last row of the chunk ends at lines[row]
+    size_t high=file->rows;
+    const size_t limit=file->lines[firstRow]+SVM_FILE_CHUNK;
+    while (low<high) { // last row that still ends within the limit
+        size_t middle=low+(high-low+1)/2;
+        if (file->lines[middle] <= limit) {
+            low=middle;
+        }
+        else{
+            high=middle-1;
+        }
+    }
+    return low-firstRow;
+}
+
+// converts lines of a text file, shared by all workers of SVMParallelFor(). Counts the nodes of each line if nodes is NULL, fills them otherwise
+struct TextLineNodes {
+    const struct SVMDataFile *file;
+    size_t firstRow;
+    int sparse;
+    double threshold;
+    size_t *offsets; // first node of each line, relative to firstRow
+    struct svm_node *nodes;
+    struct svm_node **x; // relative to firstRow
+    double *labels; // relative to firstRow, NULL if not needed
+    
+    void operator()(size_t begin, size_t end, int){
+        for (size_t i=begin; i<end; i++) {
+            const char *lineEnd;
+            const char *line=sampleLine(file, firstRow+i, &lineEnd);
+            if (nodes == NULL) {
+                offsets[i+1]=parseLine(line, lineEnd, NULL, NULL, sparse, threshold, NULL)+1; // checked by mapTextDataFile()
+            }
+            else{
+                x[i]=nodes+offsets[i];
+                parseLine(line, lineEnd, labels != NULL ? labels+i : NULL, x[i], sparse, threshold, NULL);
+            }
+        }
+    }
+};
+
+/*
+ converts the samples [firstRow, firstRow+numRows) of a text file to nodes, on numThreads threads (<1: one per core): *buffer receives one block of nodes, x[i] the nodes of sample firstRow+i and labels[i] its label (if labels is not NULL). Points with |value| <= threshold are dropped if sparse.
+ Returns -1 if memory runs out, *buffer has to be freed.
+ */
+
+int textFileNodes(const struct SVMDataFile *file, size_t firstRow, size_t numRows, int sparse, double threshold, int numThreads, struct svm_node **buffer, struct svm_node **x, double *labels){
+    *buffer=NULL;
+    TextLineNodes lines;
+    lines.file=file;
+    lines.firstRow=firstRow;
+    lines.sparse=sparse;
+    lines.threshold=threshold;
+    lines.offsets=Malloc(size_t, numRows+1);
+    lines.nodes=NULL;
+    lines.x=x;
+    lines.labels=labels;
+    if (lines.offsets == NULL) {
+        return -1;
+    }
+    int workers=SVMNumberOfThreads(numThreads, numRows);
+    SVMParallelFor(numRows, 1024, workers, lines);
+    
+    lines.offsets[0]=0;
+    for (size_t i=0; i<numRows; i++) {
+        lines.offsets[i+1]+=lines.offsets[i];
+    }
+    *buffer=Malloc(struct svm_node, lines.offsets[numRows]>0 ? lines.offsets[numRows] : 1);
+    if (*buffer == NULL) {
+        free(lines.offsets);
+        return -1;
+    }
+    lines.nodes=*buffer;
+    SVMParallelFor(numRows, 1024, workers, lines);
+    free(lines.offsets);
+    return 0;
+}
@@ -0,0 +1,34 @@
+/*
+	SVMDataFile.h -- samples read from libSVM text files and raw binary matrices instead of waves
+*/
+
+#ifndef SVM_DATA_FILE_H
+#define SVM_DATA_FILE_H
+
+#include <stddef.h>
+#include "libSVM/svm.h"
+#include "SVMWaveData.h"
+
+enum {
+    SVM_FILE_CHUNK=32<<20 // bytes of a text file converted to nodes at a time for classification
+};
+
+/*
+ a data file mapped read-only: a text file in the format of libSVM (one sample per line, "label index:value index:value ..." with ascending indices) or a raw binary matrix in native byte order, one sample after the other.
+ */
+struct SVMDataFile {
+    void *mapping;
+    size_t size;
+    size_t rows; // number of samples
+    int columns; // largest index of a text file, data points per sample of a raw matrix
+    size_t *lines; // text files: offset of the line of each sample and the size of the file, rows+1 entries, resident while the file is mapped. NULL for raw matrices
+    SVMDataBlock block; // raw matrices: the samples in the mapping
+};
+
+int mapTextDataFile(const char *path, int numThreads, struct SVMDataFile *file);
+int mapRawDataFile(const char *path, int type, int columns, struct SVMDataFile *file);
+void unmapDataFile(struct SVMDataFile *file);
+size_t textChunkRows(const struct SVMDataFile *file, size_t firstRow);
+int textFileNodes(const struct SVMDataFile *file, size_t firstRow, size_t numRows, int sparse, double threshold, int numThreads, struct svm_node **buffer, struct svm_node **x, double *labels);
+
+#endif
@@ -0,0 +1,204 @@
+/*	SVMDense.cpp -- dense single precision samples for SVM XOP
+
+	libSVM keeps every data point of a sample as an svm_node, an index and a double: 16 bytes per point, for
+	dense data mostly spent on indices that just count up. SVMDenseSamples holds the input matrix as it is, as
+	floats for FP32 and 8/16 bit integer waves (4 bytes per point) and as doubles otherwise, and denseTrain()
+	never builds nodes for all samples: solveDual() (SVMSolver.cpp) computes the kernel rows it needs straight
+	from the dense columns and keeps them in a row cache of a fixed size, there is no kernel matrix. Products are
+	converted to double and added in ascending feature order, as dot() in svm.cpp adds them, so the rows and the
+	model are the same as from the nodes. Only the support vectors of the model get nodes, cross validation builds
+	the nodes of one left out sample at a time.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "SVMDense.h"
+#include "SVMSolver.h"
+#include "SVMTraining.h"
+#include "SVMThreads.h"
+
+#define Malloc(type,n) (type *)malloc((n)*sizeof(type)) //from libSVM
+
+/*
+ reads a data block (rows are samples) into dense samples, as floats if the type of the block is exact in a float, as doubles otherwise. Returns -1 if memory runs out or the type is not supported.
+ */
+
+int makeDenseSamples(const SVMDataBlock *block, struct SVMDenseSamples *samples){
+    size_t size=block->rows*(size_t)block->columns;
+    samples->l=(int)block->rows;
+    samples->dim=block->columns;
+    samples->f=NULL;
+    samples->d=NULL;
+    
+    switch (block->type) {
+        case SVM_DATA_FLOAT32:
+        case SVM_DATA_INT8:
+        case SVM_DATA_UINT8:
+        case SVM_DATA_INT16:
+        case SVM_DATA_UINT16:
+            samples->f=Malloc(float, size>0 ? size : 1);
+            if (samples->f == NULL || SVMBlockToFeatures(*block, samples->f)) {
+                freeDenseSamples(samples);
+                return -1;
+            }
+            break;
+        default:
+            samples->d=Malloc(double, size>0 ? size : 1);
+            if (samples->d == NULL || SVMBlockToFeatures(*block, samples->d)) {
+                freeDenseSamples(samples);
+                return -1;
+            }
+            break;
+    }
+    return 0;
+}
+
+void freeDenseSamples(struct SVMDenseSamples *samples){
+    free(samples->f);
+    free(samples->d);
+    samples->f=NULL;
+    samples->d=NULL;
+}
+
+/*
+ helper function, the nodes of sample i: dim points and the terminating node, zeros included as makeNodes() does without /SPARSE.
+ */
+
+static void sampleNodes(const struct SVMDenseSamples *samples, int i, struct svm_node *row){
+    for (int k=0; k<samples->dim; k++) {
+        size_t point=(size_t)k*samples->l+i;
+        row[k].index=k+1;
+        row[k].value=samples->f != NULL ? (double)samples->f[point] : samples->d[point];
+    }
+    row[samples->dim].index=-1;
+    row[samples->dim].value=0;
+}
+
+/*
+ helper function, gives the support vectors of model their own nodes, built from the samples: sv_indices counts the training samples, sample k of the training is column index[k] of samples (k itself without index). They are in one block that the model frees itself (free_sv), like a model loaded from a file.
+ Returns -1 if memory runs out.
+ */
+
+static int denseSupportVectors(const struct SVMDenseSamples *samples, const int *index, struct svm_model *model){
+    const size_t rowLength=(size_t)samples->dim+1;
+    if (model->l<1) {
+        return 0;
+    }
+    struct svm_node *nodes=Malloc(struct svm_node, model->l*rowLength);
+    if (nodes == NULL) {
+        return -1;
+    }
+    for (int i=0; i<model->l; i++) {
+        int k=model->sv_indices[i]-1;
+        model->SV[i]=nodes+i*rowLength;
+        sampleNodes(samples, index != NULL ? index[k] : k, model->SV[i]);
+    }
+    model->free_sv=1; // svm_free_model_content() frees SV[0], the start of the block
+    return 0;
+}
+
+/*
+ helper function, solverTrain() on the columns index[0..n-1] of the samples (all samples in order without index) with the labels of labels, the support vectors get their own nodes. Returns NULL if memory runs out.
+ */
+
+static struct svm_model *denseSolverTrain(const struct SVMDenseSamples *samples, const int *index, const struct svm_problem *labels, const struct svm_parameter *param, unsigned int seed, int numThreads, double cacheBudget){
+    struct SVMKernelSamples kernelSamples={NULL, samples, index, labels->l};
+    struct svm_model *model=solverTrain(labels, &kernelSamples, param, seed, numThreads, cacheBudget);
+    if (model != NULL && denseSupportVectors(samples, index, model)) {
+        svm_free_and_destroy_model(&model);
+    }
+    return model;
+}
+
+/*
+ trains dense samples with the labels of labels (labels->x is not used) with solverTrain(): the kernel rows the solver needs are computed from the dense samples on numThreads threads and cached in gramBudget MB (at least cacheBudget), see above. The multi-class problems and the probability model (folds drawn from seed) are solved one after the other.
+ Same model as gramTrain() on the nodes of the samples; the support vectors have their own nodes, the samples can be freed afterwards. Returns NULL if memory runs out.
+ */
+
+struct svm_model *denseTrain(const struct SVMDenseSamples *samples, const struct svm_problem *labels, const struct svm_parameter *param, unsigned int seed, int numThreads, double cacheBudget, double gramBudget){
+    return denseSolverTrain(samples, NULL, labels, param, seed, numThreads, gramBudget>cacheBudget ? gramBudget : cacheBudget);
+}
+
+// predicts the left out samples of one fold, shared by all workers of SVMParallelFor()
+struct DenseFoldPredictions {
+    const struct SVMDenseSamples *samples;
+    const struct svm_model *model;
+    const int *perm; // the samples of the fold
+    int probability; // svm_predict_probability() as svm_cross_validation() does for probability models
+    struct svm_node *rows; // dim+1 nodes per worker
+    double *estimates; // nr_class per worker
+    double *target;
+    
+    void operator()(size_t begin, size_t end, int thread){
+        const int nr_class=svm_get_nr_class(model);
+        struct svm_node *row=rows+(size_t)thread*(samples->dim+1);
+        for (size_t j=begin; j<end; j++) {
+            sampleNodes(samples, perm[j], row);
+            target[perm[j]]=probability ? svm_predict_probability(model, row, estimates+(size_t)thread*nr_class) : svm_predict(model, row);
+        }
+    }
+};
+
+/*
+ nr_fold cross validation of dense samples with the labels of labels, with the folds of parallelCrossValidation(): the folds are trained one after the other with denseSolverTrain() and the left out samples are predicted on numThreads threads, from nodes built one sample at a time.
+ No kernel matrix and no nodes for all samples. Returns -1 if memory runs out.
+ */
+
+int denseCrossValidation(const struct SVMDenseSamples *samples, const struct svm_problem *labels, const struct svm_parameter *param, int nr_fold, unsigned int seed, int numThreads, double cacheBudget, double gramBudget, double *target){
+    const int l=labels->l;
+    if (nr_fold>l) {
+        nr_fold=l; // same as libSVM, leave-one-out
+    }
+    if (nr_fold<1) {
+        return -1;
+    }
+    const double budget=gramBudget>cacheBudget ? gramBudget : cacheBudget;
+    const int workers=SVMNumberOfThreads(numThreads, SVM_MAX_THREADS);
+    int *perm=Malloc(int, l);
+    int *fold_start=Malloc(int, nr_fold+1);
+    int *index=Malloc(int, l);
+    double *y=Malloc(double, l);
+    DenseFoldPredictions predictions;
+    predictions.samples=samples;
+    predictions.probability=param->probability && (param->svm_type == C_SVC || param->svm_type == NU_SVC);
+    predictions.rows=Malloc(struct svm_node, (size_t)workers*(samples->dim+1));
+    predictions.target=target;
+    int failed=perm == NULL || fold_start == NULL || index == NULL || y == NULL || predictions.rows == NULL || crossValidationFolds(labels, param, nr_fold, seed, perm, fold_start);
+    
+    for (int fold=0; fold<nr_fold && !failed; fold++) {
+        int foldBegin=fold_start[fold];
+        int foldEnd=fold_start[fold+1];
+        struct svm_problem sub;
+        sub.l=0;
+        sub.x=NULL; // the samples are in index
+        sub.y=y;
+        for (int j=0; j<l; j++) {
+            if (j<foldBegin || j >= foldEnd) {
+                index[sub.l]=perm[j];
+                y[sub.l++]=labels->y[perm[j]];
+            }
+        }
+        
+        struct svm_model *model=denseSolverTrain(samples, index, &sub, param, seed, numThreads, budget);
+        if (model == NULL) {
+            failed=1;
+            break;
+        }
+        predictions.estimates=predictions.probability ? Malloc(double, (size_t)workers*svm_get_nr_class(model)) : NULL; // the folds can miss a class
+        failed=predictions.probability && predictions.estimates == NULL;
+        if (!failed) {
+            predictions.model=model;
+            predictions.perm=perm+foldBegin;
+            SVMParallelFor((size_t)(foldEnd-foldBegin), 16, SVMNumberOfThreads(numThreads, (size_t)(foldEnd-foldBegin)), predictions);
+        }
+        free(predictions.estimates);
+        svm_free_and_destroy_model(&model);
+    }
+    
+    free(perm);
+    free(fold_start);
+    free(index);
+    free(y);
+    free(predictions.rows);
+    return failed ? -1 : 0;
+}
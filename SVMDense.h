@@ -0,0 +1,26 @@
+/*
+	SVMDense.h -- dense single precision samples for training without a node per data point
+*/
+
+#ifndef SVM_DENSE_H
+#define SVM_DENSE_H
+
+#include "libSVM/svm.h"
+#include "SVMWaveData.h"
+
+/*
+ the samples of a problem as feature-major matrix, dim x l: feature k of sample i is at [k*l+i], the layout of the Igor input matrix. Exactly one of f and d is set.
+ */
+struct SVMDenseSamples {
+    int l; // number of samples
+    int dim; // data points per sample
+    float *f; // single precision, for FP32 and 8/16 bit integer data (exact in a float)
+    double *d; // double precision, for the other types
+};
+
+int makeDenseSamples(const SVMDataBlock *block, struct SVMDenseSamples *samples);
+void freeDenseSamples(struct SVMDenseSamples *samples);
+struct svm_model *denseTrain(const struct SVMDenseSamples *samples, const struct svm_problem *labels, const struct svm_parameter *param, unsigned int seed, int numThreads, double cacheBudget, double gramBudget);
+int denseCrossValidation(const struct SVMDenseSamples *samples, const struct svm_problem *labels, const struct svm_parameter *param, int nr_fold, unsigned int seed, int numThreads, double cacheBudget, double gramBudget, double *target);
+
+#endif
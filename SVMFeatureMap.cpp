@@ -0,0 +1,497 @@
+/*	SVMFeatureMap.cpp -- explicit feature maps that approximate the RBF kernel
+
+	svm_train() with an RBF kernel needs kernel values between all pairs of samples that become support vectors, which
+	grows roughly quadratically with the number of samples. A feature map phi(x) of fixed dimension with
+	phi(x)·phi(y) ~ exp(-gamma*|x-y|^2) turns the problem into a linear one, which linearTrain() solves in time linear in
+	the number of samples.
+	Random Fourier features (Rahimi and Recht, NIPS 2007) draw the frequencies w from N(0, 2*gamma) and the phases b from
+	[0, 2pi), phi(x)=sqrt(2/D)*cos(w·x+b). The Nyström map draws m landmarks from the training samples and uses
+	phi(x)=L^-1*k(x), with k(x) the kernel values of x against the landmarks and L the Cholesky factor of their kernel
+	matrix, so phi(x)·phi(y) is the Nyström approximation k(x)'*K^-1*k(y).
+	The dot products with the frequencies or landmarks are computed with denseDotProducts() for blocks of samples. A model
+	trained on mapped samples is reduced to one weight vector per decision function (weightVectorModel()), it is saved
+	together with its map in a binary model file.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "SVMFeatureMap.h"
+#include "SVMBatch.h"
+#include "SVMKernel.h"
+#include "SVMTraining.h"
+#include "SVMThreads.h"
+
+#define Malloc(type,n) (type *)malloc((n)*sizeof(type)) //from libSVM
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846 // not defined by MSVC without _USE_MATH_DEFINES
+#endif
+
+enum {
+    SVM_MAP_BATCH=64 // samples mapped per block
+};
+
+/*
+ helper function, uniform random number in (0,1)
+ */
+
+static double uniformRandom(uint64_t *state){
+    return ((double)nextRandom(state)+0.5)/4294967296.0;
+}
+
+/*
+ helper function, normal random number (Box-Muller)
+ */
+
+static double normalRandom(uint64_t *state){
+    double u1=uniformRandom(state);
+    double u2=uniformRandom(state);
+    return sqrt(-2*log(u1))*cos(2*M_PI*u2);
+}
+
+/*
+ helper function, largest feature index of n samples
+ */
+
+static int largestFeature(struct svm_node *const *x, int n){
+    int dim=0;
+    for (int i=0; i<n; i++) {
+        for (const struct svm_node *node=x[i]; node->index != -1; node++) {
+            if (node->index>dim) {
+                dim=node->index;
+            }
+        }
+    }
+    return dim;
+}
+
+/*
+ builds the feature map of type (SVM_FEATURE_MAP_RFF or SVM_FEATURE_MAP_NYSTROEM) for the RBF kernel with gamma: dimension random frequencies, or dimension landmarks (at most the number of samples) drawn from the samples of prob. seed selects the random numbers, the kernel matrix of the landmarks is computed on numThreads threads (<1: one per core).
+ Returns -1 if memory runs out or the parameters make no sense.
+ */
+
+int makeFeatureMap(const struct svm_problem *prob, int type, int dimension, double gamma, unsigned int seed, int numThreads, struct SVMFeatureMap **map){
+    const int l=prob->l;
+    if (dimension<1 || l<1 || (type != SVM_FEATURE_MAP_RFF && type != SVM_FEATURE_MAP_NYSTROEM)) {
+        return -1;
+    }
+    struct SVMFeatureMap *result=(struct SVMFeatureMap *)calloc(1, sizeof(struct SVMFeatureMap));
+    if (result == NULL) {
+        return -1;
+    }
+    result->type=type;
+    result->gamma=gamma;
+    uint64_t state=randomState(seed);
+    int failed=0;
+    
+    if (type == SVM_FEATURE_MAP_RFF) {
+        const int n=dimension;
+        result->inputDim=largestFeature(prob->x, l);
+        result->numBasis=n;
+        result->outputDim=n;
+        result->basisT=Malloc(double, (size_t)result->inputDim*n>0 ? (size_t)result->inputDim*n : 1);
+        result->phase=Malloc(double, n);
+        failed=result->basisT == NULL || result->phase == NULL;
+        if (!failed) {
+            double sigma=sqrt(2*gamma); // the Fourier transform of exp(-gamma*|d|^2) is a normal distribution with variance 2*gamma
+            for (int b=0; b<n; b++) {
+                result->phase[b]=2*M_PI*uniformRandom(&state);
+            }
+            for (int k=0; k<result->inputDim; k++) {
+                for (int b=0; b<n; b++) {
+                    result->basisT[(size_t)k*n+b]=sigma*normalRandom(&state);
+                }
+            }
+        }
+    }
+    else{
+        const int m=dimension<l ? dimension : l;
+        int *order=Malloc(int, l);
+        struct svm_node **landmarks=Malloc(struct svm_node *, m);
+        double *kernel=Malloc(double, (size_t)m*m);
+        result->numBasis=m;
+        result->outputDim=m;
+        result->phase=Malloc(double, m);
+        result->factor=Malloc(double, (size_t)m*m);
+        failed=order == NULL || landmarks == NULL || kernel == NULL || result->phase == NULL || result->factor == NULL;
+        if (!failed) {
+            for (int i=0; i<l; i++) {
+                order[i]=i;
+            }
+            for (int i=0; i<m; i++) { // the first m entries of a random permutation
+                int j=i+(int)(nextRandom(&state)%(uint32_t)(l-i));
+                int swap=order[i];
+                order[i]=order[j];
+                order[j]=swap;
+                landmarks[i]=prob->x[order[i]];
+            }
+            result->inputDim=largestFeature(landmarks, m);
+            failed=makeDenseVectors(landmarks, m, result->inputDim, &result->basisT);
+        }
+        if (!failed) {
+            for (int b=0; b<m; b++) {
+                double square=0;
+                for (const struct svm_node *node=landmarks[b]; node->index != -1; node++) {
+                    if (node->index>0) {
+                        square+=node->value*node->value;
+                    }
+                }
+                result->phase[b]=square;
+            }
+            struct svm_parameter param;
+            memset(&param, 0, sizeof(param));
+            param.kernel_type=RBF;
+            param.gamma=gamma;
+            failed=kernelMatrix(landmarks, m, landmarks, m, &param, numThreads, kernel) || choleskyFactor(kernel, m, result->factor);
+        }
+        free(order);
+        free(landmarks);
+        free(kernel);
+    }
+    
+    if (failed) {
+        freeFeatureMap(result);
+        return -1;
+    }
+    *map=result;
+    return 0;
+}
+
+void freeFeatureMap(struct SVMFeatureMap *map){
+    if (map == NULL) {
+        return;
+    }
+    free(map->basisT);
+    free(map->phase);
+    free(map->factor);
+    free(map);
+}
+
+/*
+ helper function, the features of one sample from its dot products with the frequencies or landmarks (numBasis) and its squared norm (Nyström only).
+ */
+
+static void featuresFromDots(const struct SVMFeatureMap *map, const double *dots, double square, double *features){
+    const int n=map->numBasis;
+    if (map->type == SVM_FEATURE_MAP_RFF) {
+        const double scale=sqrt(2.0/n);
+        for (int b=0; b<n; b++) {
+            features[b]=scale*cos(dots[b]+map->phase[b]);
+        }
+        return;
+    }
+    for (int o=0; o<n; o++) { // forward substitution, L*phi=k
+        const double *row=map->factor+(size_t)o*n;
+        double value=exp(-map->gamma*(square+map->phase[o]-2*dots[o])); // same formula as the training kernel of svm.cpp
+        for (int b=0; b<o; b++) {
+            value-=row[b]*features[b];
+        }
+        features[o]=value/row[o];
+    }
+}
+
+/*
+ maps numSamples dense samples (row-major, columns values per sample) into features (numSamples x outputDim, row-major). dots is a buffer of numSamples*numBasis doubles. Columns beyond inputDim don't enter the dot products.
+ */
+
+void mapDenseSamples(const struct SVMFeatureMap *map, const double *samples, size_t numSamples, int columns, double *dots, double *features){
+    denseDotProducts(map->basisT, map->numBasis, map->inputDim, samples, numSamples, columns, dots);
+    for (size_t i=0; i<numSamples; i++) {
+        const double *x=samples+i*columns;
+        double square=0;
+        for (int k=0; k<columns; k++) {
+            square+=x[k]*x[k];
+        }
+        featuresFromDots(map, dots+i*map->numBasis, square, features+i*map->outputDim);
+    }
+}
+
+/*
+ maps the sample x into outputDim+1 nodes (every feature and the terminator). dots is a buffer of numBasis+outputDim doubles.
+ */
+
+void mapNodes(const struct SVMFeatureMap *map, const struct svm_node *x, double *dots, struct svm_node *mapped){
+    const int n=map->numBasis;
+    double *features=dots+n;
+    double square=0;
+    memset(dots, 0, n*sizeof(double));
+    for (; x->index != -1; x++) {
+        if (x->index<1) {
+            continue;
+        }
+        square+=x->value*x->value;
+        if (x->index <= map->inputDim && x->value != 0) {
+            const double *basis=map->basisT+(size_t)(x->index-1)*n;
+            for (int b=0; b<n; b++) {
+                dots[b]+=x->value*basis[b];
+            }
+        }
+    }
+    featuresFromDots(map, dots, square, features);
+    for (int o=0; o<map->outputDim; o++) {
+        mapped[o].index=o+1;
+        mapped[o].value=features[o];
+    }
+    mapped[map->outputDim].index=-1;
+    mapped[map->outputDim].value=0;
+}
+
+// maps a block of samples per call, each worker has its own buffers
+struct MapRows {
+    const struct SVMFeatureMap *map;
+    struct svm_node *const *x;
+    struct svm_node *mapped; // outputDim+1 nodes per sample
+    double *samples; // SVM_MAP_BATCH x inputDim per worker
+    double *squares; // SVM_MAP_BATCH per worker
+    double *dots; // SVM_MAP_BATCH x numBasis per worker
+    double *features; // outputDim per worker
+    
+    void operator()(size_t begin, size_t end, int thread){
+        const int dim=map->inputDim;
+        const size_t count=end-begin;
+        double *threadSamples=samples+(size_t)thread*SVM_MAP_BATCH*dim;
+        double *threadSquares=squares+(size_t)thread*SVM_MAP_BATCH;
+        double *threadDots=dots+(size_t)thread*SVM_MAP_BATCH*map->numBasis;
+        double *threadFeatures=features+(size_t)thread*map->outputDim;
+        
+        memset(threadSamples, 0, count*dim*sizeof(double));
+        for (size_t i=0; i<count; i++) {
+            double square=0;
+            for (const struct svm_node *node=x[begin+i]; node->index != -1; node++) {
+                if (node->index<1) {
+                    continue;
+                }
+                square+=node->value*node->value;
+                if (node->index <= dim) {
+                    threadSamples[i*dim+node->index-1]=node->value;
+                }
+            }
+            threadSquares[i]=square;
+        }
+        denseDotProducts(map->basisT, map->numBasis, dim, threadSamples, count, dim, threadDots);
+        
+        for (size_t i=0; i<count; i++) {
+            featuresFromDots(map, threadDots+i*map->numBasis, threadSquares[i], threadFeatures);
+            struct svm_node *row=mapped+(begin+i)*(size_t)(map->outputDim+1);
+            for (int o=0; o<map->outputDim; o++) {
+                row[o].index=o+1;
+                row[o].value=threadFeatures[o];
+            }
+            row[map->outputDim].index=-1;
+            row[map->outputDim].value=0;
+        }
+    }
+};
+
+/*
+ maps all samples of prob, on numThreads threads (<1: one per core). mapped gets the same labels, its samples live in *buffer (outputDim+1 nodes each). The caller frees *buffer, mapped->x and mapped->y.
+ Returns -1 if memory runs out.
+ */
+
+int mapProblem(const struct SVMFeatureMap *map, const struct svm_problem *prob, int numThreads, struct svm_node **buffer, struct svm_problem *mapped){
+    const int l=prob->l;
+    const size_t rowLength=(size_t)map->outputDim+1;
+    numThreads=SVMNumberOfThreads(numThreads, ((size_t)l+SVM_MAP_BATCH-1)/SVM_MAP_BATCH);
+    
+    MapRows rows;
+    rows.map=map;
+    rows.x=prob->x;
+    rows.mapped=Malloc(struct svm_node, (size_t)(l>0 ? l : 1)*rowLength);
+    rows.samples=Malloc(double, (size_t)SVM_MAP_BATCH*(map->inputDim>0 ? map->inputDim : 1)*numThreads);
+    rows.squares=Malloc(double, (size_t)SVM_MAP_BATCH*numThreads);
+    rows.dots=Malloc(double, (size_t)SVM_MAP_BATCH*map->numBasis*numThreads);
+    rows.features=Malloc(double, (size_t)map->outputDim*numThreads);
+    mapped->l=l;
+    mapped->x=Malloc(struct svm_node *, l>0 ? l : 1);
+    mapped->y=Malloc(double, l>0 ? l : 1);
+    int failed=rows.mapped == NULL || rows.samples == NULL || rows.squares == NULL || rows.dots == NULL || rows.features == NULL || mapped->x == NULL || mapped->y == NULL;
+    
+    if (!failed) {
+        SVMParallelFor((size_t)l, SVM_MAP_BATCH, numThreads, rows);
+        for (int i=0; i<l; i++) {
+            mapped->x[i]=rows.mapped+(size_t)i*rowLength;
+            mapped->y[i]=prob->y[i];
+        }
+        *buffer=rows.mapped;
+    }
+    else{
+        free(rows.mapped);
+        free(mapped->x);
+        free(mapped->y);
+        mapped->x=NULL;
+        mapped->y=NULL;
+    }
+    free(rows.samples);
+    free(rows.squares);
+    free(rows.dots);
+    free(rows.features);
+    return failed ? -1 : 0;
+}
+
+/*
+ nr_fold cross validation of a model trained on the feature map of type with dimension bases: the folds are drawn as parallelCrossValidation() does, and the map of each fold is built from the training samples of that fold only, before all samples are mapped and the fold is trained with linearTrain() (loss linearLoss) and predicted. A map built from all samples would draw its Nyström landmarks from the samples the fold predicts, the accuracy would be optimistic.
+ The folds are processed one after the other, their maps on numThreads threads (<1: one per core). target receives the prediction for each sample. Returns -1 if memory runs out.
+ */
+
+int featureMapCrossValidation(const struct svm_problem *prob, const struct svm_parameter *param, int linearLoss, int type, int dimension, int nr_fold, unsigned int seed, int numThreads, double *target){
+    const int l=prob->l;
+    if (nr_fold>l) {
+        nr_fold=l; // same as libSVM, leave-one-out
+    }
+    if (nr_fold<1) {
+        return -1;
+    }
+    
+    int *perm=Malloc(int, l);
+    int *fold_start=Malloc(int, nr_fold+1);
+    int *training=Malloc(int, l);
+    if (perm == NULL || fold_start == NULL || training == NULL || crossValidationFolds(prob, param, nr_fold, seed, perm, fold_start)) {
+        free(perm);
+        free(fold_start);
+        free(training);
+        return -1;
+    }
+    
+    struct svm_parameter linearParam=*param;
+    linearParam.kernel_type=LINEAR; // the model is linear in the mapped samples
+    int failed=0;
+    for (int fold=0; fold<nr_fold && !failed; fold++) {
+        int n=0;
+        for (int j=0; j<l; j++) {
+            if (j<fold_start[fold] || j >= fold_start[fold+1]) {
+                training[n++]=perm[j];
+            }
+        }
+        struct svm_problem trainingProblem={0};
+        struct SVMFeatureMap *map=NULL;
+        struct svm_node *buffer=NULL;
+        struct svm_problem mapped={0};
+        if (subsetProblem(prob, training, n, &trainingProblem)) {
+            failed=1;
+            break;
+        }
+        failed=makeFeatureMap(&trainingProblem, type, dimension, param->gamma, seed, numThreads, &map) || mapProblem(map, prob, numThreads, &buffer, &mapped) || crossValidationFold(&mapped, &linearParam, linearLoss, 0, seed, perm, fold_start, fold, target);
+        free(trainingProblem.x);
+        free(trainingProblem.y);
+        freeFeatureMap(map);
+        free(mapped.x);
+        free(mapped.y);
+        free(buffer);
+    }
+    
+    free(perm);
+    free(fold_start);
+    free(training);
+    return failed ? -1 : 0;
+}
+
+/*
+ the LINEAR model as one support vector per decision function: the weight vector w (see SVMDenseModel) with coefficient 1. For classification the vector of pair (i,j) belongs to class i and has coefficient 0 in all other pairs, so libSVM computes exactly w·x-rho for every pair.
+ The size of the result doesn't depend on the number of training samples, it owns all its arrays (free_sv is set). Returns NULL if memory runs out or the model is not LINEAR.
+ */
+
+struct svm_model *weightVectorModel(const struct svm_model *model){
+    if (model->param.kernel_type != LINEAR || model->nr_class<1) {
+        return NULL;
+    }
+    const int nr_class=model->nr_class;
+    const int svm_type=model->param.svm_type;
+    const int classification=svm_type == C_SVC || svm_type == NU_SVC;
+    const int numFunctions=classification ? nr_class*(nr_class-1)/2 : 1;
+    
+    struct SVMDenseModel *dense=NULL;
+    if (model->l>0 && makeDenseModel(model, &dense)) {
+        return NULL;
+    }
+    const int dim=dense != NULL ? dense->dim : 0;
+    size_t numNodes=numFunctions;
+    for (size_t i=0; dense != NULL && i<(size_t)numFunctions*dim; i++) {
+        numNodes+=dense->w[i] != 0;
+    }
+    
+    struct svm_model *result=(struct svm_model *)calloc(1, sizeof(struct svm_model));
+    struct svm_node *nodes=Malloc(struct svm_node, numNodes>0 ? numNodes : 1);
+    int failed=result == NULL || nodes == NULL;
+    if (!failed) {
+        result->param=model->param;
+        result->param.nr_weight=0;
+        result->param.weight_label=NULL;
+        result->param.weight=NULL;
+        result->nr_class=nr_class;
+        result->l=numFunctions;
+        result->free_sv=1;
+        result->SV=Malloc(struct svm_node *, numFunctions>0 ? numFunctions : 1);
+        result->sv_coef=(double **)calloc(nr_class>1 ? nr_class-1 : 1, sizeof(double *));
+        result->rho=Malloc(double, numFunctions>0 ? numFunctions : 1);
+        failed=result->SV == NULL || result->sv_coef == NULL || result->rho == NULL;
+        for (int i=0; i<nr_class-1 && !failed; i++) {
+            result->sv_coef[i]=(double *)calloc(numFunctions>0 ? numFunctions : 1, sizeof(double));
+            failed=result->sv_coef[i] == NULL;
+        }
+        if (!failed && model->label != NULL) {
+            result->label=Malloc(int, nr_class);
+            failed=result->label == NULL;
+        }
+        if (!failed && classification) {
+            result->nSV=Malloc(int, nr_class);
+            failed=result->nSV == NULL;
+        }
+        if (!failed && model->probA != NULL) {
+            result->probA=Malloc(double, numFunctions>0 ? numFunctions : 1);
+            failed=result->probA == NULL;
+        }
+        if (!failed && model->probB != NULL) {
+            result->probB=Malloc(double, numFunctions>0 ? numFunctions : 1);
+            failed=result->probB == NULL;
+        }
+    }
+    
+    if (!failed) {
+        size_t offset=0;
+        for (int p=0; p<numFunctions; p++) {
+            result->SV[p]=nodes+offset;
+            for (int k=0; k<dim; k++) {
+                double w=dense->w[(size_t)p*dim+k];
+                if (w != 0) {
+                    nodes[offset].index=k+1;
+                    nodes[offset++].value=w;
+                }
+            }
+            nodes[offset].index=-1;
+            nodes[offset++].value=0;
+            result->rho[p]=model->rho[p];
+            if (result->probA != NULL) {
+                result->probA[p]=model->probA[p];
+            }
+            if (result->probB != NULL) {
+                result->probB[p]=model->probB[p];
+            }
+        }
+        if (result->label != NULL) {
+            memcpy(result->label, model->label, nr_class*sizeof(int));
+        }
+        if (classification) {
+            int p=0;
+            for (int i=0; i<nr_class; i++) {
+                result->nSV[i]=nr_class-1-i; // the pairs (i,j) with j>i
+                for (int j=i+1; j<nr_class; j++) {
+                    result->sv_coef[j-1][p++]=1; // coefficients with class i are in sv_coef[j-1], see svm_predict_values()
+                }
+            }
+        }
+        else if (numFunctions>0) {
+            result->sv_coef[0][0]=1;
+        }
+        nodes=numFunctions>0 ? NULL : nodes; // owned by the model from now on
+    }
+    else if (result != NULL) {
+        result->free_sv=0;
+        svm_free_and_destroy_model(&result);
+        result=NULL;
+    }
+    
+    free(nodes);
+    freeDenseModel(dense);
+    return result;
+}
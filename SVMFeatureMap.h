@@ -0,0 +1,36 @@
+/*
+	SVMFeatureMap.h -- explicit feature maps that approximate the RBF kernel, for linear training on large problems
+*/
+
+#ifndef SVM_FEATURE_MAP_H
+#define SVM_FEATURE_MAP_H
+
+#include <stddef.h>
+#include "libSVM/svm.h"
+
+enum {
+    SVM_FEATURE_MAP_RFF=1, // random Fourier features
+    SVM_FEATURE_MAP_NYSTROEM=2 // Nyström map from landmarks drawn from the training samples
+};
+
+// maps a sample x to outputDim features whose dot products approximate exp(-gamma*|x-y|^2)
+struct SVMFeatureMap {
+    int type; // SVM_FEATURE_MAP_RFF or SVM_FEATURE_MAP_NYSTROEM
+    int inputDim; // largest feature index the map reads
+    int numBasis; // random frequencies (RFF) or landmarks (Nyström)
+    int outputDim; // features of a mapped sample
+    double gamma; // of the approximated RBF kernel
+    double *basisT; // inputDim x numBasis, feature-major as in makeDenseVectors(): the frequencies or the landmarks
+    double *phase; // numBasis: the random phases (RFF) or the squared norms of the landmarks (Nyström)
+    double *factor; // numBasis x numBasis, row-major lower Cholesky factor of the kernel matrix of the landmarks. Nyström only, NULL for RFF
+};
+
+int makeFeatureMap(const struct svm_problem *prob, int type, int dimension, double gamma, unsigned int seed, int numThreads, struct SVMFeatureMap **map);
+void freeFeatureMap(struct SVMFeatureMap *map);
+void mapDenseSamples(const struct SVMFeatureMap *map, const double *samples, size_t numSamples, int columns, double *dots, double *features);
+void mapNodes(const struct SVMFeatureMap *map, const struct svm_node *x, double *dots, struct svm_node *mapped);
+int mapProblem(const struct SVMFeatureMap *map, const struct svm_problem *prob, int numThreads, struct svm_node **buffer, struct svm_problem *mapped);
+int featureMapCrossValidation(const struct svm_problem *prob, const struct svm_parameter *param, int linearLoss, int type, int dimension, int nr_fold, unsigned int seed, int numThreads, double *target);
+struct svm_model *weightVectorModel(const struct svm_model *model);
+
+#endif
@@ -0,0 +1,289 @@
+/*	SVMKernel.cpp -- threaded kernel rows for SVM XOP
+
+	Most of the time svm_train() spends in the solver goes to kernel columns (Kernel::kernel_* for every sample
+	against the working set), which are computed on one thread and only kept as long as the cache allows.
+	libSVM is not part of this project (it is linked from ../libSVM as released), so its Kernel and SVC_Q::get_Q
+	can't be given threaded rows here; SVMSolver.cpp carries a copy of its solver that splits each of those rows
+	over several threads and caches them within the memory budget instead. Every training with more than one
+	thread or with /GRAM goes through it: gramTrain(), gramCrossValidation() and gramGridSearch(). The kernel
+	values are computed with the same formulas and summation order as svm.cpp, so the models don't depend on the
+	number of threads.
+	kernelMatrix() evaluates blocks of the kernel between two sets of samples, split by rows over several threads.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "SVMKernel.h"
+#include "SVMBatch.h"
+#include "SVMTraining.h"
+#include "SVMThreads.h"
+
+#define Malloc(type,n) (type *)malloc((n)*sizeof(type)) //from libSVM
+
+/*
+ dot product of two samples, same as Kernel::dot() in svm.cpp
+ */
+
+double sparseDot(const struct svm_node *px, const struct svm_node *py){
+    double sum=0;
+    while (px->index != -1 && py->index != -1) {
+        if (px->index == py->index) {
+            sum+=px->value*py->value;
+            ++px;
+            ++py;
+        }
+        else if (px->index>py->index) {
+            ++py;
+        }
+        else {
+            ++px;
+        }
+    }
+    return sum;
+}
+
+/*
+ turns the dot products of a sample x with n samples into kernel values, in place: the training formulas of Kernel in svm.cpp. xSquare and ySquare are the squared norms, only used for RBF.
+ */
+
+void kernelValues(const struct svm_parameter *param, double xSquare, const double *ySquare, double *dots, int n){
+    for (int j=0; j<n; j++) {
+        switch (param->kernel_type) {
+            case POLY:
+                dots[j]=svmPowi(param->gamma*dots[j]+param->coef0, param->degree);
+                break;
+            case RBF:
+                dots[j]=exp(-param->gamma*(xSquare+ySquare[j]-2*dots[j]));
+                break;
+            case SIGMOID:
+                dots[j]=tanh(param->gamma*dots[j]+param->coef0);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// computes a block of rows of a kernel matrix per call, each worker has its own buffers
+struct KernelRows {
+    const struct svm_parameter *param;
+    struct svm_node *const *x; // the samples of the rows
+    struct svm_node *const *y; // the samples of the columns
+    int n; // number of columns
+    const double *x_square; // RBF only
+    const double *y_square;
+    const double *svT; // the column samples as dim x n feature-major matrix, NULL: sparse dot products
+    int dim;
+    size_t batchRows;
+    double *rows; // batchRows x dim per worker
+    double *dots; // batchRows x n per worker
+    double *values; // output as column-major matrix: K(i,j) is values[i+j*m]
+    size_t m; // number of rows
+    
+    void operator()(size_t begin, size_t end, int thread){
+        const size_t count=end-begin;
+        double *dot=dots+(size_t)thread*batchRows*n;
+        
+        if (svT != NULL) {
+            double *samples=rows+(size_t)thread*batchRows*dim;
+            memset(samples, 0, count*dim*sizeof(double));
+            for (size_t i=0; i<count; i++) {
+                for (const struct svm_node *node=x[begin+i]; node->index != -1; node++) {
+                    if (node->index>0 && node->index <= dim) {
+                        samples[i*dim+node->index-1]=node->value;
+                    }
+                }
+            }
+            denseDotProducts(svT, n, dim, samples, count, dim, dot);
+        }
+        else{
+            for (size_t i=0; i<count; i++) {
+                for (int j=0; j<n; j++) {
+                    dot[i*n+j]=sparseDot(x[begin+i], y[j]);
+                }
+            }
+        }
+        
+        for (size_t i=0; i<count; i++) {
+            double *d=dot+i*n;
+            kernelValues(param, x_square != NULL ? x_square[begin+i] : 0, y_square, d, n);
+            for (int j=0; j<n; j++) {
+                values[begin+i+(size_t)j*m]=d[j];
+            }
+        }
+    }
+};
+
+/*
+ helper function, largest feature index of n samples, and their total number of nodes
+ */
+
+static int largestIndex(struct svm_node *const *x, int n, size_t *numNodes){
+    int dim=0;
+    for (int i=0; i<n; i++) {
+        for (const struct svm_node *node=x[i]; node->index != -1; node++) {
+            if (node->index>dim) {
+                dim=node->index;
+            }
+            ++*numNodes;
+        }
+    }
+    return dim;
+}
+
+/*
+ the kernel of param between m samples x and n samples y, as column-major m x n matrix: K(x[i], y[j]) is values[i+j*m]. Rows are computed on numThreads threads (<1: one per core), with the formulas libSVM uses for training.
+ Blocks of rows are computed as dense dot products (see denseDotProducts()) unless the samples are too sparse for that. The values can be given to a PRECOMPUTED model: K(train, train) for training, K(test, train) for classification. Returns -1 if memory runs out.
+ */
+
+int kernelMatrix(struct svm_node *const *x, int m, struct svm_node *const *y, int n, const struct svm_parameter *param, int numThreads, double *values){
+    struct KernelRows rows;
+    memset(&rows, 0, sizeof(rows));
+    
+    size_t numNodes=0;
+    int dimX=largestIndex(x, m, &numNodes);
+    int dimY=largestIndex(y, n, &numNodes);
+    rows.dim=dimX>dimY ? dimX : dimY;
+    
+    rows.batchRows=n>0 && SVM_KERNEL_BUFFER/n<64 ? SVM_KERNEL_BUFFER/n : 64;
+    if (rows.batchRows<1) {
+        rows.batchRows=1;
+    }
+    numThreads=SVMNumberOfThreads(numThreads, (m+rows.batchRows-1)/rows.batchRows);
+    
+    rows.param=param;
+    rows.x=x;
+    rows.y=y;
+    rows.n=n;
+    rows.m=(size_t)m;
+    rows.values=values;
+    rows.dots=Malloc(double, rows.batchRows*(n>0 ? n : 1)*numThreads);
+    double *x_square=NULL;
+    double *y_square=NULL;
+    double *svT=NULL;
+    int failed=rows.dots == NULL;
+    
+    if (!failed && param->kernel_type == RBF) {
+        x_square=Malloc(double, m>0 ? m : 1);
+        y_square=Malloc(double, n>0 ? n : 1);
+        failed=x_square == NULL || y_square == NULL;
+        for (int i=0; i<m && !failed; i++) {
+            x_square[i]=sparseDot(x[i], x[i]);
+        }
+        for (int j=0; j<n && !failed; j++) {
+            y_square[j]=sparseDot(y[j], y[j]);
+        }
+    }
+    if (!failed && (size_t)rows.dim*n <= 4*numNodes+SVM_KERNEL_BUFFER) { // dense enough for blocked dot products, otherwise merge the sparse vectors
+        if (makeDenseVectors(y, n, rows.dim, &svT) == 0) {
+            rows.rows=Malloc(double, rows.batchRows*(rows.dim>0 ? rows.dim : 1)*numThreads);
+            if (rows.rows == NULL) {
+                free(svT);
+                svT=NULL;
+            }
+        }
+    }
+    
+    if (!failed) {
+        rows.x_square=x_square;
+        rows.y_square=y_square;
+        rows.svT=svT;
+        SVMParallelFor((size_t)m, rows.batchRows, numThreads, rows);
+    }
+    
+    free(rows.dots);
+    free(rows.rows);
+    free(svT);
+    free(x_square);
+    free(y_square);
+    return failed ? -1 : 0;
+}
+
+/*
+ lower Cholesky factor L (row-major) of the symmetric m x m matrix K. If K is not numerically positive definite (e.g. landmarks that are the same sample), an increasing multiple of the identity is added. Returns -1 if that doesn't help either.
+ */
+
+int choleskyFactor(const double *K, int m, double *L){
+    for (double jitter=0; jitter<1e-2; jitter=jitter == 0 ? 1e-10 : jitter*100) {
+        int positive=1;
+        memset(L, 0, (size_t)m*m*sizeof(double));
+        for (int i=0; i<m && positive; i++) {
+            for (int j=0; j <= i; j++) {
+                double sum=K[i+(size_t)j*m];
+                if (i == j) {
+                    sum+=jitter;
+                }
+                for (int k=0; k<j; k++) {
+                    sum-=L[(size_t)i*m+k]*L[(size_t)j*m+k];
+                }
+                if (i == j) {
+                    if (sum <= 1e-12) {
+                        positive=0;
+                        break;
+                    }
+                    L[(size_t)i*m+i]=sqrt(sum);
+                }
+                else{
+                    L[(size_t)i*m+j]=sum/L[(size_t)j*m+j];
+                }
+            }
+        }
+        if (positive) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*
+ helper function, whether to train with solverTrain() rather than svm_train(): with more than one thread (<1: one per core) or a gramBudget, unless the kernel is PRECOMPUTED, where there are no kernel values to compute.
+ */
+
+static int rowSolver(const struct svm_parameter *param, int numThreads, double gramBudget){
+    return param->kernel_type != PRECOMPUTED && (numThreads != 1 || gramBudget>0);
+}
+
+/*
+ helper function, the kernel row cache of the solver: gramBudget MB, at least cacheBudget
+ */
+
+static double rowCacheBudget(double cacheBudget, double gramBudget){
+    return gramBudget>cacheBudget ? gramBudget : cacheBudget;
+}
+
+/*
+ trains prob with solverTrain(): the kernel rows the solver needs are computed on numThreads threads and cached in gramBudget MB (at least cacheBudget), no kernel matrix is built. The probability model is trained from folds drawn with seed, also by the solver.
+ The support vectors point into prob, as svm_train() does. On one thread without gramBudget, or with a PRECOMPUTED kernel, this is just parallelTrain(). Returns NULL if memory runs out.
+ */
+
+struct svm_model *gramTrain(const struct svm_problem *prob, const struct svm_parameter *param, unsigned int seed, int numThreads, double cacheBudget, double gramBudget){
+    if (!rowSolver(param, numThreads, gramBudget)) {
+        return parallelTrain(prob, param, seed, numThreads, cacheBudget);
+    }
+    return solverTrain(prob, NULL, param, seed, numThreads, rowCacheBudget(cacheBudget, gramBudget));
+}
+
+/*
+ nr_fold cross validation as parallelCrossValidation(), with the folds trained by the solver as in gramTrain(): the folds run concurrently, the threads that are left over compute their kernel rows, and gramBudget MB (at least cacheBudget) of kernel rows are split between the folds. Same folds and predictions for any number of threads.
+ On one thread without gramBudget, or with a PRECOMPUTED kernel, this is just parallelCrossValidation(). Returns -1 if memory runs out.
+ */
+
+int gramCrossValidation(const struct svm_problem *prob, const struct svm_parameter *param, int nr_fold, unsigned int seed, int numThreads, double cacheBudget, double gramBudget, double *target){
+    if (!rowSolver(param, numThreads, gramBudget)) {
+        return parallelCrossValidation(prob, param, 0, nr_fold, seed, numThreads, cacheBudget, target);
+    }
+    return solverCrossValidation(prob, param, nr_fold, seed, numThreads, rowCacheBudget(cacheBudget, gramBudget), target);
+}
+
+/*
+ parallelGridSearch() with the folds of every point trained by the solver, see gramCrossValidation(). The scores are the same for any number of threads.
+ On one thread without gramBudget, or with a PRECOMPUTED kernel, this is just parallelGridSearch(). Returns -1 if memory runs out.
+ */
+
+int gramGridSearch(const struct svm_problem *prob, const struct svm_parameter *param, const struct SVMGridPoint *points, int numPoints, int nr_fold, unsigned int seed, int numThreads, double cacheBudget, double gramBudget, double *scores){
+    if (!rowSolver(param, numThreads, gramBudget)) {
+        return parallelGridSearch(prob, param, points, numPoints, nr_fold, seed, numThreads, cacheBudget, scores);
+    }
+    return solverGridSearch(prob, param, points, numPoints, nr_fold, seed, numThreads, rowCacheBudget(cacheBudget, gramBudget), scores);
+}
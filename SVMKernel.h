@@ -0,0 +1,21 @@
+/*
+	SVMKernel.h -- threaded kernel rows and kernel matrices
+*/
+
+#ifndef SVM_KERNEL_H
+#define SVM_KERNEL_H
+
+#include "libSVM/svm.h"
+#include "SVMTraining.h"
+
+#define SVM_GRAM_MEMORY 1024 // default kernel row cache of /GRAM, in MB
+
+double sparseDot(const struct svm_node *px, const struct svm_node *py);
+void kernelValues(const struct svm_parameter *param, double xSquare, const double *ySquare, double *dots, int n);
+int kernelMatrix(struct svm_node *const *x, int m, struct svm_node *const *y, int n, const struct svm_parameter *param, int numThreads, double *values);
+int choleskyFactor(const double *K, int m, double *L);
+struct svm_model *gramTrain(const struct svm_problem *prob, const struct svm_parameter *param, unsigned int seed, int numThreads, double cacheBudget, double gramBudget);
+int gramCrossValidation(const struct svm_problem *prob, const struct svm_parameter *param, int nr_fold, unsigned int seed, int numThreads, double cacheBudget, double gramBudget, double *target);
+int gramGridSearch(const struct svm_problem *prob, const struct svm_parameter *param, const struct SVMGridPoint *points, int numPoints, int nr_fold, unsigned int seed, int numThreads, double cacheBudget, double gramBudget, double *scores);
+
+#endif
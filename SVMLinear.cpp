@@ -0,0 +1,355 @@
+/*	SVMLinear.cpp -- dual coordinate descent for linear SVMs
+
+	With a LINEAR kernel the SMO solver of svm_train() still works with kernel columns, every column costs a pass over
+	all samples and the cache only holds a few of them for large problems. The dual coordinate descent method of
+	liblinear (Hsieh et al., ICML 2008) keeps w=sum(coef[i]*x[i]) instead and updates one dual variable at a time, each
+	update costs two passes over the nodes of one sample. It solves the L1- and L2-loss SVC and SVR problems of liblinear
+	(solve_l2r_l1l2_svc() and solve_l2r_l1l2_svr()) with a bias feature of 1, so the bias is regularized as in liblinear
+	with -B 1.
+	The coefficients are those of the dual, the solution is returned as libSVM would: coef[i] is the coefficient of
+	sample i (0 for no support vector) and w·x+bias with w=sum(coef[i]*x[i]) and bias=sum(coef[i]) is the decision value.
+	The samples are visited in an order drawn from a fixed seed, the result doesn't depend on anything else.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "SVMLinear.h"
+#include "SVMTraining.h"
+
+#define Malloc(type,n) (type *)malloc((n)*sizeof(type)) //from libSVM
+
+enum {
+    SVM_LINEAR_MAX_ITER=1000, // outer iterations, same as liblinear
+    SVM_LINEAR_SEED=1 // seed of the order the samples are visited in
+};
+
+/*
+ helper function, w·x with the bias feature (weight w[dim], feature value 1)
+ */
+
+static double linearDot(const double *w, int dim, const struct svm_node *x){
+    double sum=w[dim];
+    for (; x->index != -1; x++) {
+        if (x->index>0) {
+            sum+=w[x->index-1]*x->value;
+        }
+    }
+    return sum;
+}
+
+/*
+ helper function, w+=d*x with the bias feature
+ */
+
+static void linearAdd(double *w, int dim, double d, const struct svm_node *x){
+    w[dim]+=d;
+    for (; x->index != -1; x++) {
+        if (x->index>0) {
+            w[x->index-1]+=d*x->value;
+        }
+    }
+}
+
+/*
+ helper function, allocates w (dim+1, zero), the diagonal QD (x·x+1 per sample) and the visiting order of l samples. *dim receives the largest feature index. Returns -1 if memory runs out.
+ */
+
+static int prepareDual(struct svm_node *const *x, int l, int *dim, double **w, double **QD, int **index){
+    *dim=0;
+    for (int i=0; i<l; i++) {
+        for (const struct svm_node *node=x[i]; node->index != -1; node++) {
+            if (node->index>*dim) {
+                *dim=node->index;
+            }
+        }
+    }
+    *w=(double *)calloc((size_t)*dim+1, sizeof(double));
+    *QD=Malloc(double, l>0 ? l : 1);
+    *index=Malloc(int, l>0 ? l : 1);
+    if (*w == NULL || *QD == NULL || *index == NULL) {
+        free(*w);
+        free(*QD);
+        free(*index);
+        return -1;
+    }
+    for (int i=0; i<l; i++) {
+        double xTx=1; // the bias feature
+        for (const struct svm_node *node=x[i]; node->index != -1; node++) {
+            if (node->index>0) {
+                xTx+=node->value*node->value;
+            }
+        }
+        (*QD)[i]=xTx;
+        (*index)[i]=i;
+    }
+    return 0;
+}
+
+/*
+ binary classification (y +1/-1) of l samples with the penalties Cp and Cn, same as solve_l2r_l1l2_svc() in liblinear. coef receives y[i]*alpha[i] per sample, *bias the weight of the bias feature.
+ eps is the stopping tolerance on the projected gradient. Returns -1 if memory runs out.
+ */
+
+int linearClassifierDual(struct svm_node *const *x, const double *y, int l, double Cp, double Cn, int loss, double eps, double *coef, double *bias){
+    int dim;
+    double *w;
+    double *QD;
+    int *index;
+    if (prepareDual(x, l, &dim, &w, &QD, &index)) {
+        return -1;
+    }
+    
+    // L2 loss: a diagonal term 1/(2C) and no upper bound, L1 loss: upper bound C
+    double diag[3]={0.5/Cn, 0, 0.5/Cp};
+    double upper_bound[3]={INFINITY, 0, INFINITY};
+    if (loss == SVM_LINEAR_L1LOSS) {
+        diag[0]=0;
+        diag[2]=0;
+        upper_bound[0]=Cn;
+        upper_bound[2]=Cp;
+    }
+    
+    double *alpha=coef; // alpha[i] until the end, then y[i]*alpha[i]
+    for (int i=0; i<l; i++) {
+        alpha[i]=0;
+        QD[i]+=diag[y[i]>0 ? 2 : 0];
+    }
+    
+    uint64_t state=randomState(SVM_LINEAR_SEED);
+    int active_size=l;
+    double PGmax_old=INFINITY;
+    double PGmin_old=-INFINITY;
+    for (int iter=0; iter<SVM_LINEAR_MAX_ITER; iter++) {
+        double PGmax_new=-INFINITY;
+        double PGmin_new=INFINITY;
+        
+        for (int i=0; i<active_size; i++) {
+            int j=i+(int)(nextRandom(&state)%(uint32_t)(active_size-i));
+            int tmp=index[i];
+            index[i]=index[j];
+            index[j]=tmp;
+        }
+        
+        for (int s=0; s<active_size; s++) {
+            int i=index[s];
+            int yi=y[i]>0 ? 1 : -1;
+            int GETI=yi+1;
+            double G=yi*linearDot(w, dim, x[i])-1+alpha[i]*diag[GETI];
+            double C=upper_bound[GETI];
+            double PG=0;
+            
+            if (alpha[i] == 0) {
+                if (G>PGmax_old) { // shrink
+                    active_size--;
+                    int tmp=index[s];
+                    index[s]=index[active_size];
+                    index[active_size]=tmp;
+                    s--;
+                    continue;
+                }
+                else if (G<0) {
+                    PG=G;
+                }
+            }
+            else if (alpha[i] == C) {
+                if (G<PGmin_old) {
+                    active_size--;
+                    int tmp=index[s];
+                    index[s]=index[active_size];
+                    index[active_size]=tmp;
+                    s--;
+                    continue;
+                }
+                else if (G>0) {
+                    PG=G;
+                }
+            }
+            else{
+                PG=G;
+            }
+            
+            PGmax_new=PGmax_new>PG ? PGmax_new : PG;
+            PGmin_new=PGmin_new<PG ? PGmin_new : PG;
+            
+            if (fabs(PG)>1.0e-12 && QD[i]>0) {
+                double alpha_old=alpha[i];
+                double a=alpha[i]-G/QD[i];
+                alpha[i]=a<0 ? 0 : (a>C ? C : a);
+                linearAdd(w, dim, (alpha[i]-alpha_old)*yi, x[i]);
+            }
+        }
+        
+        if (PGmax_new-PGmin_new <= eps) {
+            if (active_size == l) {
+                break;
+            }
+            active_size=l; // check all samples once more before stopping
+            PGmax_old=INFINITY;
+            PGmin_old=-INFINITY;
+            continue;
+        }
+        PGmax_old=PGmax_new;
+        PGmin_old=PGmin_new;
+        if (PGmax_old <= 0) {
+            PGmax_old=INFINITY;
+        }
+        if (PGmin_old >= 0) {
+            PGmin_old=-INFINITY;
+        }
+    }
+    
+    *bias=0;
+    for (int i=0; i<l; i++) {
+        coef[i]=y[i]>0 ? alpha[i] : -alpha[i];
+        *bias+=coef[i];
+    }
+    free(w);
+    free(QD);
+    free(index);
+    return 0;
+}
+
+/*
+ regression of l samples with targets y, penalty C and insensitive zone p, same as solve_l2r_l1l2_svr() in liblinear. coef receives beta[i] per sample, *bias the weight of the bias feature.
+ eps is the relative stopping tolerance on the violation of the optimality conditions. Returns -1 if memory runs out.
+ */
+
+int linearRegressionDual(struct svm_node *const *x, const double *y, int l, double C, double p, int loss, double eps, double *coef, double *bias){
+    int dim;
+    double *w;
+    double *QD;
+    int *index;
+    if (prepareDual(x, l, &dim, &w, &QD, &index)) {
+        return -1;
+    }
+    
+    // L2 loss: a diagonal term 1/(2C) and no upper bound, L1 loss: upper bound C
+    double lambda=0.5/C;
+    double upper_bound=INFINITY;
+    if (loss == SVM_LINEAR_L1LOSS) {
+        lambda=0;
+        upper_bound=C;
+    }
+    
+    double *beta=coef;
+    for (int i=0; i<l; i++) {
+        beta[i]=0;
+    }
+    
+    uint64_t state=randomState(SVM_LINEAR_SEED);
+    int active_size=l;
+    double Gmax_old=INFINITY;
+    double Gnorm1_init=-1.0; // Gnorm1_init is initialized at the first iteration
+    for (int iter=0; iter<SVM_LINEAR_MAX_ITER; iter++) {
+        double Gmax_new=0;
+        double Gnorm1_new=0;
+        
+        for (int i=0; i<active_size; i++) {
+            int j=i+(int)(nextRandom(&state)%(uint32_t)(active_size-i));
+            int tmp=index[i];
+            index[i]=index[j];
+            index[j]=tmp;
+        }
+        
+        for (int s=0; s<active_size; s++) {
+            int i=index[s];
+            double G=-y[i]+lambda*beta[i]+linearDot(w, dim, x[i]);
+            double H=QD[i]+lambda;
+            double Gp=G+p;
+            double Gn=G-p;
+            double violation=0;
+            int shrink=0;
+            
+            if (beta[i] == 0) {
+                if (Gp<0) {
+                    violation=-Gp;
+                }
+                else if (Gn>0) {
+                    violation=Gn;
+                }
+                else if (Gp>Gmax_old && Gn<-Gmax_old) {
+                    shrink=1;
+                }
+            }
+            else if (beta[i] >= upper_bound) {
+                if (Gp>0) {
+                    violation=Gp;
+                }
+                else if (Gp<-Gmax_old) {
+                    shrink=1;
+                }
+            }
+            else if (beta[i] <= -upper_bound) {
+                if (Gn<0) {
+                    violation=-Gn;
+                }
+                else if (Gn>Gmax_old) {
+                    shrink=1;
+                }
+            }
+            else if (beta[i]>0) {
+                violation=fabs(Gp);
+            }
+            else{
+                violation=fabs(Gn);
+            }
+            if (shrink) {
+                active_size--;
+                int tmp=index[s];
+                index[s]=index[active_size];
+                index[active_size]=tmp;
+                s--;
+                continue;
+            }
+            
+            Gmax_new=Gmax_new>violation ? Gmax_new : violation;
+            Gnorm1_new+=violation;
+            
+            // obtain Newton direction d
+            double d;
+            if (Gp<H*beta[i]) {
+                d=-Gp/H;
+            }
+            else if (Gn>H*beta[i]) {
+                d=-Gn/H;
+            }
+            else{
+                d=-beta[i];
+            }
+            if (fabs(d)<1.0e-12 || H <= 0) {
+                continue;
+            }
+            
+            double beta_old=beta[i];
+            double b=beta[i]+d;
+            beta[i]=b<-upper_bound ? -upper_bound : (b>upper_bound ? upper_bound : b);
+            d=beta[i]-beta_old;
+            if (d != 0) {
+                linearAdd(w, dim, d, x[i]);
+            }
+        }
+        
+        if (iter == 0) {
+            Gnorm1_init=Gnorm1_new;
+        }
+        if (Gnorm1_new <= eps*Gnorm1_init) {
+            if (active_size == l) {
+                break;
+            }
+            active_size=l; // check all samples once more before stopping
+            Gmax_old=INFINITY;
+            continue;
+        }
+        Gmax_old=Gmax_new;
+    }
+    
+    *bias=0;
+    for (int i=0; i<l; i++) {
+        *bias+=beta[i];
+    }
+    free(w);
+    free(QD);
+    free(index);
+    return 0;
+}
@@ -0,0 +1,20 @@
+/*
+	SVMLinear.h -- dual coordinate descent solvers for linear SVMs on libSVM nodes
+*/
+
+#ifndef SVM_LINEAR_H
+#define SVM_LINEAR_H
+
+#include "libSVM/svm.h"
+
+enum {
+    SVM_LINEAR_L1LOSS=1, // hinge loss (epsilon insensitive loss for regression)
+    SVM_LINEAR_L2LOSS=2 // squared hinge loss (squared epsilon insensitive loss for regression)
+};
+
+#define SVM_LINEAR_EPS 0.1 // default stopping tolerance, same as liblinear's dual solvers
+
+int linearClassifierDual(struct svm_node *const *x, const double *y, int l, double Cp, double Cn, int loss, double eps, double *coef, double *bias);
+int linearRegressionDual(struct svm_node *const *x, const double *y, int l, double C, double p, int loss, double eps, double *coef, double *bias);
+
+#endif
@@ -0,0 +1,350 @@
+/*	SVMModels.cpp -- registry of models that stay loaded between operations
+
+	Models are kept under an integer ID until they are freed with SVMModelFree or the XOP is unloaded.
+	Models loaded from a file remember path, modification time and size of the file, so loading the
+	same unchanged file again returns the resident model instead of parsing it again.
+	Binary model files (SVMBinaryModel.cpp) are mapped instead of parsed, their entries keep the mapping.
+	Models trained on an approximate RBF feature map (SVMFeatureMap.h) keep their map, SVMClassify maps the samples
+	with it before they are classified.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <map>
+#include <string>
+#include "SVMModels.h"
+#include "SVMBinaryModel.h"
+#include "SVMBatch.h"
+#include "SVMQuantize.h"
+#include "SVMFeatureMap.h"
+
+#define Malloc(type,n) (type *)malloc((n)*sizeof(type)) //from libSVM
+
+struct SVMModelEntry {
+    struct svm_model *model;
+    std::string path; // empty for models that were not loaded from a file
+    time_t modificationTime;
+    long long fileSize;
+    struct SVMMappedModel mapped; // mapped.mapping is NULL unless the model was mapped from a binary model file
+    struct SVMFeatureMap *featureMap; // NULL for models on the original samples, belongs to mapped for mapped models
+    struct SVMDenseModel *dense; // dense support vectors for batch prediction, built on first use
+    int denseTried; // set once makeDenseModel() was called, dense stays NULL if the model doesn't support it
+    int nodesReleased; // the node support vectors were freed by releaseSupportVectors(), model->SV holds NULL until nodeModelForID() rebuilds them from dense
+};
+
+static std::map<int, SVMModelEntry> models; // all resident models by ID
+static int nextModelID=1;
+
+/*
+ helper function to release the model of an entry, mapped models are not allocated by libSVM.
+ */
+
+static void destroyEntry(SVMModelEntry *entry){
+    freeDenseModel(entry->dense);
+    entry->dense=NULL;
+    if (entry->mapped.mapping != NULL) {
+        unmapBinaryModel(&entry->mapped);
+        entry->model=NULL;
+    }
+    else{
+        svm_free_and_destroy_model(&entry->model);
+        freeFeatureMap(entry->featureMap);
+    }
+    entry->featureMap=NULL;
+}
+
+/*
+ adds a model to the registry, the registry owns the model and its featureMap (NULL if it has none) from now on. path is the file the model was loaded from, NULL if it wasn't.
+ */
+
+int registerModel(struct svm_model *model, struct SVMFeatureMap *featureMap, const char *path, int *modelID){
+    SVMModelEntry entry;
+    entry.model=model;
+    entry.featureMap=featureMap;
+    entry.modificationTime=0;
+    entry.fileSize=-1;
+    entry.mapped.model=NULL;
+    entry.mapped.featureMap=NULL;
+    entry.mapped.mapping=NULL;
+    entry.mapped.mappingSize=0;
+    entry.dense=NULL;
+    entry.denseTried=0;
+    entry.nodesReleased=0;
+    
+    if (path != NULL) {
+        struct stat fileInfo;
+        if (stat(path, &fileInfo) == 0) {
+            entry.path=path;
+            entry.modificationTime=fileInfo.st_mtime;
+            entry.fileSize=(long long)fileInfo.st_size;
+        }
+    }
+    
+    *modelID=nextModelID++;
+    models[*modelID]=entry;
+    
+    if (model->param.kernel_type == LINEAR) { // collapse to the weight vectors right away, it is cheap and every prediction profits
+        denseModelForID(*modelID);
+    }
+    return 0;
+}
+
+/*
+ returns the model registered as modelID, NULL if there is none. Its support vectors may have been released (releaseSupportVectors()), nodeModelForID() returns it with nodes.
+ */
+
+struct svm_model *modelForID(int modelID){
+    std::map<int, SVMModelEntry>::iterator it=models.find(modelID);
+    if (it == models.end()) {
+        return NULL;
+    }
+    return it->second.model;
+}
+
+/*
+ returns the dense support vectors of the model registered as modelID for the batch prediction engine (SVMBatch.h), built on the first call. NULL if there is no such model or the engine doesn't support it.
+ */
+
+const struct SVMDenseModel *denseModelForID(int modelID){
+    std::map<int, SVMModelEntry>::iterator it=models.find(modelID);
+    if (it == models.end()) {
+        return NULL;
+    }
+    if (!it->second.denseTried) {
+        it->second.denseTried=1;
+        if (makeDenseModel(it->second.model, &it->second.dense)) {
+            it->second.dense=NULL;
+        }
+    }
+    return it->second.dense;
+}
+
+/*
+ replaces the dense support vectors of the model registered as modelID, e.g. by quantized ones (SVMQuantize.h). dense has to be built from modelForID(modelID) and belongs to the registry from now on. Returns -1 if there is no such model, dense is freed then.
+ */
+
+int replaceDenseModel(int modelID, struct SVMDenseModel *dense){
+    std::map<int, SVMModelEntry>::iterator it=models.find(modelID);
+    if (it == models.end()) {
+        freeDenseModel(dense);
+        return -1;
+    }
+    freeDenseModel(it->second.dense);
+    it->second.dense=dense;
+    it->second.denseTried=1;
+    return 0;
+}
+
+/*
+ frees the node support vectors of the model registered as modelID, its dense support vectors (e.g. quantized ones, see replaceDenseModel()) serve the predictions from now on: SVMClassify reads dense samples with the engine, nodeModelForID() rebuilds the nodes from the dense support vectors for everything else. Models mapped from a binary model file keep their nodes, they are part of the mapping.
+ Returns -1 if there is no such model or it has no dense support vectors, 1 if the nodes can't be released.
+ */
+
+int releaseSupportVectors(int modelID){
+    std::map<int, SVMModelEntry>::iterator it=models.find(modelID);
+    if (it == models.end() || it->second.dense == NULL || (it->second.dense->svT == NULL && it->second.dense->qT == NULL)) {
+        return -1;
+    }
+    struct svm_model *model=it->second.model;
+    if (it->second.mapped.mapping != NULL || !model->free_sv) {
+        return 1;
+    }
+    if (!it->second.nodesReleased && model->l>0) {
+        free(model->SV[0]); // one block, see ownSupportVectors()
+        for (int i=0; i<model->l; i++) {
+            model->SV[i]=NULL;
+        }
+        it->second.nodesReleased=1;
+    }
+    return 0;
+}
+
+/*
+ returns the model registered as modelID with node support vectors, for svm_predict() and everything else that reads model->SV. Nodes freed by releaseSupportVectors() are rebuilt from the dense support vectors, with the values the engine predicts with.
+ NULL if there is no such model or memory runs out.
+ */
+
+struct svm_model *nodeModelForID(int modelID){
+    std::map<int, SVMModelEntry>::iterator it=models.find(modelID);
+    if (it == models.end()) {
+        return NULL;
+    }
+    if (it->second.nodesReleased) {
+        if (supportVectorNodes(it->second.dense, it->second.model)) {
+            return NULL;
+        }
+        it->second.nodesReleased=0;
+    }
+    return it->second.model;
+}
+
+/*
+ memory held by the support vectors of the model registered as modelID, in bytes: its nodes (in the mapping for models mapped from a binary model file) and the dense support vectors of the engine. 0 if there is no such model.
+ */
+
+size_t residentSupportVectorBytes(int modelID){
+    std::map<int, SVMModelEntry>::iterator it=models.find(modelID);
+    if (it == models.end()) {
+        return 0;
+    }
+    const struct svm_model *model=it->second.model;
+    size_t numNodes=0;
+    for (int i=0; i<model->l && !it->second.nodesReleased; i++) {
+        const struct svm_node *node=model->SV[i];
+        if (model->param.kernel_type == PRECOMPUTED) {
+            numNodes+=2; // serial number and terminator
+            continue;
+        }
+        while (node->index != -1) {
+            node++;
+        }
+        numNodes+=node-model->SV[i]+1;
+    }
+    size_t bytes=numNodes*sizeof(struct svm_node);
+    if (it->second.dense != NULL) {
+        bytes+=supportVectorBytes(it->second.dense);
+    }
+    return bytes;
+}
+
+/*
+ returns the feature map of the model registered as modelID, NULL if there is no such model or it classifies the original samples.
+ */
+
+const struct SVMFeatureMap *featureMapForID(int modelID){
+    std::map<int, SVMModelEntry>::iterator it=models.find(modelID);
+    if (it == models.end()) {
+        return NULL;
+    }
+    return it->second.featureMap;
+}
+
+/*
+ returns the ID of a model loaded from path. If the file was loaded before and has not changed since (same modification time and size), the resident model is reused. Otherwise the file is mapped (binary model files) or parsed with svm_load_model (text model files), and an older model of that path is freed.
+ Returns -1 if the file can't be read or is not a model.
+ */
+
+int loadModel(const char *path, int *modelID){
+    struct stat fileInfo;
+    if (stat(path, &fileInfo) != 0) {
+        return -1;
+    }
+    
+    for (std::map<int, SVMModelEntry>::iterator it=models.begin(); it != models.end(); ++it) {
+        if (it->second.path == path) {
+            if (it->second.modificationTime == fileInfo.st_mtime && it->second.fileSize == (long long)fileInfo.st_size) { // unchanged, use the resident model
+                *modelID=it->first;
+                return 0;
+            }
+            destroyEntry(&it->second); // the file has changed, the cached model is outdated
+            models.erase(it);
+            break;
+        }
+    }
+    
+    if (isBinaryModelFile(path)) {
+        struct SVMMappedModel mapped;
+        if (mapBinaryModel(path, &mapped)) {
+            return -1;
+        }
+        registerModel(mapped.model, mapped.featureMap, path, modelID);
+        models[*modelID].mapped=mapped;
+        return 0;
+    }
+    
+    struct svm_model *model=svm_load_model(path);
+    if (model == NULL) {
+        return -1;
+    }
+    return registerModel(model, NULL, path, modelID);
+}
+
+/*
+ frees the model registered as modelID. Returns -1 if there is no such model.
+ */
+
+int freeModel(int modelID){
+    std::map<int, SVMModelEntry>::iterator it=models.find(modelID);
+    if (it == models.end()) {
+        return -1;
+    }
+    destroyEntry(&it->second);
+    models.erase(it);
+    return 0;
+}
+
+/*
+ frees all resident models, called by SVMModelFree /A and when Igor unloads the XOP.
+ */
+
+void freeAllModels(void){
+    for (std::map<int, SVMModelEntry>::iterator it=models.begin(); it != models.end(); ++it) {
+        destroyEntry(&it->second);
+    }
+    models.clear();
+}
+
+/*
+ svm_train() doesn't copy the support vectors, model->SV points into the nodes of the training problem. This copies them into one buffer owned by the model, so the model stays valid after the problem is freed (free_sv makes svm_free_model_content() release the buffer).
+ The weights in model->param belong to the training parameters as well and are dropped, they are not needed for prediction.
+ Returns -1 if the buffer can't be allocated.
+ */
+
+int ownSupportVectors(struct svm_model *model){
+    model->param.nr_weight=0;
+    model->param.weight_label=NULL;
+    model->param.weight=NULL;
+    
+    if (model->free_sv || model->l == 0) {
+        return 0;
+    }
+    
+    int precomputed=model->param.kernel_type == PRECOMPUTED; // only the serial number is needed, the kernel values come with the samples
+    size_t numNodes=0;
+    for (int i=0; i<model->l; i++) {
+        const struct svm_node *node=model->SV[i];
+        while (node->index != -1 && !precomputed) {
+            node++;
+        }
+        numNodes+=precomputed ? 2 : node-model->SV[i]+1; // including the terminator
+    }
+    
+    struct svm_node *buffer=Malloc(struct svm_node, numNodes);
+    if (buffer == NULL) {
+        return -1;
+    }
+    
+    size_t offset=0;
+    for (int i=0; i<model->l; i++) {
+        const struct svm_node *node=model->SV[i];
+        struct svm_node *copy=buffer+offset;
+        if (precomputed) {
+            buffer[offset++]=*node;
+            buffer[offset].index=-1;
+            buffer[offset++].value=0;
+        }
+        else{
+            do {
+                buffer[offset++]=*node;
+            } while ((node++)->index != -1);
+        }
+        model->SV[i]=copy;
+    }
+    model->free_sv=1; // SV[0] is the start of buffer
+    
+    return 0;
+}
+
+/*
+ writes a model file, as binary model file if binary is set or path ends with .svmb, otherwise in the text format of libSVM. Returns 0 on success.
+ The text format has no place for a feature map, models with featureMap are always written as binary model files.
+ */
+
+int saveModel(const char *path, const struct svm_model *model, const struct SVMFeatureMap *featureMap, int binary){
+    if (binary || featureMap != NULL || isBinaryModelPath(path)) {
+        return saveBinaryModel(path, model, featureMap);
+    }
+    return svm_save_model(path, model);
+}
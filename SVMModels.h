@@ -0,0 +1,28 @@
+/*
+	SVMModels.h -- registry of models that stay loaded between operations
+*/
+
+#ifndef SVM_MODELS_H
+#define SVM_MODELS_H
+
+#include <stddef.h>
+#include "libSVM/svm.h"
+
+struct SVMDenseModel;
+struct SVMFeatureMap;
+
+int registerModel(struct svm_model *model, struct SVMFeatureMap *featureMap, const char *path, int *modelID);
+struct svm_model *modelForID(int modelID);
+const struct SVMDenseModel *denseModelForID(int modelID);
+int replaceDenseModel(int modelID, struct SVMDenseModel *dense);
+int releaseSupportVectors(int modelID);
+struct svm_model *nodeModelForID(int modelID);
+size_t residentSupportVectorBytes(int modelID);
+const struct SVMFeatureMap *featureMapForID(int modelID);
+int loadModel(const char *path, int *modelID);
+int freeModel(int modelID);
+void freeAllModels(void);
+int ownSupportVectors(struct svm_model *model);
+int saveModel(const char *path, const struct svm_model *model, const struct SVMFeatureMap *featureMap, int binary);
+
+#endif
@@ -0,0 +1,122 @@
+/*	SVMPredict.cpp -- prediction helpers for SVM XOP
+*/
+
+#include <stdlib.h>
+#include <math.h>
+#include "SVMPredict.h"
+
+/*
+ Platt's sigmoid for one pair of classes, same as sigmoid_predict() in svm.cpp
+ */
+
+static double sigmoidPredict(double decisionValue, double A, double B){
+    double fApB=decisionValue*A+B;
+    if (fApB >= 0) { // 1-p used later; avoid catastrophic cancellation
+        return exp(-fApB)/(1.0+exp(-fApB));
+    }
+    else{
+        return 1.0/(1+exp(fApB));
+    }
+}
+
+/*
+ pairwise coupling of the class probabilities (Wu, Lin and Weng, method 2), same as multiclass_probability() in svm.cpp. r is k x k row-major, Q (k x k) and Qp (k) are scratch.
+ */
+
+static void multiclassProbability(int k, const double *r, double *p, double *Q, double *Qp){
+    int t,j;
+    int iter=0;
+    int max_iter=k>100 ? k : 100;
+    double pQp;
+    double eps=0.005/k;
+    
+    for (t=0; t<k; t++) {
+        p[t]=1.0/k;  // Valid if k = 1
+        Q[t*k+t]=0;
+        for (j=0; j<t; j++) {
+            Q[t*k+t]+=r[j*k+t]*r[j*k+t];
+            Q[t*k+j]=Q[j*k+t];
+        }
+        for (j=t+1; j<k; j++) {
+            Q[t*k+t]+=r[j*k+t]*r[j*k+t];
+            Q[t*k+j]=-r[j*k+t]*r[t*k+j];
+        }
+    }
+    for (iter=0; iter<max_iter; iter++) {
+        // stopping condition, recalculate QP,pQP for numerical accuracy
+        pQp=0;
+        for (t=0; t<k; t++) {
+            Qp[t]=0;
+            for (j=0; j<k; j++) {
+                Qp[t]+=Q[t*k+j]*p[j];
+            }
+            pQp+=p[t]*Qp[t];
+        }
+        double max_error=0;
+        for (t=0; t<k; t++) {
+            double error=fabs(Qp[t]-pQp);
+            if (error>max_error) {
+                max_error=error;
+            }
+        }
+        if (max_error<eps) {
+            break;
+        }
+        
+        for (t=0; t<k; t++) {
+            double diff=(-Qp[t]+pQp)/Q[t*k+t];
+            p[t]+=diff;
+            pQp=(pQp+diff*(diff*Q[t*k+t]+2*Qp[t]))/(1+diff)/(1+diff);
+            for (j=0; j<k; j++) {
+                Qp[j]=(Qp[j]+diff*Q[t*k+j])/(1+diff);
+                p[j]/=(1+diff);
+            }
+        }
+    }
+}
+
+/*
+ number of doubles probabilityFromDecisionValues() needs as scratch for a model with nr_class classes: the pairwise probabilities and the matrix of the coupling.
+ */
+
+size_t probabilityScratchSize(int nr_class){
+    return 2*(size_t)nr_class*nr_class+nr_class;
+}
+
+/*
+ computes the probability estimates of a C_SVC or NU_SVC model with probability information from the decision values of svm_predict_values(). Gives the same result as svm_predict_probability(), but the decision values don't have to be evaluated a second time.
+ Returns the predicted label (class with the highest probability), prob_estimates needs to hold nr_class values and scratch probabilityScratchSize(nr_class), so a worker can reuse its own buffers for every sample.
+ */
+
+double probabilityFromDecisionValues(const struct svm_model *model, const double *decisionValues, double *prob_estimates, double *scratch){
+    int nr_class=model->nr_class;
+    double min_prob=1e-7;
+    double *pairwise_prob=scratch; // nr_class x nr_class, row-major
+    
+    int k=0;
+    for (int i=0; i<nr_class; i++) {
+        for (int j=i+1; j<nr_class; j++) {
+            double prob=sigmoidPredict(decisionValues[k],model->probA[k],model->probB[k]);
+            pairwise_prob[i*nr_class+j]=fmin(fmax(prob,min_prob),1-min_prob);
+            pairwise_prob[j*nr_class+i]=1-pairwise_prob[i*nr_class+j];
+            k++;
+        }
+    }
+    
+    if (nr_class == 2) {
+        prob_estimates[0]=pairwise_prob[1];
+        prob_estimates[1]=pairwise_prob[2];
+    }
+    else{
+        multiclassProbability(nr_class,pairwise_prob,prob_estimates,scratch+(size_t)nr_class*nr_class,scratch+2*(size_t)nr_class*nr_class);
+    }
+    
+    int prob_max_idx=0;
+    for (int i=1; i<nr_class; i++) {
+        if (prob_estimates[i] > prob_estimates[prob_max_idx]) {
+            prob_max_idx=i;
+        }
+    }
+    
+    return model->label[prob_max_idx];
+}
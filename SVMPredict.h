@@ -0,0 +1,14 @@
+/*
+	SVMPredict.h -- prediction helpers for SVM XOP that work on libSVM models directly
+*/
+
+#ifndef SVM_PREDICT_H
+#define SVM_PREDICT_H
+
+#include <stddef.h>
+#include "libSVM/svm.h"
+
+size_t probabilityScratchSize(int nr_class);
+double probabilityFromDecisionValues(const struct svm_model *model, const double *decisionValues, double *prob_estimates, double *scratch);
+
+#endif
@@ -0,0 +1,409 @@
+/*	SVMQuantize.cpp -- compact support vectors for SVM XOP
+
+	The batch prediction engine (SVMBatch.cpp) streams the dense support vectors of a model once per batch of
+	samples, 8 bytes per value. For large models that is most of the memory a resident model holds and most of
+	the memory traffic of a prediction. makeQuantizedModel() stores them as half floats (2 bytes) or 8 bit
+	integers (1 byte) instead, each feature scaled by its largest magnitude so that the levels cover the values
+	that occur. The kernels below read the compact values and convert them in the innermost loop, which stays
+	a straight loop over a block of support vectors like the one in SVMBatch.cpp; sums, decision values and
+	voting are in double precision as before. Half floats keep 11 significant bits, 8 bit integers a step of
+	1/127 of the largest value of a feature: the decision values change a little, labels rarely.
+	quantizationReport() predicts validation samples with the compact and the full precision model to show
+	what it costs.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "SVMQuantize.h"
+#include "SVMBatch.h"
+#include "SVMThreads.h"
+
+#define Malloc(type,n) (type *)malloc((n)*sizeof(type)) //from libSVM
+
+/*
+ helper function, half float (IEEE 754 binary16) nearest to v, |v| <= 1.
+ */
+
+static uint16_t halfFromDouble(double v){
+    uint16_t sign=v<0 ? 0x8000 : 0;
+    double magnitude=fabs(v);
+    if (magnitude<ldexp(1.0, -14)) { // subnormal, multiples of 2^-24
+        return sign | (uint16_t)lround(ldexp(magnitude, 24));
+    }
+    int exponent;
+    double fraction=frexp(magnitude, &exponent); // magnitude=fraction*2^exponent, 0.5 <= fraction < 1
+    long mantissa=lround((2*fraction-1)*1024);
+    exponent+=14; // biased exponent of 2*fraction
+    if (mantissa == 1024) { // rounded up to the next power of 2
+        mantissa=0;
+        exponent++;
+    }
+    return sign | (uint16_t)(exponent<<10) | (uint16_t)mantissa;
+}
+
+/*
+ helper function, value of a half float: exponent and mantissa moved into a float and rebiased with one multiplication, which covers subnormals as well. No infinities or NaNs, the values are scaled to |v| <= 1.
+ */
+
+static inline double quantizedValue(uint16_t h){
+    uint32_t bits=(uint32_t)(h & 0x7fff)<<13;
+    float magnitude;
+    memcpy(&magnitude, &bits, sizeof(magnitude));
+    magnitude*=5.192296858534828e33f; // 2^112, from exponent bias 127 to 15
+    memcpy(&bits, &magnitude, sizeof(bits));
+    bits|=(uint32_t)(h & 0x8000)<<16;
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return (double)value;
+}
+
+static inline double quantizedValue(int8_t q){
+    return (double)q;
+}
+
+/*
+ builds the dense support vectors of model for the batch prediction engine (see makeDenseModel()), stored as quantization (SVMQuantization). With SVM_QUANTIZE_NONE this is makeDenseModel().
+ Returns -1 if the engine doesn't support the model, if it is LINEAR (collapsed to weight vectors, nothing to quantize) or if memory runs out.
+ */
+
+int makeQuantizedModel(const struct svm_model *model, int quantization, struct SVMDenseModel **dense){
+    struct SVMDenseModel *result;
+    if (makeDenseModel(model, &result)) {
+        return -1;
+    }
+    if (result->svT == NULL) {
+        freeDenseModel(result);
+        return -1;
+    }
+    if (quantization == SVM_QUANTIZE_NONE) {
+        *dense=result;
+        return 0;
+    }
+    
+    const int l=result->l;
+    const int dim=result->dim;
+    size_t size=(size_t)dim*l;
+    result->scale=Malloc(double, dim>0 ? dim : 1);
+    result->qT=malloc((size>0 ? size : 1)*(quantization == SVM_QUANTIZE_INT8 ? sizeof(int8_t) : sizeof(uint16_t)));
+    if (result->scale == NULL || result->qT == NULL) {
+        freeDenseModel(result);
+        return -1;
+    }
+    
+    for (int k=0; k<dim; k++) {
+        const double *sv=result->svT+(size_t)k*l;
+        double largest=0;
+        for (int s=0; s<l; s++) {
+            if (fabs(sv[s])>largest) {
+                largest=fabs(sv[s]);
+            }
+        }
+        if (quantization == SVM_QUANTIZE_INT8) {
+            int8_t *q=(int8_t*)result->qT+(size_t)k*l;
+            result->scale[k]=largest/127;
+            for (int s=0; s<l; s++) {
+                q[s]=largest>0 ? (int8_t)lround(sv[s]/result->scale[k]) : 0;
+            }
+        }
+        else{
+            uint16_t *q=(uint16_t*)result->qT+(size_t)k*l;
+            result->scale[k]=largest;
+            for (int s=0; s<l; s++) {
+                q[s]=largest>0 ? halfFromDouble(sv[s]/largest) : 0;
+            }
+        }
+    }
+    result->quantization=quantization;
+    free(result->svT); // the engine reads qT from now on
+    result->svT=NULL;
+    *dense=result;
+    return 0;
+}
+
+/*
+ memory held by the support vectors of a dense model in the engine, in bytes.
+ */
+
+size_t supportVectorBytes(const struct SVMDenseModel *dense){
+    size_t size=(size_t)dense->dim*dense->l;
+    switch (dense->quantization) {
+        case SVM_QUANTIZE_FLOAT16:
+            return size*sizeof(uint16_t)+dense->dim*sizeof(double);
+        case SVM_QUANTIZE_INT8:
+            return size*sizeof(int8_t)+dense->dim*sizeof(double);
+        default:
+            return dense->svT != NULL ? size*sizeof(double) : (size_t)dense->numDecisionValues*dense->dim*sizeof(double);
+    }
+}
+
+/*
+ helper function, feature k of support vector s of a dense model as the engine sees it.
+ */
+
+static double denseValue(const struct SVMDenseModel *dense, int k, int s){
+    size_t i=(size_t)k*dense->l+s;
+    switch (dense->quantization) {
+        case SVM_QUANTIZE_FLOAT16:
+            return dense->scale[k]*quantizedValue(((const uint16_t*)dense->qT)[i]);
+        case SVM_QUANTIZE_INT8:
+            return dense->scale[k]*quantizedValue(((const int8_t*)dense->qT)[i]);
+        default:
+            return dense->svT[i];
+    }
+}
+
+/*
+ gives model node support vectors again, built from its dense support vectors (dense from makeQuantizedModel() of model): the values the engine predicts with, zeros left out. The nodes are one block owned by the model (free_sv) like those of a model loaded from a file, model->SV has to hold no nodes.
+ Returns -1 if memory runs out or dense has no support vectors (LINEAR models).
+ */
+
+int supportVectorNodes(const struct SVMDenseModel *dense, struct svm_model *model){
+    const int l=dense->l;
+    const int dim=dense->dim;
+    if ((dense->svT == NULL && dense->qT == NULL) || l != model->l) {
+        return -1;
+    }
+    size_t *offset=Malloc(size_t, l+1);
+    if (offset == NULL) {
+        return -1;
+    }
+    for (int s=0; s<=l; s++) {
+        offset[s]=s; // the terminators
+    }
+    for (int k=0; k<dim; k++) { // feature-major, as stored
+        for (int s=0; s<l; s++) {
+            if (denseValue(dense, k, s) != 0) {
+                offset[s+1]++;
+            }
+        }
+    }
+    for (int s=0; s<l; s++) { // counts to the start of each support vector
+        offset[s+1]+=offset[s]-s;
+    }
+    struct svm_node *nodes=Malloc(struct svm_node, offset[l]>0 ? offset[l] : 1);
+    if (nodes == NULL) {
+        free(offset);
+        return -1;
+    }
+    
+    for (int s=0; s<l; s++) {
+        model->SV[s]=nodes+offset[s];
+    }
+    for (int k=0; k<dim; k++) {
+        for (int s=0; s<l; s++) {
+            double value=denseValue(dense, k, s);
+            if (value != 0) {
+                nodes[offset[s]].index=k+1;
+                nodes[offset[s]++].value=value;
+            }
+        }
+    }
+    for (int s=0; s<l; s++) {
+        nodes[offset[s]].index=-1;
+        nodes[offset[s]].value=0;
+    }
+    model->free_sv=1; // svm_free_model_content() frees SV[0], the start of the block
+    free(offset);
+    return 0;
+}
+
+/*
+ helper function, denseDotProducts() on the compact support vectors Q (dim x l): each feature of the sample is scaled once, the products are added in ascending feature order.
+ */
+
+template <typename Q>
+static void dotProducts(const struct SVMDenseModel *dense, const Q *qT, const double *samples, size_t numSamples, int columns, double *dots){
+    const int l=dense->l;
+    const int common=columns<dense->dim ? columns : dense->dim;
+    
+    for (int s0=0; s0<l; s0+=SVM_SV_BLOCK) {
+        const int n=l-s0<SVM_SV_BLOCK ? l-s0 : SVM_SV_BLOCK;
+        
+        for (size_t i=0; i<numSamples; i++) {
+            const double *x=samples+i*columns;
+            double *acc=dots+i*l+s0;
+            for (int s=0; s<n; s++) {
+                acc[s]=0;
+            }
+            for (int k=0; k<common; k++) {
+                if (x[k] == 0) {
+                    continue;
+                }
+                const double xk=x[k]*dense->scale[k];
+                const Q *sv=qT+(size_t)k*l+s0;
+                for (int s=0; s<n; s++) {
+                    acc[s]+=xk*quantizedValue(sv[s]);
+                }
+            }
+        }
+    }
+}
+
+/*
+ helper function, squared distances between the samples and the compact support vectors Q (dim x l), in the order of denseKernelValues().
+ */
+
+template <typename Q>
+static void distances(const struct SVMDenseModel *dense, const Q *qT, const double *samples, size_t numSamples, int columns, double *result){
+    const int l=dense->l;
+    const int dim=dense->dim;
+    const int common=columns<dim ? columns : dim;
+    
+    for (int s0=0; s0<l; s0+=SVM_SV_BLOCK) {
+        const int n=l-s0<SVM_SV_BLOCK ? l-s0 : SVM_SV_BLOCK;
+        
+        for (size_t i=0; i<numSamples; i++) {
+            const double *x=samples+i*columns;
+            double *acc=result+i*l+s0;
+            for (int s=0; s<n; s++) {
+                acc[s]=0;
+            }
+            
+            int k=0;
+            for (; k<common; k++) {
+                const double xk=x[k];
+                const double scale=dense->scale[k];
+                const Q *sv=qT+(size_t)k*l+s0;
+                for (int s=0; s<n; s++) {
+                    double d=xk-scale*quantizedValue(sv[s]);
+                    acc[s]+=d*d;
+                }
+            }
+            for (; k<dim; k++) { // features only the support vectors have
+                const double scale=dense->scale[k];
+                const Q *sv=qT+(size_t)k*l+s0;
+                for (int s=0; s<n; s++) {
+                    double v=scale*quantizedValue(sv[s]);
+                    acc[s]+=v*v;
+                }
+            }
+            for (; k<columns; k++) { // features only the sample has
+                const double x2=x[k]*x[k];
+                for (int s=0; s<n; s++) {
+                    acc[s]+=x2;
+                }
+            }
+        }
+    }
+}
+
+/*
+ dot products of numSamples samples (row-major, columns values per sample) with the compact support vectors of a quantized model, written to dots (numSamples x l, row-major), see denseDotProducts().
+ */
+
+void quantizedDotProducts(const struct SVMDenseModel *dense, const double *samples, size_t numSamples, int columns, double *dots){
+    if (dense->quantization == SVM_QUANTIZE_INT8) {
+        dotProducts(dense, (const int8_t*)dense->qT, samples, numSamples, columns, dots);
+    }
+    else{
+        dotProducts(dense, (const uint16_t*)dense->qT, samples, numSamples, columns, dots);
+    }
+}
+
+/*
+ squared distances of numSamples samples (row-major, columns values per sample) to the compact support vectors of a quantized model, written to distances (numSamples x l, row-major), for the RBF kernel.
+ */
+
+void quantizedDistances(const struct SVMDenseModel *dense, const double *samples, size_t numSamples, int columns, double *result){
+    if (dense->quantization == SVM_QUANTIZE_INT8) {
+        distances(dense, (const int8_t*)dense->qT, samples, numSamples, columns, result);
+    }
+    else{
+        distances(dense, (const uint16_t*)dense->qT, samples, numSamples, columns, result);
+    }
+}
+
+// predicts blocks of samples with the batch prediction engine, shared by all workers of SVMParallelFor()
+struct EnginePredictionRows {
+    const struct SVMDenseModel *dense;
+    const SVMDataBlock *samples;
+    size_t batchRows;
+    double *rows; // batchRows x columns per worker
+    double *kvalues; // batchRows x l per worker
+    double *decisionValues; // numDecisionValues per worker
+    int *vote; // nr_class per worker
+    double *target;
+    
+    void operator()(size_t begin, size_t end, int thread){
+        const size_t count=end-begin;
+        double *threadRows=rows+(size_t)thread*batchRows*samples->columns;
+        double *threadKValues=kvalues+(size_t)thread*batchRows*dense->l;
+        SVMBlockToMatrix(*samples, begin, count, threadRows);
+        denseKernelValues(dense, threadRows, count, samples->columns, threadKValues);
+        for (size_t i=0; i<count; i++) {
+            target[begin+i]=denseDecisionValues(dense, threadKValues+i*dense->l, decisionValues+(size_t)thread*dense->numDecisionValues, vote+(size_t)thread*dense->model->nr_class);
+        }
+    }
+};
+
+/*
+ compares a quantized model with the full precision model of the same svm_model: predicts the validation samples (rows of samples) with both on up to numThreads workers and fills report, labels holds the true label or value of each sample.
+ Returns -1 if memory runs out.
+ */
+
+int quantizationReport(const struct SVMDenseModel *quantized, const struct SVMDenseModel *full, const SVMDataBlock *samples, const double *labels, int numThreads, struct SVMQuantizationReport *report){
+    const size_t numSamples=samples->rows;
+    const int svm_type=full->model->param.svm_type;
+    const int regression=svm_type == EPSILON_SVR || svm_type == NU_SVR;
+    
+    EnginePredictionRows rows;
+    rows.samples=samples;
+    rows.batchRows=denseBatchRows(full);
+    int workers=SVMNumberOfThreads(numThreads, (numSamples+rows.batchRows-1)/rows.batchRows);
+    rows.rows=Malloc(double, rows.batchRows*(samples->columns>0 ? samples->columns : 1)*workers);
+    rows.kvalues=Malloc(double, rows.batchRows*full->l*workers);
+    rows.decisionValues=Malloc(double, (size_t)full->numDecisionValues*workers);
+    rows.vote=Malloc(int, (size_t)(full->model->nr_class>0 ? full->model->nr_class : 1)*workers);
+    double *quantizedTarget=Malloc(double, numSamples>0 ? numSamples : 1);
+    double *fullTarget=Malloc(double, numSamples>0 ? numSamples : 1);
+    if (rows.rows == NULL || rows.kvalues == NULL || rows.decisionValues == NULL || rows.vote == NULL || quantizedTarget == NULL || fullTarget == NULL) {
+        free(rows.rows);
+        free(rows.kvalues);
+        free(rows.decisionValues);
+        free(rows.vote);
+        free(quantizedTarget);
+        free(fullTarget);
+        return -1;
+    }
+    
+    rows.dense=quantized;
+    rows.target=quantizedTarget;
+    SVMParallelFor(numSamples, rows.batchRows, workers, rows);
+    rows.dense=full;
+    rows.target=fullTarget;
+    SVMParallelFor(numSamples, rows.batchRows, workers, rows);
+    
+    double quantizedScore=0;
+    double fullScore=0;
+    double difference=0;
+    for (size_t i=0; i<numSamples; i++) {
+        if (regression) {
+            quantizedScore+=(quantizedTarget[i]-labels[i])*(quantizedTarget[i]-labels[i]);
+            fullScore+=(fullTarget[i]-labels[i])*(fullTarget[i]-labels[i]);
+            difference+=(quantizedTarget[i]-fullTarget[i])*(quantizedTarget[i]-fullTarget[i]);
+        }
+        else if (svm_type == ONE_CLASS) { // correct: the sample is in the known data, as for the cross validation of SVMTrain
+            quantizedScore+=quantizedTarget[i]>0;
+            fullScore+=fullTarget[i]>0;
+            difference+=quantizedTarget[i] != fullTarget[i];
+        }
+        else{
+            quantizedScore+=quantizedTarget[i] == labels[i];
+            fullScore+=fullTarget[i] == labels[i];
+            difference+=quantizedTarget[i] != fullTarget[i];
+        }
+    }
+    double scale=numSamples>0 ? (regression ? 1.0/numSamples : 100.0/numSamples) : 0;
+    report->quantizedScore=quantizedScore*scale;
+    report->fullScore=fullScore*scale;
+    report->difference=difference*scale;
+    
+    free(rows.rows);
+    free(rows.kvalues);
+    free(rows.decisionValues);
+    free(rows.vote);
+    free(quantizedTarget);
+    free(fullTarget);
+    return 0;
+}
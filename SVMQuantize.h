@@ -0,0 +1,35 @@
+/*
+	SVMQuantize.h -- compact half float and 8 bit support vectors for the batch prediction engine
+*/
+
+#ifndef SVM_QUANTIZE_H
+#define SVM_QUANTIZE_H
+
+#include <stddef.h>
+#include "libSVM/svm.h"
+#include "SVMWaveData.h"
+
+struct SVMDenseModel;
+
+// storage of the dense support vectors of a SVMDenseModel
+enum SVMQuantization {
+    SVM_QUANTIZE_NONE, // doubles, svT
+    SVM_QUANTIZE_FLOAT16, // half floats relative to the largest value of each feature, 2 bytes per value
+    SVM_QUANTIZE_INT8 // 8 bit integers, 255 levels between -max and max of each feature, 1 byte per value
+};
+
+// how the predictions of a quantized model compare to the full precision model, on validation samples
+struct SVMQuantizationReport {
+    double quantizedScore; // accuracy in % (classification and ONE_CLASS) or mean squared error (regression) of the quantized model
+    double fullScore; // same for the full precision model
+    double difference; // % of the samples predicted differently (classification and ONE_CLASS) or mean squared difference of the predictions (regression)
+};
+
+int makeQuantizedModel(const struct svm_model *model, int quantization, struct SVMDenseModel **dense);
+size_t supportVectorBytes(const struct SVMDenseModel *dense);
+int supportVectorNodes(const struct SVMDenseModel *dense, struct svm_model *model);
+void quantizedDotProducts(const struct SVMDenseModel *dense, const double *samples, size_t numSamples, int columns, double *dots);
+void quantizedDistances(const struct SVMDenseModel *dense, const double *samples, size_t numSamples, int columns, double *distances);
+int quantizationReport(const struct SVMDenseModel *quantized, const struct SVMDenseModel *full, const SVMDataBlock *samples, const double *labels, int numThreads, struct SVMQuantizationReport *report);
+
+#endif
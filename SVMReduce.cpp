@@ -0,0 +1,589 @@
+/*	SVMReduce.cpp -- reduced-set models for SVM XOP
+
+	Predicting a sample costs one kernel evaluation per support vector, and models trained on noisy or overlapping
+	data keep many support vectors whose small coefficients hardly change the decision values. reduceModel() keeps
+	the support vectors with the largest coefficients and fits new coefficients to them: of all functions of the
+	kept vectors S, the one closest to a decision function f(x)=sum(a_i*K(x_i,x))-rho in the feature space of
+	the kernel is the projection b=K_SS^-1*K_SA*a, A the support vectors of f. It is solved with the Cholesky
+	factor of K_SS, K_SA is evaluated in blocks of columns. rho is shifted so that the decision values at the
+	support vectors of f change by 0 on average, the largest change there is the error of the reduction.
+	With a bound for that error the smallest model within the bound is searched for, doubling the number of kept
+	vectors and bisecting. The reduced model is an ordinary svm_model with its own support vectors, it is saved,
+	loaded and classified as any other model. The probability model (probA, probB) is kept as it is, it is fitted
+	to decision values that change little.
+	reductionReport() predicts validation samples with both models to show speed and agreement.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include "SVMReduce.h"
+#include "SVMKernel.h"
+#include "SVMBatch.h"
+#include "SVMThreads.h"
+
+#define Malloc(type,n) (type *)malloc((n)*sizeof(type)) //from libSVM
+
+enum {
+    SVM_REDUCE_FIRST_SV=16 // kept support vectors the search within an error bound starts with
+};
+
+// what all reductions of one model share
+struct SVMReduction {
+    const struct svm_model *model;
+    int classification;
+    int numFunctions;
+    int *start; // first support vector of each class, classification only
+    double *decValues; // decision values of the support vectors of the model, l x numFunctions, row-major
+    double *importance; // largest |coefficient| of each support vector
+    int *order; // support vectors, most important first
+    int numThreads;
+};
+
+// decision values of the support vectors of a model, shared by all workers of SVMParallelFor()
+struct SupportVectorValues {
+    const struct svm_model *model;
+    int numFunctions;
+    double *decValues; // model->l x numFunctions, row-major
+    
+    void operator()(size_t begin, size_t end, int){
+        for (size_t i=begin; i<end; i++) {
+            svm_predict_values(model, model->SV[i], decValues+i*numFunctions);
+        }
+    }
+};
+
+// orders support vectors by importance, the first one of equal ones first
+struct MoreImportant {
+    const double *importance;
+    
+    bool operator()(int i, int j) const{
+        return importance[i]>importance[j] || (importance[i] == importance[j] && i<j);
+    }
+};
+
+/*
+ helper function, the row of sv_coef that holds the coefficient of support vector k (of class a or b) for the decision function of the pair (a,b), see svm_predict_values(). a<0 for the single function of ONE_CLASS and regression models.
+ */
+
+static int coefficientRow(const struct svm_model *model, const int *start, int a, int b, int k){
+    if (a<0) {
+        return 0;
+    }
+    return k >= start[a] && k<start[a]+model->nSV[a] ? b-1 : a;
+}
+
+/*
+ helper function, decision values, importance and order of the support vectors of model, computed on numThreads threads (<1: one per core). Returns -1 if memory runs out.
+ */
+
+static int makeReduction(const struct svm_model *model, int numThreads, struct SVMReduction *r){
+    const int l=model->l;
+    const int nr_class=model->nr_class;
+    const int svm_type=model->param.svm_type;
+    r->model=model;
+    r->classification=(svm_type == C_SVC || svm_type == NU_SVC) && model->nSV != NULL;
+    r->numFunctions=r->classification ? nr_class*(nr_class-1)/2 : 1;
+    r->numThreads=numThreads;
+    r->start=Malloc(int, nr_class>0 ? nr_class : 1);
+    r->decValues=Malloc(double, (size_t)l*(r->numFunctions>0 ? r->numFunctions : 1));
+    r->importance=(double *)calloc(l, sizeof(double));
+    r->order=Malloc(int, l);
+    if (r->start == NULL || r->decValues == NULL || r->importance == NULL || r->order == NULL) {
+        free(r->start);
+        free(r->decValues);
+        free(r->importance);
+        free(r->order);
+        return -1;
+    }
+    
+    if (r->classification && nr_class>0) {
+        r->start[0]=0;
+        for (int i=1; i<nr_class; i++) {
+            r->start[i]=r->start[i-1]+model->nSV[i-1];
+        }
+    }
+    
+    SupportVectorValues rows;
+    rows.model=model;
+    rows.numFunctions=r->numFunctions;
+    rows.decValues=r->decValues;
+    SVMParallelFor((size_t)l, 64, SVMNumberOfThreads(numThreads, (size_t)l), rows);
+    
+    const int numRows=r->classification ? nr_class-1 : 1;
+    for (int k=0; k<l; k++) {
+        for (int row=0; row<numRows; row++) {
+            r->importance[k]=std::max(r->importance[k], fabs(model->sv_coef[row][k]));
+        }
+        r->order[k]=k;
+    }
+    MoreImportant compare;
+    compare.importance=r->importance;
+    std::sort(r->order, r->order+l, compare);
+    return 0;
+}
+
+static void freeReduction(struct SVMReduction *r){
+    free(r->start);
+    free(r->decValues);
+    free(r->importance);
+    free(r->order);
+}
+
+/*
+ helper function, the smallest number of support vectors a reduced model can have: one of each class that has some for classification, one otherwise
+ */
+
+static int fewestSupportVectors(const struct SVMReduction *r){
+    if (!r->classification) {
+        return 1;
+    }
+    int n=0;
+    for (int c=0; c<r->model->nr_class; c++) {
+        n+=r->model->nSV[c]>0;
+    }
+    return n;
+}
+
+/*
+ helper function, marks the n most important support vectors in keep, including the most important one of each class (see fewestSupportVectors())
+ */
+
+static void keepSupportVectors(const struct SVMReduction *r, int n, char *keep){
+    const struct svm_model *model=r->model;
+    memset(keep, 0, model->l);
+    int count=0;
+    for (int c=0; r->classification && c<model->nr_class; c++) {
+        int best=-1;
+        for (int k=r->start[c]; k<r->start[c]+model->nSV[c]; k++) {
+            if (best<0 || r->importance[k]>r->importance[best]) {
+                best=k;
+            }
+        }
+        if (best >= 0) {
+            keep[best]=1;
+            count++;
+        }
+    }
+    for (int i=0; i<model->l && count<n; i++) {
+        if (!keep[r->order[i]]) {
+            keep[r->order[i]]=1;
+            count++;
+        }
+    }
+}
+
+/*
+ helper function, projects the decision function of the n support vectors x with coefficients alpha onto the m kept vectors (see above): beta receives their coefficients, *rho the shifted rho and *maxError the largest change of the decision values at x, the original ones are decision. Kernels on numThreads threads.
+ Returns -1 if memory runs out, 1 if K_SS can't be factored (kernels that are not positive definite, SIGMOID).
+ */
+
+static int projectFunction(const struct svm_parameter *param, struct svm_node *const *x, const double *alpha, const double *decision, int n, struct svm_node *const *kept, int m, int numThreads, double *beta, double *rho, double *maxError){
+    const int block=SVM_KERNEL_BUFFER/m>0 ? SVM_KERNEL_BUFFER/m : 1; // columns of K_SA per block
+    const int columns=n<block ? n : block;
+    double *K=Malloc(double, (size_t)m*m);
+    double *L=Malloc(double, (size_t)m*m);
+    double *values=Malloc(double, (size_t)m*columns);
+    double *fit=Malloc(double, n);
+    int failed=K == NULL || L == NULL || values == NULL || fit == NULL || kernelMatrix(kept, m, kept, m, param, numThreads, K);
+    int factored=!failed && choleskyFactor(K, m, L) == 0;
+    free(K);
+    if (!failed && !factored) {
+        free(L);
+        free(values);
+        free(fit);
+        return 1;
+    }
+    
+    for (int s=0; s<m; s++) {
+        beta[s]=0;
+    }
+    for (int j0=0; j0<n && !failed; j0+=columns) { // K_SA*alpha
+        const int nb=n-j0<columns ? n-j0 : columns;
+        if (kernelMatrix(kept, m, x+j0, nb, param, numThreads, values)) {
+            failed=1;
+            break;
+        }
+        for (int j=0; j<nb; j++) {
+            const double a=alpha[j0+j];
+            const double *column=values+(size_t)j*m;
+            for (int s=0; s<m; s++) {
+                beta[s]+=column[s]*a;
+            }
+        }
+    }
+    if (failed) {
+        free(L);
+        free(values);
+        free(fit);
+        return -1;
+    }
+    
+    for (int i=0; i<m; i++) { // L*L'*beta=K_SA*alpha, L is row-major
+        double sum=beta[i];
+        for (int k=0; k<i; k++) {
+            sum-=L[(size_t)i*m+k]*beta[k];
+        }
+        beta[i]=sum/L[(size_t)i*m+i];
+    }
+    for (int i=m-1; i >= 0; i--) {
+        double sum=beta[i];
+        for (int k=i+1; k<m; k++) {
+            sum-=L[(size_t)k*m+i]*beta[k];
+        }
+        beta[i]=sum/L[(size_t)i*m+i];
+    }
+    
+    for (int j0=0; j0<n; j0+=columns) { // decision values of the projection at x, without rho. A single block is still in values
+        const int nb=n-j0<columns ? n-j0 : columns;
+        if (n>columns && kernelMatrix(kept, m, x+j0, nb, param, numThreads, values)) {
+            failed=1;
+            break;
+        }
+        for (int j=0; j<nb; j++) {
+            const double *column=values+(size_t)j*m;
+            double sum=0;
+            for (int s=0; s<m; s++) {
+                sum+=beta[s]*column[s];
+            }
+            fit[j0+j]=sum;
+        }
+    }
+    
+    if (!failed) {
+        double shift=0;
+        for (int j=0; j<n; j++) {
+            shift+=fit[j]-decision[j];
+        }
+        shift/=n;
+        *rho=shift;
+        *maxError=0;
+        for (int j=0; j<n; j++) {
+            *maxError=std::max(*maxError, fabs(fit[j]-shift-decision[j]));
+        }
+    }
+    free(L);
+    free(values);
+    free(fit);
+    return failed ? -1 : 0;
+}
+
+/*
+ helper function, *reduced receives the model of the support vectors marked in keep, with the coefficients and rho of the projection of each decision function. *maxError receives the largest change of a decision value at the support vectors of the original model. If all support vectors are kept this is a copy of the model.
+ Returns -1 if memory runs out, 1 if a projection fails (see projectFunction()), *reduced is NULL then.
+ */
+
+static int reducedModel(const struct SVMReduction *r, const char *keep, struct svm_model **reduced, double *maxError){
+    const struct svm_model *model=r->model;
+    const int l=model->l;
+    const int nr_class=model->nr_class;
+    const int numRows=nr_class>1 ? nr_class-1 : 1;
+    const int numFunctions=r->numFunctions;
+    
+    int numKept=0;
+    size_t numNodes=0;
+    for (int k=0; k<l; k++) {
+        if (keep[k]) {
+            numKept++;
+            const struct svm_node *node=model->SV[k];
+            while (node->index != -1) {
+                node++;
+            }
+            numNodes+=node-model->SV[k]+1;
+        }
+    }
+    
+    int *newIndex=Malloc(int, l);
+    struct svm_node **x=Malloc(struct svm_node *, l);
+    struct svm_node **kept=Malloc(struct svm_node *, l);
+    int *keptIndex=Malloc(int, l);
+    double *alpha=Malloc(double, l);
+    double *decision=Malloc(double, l);
+    double *beta=Malloc(double, l);
+    struct svm_model *result=(struct svm_model *)calloc(1, sizeof(struct svm_model));
+    struct svm_node *nodes=Malloc(struct svm_node, numNodes>0 ? numNodes : 1);
+    int failed=newIndex == NULL || x == NULL || kept == NULL || keptIndex == NULL || alpha == NULL || decision == NULL || beta == NULL || result == NULL || nodes == NULL;
+    if (!failed) {
+        result->param=model->param;
+        result->param.nr_weight=0;
+        result->param.weight_label=NULL;
+        result->param.weight=NULL;
+        result->nr_class=nr_class;
+        result->l=numKept;
+        result->free_sv=1;
+        result->SV=Malloc(struct svm_node *, numKept);
+        result->sv_coef=(double **)calloc(numRows, sizeof(double *));
+        result->rho=Malloc(double, numFunctions);
+        failed=result->SV == NULL || result->sv_coef == NULL || result->rho == NULL;
+        for (int i=0; i<numRows && !failed; i++) {
+            result->sv_coef[i]=(double *)calloc(numKept, sizeof(double));
+            failed=result->sv_coef[i] == NULL;
+        }
+        if (!failed && model->sv_indices != NULL) {
+            result->sv_indices=Malloc(int, numKept);
+            failed=result->sv_indices == NULL;
+        }
+        if (!failed && model->label != NULL) {
+            result->label=Malloc(int, nr_class);
+            failed=result->label == NULL;
+        }
+        if (!failed && model->nSV != NULL) {
+            result->nSV=(int *)calloc(nr_class, sizeof(int));
+            failed=result->nSV == NULL;
+        }
+        if (!failed && model->probA != NULL) {
+            result->probA=Malloc(double, numFunctions);
+            failed=result->probA == NULL;
+        }
+        if (!failed && model->probB != NULL) {
+            result->probB=Malloc(double, numFunctions);
+            failed=result->probB == NULL;
+        }
+    }
+    
+    if (!failed) { // the kept support vectors in their order, so the classes stay together
+        size_t offset=0;
+        int n=0;
+        for (int k=0; k<l; k++) {
+            newIndex[k]=-1;
+            if (!keep[k]) {
+                continue;
+            }
+            newIndex[k]=n;
+            result->SV[n]=nodes+offset;
+            for (const struct svm_node *node=model->SV[k]; ; node++) {
+                nodes[offset++]=*node;
+                if (node->index == -1) {
+                    break;
+                }
+            }
+            if (result->sv_indices != NULL) {
+                result->sv_indices[n]=model->sv_indices[k];
+            }
+            n++;
+        }
+        if (result->label != NULL) {
+            memcpy(result->label, model->label, nr_class*sizeof(int));
+        }
+        for (int c=0; result->nSV != NULL && r->classification && c<nr_class; c++) {
+            for (int k=r->start[c]; k<r->start[c]+model->nSV[c]; k++) {
+                result->nSV[c]+=keep[k];
+            }
+        }
+        for (int p=0; p<numFunctions; p++) {
+            if (result->probA != NULL) {
+                result->probA[p]=model->probA[p];
+            }
+            if (result->probB != NULL) {
+                result->probB[p]=model->probB[p];
+            }
+        }
+    }
+    
+    *maxError=0;
+    int projected=0;
+    int p=0;
+    for (int a=r->classification ? 0 : -1; a<(r->classification ? nr_class : 0) && !failed; a++) {
+        for (int b=a+1; b<(r->classification ? nr_class : 1) && !failed; b++, p++) { // same order of the pairs as in svm_predict_values(), one function without classes
+            int n=0;
+            int m=0;
+            for (int k=0; k<l; k++) {
+                if (a >= 0 && !(k >= r->start[a] && k<r->start[a]+model->nSV[a]) && !(k >= r->start[b] && k<r->start[b]+model->nSV[b])) {
+                    continue;
+                }
+                x[n]=model->SV[k];
+                alpha[n]=model->sv_coef[coefficientRow(model, r->start, a, b, k)][k];
+                decision[n]=r->decValues[(size_t)k*numFunctions+p];
+                n++;
+                if (keep[k]) {
+                    kept[m]=model->SV[k];
+                    keptIndex[m++]=k;
+                }
+            }
+            
+            double rho=model->rho[p];
+            double error=0;
+            if (m == n) { // nothing to project
+                for (int j=0; j<n; j++) {
+                    beta[j]=alpha[j];
+                }
+            }
+            else if (m>0 && (projected=projectFunction(&model->param, x, alpha, decision, n, kept, m, r->numThreads, beta, &rho, &error))) {
+                failed=1;
+                break;
+            }
+            for (int s=0; s<m; s++) {
+                int k=keptIndex[s];
+                result->sv_coef[coefficientRow(model, r->start, a, b, k)][newIndex[k]]=beta[s];
+            }
+            result->rho[p]=rho;
+            *maxError=std::max(*maxError, error);
+        }
+    }
+    
+    if (!failed) {
+        nodes=NULL; // owned by the model from now on
+    }
+    else if (result != NULL) {
+        result->free_sv=0; // the nodes are still separate
+        svm_free_and_destroy_model(&result);
+        result=NULL;
+    }
+    free(nodes);
+    free(newIndex);
+    free(x);
+    free(kept);
+    free(keptIndex);
+    free(alpha);
+    free(decision);
+    free(beta);
+    *reduced=result;
+    return failed ? (projected>0 ? 1 : -1) : 0;
+}
+
+/*
+ builds a model with fewer support vectors that approximates the decision functions of model (see above) into *reduced. With errorBound <= 0 it keeps the targetSV most important support vectors, otherwise the fewest (at most targetSV if targetSV>0) whose largest change of a decision value at the support vectors of model stays within errorBound, or as many as allowed if none does. *maxError receives that change, kernels are computed on numThreads threads (<1: one per core).
+ Classification models keep at least one support vector of each class. The model has its own support vectors (free_sv), model can be freed. Returns -1 if memory runs out, 1 if the model can't be reduced (PRECOMPUTED kernel, no support vectors, a kernel matrix of the kept support vectors that is not positive definite as with most SIGMOID kernels), *reduced is NULL then.
+ */
+
+int reduceModel(const struct svm_model *model, int targetSV, double errorBound, int numThreads, struct svm_model **reduced, double *maxError){
+    const int l=model->l;
+    *reduced=NULL;
+    if (model->param.kernel_type == PRECOMPUTED || l<1 || (targetSV<1 && errorBound <= 0)) {
+        return 1;
+    }
+    struct SVMReduction r;
+    char *keep=Malloc(char, l);
+    if (keep == NULL || makeReduction(model, numThreads, &r)) {
+        free(keep);
+        return -1;
+    }
+    
+    const int fewest=fewestSupportVectors(&r);
+    int largest=targetSV>0 && targetSV<l ? targetSV : l;
+    if (largest<fewest) {
+        largest=fewest;
+    }
+    
+    struct svm_model *result=NULL;
+    int err=0;
+    if (errorBound <= 0) {
+        keepSupportVectors(&r, largest, keep);
+        err=reducedModel(&r, keep, &result, maxError);
+    }
+    else{
+        int low=fewest-1; // largest number known to miss the bound
+        int n=std::min(std::max(fewest, (int)SVM_REDUCE_FIRST_SV), largest);
+        double error=0;
+        for (;;) { // double until within the bound
+            keepSupportVectors(&r, n, keep);
+            err=reducedModel(&r, keep, &result, &error);
+            if (err || error <= errorBound || n >= largest) {
+                break;
+            }
+            svm_free_and_destroy_model(&result);
+            low=n;
+            n=n<largest/2 ? 2*n : largest;
+        }
+        *maxError=error;
+        
+        int high=n;
+        while (!err && *maxError <= errorBound && high-low>1) { // bisect between the last miss and the first hit
+            int mid=low+(high-low)/2;
+            keepSupportVectors(&r, mid, keep);
+            struct svm_model *candidate=NULL;
+            int candidateErr=reducedModel(&r, keep, &candidate, &error);
+            if (candidateErr<0) {
+                svm_free_and_destroy_model(&result);
+                err=-1;
+                break;
+            }
+            if (candidateErr == 0 && error <= errorBound) {
+                svm_free_and_destroy_model(&result);
+                result=candidate;
+                *maxError=error;
+                high=mid;
+            }
+            else{ // a projection that fails counts as a miss
+                if (candidate != NULL) {
+                    svm_free_and_destroy_model(&candidate);
+                }
+                low=mid;
+            }
+        }
+    }
+    
+    freeReduction(&r);
+    free(keep);
+    *reduced=result;
+    return err;
+}
+
+// predicts samples that are nodes already, shared by all workers of SVMParallelFor()
+struct NodePredictionRows {
+    const struct svm_model *model;
+    const struct svm_node *nodes; // columns+1 per sample
+    size_t rowLength;
+    double *target;
+    
+    void operator()(size_t begin, size_t end, int){
+        for (size_t i=begin; i<end; i++) {
+            target[i]=svm_predict(model, nodes+i*rowLength);
+        }
+    }
+};
+
+/*
+ compares a reduced model with the original model: predicts the validation samples (rows of samples) with both on up to numThreads workers, timed, and fills report.
+ Returns -1 if memory runs out or the type of samples is not supported.
+ */
+
+int reductionReport(const struct svm_model *reduced, const struct svm_model *original, const SVMDataBlock *samples, int numThreads, struct SVMReductionReport *report){
+    const size_t numSamples=samples->rows;
+    const int svm_type=original->param.svm_type;
+    const int regression=svm_type == EPSILON_SVR || svm_type == NU_SVR;
+    
+    NodePredictionRows rows;
+    rows.rowLength=(size_t)samples->columns+1;
+    struct svm_node *nodes=Malloc(struct svm_node, numSamples*rows.rowLength>0 ? numSamples*rows.rowLength : 1);
+    double *reducedTarget=Malloc(double, numSamples>0 ? numSamples : 1);
+    double *originalTarget=Malloc(double, numSamples>0 ? numSamples : 1);
+    if (nodes == NULL || reducedTarget == NULL || originalTarget == NULL || SVMBlockToNodes(*samples, 0, numSamples, nodes)) {
+        free(nodes);
+        free(reducedTarget);
+        free(originalTarget);
+        return -1;
+    }
+    rows.nodes=nodes;
+    int workers=SVMNumberOfThreads(numThreads, numSamples);
+    
+    std::chrono::steady_clock::time_point begin=std::chrono::steady_clock::now();
+    rows.model=original;
+    rows.target=originalTarget;
+    SVMParallelFor(numSamples, 64, workers, rows);
+    std::chrono::steady_clock::time_point middle=std::chrono::steady_clock::now();
+    rows.model=reduced;
+    rows.target=reducedTarget;
+    SVMParallelFor(numSamples, 64, workers, rows);
+    std::chrono::steady_clock::time_point end=std::chrono::steady_clock::now();
+    report->originalSeconds=std::chrono::duration<double>(middle-begin).count();
+    report->reducedSeconds=std::chrono::duration<double>(end-middle).count();
+    
+    double difference=0;
+    for (size_t i=0; i<numSamples; i++) {
+        if (regression) {
+            difference+=(reducedTarget[i]-originalTarget[i])*(reducedTarget[i]-originalTarget[i]);
+        }
+        else{
+            difference+=reducedTarget[i] != originalTarget[i];
+        }
+    }
+    report->difference=numSamples>0 ? difference*(regression ? 1.0/numSamples : 100.0/numSamples) : 0;
+    
+    free(nodes);
+    free(reducedTarget);
+    free(originalTarget);
+    return 0;
+}
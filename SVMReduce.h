@@ -0,0 +1,21 @@
+/*
+	SVMReduce.h -- reduced-set models with fewer support vectors
+*/
+
+#ifndef SVM_REDUCE_H
+#define SVM_REDUCE_H
+
+#include "libSVM/svm.h"
+#include "SVMWaveData.h"
+
+// how the predictions of a reduced model compare to the original model, on validation samples
+struct SVMReductionReport {
+    double difference; // % of the samples predicted differently (classification and ONE_CLASS) or mean squared difference of the predictions (regression)
+    double originalSeconds; // time to predict the samples with the original model
+    double reducedSeconds; // same for the reduced model
+};
+
+int reduceModel(const struct svm_model *model, int targetSV, double errorBound, int numThreads, struct svm_model **reduced, double *maxError);
+int reductionReport(const struct svm_model *reduced, const struct svm_model *original, const SVMDataBlock *samples, int numThreads, struct SVMReductionReport *report);
+
+#endif
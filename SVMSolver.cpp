@@ -0,0 +1,1179 @@
+/*	SVMSolver.cpp -- SMO solver with threaded kernel rows for SVM XOP
+
+	svm_train() spends most of its time in Kernel::kernel_*, evaluating the rows of the kernel matrix the working
+	set needs, on one thread. solveDual() solves the same dual problems as svm.cpp for all five types of libSVM,
+	transcribed from its Solver and Solver_NU: the second order working set selection of Fan, Chen and Lin, the
+	two variable update, shrinking (param->shrinking) and rho from the free variables. Each kernel row is split into
+	blocks of columns evaluated on several threads, and kept as floats in an LRU cache of param->cache_size MB as
+	libSVM does, so the memory grows with the cache and not with l*l like a kernel matrix.
+	The samples are nodes or dense samples (SVMDense.h), dense samples are read straight from the feature-major
+	matrix without nodes. Dot products are added in ascending feature order as dot() in svm.cpp adds them, so every
+	row is the one libSVM computes and the result doesn't depend on the number of threads or the cache size.
+	It is a copy rather than a patch of Kernel and SVC_Q::get_Q because libSVM is not part of this project: it is
+	linked from ../libSVM as released, and svm_train() has no hook for computing the rows elsewhere.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <algorithm>
+#include "SVMSolver.h"
+#include "SVMKernel.h"
+#include "SVMThreads.h"
+
+#define Malloc(type,n) (type *)malloc((n)*sizeof(type)) //from libSVM
+#define TAU 1e-12 // as in svm.cpp
+
+enum {
+    SVM_ROW_CHUNK=256, // smallest block of columns of a kernel row per task
+    SVM_ROW_WORK=65536 // dot product terms per worker below which a row is not worth splitting
+};
+
+enum {
+    SVM_LOWER_BOUND,
+    SVM_UPPER_BOUND,
+    SVM_FREE
+};
+
+/*
+ helper function, the dot products of column xi of the dense feature-major matrix X (dim x L) with the columns index[begin...end-1], added in ascending feature order.
+ */
+
+template <typename T>
+static void denseDots(const T *X, int L, int dim, int xi, const int *index, size_t begin, size_t end, double *dot){
+    const size_t n=end-begin;
+    for (size_t j=0; j<n; j++) {
+        dot[j]=0;
+    }
+    for (int k=0; k<dim; k++) {
+        const T *feature=X+(size_t)k*L;
+        const double xk=(double)feature[xi];
+        if (xk == 0) { // adds nothing, as in denseDotProducts()
+            continue;
+        }
+        for (size_t j=0; j<n; j++) {
+            dot[j]+=xk*(double)feature[index[begin+j]];
+        }
+    }
+}
+
+// evaluates a block of columns of one kernel row per call, shared by all workers of SVMParallelFor()
+struct KernelColumns {
+    const struct svm_parameter *param;
+    const struct SVMKernelSamples *samples;
+    const int *column; // node or dense column of the sample of each column of the row
+    const double *square; // squared norm of the sample of each column, RBF only
+    int rowColumn; // node or dense column of the sample of the row
+    double rowSquare;
+    size_t first; // the columns first, first+1, ... are computed
+    double *values; // the row
+    
+    void operator()(size_t begin, size_t end, int){
+        begin+=first;
+        end+=first;
+        double *dot=values+begin;
+        
+        if (samples->x != NULL) {
+            for (size_t j=begin; j<end; j++) {
+                dot[j-begin]=sparseDot(samples->x[rowColumn], samples->x[column[j]]);
+            }
+        }
+        else if (samples->dense->f != NULL) {
+            denseDots(samples->dense->f, samples->dense->l, samples->dense->dim, rowColumn, column, begin, end, dot);
+        }
+        else{
+            denseDots(samples->dense->d, samples->dense->l, samples->dense->dim, rowColumn, column, begin, end, dot);
+        }
+        kernelValues(param, rowSquare, square != NULL ? square+begin : NULL, dot, (int)(end-begin));
+    }
+};
+
+/*
+ the state of one solveDual() run: Solver (Solver_NU with nu set) of svm.cpp on the Q matrix of SVC_Q, ONE_CLASS_Q or SVR_Q. Shrinking moves variables in place, activeSet keeps their original positions.
+ A cached row belongs to a variable and moves with it (classification), or to a sample (regression, a row of K both variables of the sample use), as in libSVM.
+ */
+struct DualSolver {
+    const struct svm_parameter *param;
+    const struct SVMKernelSamples *samples;
+    int n; // number of samples
+    int l; // number of variables
+    int regression; // variable i<n is alpha_i, variable n+i is alpha*_i, as in SVR_Q
+    int nu; // working set, shrinking and rho per sign of y, as in Solver_NU
+    double Cp;
+    double Cn;
+    signed char *y;
+    double *p;
+    double *alpha;
+    double *G;
+    double *G_bar; // gradient part of the variables at the upper bound
+    double *QD;
+    char *status;
+    int *activeSet;
+    int activeSize;
+    int unshrink;
+    double r; // nu only
+    
+    // kernel rows: y_i*y_j*K(i,j) per variable, K(i,j) per sample for regression, evaluated on up to rowThreads threads
+    int *column; // per variable (per sample for regression), the node or dense column of its sample
+    double *square; // per variable (per sample for regression), the squared norm of its sample
+    int *sample; // regression, the sample of each variable
+    int rowThreads;
+    double rowTerms; // average number of terms of a dot product
+    double *kernel; // one row as double
+    float **rows; // cached rows, NULL if not cached
+    int *length; // number of columns computed of each cached row
+    int *prev; // the cached rows as list, most recently used first, n is the head
+    int *next;
+    size_t numRows;
+    size_t maxRows;
+    float *buffer[2]; // regression, the last two rows of Q
+    int nextBuffer;
+    
+    double C(int i){
+        return y[i]>0 ? Cp : Cn;
+    }
+    
+    void updateStatus(int i){
+        if (alpha[i] >= C(i)) {
+            status[i]=SVM_UPPER_BOUND;
+        }
+        else if (alpha[i] <= 0) {
+            status[i]=SVM_LOWER_BOUND;
+        }
+        else{
+            status[i]=SVM_FREE;
+        }
+    }
+    
+    void unlinkRow(int s){
+        next[prev[s]]=next[s];
+        prev[next[s]]=prev[s];
+    }
+    
+    void insertRow(int s){
+        next[s]=next[n];
+        prev[s]=n;
+        prev[next[n]]=s;
+        next[n]=s;
+    }
+    
+    /*
+     the first len columns of cached row s, computed if they aren't there yet, as Cache::get_data(). The least recently used row makes room when the cache is full, the row of the previous call stays valid. NULL if memory runs out.
+     */
+    float *cachedRow(int s, int len){
+        if (rows[s] != NULL) {
+            unlinkRow(s);
+            insertRow(s);
+            if (length[s] >= len) {
+                return rows[s];
+            }
+        }
+        else{
+            float *data=NULL;
+            if (numRows<maxRows) {
+                data=Malloc(float, n);
+                if (data != NULL) {
+                    numRows++;
+                }
+                else{
+                    maxRows=numRows; // make do with the rows there are
+                }
+            }
+            if (data == NULL) {
+                if (numRows<2) {
+                    return NULL;
+                }
+                int last=prev[n];
+                unlinkRow(last);
+                data=rows[last];
+                rows[last]=NULL;
+                length[last]=0;
+            }
+            rows[s]=data;
+            length[s]=0;
+            insertRow(s);
+        }
+        
+        const size_t start=(size_t)length[s];
+        const size_t count=(size_t)len-start;
+        KernelColumns columns;
+        columns.param=param;
+        columns.samples=samples;
+        columns.column=column;
+        columns.square=param->kernel_type == RBF ? square : NULL;
+        columns.rowColumn=column[s];
+        columns.rowSquare=square[s];
+        columns.first=start;
+        columns.values=kernel;
+        int threads=SVMNumberOfThreads(rowThreads, (size_t)(count*rowTerms/SVM_ROW_WORK));
+        size_t chunk=count/(4*threads)>SVM_ROW_CHUNK ? count/(4*threads) : (size_t)SVM_ROW_CHUNK;
+        SVMParallelFor(count, chunk, threads, columns);
+        
+        float *data=rows[s];
+        if (regression) {
+            for (size_t j=start; j<(size_t)len; j++) {
+                data[j]=(float)kernel[j];
+            }
+        }
+        else{
+            for (size_t j=start; j<(size_t)len; j++) {
+                data[j]=(float)(y[s]*y[j]*kernel[j]);
+            }
+        }
+        length[s]=len;
+        return data;
+    }
+    
+    /*
+     the first len columns of row i of Q, as get_Q() of svm.cpp. For regression the row is in one of two buffers, so the row of the previous call stays valid as well.
+     */
+    const float *Q(int i, int len){
+        if (!regression) {
+            return cachedRow(i, len);
+        }
+        const float *data=cachedRow(sample[i], n);
+        if (data == NULL) {
+            return NULL;
+        }
+        float *row=buffer[nextBuffer];
+        nextBuffer=1-nextBuffer;
+        const float sign=(float)y[i];
+        for (int j=0; j<len; j++) {
+            row[j]=sign*(float)y[j]*data[sample[j]];
+        }
+        return row;
+    }
+    
+    /*
+     exchanges variables i and j, as Solver::swap_index() with swap_index() of the Q matrix and its cache
+     */
+    void swapIndex(int i, int j){
+        if (regression) {
+            std::swap(sample[i], sample[j]);
+        }
+        else{
+            if (rows[i] != NULL) {
+                unlinkRow(i);
+            }
+            if (rows[j] != NULL) {
+                unlinkRow(j);
+            }
+            std::swap(rows[i], rows[j]);
+            std::swap(length[i], length[j]);
+            if (rows[i] != NULL) {
+                insertRow(i);
+            }
+            if (rows[j] != NULL) {
+                insertRow(j);
+            }
+            int first=std::min(i, j);
+            int second=std::max(i, j);
+            for (int h=next[n]; h != n;) {
+                int following=next[h];
+                if (length[h]>first) {
+                    if (length[h]>second) {
+                        std::swap(rows[h][first], rows[h][second]);
+                    }
+                    else{ // the row has only one of the columns, give it up
+                        unlinkRow(h);
+                        free(rows[h]);
+                        rows[h]=NULL;
+                        length[h]=0;
+                        numRows--;
+                    }
+                }
+                h=following;
+            }
+            std::swap(column[i], column[j]);
+            std::swap(square[i], square[j]);
+        }
+        std::swap(QD[i], QD[j]);
+        std::swap(y[i], y[j]);
+        std::swap(G[i], G[j]);
+        std::swap(status[i], status[j]);
+        std::swap(alpha[i], alpha[j]);
+        std::swap(p[i], p[j]);
+        std::swap(activeSet[i], activeSet[j]);
+        std::swap(G_bar[i], G_bar[j]);
+    }
+    
+    /*
+     the gradient of the inactive variables from G_bar and the free variables, as Solver::reconstruct_gradient(). Returns -1 if memory runs out.
+     */
+    int reconstructGradient(){
+        if (activeSize == l) {
+            return 0;
+        }
+        int nr_free=0;
+        for (int j=activeSize; j<l; j++) {
+            G[j]=G_bar[j]+p[j];
+        }
+        for (int j=0; j<activeSize; j++) {
+            if (status[j] == SVM_FREE) {
+                nr_free++;
+            }
+        }
+        if ((double)nr_free*l>2.0*activeSize*(l-activeSize)) {
+            for (int i=activeSize; i<l; i++) {
+                const float *Q_i=Q(i, activeSize);
+                if (Q_i == NULL) {
+                    return -1;
+                }
+                for (int j=0; j<activeSize; j++) {
+                    if (status[j] == SVM_FREE) {
+                        G[i]+=alpha[j]*Q_i[j];
+                    }
+                }
+            }
+        }
+        else{
+            for (int i=0; i<activeSize; i++) {
+                if (status[i] == SVM_FREE) {
+                    const float *Q_i=Q(i, l);
+                    if (Q_i == NULL) {
+                        return -1;
+                    }
+                    double alpha_i=alpha[i];
+                    for (int j=activeSize; j<l; j++) {
+                        G[j]+=alpha_i*Q_i[j];
+                    }
+                }
+            }
+        }
+        return 0;
+    }
+    
+    /*
+     the pair of variables to update, as Solver::select_working_set(). Returns 1 if the solution is optimal within param->eps, -1 if memory runs out.
+     */
+    int selectWorkingSet(int *out_i, int *out_j){
+        double Gmax=-HUGE_VAL;
+        double Gmax2=-HUGE_VAL;
+        int Gmax_idx=-1;
+        int Gmin_idx=-1;
+        double obj_diff_min=HUGE_VAL;
+        
+        for (int t=0; t<activeSize; t++) {
+            if (y[t] == +1) {
+                if (status[t] != SVM_UPPER_BOUND && -G[t] >= Gmax) {
+                    Gmax=-G[t];
+                    Gmax_idx=t;
+                }
+            }
+            else{
+                if (status[t] != SVM_LOWER_BOUND && G[t] >= Gmax) {
+                    Gmax=G[t];
+                    Gmax_idx=t;
+                }
+            }
+        }
+        
+        int i=Gmax_idx;
+        const float *Q_i=NULL;
+        if (i != -1) { // Q_i is not used otherwise, Gmax is -HUGE_VAL
+            Q_i=Q(i, activeSize);
+            if (Q_i == NULL) {
+                return -1;
+            }
+        }
+        
+        for (int j=0; j<activeSize; j++) {
+            double grad_diff;
+            double quad_coef;
+            if (y[j] == +1) {
+                if (status[j] == SVM_LOWER_BOUND) {
+                    continue;
+                }
+                grad_diff=Gmax+G[j];
+                if (G[j] >= Gmax2) {
+                    Gmax2=G[j];
+                }
+                if (grad_diff <= 0) {
+                    continue;
+                }
+                quad_coef=QD[i]+QD[j]-2.0*y[i]*Q_i[j];
+            }
+            else{
+                if (status[j] == SVM_UPPER_BOUND) {
+                    continue;
+                }
+                grad_diff=Gmax-G[j];
+                if (-G[j] >= Gmax2) {
+                    Gmax2=-G[j];
+                }
+                if (grad_diff <= 0) {
+                    continue;
+                }
+                quad_coef=QD[i]+QD[j]+2.0*y[i]*Q_i[j];
+            }
+            double obj_diff=quad_coef>0 ? -(grad_diff*grad_diff)/quad_coef : -(grad_diff*grad_diff)/TAU;
+            if (obj_diff <= obj_diff_min) {
+                Gmin_idx=j;
+                obj_diff_min=obj_diff;
+            }
+        }
+        
+        if (Gmax+Gmax2<param->eps || Gmin_idx == -1) {
+            return 1;
+        }
+        *out_i=Gmax_idx;
+        *out_j=Gmin_idx;
+        return 0;
+    }
+    
+    /*
+     the pair of variables to update, as Solver_NU::select_working_set(): both variables have the same sign of y. Returns 1 if the solution is optimal within param->eps, -1 if memory runs out.
+     */
+    int selectWorkingSetNu(int *out_i, int *out_j){
+        double Gmaxp=-HUGE_VAL;
+        double Gmaxp2=-HUGE_VAL;
+        int Gmaxp_idx=-1;
+        double Gmaxn=-HUGE_VAL;
+        double Gmaxn2=-HUGE_VAL;
+        int Gmaxn_idx=-1;
+        int Gmin_idx=-1;
+        double obj_diff_min=HUGE_VAL;
+        
+        for (int t=0; t<activeSize; t++) {
+            if (y[t] == +1) {
+                if (status[t] != SVM_UPPER_BOUND && -G[t] >= Gmaxp) {
+                    Gmaxp=-G[t];
+                    Gmaxp_idx=t;
+                }
+            }
+            else{
+                if (status[t] != SVM_LOWER_BOUND && G[t] >= Gmaxn) {
+                    Gmaxn=G[t];
+                    Gmaxn_idx=t;
+                }
+            }
+        }
+        
+        int ip=Gmaxp_idx;
+        int in=Gmaxn_idx;
+        const float *Q_ip=NULL;
+        const float *Q_in=NULL;
+        if (ip != -1) {
+            Q_ip=Q(ip, activeSize);
+            if (Q_ip == NULL) {
+                return -1;
+            }
+        }
+        if (in != -1) { // Q_ip stays valid
+            Q_in=Q(in, activeSize);
+            if (Q_in == NULL) {
+                return -1;
+            }
+        }
+        
+        for (int j=0; j<activeSize; j++) {
+            double grad_diff;
+            double quad_coef;
+            if (y[j] == +1) {
+                if (status[j] == SVM_LOWER_BOUND) {
+                    continue;
+                }
+                grad_diff=Gmaxp+G[j];
+                if (G[j] >= Gmaxp2) {
+                    Gmaxp2=G[j];
+                }
+                if (grad_diff <= 0) {
+                    continue;
+                }
+                quad_coef=QD[ip]+QD[j]-2*Q_ip[j];
+            }
+            else{
+                if (status[j] == SVM_UPPER_BOUND) {
+                    continue;
+                }
+                grad_diff=Gmaxn-G[j];
+                if (-G[j] >= Gmaxn2) {
+                    Gmaxn2=-G[j];
+                }
+                if (grad_diff <= 0) {
+                    continue;
+                }
+                quad_coef=QD[in]+QD[j]-2*Q_in[j];
+            }
+            double obj_diff=quad_coef>0 ? -(grad_diff*grad_diff)/quad_coef : -(grad_diff*grad_diff)/TAU;
+            if (obj_diff <= obj_diff_min) {
+                Gmin_idx=j;
+                obj_diff_min=obj_diff;
+            }
+        }
+        
+        if (std::max(Gmaxp+Gmaxp2, Gmaxn+Gmaxn2)<param->eps || Gmin_idx == -1) {
+            return 1;
+        }
+        *out_i=y[Gmin_idx] == +1 ? Gmaxp_idx : Gmaxn_idx;
+        *out_j=Gmin_idx;
+        return 0;
+    }
+    
+    /*
+     whether variable i can be left out of the working set, as Solver::be_shrunk() and Solver_NU::be_shrunk(): Gmax1 and Gmax2 bound the positive variables, Gmax4 and Gmax3 the negative ones
+     */
+    int beShrunk(int i, double Gmax1, double Gmax2, double Gmax3, double Gmax4){
+        if (status[i] == SVM_UPPER_BOUND) {
+            return y[i] == +1 ? -G[i]>Gmax1 : -G[i]>Gmax4;
+        }
+        if (status[i] == SVM_LOWER_BOUND) {
+            return y[i] == +1 ? G[i]>Gmax2 : G[i]>Gmax3;
+        }
+        return 0;
+    }
+    
+    /*
+     moves the variables that are unlikely to change behind activeSize, as Solver::do_shrinking() and Solver_NU::do_shrinking(). Returns -1 if memory runs out.
+     */
+    int doShrinking(){
+        double Gmax1=-HUGE_VAL; // max { -y_i * grad(f)_i | i in I_up(\alpha) }, of the positive variables for nu
+        double Gmax2=-HUGE_VAL; // max { y_i * grad(f)_i | i in I_low(\alpha) }, of the positive variables for nu
+        double Gmax3=-HUGE_VAL; // nu, the same of the negative variables
+        double Gmax4=-HUGE_VAL;
+        
+        for (int i=0; i<activeSize; i++) {
+            if (nu) {
+                if (status[i] != SVM_UPPER_BOUND) {
+                    if (y[i] == +1) {
+                        if (-G[i]>Gmax1) {
+                            Gmax1=-G[i];
+                        }
+                    }
+                    else if (-G[i]>Gmax4) {
+                        Gmax4=-G[i];
+                    }
+                }
+                if (status[i] != SVM_LOWER_BOUND) {
+                    if (y[i] == +1) {
+                        if (G[i]>Gmax2) {
+                            Gmax2=G[i];
+                        }
+                    }
+                    else if (G[i]>Gmax3) {
+                        Gmax3=G[i];
+                    }
+                }
+            }
+            else if (y[i] == +1) {
+                if (status[i] != SVM_UPPER_BOUND && -G[i] >= Gmax1) {
+                    Gmax1=-G[i];
+                }
+                if (status[i] != SVM_LOWER_BOUND && G[i] >= Gmax2) {
+                    Gmax2=G[i];
+                }
+            }
+            else{
+                if (status[i] != SVM_UPPER_BOUND && -G[i] >= Gmax2) {
+                    Gmax2=-G[i];
+                }
+                if (status[i] != SVM_LOWER_BOUND && G[i] >= Gmax1) {
+                    Gmax1=G[i];
+                }
+            }
+        }
+        if (!nu) { // the negative variables are bounded by the same values, swapped
+            Gmax3=Gmax1;
+            Gmax4=Gmax2;
+        }
+        
+        if (!unshrink && std::max(Gmax1+Gmax2, Gmax3+Gmax4) <= param->eps*10) {
+            unshrink=1;
+            if (reconstructGradient()) {
+                return -1;
+            }
+            activeSize=l;
+        }
+        
+        for (int i=0; i<activeSize; i++) {
+            if (beShrunk(i, Gmax1, Gmax2, Gmax3, Gmax4)) {
+                activeSize--;
+                while (activeSize>i) {
+                    if (!beShrunk(activeSize, Gmax1, Gmax2, Gmax3, Gmax4)) {
+                        swapIndex(i, activeSize);
+                        break;
+                    }
+                    activeSize--;
+                }
+            }
+        }
+        return 0;
+    }
+    
+    /*
+     rho as Solver::calculate_rho(): the mean of y*G over the free variables, the middle of the feasible interval if there are none
+     */
+    double calculateRho(){
+        int nr_free=0;
+        double ub=HUGE_VAL;
+        double lb=-HUGE_VAL;
+        double sum_free=0;
+        for (int i=0; i<activeSize; i++) {
+            double yG=y[i]*G[i];
+            if (status[i] == SVM_UPPER_BOUND) {
+                if (y[i] == -1) {
+                    ub=std::min(ub, yG);
+                }
+                else{
+                    lb=std::max(lb, yG);
+                }
+            }
+            else if (status[i] == SVM_LOWER_BOUND) {
+                if (y[i] == +1) {
+                    ub=std::min(ub, yG);
+                }
+                else{
+                    lb=std::max(lb, yG);
+                }
+            }
+            else{
+                ++nr_free;
+                sum_free+=yG;
+            }
+        }
+        return nr_free>0 ? sum_free/nr_free : (ub+lb)/2;
+    }
+    
+    /*
+     rho and r as Solver_NU::calculate_rho(), for each sign of y separately
+     */
+    double calculateRhoNu(){
+        int nr_free1=0;
+        int nr_free2=0;
+        double ub1=HUGE_VAL;
+        double ub2=HUGE_VAL;
+        double lb1=-HUGE_VAL;
+        double lb2=-HUGE_VAL;
+        double sum_free1=0;
+        double sum_free2=0;
+        for (int i=0; i<activeSize; i++) {
+            if (y[i] == +1) {
+                if (status[i] == SVM_UPPER_BOUND) {
+                    lb1=std::max(lb1, G[i]);
+                }
+                else if (status[i] == SVM_LOWER_BOUND) {
+                    ub1=std::min(ub1, G[i]);
+                }
+                else{
+                    ++nr_free1;
+                    sum_free1+=G[i];
+                }
+            }
+            else{
+                if (status[i] == SVM_UPPER_BOUND) {
+                    lb2=std::max(lb2, G[i]);
+                }
+                else if (status[i] == SVM_LOWER_BOUND) {
+                    ub2=std::min(ub2, G[i]);
+                }
+                else{
+                    ++nr_free2;
+                    sum_free2+=G[i];
+                }
+            }
+        }
+        double r1=nr_free1>0 ? sum_free1/nr_free1 : (ub1+lb1)/2;
+        double r2=nr_free2>0 ? sum_free2/nr_free2 : (ub2+lb2)/2;
+        r=(r1+r2)/2;
+        return (r1-r2)/2;
+    }
+    
+    /*
+     Solver::Solve(): alpha is updated in place and the variables may end up in a different order, activeSet[i] is the original position of variable i. Sets *rho, returns -1 if memory runs out.
+     */
+    int solve(double *rho){
+        activeSize=l;
+        unshrink=0;
+        for (int i=0; i<l; i++) {
+            updateStatus(i);
+            activeSet[i]=i;
+            G[i]=p[i];
+            G_bar[i]=0;
+        }
+        for (int i=0; i<l; i++) {
+            if (status[i] != SVM_LOWER_BOUND) {
+                const float *Q_i=Q(i, l);
+                if (Q_i == NULL) {
+                    return -1;
+                }
+                double alpha_i=alpha[i];
+                for (int j=0; j<l; j++) {
+                    G[j]+=alpha_i*Q_i[j];
+                }
+                if (status[i] == SVM_UPPER_BOUND) {
+                    for (int j=0; j<l; j++) {
+                        G_bar[j]+=C(i)*Q_i[j];
+                    }
+                }
+            }
+        }
+        
+        int iter=0;
+        int max_iter=std::max(10000000, l>INT_MAX/100 ? INT_MAX : 100*l);
+        int counter=std::min(l, 1000)+1;
+        while (iter<max_iter) {
+            if (--counter == 0) {
+                counter=std::min(l, 1000);
+                if (param->shrinking && doShrinking()) {
+                    return -1;
+                }
+            }
+            
+            int i=0;
+            int j=0;
+            int selected=nu ? selectWorkingSetNu(&i, &j) : selectWorkingSet(&i, &j);
+            if (selected>0) { // optimal on the active variables, check all of them
+                if (reconstructGradient()) {
+                    return -1;
+                }
+                activeSize=l;
+                selected=nu ? selectWorkingSetNu(&i, &j) : selectWorkingSet(&i, &j);
+                if (selected>0) {
+                    break;
+                }
+                counter=1; // shrink in the next iteration
+            }
+            if (selected<0) {
+                return -1;
+            }
+            ++iter;
+            
+            const float *Q_i=Q(i, activeSize);
+            const float *Q_j=Q_i != NULL ? Q(j, activeSize) : NULL;
+            if (Q_j == NULL) {
+                return -1;
+            }
+            double C_i=C(i);
+            double C_j=C(j);
+            double old_alpha_i=alpha[i];
+            double old_alpha_j=alpha[j];
+            
+            if (y[i] != y[j]) {
+                double quad_coef=QD[i]+QD[j]+2*Q_i[j];
+                if (quad_coef <= 0) {
+                    quad_coef=TAU;
+                }
+                double delta=(-G[i]-G[j])/quad_coef;
+                double diff=alpha[i]-alpha[j];
+                alpha[i]+=delta;
+                alpha[j]+=delta;
+                if (diff>0) {
+                    if (alpha[j]<0) {
+                        alpha[j]=0;
+                        alpha[i]=diff;
+                    }
+                }
+                else{
+                    if (alpha[i]<0) {
+                        alpha[i]=0;
+                        alpha[j]=-diff;
+                    }
+                }
+                if (diff>C_i-C_j) {
+                    if (alpha[i]>C_i) {
+                        alpha[i]=C_i;
+                        alpha[j]=C_i-diff;
+                    }
+                }
+                else{
+                    if (alpha[j]>C_j) {
+                        alpha[j]=C_j;
+                        alpha[i]=C_j+diff;
+                    }
+                }
+            }
+            else{
+                double quad_coef=QD[i]+QD[j]-2*Q_i[j];
+                if (quad_coef <= 0) {
+                    quad_coef=TAU;
+                }
+                double delta=(G[i]-G[j])/quad_coef;
+                double sum=alpha[i]+alpha[j];
+                alpha[i]-=delta;
+                alpha[j]+=delta;
+                if (sum>C_i) {
+                    if (alpha[i]>C_i) {
+                        alpha[i]=C_i;
+                        alpha[j]=sum-C_i;
+                    }
+                }
+                else{
+                    if (alpha[j]<0) {
+                        alpha[j]=0;
+                        alpha[i]=sum;
+                    }
+                }
+                if (sum>C_j) {
+                    if (alpha[j]>C_j) {
+                        alpha[j]=C_j;
+                        alpha[i]=sum-C_j;
+                    }
+                }
+                else{
+                    if (alpha[i]<0) {
+                        alpha[i]=0;
+                        alpha[j]=sum;
+                    }
+                }
+            }
+            
+            double delta_alpha_i=alpha[i]-old_alpha_i;
+            double delta_alpha_j=alpha[j]-old_alpha_j;
+            for (int k=0; k<activeSize; k++) {
+                G[k]+=Q_i[k]*delta_alpha_i+Q_j[k]*delta_alpha_j;
+            }
+            
+            int ui=status[i] == SVM_UPPER_BOUND;
+            int uj=status[j] == SVM_UPPER_BOUND;
+            updateStatus(i);
+            updateStatus(j);
+            if (ui != (status[i] == SVM_UPPER_BOUND)) {
+                Q_i=Q(i, l);
+                if (Q_i == NULL) {
+                    return -1;
+                }
+                for (int k=0; k<l; k++) {
+                    G_bar[k]+=ui ? -C_i*Q_i[k] : C_i*Q_i[k];
+                }
+            }
+            if (uj != (status[j] == SVM_UPPER_BOUND)) {
+                Q_j=Q(j, l);
+                if (Q_j == NULL) {
+                    return -1;
+                }
+                for (int k=0; k<l; k++) {
+                    G_bar[k]+=uj ? -C_j*Q_j[k] : C_j*Q_j[k];
+                }
+            }
+        }
+        
+        if (iter >= max_iter && activeSize<l) { // stopped early, rho from all variables
+            if (reconstructGradient()) {
+                return -1;
+            }
+            activeSize=l;
+        }
+        *rho=nu ? calculateRhoNu() : calculateRho();
+        return 0;
+    }
+};
+
+/*
+ helper function, frees what solveDual() allocated for solver
+ */
+
+static void freeDualSolver(struct DualSolver *solver){
+    if (solver->rows != NULL) {
+        for (int s=0; s<solver->n; s++) {
+            free(solver->rows[s]);
+        }
+    }
+    free(solver->rows);
+    free(solver->length);
+    free(solver->prev);
+    free(solver->next);
+    free(solver->buffer[0]);
+    free(solver->buffer[1]);
+    free(solver->y);
+    free(solver->p);
+    free(solver->alpha);
+    free(solver->G);
+    free(solver->G_bar);
+    free(solver->QD);
+    free(solver->status);
+    free(solver->activeSet);
+    free(solver->column);
+    free(solver->square);
+    free(solver->sample);
+    free(solver->kernel);
+}
+
+/*
+ helper function, the node or dense column and the squared norm (added in the order of dot()) of each sample. Returns the average number of terms of a dot product.
+ */
+
+static double sampleNorms(const struct SVMKernelSamples *samples, int *column, double *square){
+    double terms=0;
+    for (int k=0; k<samples->l; k++) {
+        column[k]=samples->index != NULL ? samples->index[k] : k;
+        if (samples->x != NULL) {
+            square[k]=sparseDot(samples->x[column[k]], samples->x[column[k]]);
+            for (const struct svm_node *node=samples->x[column[k]]; node->index != -1; node++) {
+                terms++;
+            }
+        }
+        else if (samples->dense->f != NULL) {
+            denseDots(samples->dense->f, samples->dense->l, samples->dense->dim, column[k], column, k, k+1, &square[k]);
+            terms+=samples->dense->dim;
+        }
+        else{
+            denseDots(samples->dense->d, samples->dense->l, samples->dense->dim, column[k], column, k, k+1, &square[k]);
+            terms+=samples->dense->dim;
+        }
+    }
+    return samples->l>0 ? terms/samples->l : 0;
+}
+
+/*
+ solves the dual problem of param->svm_type for the samples with labels (C_SVC, NU_SVC: +1/-1) or targets (regression) y, ignored for ONE_CLASS, as svm_train_one() does: Cp and Cn are the penalties of the positive and negative samples for C_SVC, param->C is used for regression. Shrinks if param->shrinking is set, as libSVM.
+ coef receives one coefficient per sample (alpha*y for classification, alpha-alpha* for regression, 0 if the sample is no support vector) and *rho the offset, the decision function is sum(coef[i]*K(x_i, x))-rho as in libSVM.
+ Each kernel row is computed on up to numThreads threads (<1: one per core), the rows are cached in param->cache_size MB. Returns -1 if memory runs out.
+ */
+
+int solveDual(const struct SVMKernelSamples *samples, const double *y, const struct svm_parameter *param, double Cp, double Cn, int numThreads, double *coef, double *rho){
+    struct DualSolver solver;
+    memset(&solver, 0, sizeof(solver));
+    const int n=samples->l;
+    const int type=param->svm_type;
+    *rho=0;
+    if (n<1) {
+        return 0;
+    }
+    
+    solver.param=param;
+    solver.samples=samples;
+    solver.n=n;
+    solver.regression=type == EPSILON_SVR || type == NU_SVR;
+    solver.nu=type == NU_SVC || type == NU_SVR;
+    solver.l=solver.regression ? 2*n : n;
+    const int l=solver.l;
+    solver.y=Malloc(signed char, l);
+    solver.p=Malloc(double, l);
+    solver.alpha=Malloc(double, l);
+    solver.G=Malloc(double, l);
+    solver.G_bar=Malloc(double, l);
+    solver.QD=Malloc(double, l);
+    solver.status=Malloc(char, l);
+    solver.activeSet=Malloc(int, l);
+    solver.column=Malloc(int, n);
+    solver.square=Malloc(double, n);
+    solver.kernel=Malloc(double, n);
+    solver.rows=(float **)calloc(n, sizeof(float *));
+    solver.length=(int *)calloc(n, sizeof(int));
+    solver.prev=Malloc(int, n+1);
+    solver.next=Malloc(int, n+1);
+    if (solver.regression) {
+        solver.sample=Malloc(int, l);
+        solver.buffer[0]=Malloc(float, l);
+        solver.buffer[1]=Malloc(float, l);
+    }
+    if (solver.y == NULL || solver.p == NULL || solver.alpha == NULL || solver.G == NULL || solver.G_bar == NULL || solver.QD == NULL || solver.status == NULL || solver.activeSet == NULL || solver.column == NULL || solver.square == NULL || solver.kernel == NULL || solver.rows == NULL || solver.length == NULL || solver.prev == NULL || solver.next == NULL || (solver.regression && (solver.sample == NULL || solver.buffer[0] == NULL || solver.buffer[1] == NULL))) {
+        freeDualSolver(&solver);
+        return -1;
+    }
+    solver.prev[n]=n; // empty cache
+    solver.next[n]=n;
+    solver.maxRows=(size_t)(param->cache_size*1024*1024/((double)n*sizeof(float)));
+    solver.maxRows=std::max(solver.maxRows, (size_t)2);
+    solver.maxRows=std::min(solver.maxRows, (size_t)n);
+    solver.rowThreads=SVMNumberOfThreads(numThreads, SVM_MAX_THREADS);
+    solver.rowTerms=sampleNorms(samples, solver.column, solver.square);
+    
+    for (int k=0; k<n; k++) { // the diagonal, K(x,x)
+        double self=solver.square[k];
+        kernelValues(param, solver.square[k], &solver.square[k], &self, 1);
+        solver.QD[k]=self;
+        if (solver.regression) {
+            solver.QD[k+n]=self;
+            solver.sample[k]=k;
+            solver.sample[k+n]=k;
+        }
+    }
+    
+    switch (type) { // the starting point of solve_c_svc() ... solve_nu_svr()
+        case C_SVC:
+            solver.Cp=Cp;
+            solver.Cn=Cn;
+            for (int i=0; i<n; i++) {
+                solver.y[i]=y[i]>0 ? +1 : -1;
+                solver.p[i]=-1;
+                solver.alpha[i]=0;
+            }
+            break;
+        case NU_SVC: {
+            double sum_pos=param->nu*n/2;
+            double sum_neg=param->nu*n/2;
+            solver.Cp=1;
+            solver.Cn=1;
+            for (int i=0; i<n; i++) {
+                solver.y[i]=y[i]>0 ? +1 : -1;
+                solver.p[i]=0;
+                if (solver.y[i] == +1) {
+                    solver.alpha[i]=std::min(1.0, sum_pos);
+                    sum_pos-=solver.alpha[i];
+                }
+                else{
+                    solver.alpha[i]=std::min(1.0, sum_neg);
+                    sum_neg-=solver.alpha[i];
+                }
+            }
+            break;
+        }
+        case ONE_CLASS: {
+            int bound=(int)(param->nu*n); // number of alphas at the upper bound
+            solver.Cp=1;
+            solver.Cn=1;
+            for (int i=0; i<n; i++) {
+                solver.y[i]=+1;
+                solver.p[i]=0;
+                solver.alpha[i]=i<bound ? 1 : 0;
+            }
+            if (bound<n) {
+                solver.alpha[bound]=param->nu*n-bound;
+            }
+            break;
+        }
+        case EPSILON_SVR:
+            solver.Cp=param->C;
+            solver.Cn=param->C;
+            for (int i=0; i<n; i++) {
+                solver.alpha[i]=0;
+                solver.p[i]=param->p-y[i];
+                solver.y[i]=+1;
+                solver.alpha[i+n]=0;
+                solver.p[i+n]=param->p+y[i];
+                solver.y[i+n]=-1;
+            }
+            break;
+        case NU_SVR: {
+            double sum=param->C*param->nu*n/2;
+            solver.Cp=param->C;
+            solver.Cn=param->C;
+            for (int i=0; i<n; i++) {
+                solver.alpha[i]=std::min(sum, param->C);
+                solver.alpha[i+n]=solver.alpha[i];
+                sum-=solver.alpha[i];
+                solver.p[i]=-y[i];
+                solver.y[i]=+1;
+                solver.p[i+n]=y[i];
+                solver.y[i+n]=-1;
+            }
+            break;
+        }
+        default:
+            freeDualSolver(&solver);
+            return -1;
+    }
+    
+    if (solver.solve(rho)) {
+        freeDualSolver(&solver);
+        return -1;
+    }
+    
+    double *alpha=solver.G_bar; // not needed any more, receives alpha in the original order
+    signed char *sign=(signed char *)solver.status;
+    for (int i=0; i<l; i++) {
+        alpha[solver.activeSet[i]]=solver.alpha[i];
+        sign[solver.activeSet[i]]=solver.y[i];
+    }
+    for (int i=0; i<n; i++) {
+        switch (type) {
+            case C_SVC:
+                coef[i]=alpha[i]*sign[i];
+                break;
+            case NU_SVC:
+                coef[i]=alpha[i]*sign[i]/solver.r;
+                break;
+            case ONE_CLASS:
+                coef[i]=alpha[i];
+                break;
+            default:
+                coef[i]=alpha[i]-alpha[i+n];
+                break;
+        }
+    }
+    if (type == NU_SVC) {
+        *rho/=solver.r;
+    }
+    freeDualSolver(&solver);
+    return 0;
+}
+
+// the decision values of a block of target samples per call, shared by all workers of SVMParallelFor()
+struct DecisionTargets {
+    KernelColumns columns; // the kernel row of one target against the support vectors
+    const double *coef; // of the support vectors
+    double rho;
+    int numSV;
+    const int *target; // node or dense column of each target
+    const double *targetSquare; // squared norm of each target
+    double *dots; // numSV per worker
+    double *values;
+    
+    void operator()(size_t begin, size_t end, int thread){
+        KernelColumns row=columns;
+        row.values=dots+(size_t)thread*numSV;
+        for (size_t t=begin; t<end; t++) {
+            row.rowColumn=target[t];
+            row.rowSquare=targetSquare[t];
+            row((size_t)0, (size_t)numSV, thread);
+            double sum=0;
+            for (int j=0; j<numSV; j++) {
+                sum+=coef[j]*row.values[j];
+            }
+            values[t]=sum-rho;
+        }
+    }
+};
+
+/*
+ the decision function sum(coef[i]*K(x_i, x))-rho of solveDual() for the samples targets, with its own index into the same nodes or dense samples as samples: values receives one decision value per target. Only the samples with nonzero coefficient are used.
+ The targets are distributed over numThreads threads (<1: one per core). Returns -1 if memory runs out.
+ */
+
+int kernelDecisionValues(const struct SVMKernelSamples *samples, const double *coef, double rho, const struct svm_parameter *param, const struct SVMKernelSamples *targets, int numThreads, double *values){
+    const int n=samples->l;
+    const int m=targets->l;
+    int *column=Malloc(int, n>0 ? n : 1);
+    double *square=Malloc(double, n>0 ? n : 1);
+    double *svCoef=Malloc(double, n>0 ? n : 1);
+    int *target=Malloc(int, m>0 ? m : 1);
+    double *targetSquare=Malloc(double, m>0 ? m : 1);
+    if (column == NULL || square == NULL || svCoef == NULL || target == NULL || targetSquare == NULL) {
+        free(column);
+        free(square);
+        free(svCoef);
+        free(target);
+        free(targetSquare);
+        return -1;
+    }
+    double terms=sampleNorms(samples, column, square);
+    sampleNorms(targets, target, targetSquare);
+    int numSV=0;
+    for (int i=0; i<n; i++) { // the support vectors to the front
+        if (coef[i] != 0) {
+            column[numSV]=column[i];
+            square[numSV]=square[i];
+            svCoef[numSV]=coef[i];
+            numSV++;
+        }
+    }
+    
+    numThreads=SVMNumberOfThreads(numThreads, (size_t)(m*(double)numSV*terms/SVM_ROW_WORK));
+    DecisionTargets decision;
+    decision.columns.param=param;
+    decision.columns.samples=samples;
+    decision.columns.column=column;
+    decision.columns.square=param->kernel_type == RBF ? square : NULL;
+    decision.columns.first=0;
+    decision.coef=svCoef;
+    decision.rho=rho;
+    decision.numSV=numSV;
+    decision.target=target;
+    decision.targetSquare=targetSquare;
+    decision.values=values;
+    decision.dots=Malloc(double, (size_t)(numSV>0 ? numSV : 1)*numThreads);
+    int err=decision.dots == NULL ? -1 : 0;
+    if (!err) {
+        SVMParallelFor((size_t)m, 16, numThreads, decision);
+    }
+    
+    free(decision.dots);
+    free(column);
+    free(square);
+    free(svCoef);
+    free(target);
+    free(targetSquare);
+    return err;
+}
@@ -0,0 +1,24 @@
+/*
+	SVMSolver.h -- SMO solver for SVM XOP with the kernel rows computed on several threads
+*/
+
+#ifndef SVM_SOLVER_H
+#define SVM_SOLVER_H
+
+#include "libSVM/svm.h"
+#include "SVMDense.h"
+
+/*
+ the training samples of one problem: sample k is x[index[k]], or column index[k] of dense. Exactly one of x and dense is set, index is NULL for the samples in their own order.
+ */
+struct SVMKernelSamples {
+    struct svm_node *const *x;
+    const struct SVMDenseSamples *dense;
+    const int *index;
+    int l;
+};
+
+int solveDual(const struct SVMKernelSamples *samples, const double *y, const struct svm_parameter *param, double Cp, double Cn, int numThreads, double *coef, double *rho);
+int kernelDecisionValues(const struct SVMKernelSamples *samples, const double *coef, double rho, const struct svm_parameter *param, const struct SVMKernelSamples *targets, int numThreads, double *values);
+
+#endif
@@ -0,0 +1,96 @@
+/*	SVMThreads.h -- host independent worker pool for SVM XOP
+
+	Work is split into chunks of consecutive items that the workers take from a shared counter, so a slow
+	chunk doesn't hold up the others. Every item is processed exactly once and by exactly one worker, the
+	results only depend on which items were processed, not on which worker or in which order.
+	Workers must not call into Igor, all XOP callbacks have to happen on the main thread.
+*/
+
+#ifndef SVM_THREADS_H
+#define SVM_THREADS_H
+
+#include <stddef.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+enum {
+    SVM_MAX_THREADS=256
+};
+
+/*
+ number of workers to use when requested workers were asked for (<1 means one per core) for count items, at most one worker per item.
+ */
+inline int SVMNumberOfThreads(int requested, size_t count){
+    int numThreads=requested;
+    if (numThreads<1) {
+        numThreads=(int)std::thread::hardware_concurrency();
+        if (numThreads<1) {
+            numThreads=1;
+        }
+    }
+    if (numThreads>SVM_MAX_THREADS) {
+        numThreads=SVM_MAX_THREADS;
+    }
+    if ((size_t)numThreads>count) {
+        numThreads=count>0 ? (int)count : 1;
+    }
+    return numThreads;
+}
+
+template <class Operation>
+void SVMWorkerLoop(std::atomic<size_t> *next, size_t count, size_t chunk, int thread, Operation *op){
+    for (size_t begin=next->fetch_add(chunk); begin<count; begin=next->fetch_add(chunk)) {
+        size_t end=count-begin<chunk ? count : begin+chunk;
+        (*op)(begin, end, thread);
+    }
+}
+
+/*
+ calls op(begin, end, thread) for consecutive ranges [begin, end) covering [0, count), chunk items at a time, on numThreads workers. thread is the index of the worker (0...numThreads-1), for per-worker buffers.
+ The calling thread is worker 0. If a thread can't be started, the remaining workers take over its share.
+ */
+template <class Operation>
+void SVMParallelFor(size_t count, size_t chunk, int numThreads, Operation &op){
+    std::atomic<size_t> next(0);
+    if (chunk<1) {
+        chunk=1;
+    }
+    
+    std::vector<std::thread> workers;
+    for (int i=1; i<numThreads; i++) {
+        try {
+            workers.push_back(std::thread(SVMWorkerLoop<Operation>, &next, count, chunk, i, &op));
+        } catch (...) { // out of threads or memory, do with fewer workers
+            break;
+        }
+    }
+    SVMWorkerLoop(&next, count, chunk, 0, &op);
+    for (size_t i=0; i<workers.size(); i++) {
+        workers[i].join();
+    }
+}
+
+// shifts the ranges of SVMParallelFor() by first, see SVMParallelForRange()
+template <class Operation>
+struct SVMOffsetRange {
+    Operation *op;
+    size_t first;
+    
+    void operator()(size_t begin, size_t end, int thread){
+        (*op)(first+begin, first+end, thread);
+    }
+};
+
+/*
+ SVMParallelFor() for the items [first, first+count), e.g. a part of the samples that is converted at a time.
+ */
+template <class Operation>
+void SVMParallelForRange(size_t first, size_t count, size_t chunk, int numThreads, Operation &op){
+    SVMOffsetRange<Operation> range;
+    range.op=&op;
+    range.first=first;
+    SVMParallelFor(count, chunk, numThreads, range);
+}
+
+#endif
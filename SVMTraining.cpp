@@ -0,0 +1,1641 @@
+/*	SVMTraining.cpp -- parallel training helpers for SVM XOP
+
+	svm_cross_validation() trains the folds one after another and draws the fold assignment from rand(), so the
+	result depends on whatever used rand() before. parallelCrossValidation() assigns the folds the same way as
+	libSVM (stratified for C_SVC and NU_SVC) but from a private generator seeded by the caller, then trains the
+	folds concurrently. Each fold is trained and predicted exactly as in svm_cross_validation(), so for a given
+	seed the predictions don't depend on the number of threads. The kernel cache only affects speed, the global
+	cache budget is split between the workers.
+	libSVM itself is only thread safe as long as nothing calls rand(), which svm_train() does for probability
+	models (internal cross validation in svm_binary_svc_probability()). Cross validation of those runs on one
+	thread. parallelTrain() instead fits the probability model itself: the internal folds are drawn from the seed
+	and trained concurrently for all pairs of classes, the sigmoids are fitted as in sigmoid_train().
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "SVMTraining.h"
+#include "SVMLinear.h"
+#include "SVMSolver.h"
+#include "SVMThreads.h"
+
+#define Malloc(type,n) (type *)malloc((n)*sizeof(type)) //from libSVM
+
+enum {
+    SVM_PROBABILITY_FOLDS=5 // internal cross validation of the probability model, as in svm_binary_svc_probability() and svm_svr_probability()
+};
+
+/*
+ small deterministic random generator (xorshift64*) so the folds are the same on every platform and independent of rand(). randomState() gives the initial state for a seed.
+ */
+
+uint32_t nextRandom(uint64_t *state){
+    *state^=*state>>12;
+    *state^=*state<<25;
+    *state^=*state>>27;
+    return (uint32_t)((*state*2685821657736338717ULL)>>32);
+}
+
+uint64_t randomState(unsigned int seed){
+    return 0x9E3779B97F4A7C15ULL^((uint64_t)seed*0xBF58476D1CE4E5B9ULL); // never 0
+}
+
+/*
+ groups the samples of prob by class, same as svm_group_classes() in svm.cpp. Returns -1 if memory runs out.
+ */
+
+int groupClasses(const struct svm_problem *prob, struct SVMClassGroups *groups){
+    int l=prob->l;
+    int max_nr_class=16;
+    int nr_class=0;
+    int *label=Malloc(int, max_nr_class);
+    int *count=Malloc(int, max_nr_class);
+    int *data_label=Malloc(int, l>0 ? l : 1);
+    
+    memset(groups, 0, sizeof(*groups));
+    if (label == NULL || count == NULL || data_label == NULL) {
+        free(label);
+        free(count);
+        free(data_label);
+        return -1;
+    }
+    
+    for (int i=0; i<l; i++) {
+        int this_label=(int)prob->y[i];
+        int j;
+        for (j=0; j<nr_class; j++) {
+            if (this_label == label[j]) {
+                ++count[j];
+                break;
+            }
+        }
+        data_label[i]=j;
+        if (j == nr_class) {
+            if (nr_class == max_nr_class) {
+                max_nr_class*=2;
+                int *newLabel=(int *)realloc(label, max_nr_class*sizeof(int));
+                int *newCount=(int *)realloc(count, max_nr_class*sizeof(int));
+                if (newLabel != NULL) {
+                    label=newLabel;
+                }
+                if (newCount != NULL) {
+                    count=newCount;
+                }
+                if (newLabel == NULL || newCount == NULL) {
+                    free(label);
+                    free(count);
+                    free(data_label);
+                    return -1;
+                }
+            }
+            label[nr_class]=this_label;
+            count[nr_class]=1;
+            ++nr_class;
+        }
+    }
+    
+    // Labels are ordered by their first occurrence in the training set.
+    // However, for two-class sets with -1/+1 labels and -1 appears first,
+    // we swap labels to ensure that internally the binary SVM has positive data corresponding to the +1 instances.
+    if (nr_class == 2 && label[0] == -1 && label[1] == 1) {
+        int tmp=label[0];
+        label[0]=label[1];
+        label[1]=tmp;
+        tmp=count[0];
+        count[0]=count[1];
+        count[1]=tmp;
+        for (int i=0; i<l; i++) {
+            data_label[i]=data_label[i] == 0 ? 1 : 0;
+        }
+    }
+    
+    int *start=Malloc(int, nr_class>0 ? nr_class : 1);
+    int *perm=Malloc(int, l>0 ? l : 1);
+    if (start == NULL || perm == NULL) {
+        free(label);
+        free(count);
+        free(data_label);
+        free(start);
+        free(perm);
+        return -1;
+    }
+    start[0]=0;
+    for (int i=1; i<nr_class; i++) {
+        start[i]=start[i-1]+count[i-1];
+    }
+    for (int i=0; i<l; i++) {
+        perm[start[data_label[i]]]=i;
+        ++start[data_label[i]];
+    }
+    start[0]=0;
+    for (int i=1; i<nr_class; i++) {
+        start[i]=start[i-1]+count[i-1];
+    }
+    free(data_label);
+    
+    groups->nr_class=nr_class;
+    groups->label=label;
+    groups->start=start;
+    groups->count=count;
+    groups->perm=perm;
+    return 0;
+}
+
+void freeClassGroups(struct SVMClassGroups *groups){
+    free(groups->label);
+    free(groups->start);
+    free(groups->count);
+    free(groups->perm);
+    memset(groups, 0, sizeof(*groups));
+}
+
+/*
+ the sub-problem of the n samples set (indices into prob), for training on a part of the samples. The nodes are not copied, the caller frees sub->x and sub->y. Returns -1 if memory runs out.
+ */
+
+int subsetProblem(const struct svm_problem *prob, const int *set, int n, struct svm_problem *sub){
+    sub->l=n;
+    sub->y=Malloc(double, n>0 ? n : 1);
+    sub->x=Malloc(struct svm_node *, n>0 ? n : 1);
+    if (sub->y == NULL || sub->x == NULL) {
+        free(sub->y);
+        free(sub->x);
+        return -1;
+    }
+    for (int i=0; i<n; i++) {
+        sub->y[i]=prob->y[set[i]];
+        sub->x[i]=prob->x[set[i]];
+    }
+    return 0;
+}
+
+/*
+ assigns the samples of prob to nr_fold folds as svm_cross_validation() does, but shuffled with a generator seeded with seed. The samples of fold i are perm[fold_start[i]...fold_start[i+1]-1], fold_start needs nr_fold+1 entries.
+ Returns -1 if memory runs out.
+ */
+
+int crossValidationFolds(const struct svm_problem *prob, const struct svm_parameter *param, int nr_fold, unsigned int seed, int *perm, int *fold_start){
+    int l=prob->l;
+    uint64_t state=randomState(seed);
+    
+    if ((param->svm_type == C_SVC || param->svm_type == NU_SVC) && nr_fold<l) { // stratified folds
+        struct SVMClassGroups groups;
+        if (groupClasses(prob, &groups)) {
+            return -1;
+        }
+        int nr_class=groups.nr_class;
+        int *fold_count=Malloc(int, nr_fold);
+        int *index=Malloc(int, l);
+        if (fold_count == NULL || index == NULL) {
+            free(fold_count);
+            free(index);
+            freeClassGroups(&groups);
+            return -1;
+        }
+        
+        for (int i=0; i<l; i++) {
+            index[i]=groups.perm[i];
+        }
+        for (int c=0; c<nr_class; c++) { // random shuffle within each class
+            for (int i=0; i<groups.count[c]; i++) {
+                int j=i+(int)(nextRandom(&state)%(uint32_t)(groups.count[c]-i));
+                int tmp=index[groups.start[c]+j];
+                index[groups.start[c]+j]=index[groups.start[c]+i];
+                index[groups.start[c]+i]=tmp;
+            }
+        }
+        for (int i=0; i<nr_fold; i++) {
+            fold_count[i]=0;
+            for (int c=0; c<nr_class; c++) {
+                fold_count[i]+=(i+1)*groups.count[c]/nr_fold-i*groups.count[c]/nr_fold;
+            }
+        }
+        fold_start[0]=0;
+        for (int i=1; i<=nr_fold; i++) {
+            fold_start[i]=fold_start[i-1]+fold_count[i-1];
+        }
+        for (int c=0; c<nr_class; c++) {
+            for (int i=0; i<nr_fold; i++) {
+                int begin=groups.start[c]+i*groups.count[c]/nr_fold;
+                int end=groups.start[c]+(i+1)*groups.count[c]/nr_fold;
+                for (int j=begin; j<end; j++) {
+                    perm[fold_start[i]]=index[j];
+                    fold_start[i]++;
+                }
+            }
+        }
+        fold_start[0]=0;
+        for (int i=1; i<=nr_fold; i++) {
+            fold_start[i]=fold_start[i-1]+fold_count[i-1];
+        }
+        free(fold_count);
+        free(index);
+        freeClassGroups(&groups);
+    }
+    else{
+        for (int i=0; i<l; i++) {
+            perm[i]=i;
+        }
+        for (int i=0; i<l; i++) {
+            int j=i+(int)(nextRandom(&state)%(uint32_t)(l-i));
+            int tmp=perm[i];
+            perm[i]=perm[j];
+            perm[j]=tmp;
+        }
+        for (int i=0; i<=nr_fold; i++) {
+            fold_start[i]=(int)((long long)i*l/nr_fold);
+        }
+    }
+    return 0;
+}
+
+/*
+ trains on all folds but fold and predicts the samples of fold into target[perm[j]], same as the loop body of svm_cross_validation(). param->cache_size is the kernel cache of this training.
+ linearLoss (SVM_LINEAR_L1LOSS or SVM_LINEAR_L2LOSS) trains with linearTrain() instead of svm_train(), 0 for svm_train(). rowThreads>0 trains with solverTrain() instead, the kernel rows on rowThreads threads and the probability model from folds drawn with seed. Returns -1 if memory runs out.
+ */
+
+int crossValidationFold(const struct svm_problem *prob, const struct svm_parameter *param, int linearLoss, int rowThreads, unsigned int seed, const int *perm, const int *fold_start, int fold, double *target){
+    int foldBegin=fold_start[fold];
+    int foldEnd=fold_start[fold+1];
+    struct svm_problem subprob;
+    subprob.l=prob->l-(foldEnd-foldBegin);
+    subprob.x=Malloc(struct svm_node*, subprob.l>0 ? subprob.l : 1);
+    subprob.y=Malloc(double, subprob.l>0 ? subprob.l : 1);
+    if (subprob.x == NULL || subprob.y == NULL) {
+        free(subprob.x);
+        free(subprob.y);
+        return -1;
+    }
+    
+    int k=0;
+    for (int j=0; j<foldBegin; j++) {
+        subprob.x[k]=prob->x[perm[j]];
+        subprob.y[k]=prob->y[perm[j]];
+        ++k;
+    }
+    for (int j=foldEnd; j<prob->l; j++) {
+        subprob.x[k]=prob->x[perm[j]];
+        subprob.y[k]=prob->y[perm[j]];
+        ++k;
+    }
+    
+    struct svm_model *submodel;
+    if (linearLoss) {
+        submodel=linearTrain(&subprob, param, linearLoss, 1);
+    }
+    else if (rowThreads) {
+        submodel=solverTrain(&subprob, NULL, param, seed, rowThreads, param->cache_size);
+    }
+    else{
+        submodel=svm_train(&subprob, param);
+    }
+    if (submodel == NULL) {
+        free(subprob.x);
+        free(subprob.y);
+        return -1;
+    }
+    if (param->probability && (param->svm_type == C_SVC || param->svm_type == NU_SVC)) {
+        double *prob_estimates=Malloc(double, svm_get_nr_class(submodel));
+        for (int j=foldBegin; j<foldEnd; j++) {
+            target[perm[j]]=svm_predict_probability(submodel, prob->x[perm[j]], prob_estimates);
+        }
+        free(prob_estimates);
+    }
+    else{
+        for (int j=foldBegin; j<foldEnd; j++) {
+            target[perm[j]]=svm_predict(submodel, prob->x[perm[j]]);
+        }
+    }
+    svm_free_and_destroy_model(&submodel);
+    free(subprob.x);
+    free(subprob.y);
+    return 0;
+}
+
+// trains and predicts one fold per task, shared by all workers of SVMParallelFor()
+struct CrossValidationFolds {
+    const struct svm_problem *prob;
+    struct svm_parameter param; // cache_size is the share of one worker
+    int linearLoss;
+    int rowThreads; // >0: solverTrain() on that many threads per fold
+    unsigned int seed;
+    const int *perm;
+    const int *fold_start;
+    double *target;
+    std::atomic<int> failed; // set by a worker that ran out of memory
+    
+    void operator()(size_t begin, size_t end, int){
+        for (size_t i=begin; i<end; i++) {
+            if (crossValidationFold(prob, &param, linearLoss, rowThreads, seed, perm, fold_start, (int)i, target)) {
+                failed=1;
+            }
+        }
+    }
+};
+
+/*
+ helper function, the cache share of each of numThreads workers from the global budget (MB).
+ */
+
+static double workerCacheSize(double cacheBudget, int numThreads){
+    double cacheSize=cacheBudget/numThreads;
+    return cacheSize<1 ? 1 : cacheSize;
+}
+
+/*
+ helper function, the kernel row threads of each of workers when numThreads (<1: one per core) are shared by them, at least one.
+ */
+
+static int rowThreadsPerWorker(int numThreads, int workers){
+    int rowThreads=SVMNumberOfThreads(numThreads, SVM_MAX_THREADS)/workers;
+    return rowThreads>1 ? rowThreads : 1;
+}
+
+/*
+ helper function, parallelCrossValidation() and solverCrossValidation(): with solver set the folds are trained with solverTrain(), the threads that are left over when every fold has a worker compute the kernel rows.
+ */
+
+static int crossValidation(const struct svm_problem *prob, const struct svm_parameter *param, int linearLoss, int solver, int nr_fold, unsigned int seed, int numThreads, double cacheBudget, double *target){
+    int l=prob->l;
+    if (nr_fold>l) {
+        nr_fold=l; // same as libSVM, leave-one-out
+    }
+    if (nr_fold<1) {
+        return -1;
+    }
+    
+    int *perm=Malloc(int, l);
+    int *fold_start=Malloc(int, nr_fold+1);
+    if (perm == NULL || fold_start == NULL || crossValidationFolds(prob, param, nr_fold, seed, perm, fold_start)) {
+        free(perm);
+        free(fold_start);
+        return -1;
+    }
+    
+    if (param->probability && !linearLoss && !solver) { // svm_train() calls rand() for probability models, which is not thread safe
+        numThreads=1;
+    }
+    int workers=SVMNumberOfThreads(numThreads, (size_t)nr_fold);
+    
+    CrossValidationFolds folds;
+    folds.prob=prob;
+    folds.param=*param;
+    folds.param.cache_size=workerCacheSize(cacheBudget, workers);
+    folds.linearLoss=linearLoss;
+    folds.rowThreads=solver ? rowThreadsPerWorker(numThreads, workers) : 0;
+    folds.seed=seed;
+    folds.perm=perm;
+    folds.fold_start=fold_start;
+    folds.target=target;
+    folds.failed=0;
+    SVMParallelFor((size_t)nr_fold, 1, workers, folds); // one fold per task, each fold writes only the targets of its own samples
+    
+    free(perm);
+    free(fold_start);
+    return folds.failed ? -1 : 0;
+}
+
+/*
+ nr_fold cross validation like svm_cross_validation(), with the folds trained on up to numThreads workers. target receives the prediction for each sample. The folds are drawn with seed (see crossValidationFolds()), cacheBudget (MB) is split between the workers.
+ Probability models are trained on one thread (svm_train() uses rand() for them). libSVM's print function is called from the workers, the caller has to make sure that is safe.
+ linearLoss selects the linear solver, see crossValidationFold(). Returns -1 if memory runs out.
+ */
+
+int parallelCrossValidation(const struct svm_problem *prob, const struct svm_parameter *param, int linearLoss, int nr_fold, unsigned int seed, int numThreads, double cacheBudget, double *target){
+    return crossValidation(prob, param, linearLoss, 0, nr_fold, seed, numThreads, cacheBudget, target);
+}
+
+/*
+ parallelCrossValidation() with every fold trained by solverTrain() (SVMSolver.cpp) instead of svm_train(): the folds run on up to numThreads workers, and the threads that are left over compute the kernel rows of each fold. Same folds; the predictions don't depend on the number of threads, probability models included (their folds are drawn from seed).
+ Not for PRECOMPUTED kernels. Returns -1 if memory runs out.
+ */
+
+int solverCrossValidation(const struct svm_problem *prob, const struct svm_parameter *param, int nr_fold, unsigned int seed, int numThreads, double cacheBudget, double *target){
+    return crossValidation(prob, param, 0, 1, nr_fold, seed, numThreads, cacheBudget, target);
+}
+
+// one task per grid point and fold, shared by all workers of SVMParallelFor()
+struct GridSearchTasks {
+    const struct svm_problem *prob;
+    struct svm_parameter param; // everything but the grid parameters, cache_size is the share of one worker
+    const struct SVMGridPoint *points;
+    int nr_fold;
+    int rowThreads; // >0: solverTrain() on that many threads per task
+    unsigned int seed;
+    const int *perm;
+    const int *fold_start;
+    double *targets; // l per worker
+    double *foldScores; // numPoints*nr_fold, number of correct predictions or sum of squared errors
+    std::atomic<int> failed;
+    
+    void operator()(size_t begin, size_t end, int thread){
+        double *target=targets+(size_t)thread*prob->l;
+        for (size_t task=begin; task<end; task++) {
+            int point=(int)(task/nr_fold);
+            int fold=(int)(task%nr_fold);
+            if (!points[point].valid) {
+                continue;
+            }
+            struct svm_parameter pointParam=param;
+            pointParam.C=points[point].C;
+            pointParam.gamma=points[point].gamma;
+            pointParam.nu=points[point].nu;
+            if (crossValidationFold(prob, &pointParam, 0, rowThreads, seed, perm, fold_start, fold, target)) {
+                failed=1;
+                continue;
+            }
+            
+            double score=0;
+            for (int j=fold_start[fold]; j<fold_start[fold+1]; j++) {
+                int i=perm[j];
+                if (param.svm_type == EPSILON_SVR || param.svm_type == NU_SVR) {
+                    score+=(target[i]-prob->y[i])*(target[i]-prob->y[i]);
+                }
+                else if (param.svm_type == ONE_CLASS) {
+                    score+=target[i]>0; // same as SVMTrain /V
+                }
+                else{
+                    score+=target[i] == prob->y[i];
+                }
+            }
+            foldScores[task]=score;
+        }
+    }
+};
+
+/*
+ helper function, parallelGridSearch() and solverGridSearch(): with solver set the folds are trained with solverTrain(), see crossValidation().
+ */
+
+static int gridSearch(const struct svm_problem *prob, const struct svm_parameter *param, const struct SVMGridPoint *points, int numPoints, int solver, int nr_fold, unsigned int seed, int numThreads, double cacheBudget, double *scores){
+    int l=prob->l;
+    if (nr_fold>l) {
+        nr_fold=l;
+    }
+    if (nr_fold<1 || numPoints<1) {
+        return -1;
+    }
+    
+    size_t numTasks=(size_t)numPoints*nr_fold;
+    if (param->probability && !solver) { // see parallelCrossValidation()
+        numThreads=1;
+    }
+    int rowThreads=0;
+    if (solver) {
+        rowThreads=rowThreadsPerWorker(numThreads, SVMNumberOfThreads(numThreads, numTasks));
+    }
+    numThreads=SVMNumberOfThreads(numThreads, numTasks);
+    
+    int *perm=Malloc(int, l);
+    int *fold_start=Malloc(int, nr_fold+1);
+    double *targets=Malloc(double, (size_t)l*numThreads);
+    double *foldScores=Malloc(double, numTasks);
+    if (perm == NULL || fold_start == NULL || targets == NULL || foldScores == NULL || crossValidationFolds(prob, param, nr_fold, seed, perm, fold_start)) {
+        free(perm);
+        free(fold_start);
+        free(targets);
+        free(foldScores);
+        return -1;
+    }
+    
+    GridSearchTasks tasks;
+    tasks.prob=prob;
+    tasks.param=*param;
+    tasks.param.cache_size=workerCacheSize(cacheBudget, numThreads);
+    tasks.points=points;
+    tasks.nr_fold=nr_fold;
+    tasks.rowThreads=rowThreads;
+    tasks.seed=seed;
+    tasks.perm=perm;
+    tasks.fold_start=fold_start;
+    tasks.targets=targets;
+    tasks.foldScores=foldScores;
+    tasks.failed=0;
+    SVMParallelFor(numTasks, 1, numThreads, tasks);
+    
+    for (int i=0; i<numPoints; i++) {
+        if (!points[i].valid) {
+            scores[i]=NAN;
+            continue;
+        }
+        double sum=0;
+        for (int fold=0; fold<nr_fold; fold++) {
+            sum+=foldScores[(size_t)i*nr_fold+fold];
+        }
+        if (param->svm_type == EPSILON_SVR || param->svm_type == NU_SVR) {
+            scores[i]=sum/l;
+        }
+        else{
+            scores[i]=100.0*sum/l;
+        }
+    }
+    
+    free(perm);
+    free(fold_start);
+    free(targets);
+    free(foldScores);
+    return tasks.failed ? -1 : 0;
+}
+
+/*
+ nr_fold cross validation of every grid point, all points use the same folds (drawn with seed, see crossValidationFolds()). The tasks (one per point and fold) run on up to numThreads workers, cacheBudget (MB) is split between them.
+ scores receives the accuracy in % for classification and the mean squared error for regression, NaN for points that are not valid. The fold results are added up in fold order, so the scores don't depend on the number of threads.
+ Returns -1 if memory runs out.
+ */
+
+int parallelGridSearch(const struct svm_problem *prob, const struct svm_parameter *param, const struct SVMGridPoint *points, int numPoints, int nr_fold, unsigned int seed, int numThreads, double cacheBudget, double *scores){
+    return gridSearch(prob, param, points, numPoints, 0, nr_fold, seed, numThreads, cacheBudget, scores);
+}
+
+/*
+ parallelGridSearch() with every fold trained by solverTrain() (SVMSolver.cpp), the threads left over when every task has a worker compute the kernel rows. Same scores for any number of threads. Not for PRECOMPUTED kernels. Returns -1 if memory runs out.
+ */
+
+int solverGridSearch(const struct svm_problem *prob, const struct svm_parameter *param, const struct SVMGridPoint *points, int numPoints, int nr_fold, unsigned int seed, int numThreads, double cacheBudget, double *scores){
+    return gridSearch(prob, param, points, numPoints, 1, nr_fold, seed, numThreads, cacheBudget, scores);
+}
+
+/*
+ helper function, the C of each class with the weights of param applied, same as svm_train()
+ */
+
+static void weightedC(const struct svm_parameter *param, const struct SVMClassGroups *groups, double *weighted_C){
+    for (int i=0; i<groups->nr_class; i++) {
+        weighted_C[i]=param->C;
+    }
+    for (int i=0; i<param->nr_weight; i++) {
+        for (int j=0; j<groups->nr_class; j++) {
+            if (param->weight_label[i] == groups->label[j]) {
+                weighted_C[j]*=param->weight[i];
+                break;
+            }
+        }
+    }
+}
+
+/*
+ helper function, the node or dense column of sample i of samples
+ */
+
+static inline int sampleColumn(const struct SVMKernelSamples *samples, int i){
+    return samples->index != NULL ? samples->index[i] : i;
+}
+
+// trains one pair of classes per task, shared by all workers of SVMParallelFor()
+struct OneVsOneTasks {
+    struct svm_parameter param; // cache_size is the share of one worker, C and the weights are set per pair
+    const struct SVMClassGroups *groups;
+    struct svm_node **x; // samples grouped by class
+    const double *weighted_C;
+    const int *pairI; // classes of each pair
+    const int *pairJ;
+    int linearLoss; // 0: svm_train(), otherwise the loss of linearClassifierDual()
+    int rowThreads; // >0: solveDual() with each kernel row computed on rowThreads threads
+    const struct SVMKernelSamples *samples; // rowThreads only, the samples of the problem instead of its nodes, NULL for the nodes
+    double **alpha; // per pair, count[i]+count[j] coefficients, 0 for samples that are no support vectors
+    double *rho;
+    std::atomic<int> failed;
+    
+    void operator()(size_t begin, size_t end, int){
+        for (size_t p=begin; p<end; p++) {
+            if (trainPair((int)p)) {
+                failed=1;
+            }
+        }
+    }
+    
+    /*
+     the same binary problem svm_train() builds for the pair (class i as +1, class j as -1) trained with svm_train(). Class +1 comes first, so libSVM doesn't reorder the samples, and with C=1 and the weights Cp and Cn are exactly weighted_C[i] and weighted_C[j].
+     With linearLoss set the pair is solved by linearClassifierDual() with the same penalties instead, with rowThreads set by solveDual() (on samples if set).
+     */
+    int trainPair(int p){
+        int i=pairI[p];
+        int j=pairJ[p];
+        int si=groups->start[i];
+        int sj=groups->start[j];
+        int ci=groups->count[i];
+        int cj=groups->count[j];
+        
+        struct svm_problem sub_prob;
+        sub_prob.l=ci+cj;
+        sub_prob.x=Malloc(struct svm_node *, sub_prob.l);
+        sub_prob.y=Malloc(double, sub_prob.l);
+        alpha[p]=(double*)calloc(sub_prob.l, sizeof(double));
+        if (sub_prob.x == NULL || sub_prob.y == NULL || alpha[p] == NULL) {
+            free(sub_prob.x);
+            free(sub_prob.y);
+            return -1;
+        }
+        for (int k=0; k<ci; k++) {
+            sub_prob.x[k]=x[si+k];
+            sub_prob.y[k]=+1;
+        }
+        for (int k=0; k<cj; k++) {
+            sub_prob.x[ci+k]=x[sj+k];
+            sub_prob.y[ci+k]=-1;
+        }
+        
+        if (linearLoss) {
+            double bias;
+            int result=linearClassifierDual(sub_prob.x, sub_prob.y, sub_prob.l, weighted_C[i], weighted_C[j], linearLoss, param.eps, alpha[p], &bias);
+            rho[p]=-bias; // decision value w·x+bias, libSVM subtracts rho
+            free(sub_prob.x);
+            free(sub_prob.y);
+            return result;
+        }
+        if (rowThreads) {
+            struct SVMKernelSamples pairSamples={sub_prob.x, NULL, NULL, sub_prob.l};
+            int *index=NULL;
+            if (samples != NULL) { // the columns of the samples of the pair
+                index=Malloc(int, sub_prob.l);
+                if (index == NULL) {
+                    free(sub_prob.x);
+                    free(sub_prob.y);
+                    return -1;
+                }
+                for (int k=0; k<ci; k++) {
+                    index[k]=sampleColumn(samples, groups->perm[si+k]);
+                }
+                for (int k=0; k<cj; k++) {
+                    index[ci+k]=sampleColumn(samples, groups->perm[sj+k]);
+                }
+                pairSamples.x=samples->x;
+                pairSamples.dense=samples->dense;
+                pairSamples.index=index;
+            }
+            int result=solveDual(&pairSamples, sub_prob.y, &param, weighted_C[i], weighted_C[j], rowThreads, alpha[p], &rho[p]);
+            free(index);
+            free(sub_prob.x);
+            free(sub_prob.y);
+            return result;
+        }
+        
+        int weight_label[2]={+1, -1};
+        double weight[2]={weighted_C[i], weighted_C[j]};
+        struct svm_parameter pairParam=param;
+        pairParam.C=1;
+        pairParam.nr_weight=2;
+        pairParam.weight_label=weight_label;
+        pairParam.weight=weight;
+        
+        struct svm_model *submodel=svm_train(&sub_prob, &pairParam);
+        for (int k=0; k<submodel->l; k++) { // the coefficients of the support vectors, sv_indices are one based positions in sub_prob
+            alpha[p][submodel->sv_indices[k]-1]=submodel->sv_coef[0][k];
+        }
+        rho[p]=submodel->rho[0];
+        svm_free_and_destroy_model(&submodel);
+        free(sub_prob.x);
+        free(sub_prob.y);
+        return 0;
+    }
+};
+
+/*
+ helper function, svm_train() for C_SVC and NU_SVC models with more than two classes, with the k(k-1)/2 one-vs-one problems trained on up to numThreads workers. cacheBudget (MB) is split between the workers.
+ The pairs are trained with svm_train() on exactly the binary problems svm_train() would solve, and the model is put together as in svm_train(), so it is identical to a serial training run.
+ Other models, probability models (svm_train() uses rand() for them) and two classes are trained with svm_train() directly. Returns NULL if memory runs out.
+ With linearLoss set (C_SVC only) every pair, also of two classes, is solved with linearClassifierDual() and the model is put together the same way.
+ With rowThreads set (C_SVC and NU_SVC, no probability) every pair is solved with solveDual(), one after the other with the kernel rows computed on rowThreads threads and cached in cacheBudget MB. If samples is set the pairs are solved on them instead of the nodes of prob (prob->x may be NULL), the support vectors of the model are NULL then.
+ */
+
+static struct svm_model *oneVsOneTrain(const struct svm_problem *prob, const struct svm_parameter *param, int numThreads, double cacheBudget, int linearLoss, int rowThreads, const struct SVMKernelSamples *samples){
+    struct SVMClassGroups groups;
+    if (!linearLoss && !rowThreads && ((param->svm_type != C_SVC && param->svm_type != NU_SVC) || param->probability || numThreads == 1)) {
+        return svm_train(prob, param);
+    }
+    if (groupClasses(prob, &groups)) {
+        return NULL;
+    }
+    int nr_class=groups.nr_class;
+    if (nr_class<3 && !linearLoss && !rowThreads) {
+        freeClassGroups(&groups);
+        return svm_train(prob, param);
+    }
+    
+    int l=prob->l;
+    int numPairs=nr_class*(nr_class-1)/2;
+    numThreads=rowThreads ? 1 : SVMNumberOfThreads(numThreads, (size_t)numPairs); // with rowThreads the threads work on the kernel rows
+    
+    struct svm_node **x=Malloc(struct svm_node *, l);
+    double *weighted_C=Malloc(double, nr_class);
+    int *pairI=Malloc(int, numPairs>0 ? numPairs : 1);
+    int *pairJ=Malloc(int, numPairs>0 ? numPairs : 1);
+    double **alpha=(double **)calloc(numPairs>0 ? numPairs : 1, sizeof(double *));
+    double *rho=Malloc(double, numPairs>0 ? numPairs : 1);
+    struct svm_model *model=(struct svm_model *)calloc(1, sizeof(struct svm_model));
+    int failed=x == NULL || weighted_C == NULL || pairI == NULL || pairJ == NULL || alpha == NULL || rho == NULL || model == NULL;
+    
+    if (!failed) {
+        for (int i=0; i<l; i++) {
+            x[i]=prob->x != NULL ? prob->x[groups.perm[i]] : NULL;
+        }
+        weightedC(param, &groups, weighted_C);
+        int p=0;
+        for (int i=0; i<nr_class; i++) {
+            for (int j=i+1; j<nr_class; j++) {
+                pairI[p]=i;
+                pairJ[p]=j;
+                p++;
+            }
+        }
+        
+        OneVsOneTasks tasks;
+        tasks.param=*param;
+        tasks.param.cache_size=workerCacheSize(cacheBudget, numThreads);
+        tasks.groups=&groups;
+        tasks.x=x;
+        tasks.weighted_C=weighted_C;
+        tasks.pairI=pairI;
+        tasks.pairJ=pairJ;
+        tasks.linearLoss=linearLoss;
+        tasks.rowThreads=rowThreads;
+        tasks.samples=samples;
+        tasks.alpha=alpha;
+        tasks.rho=rho;
+        tasks.failed=0;
+        SVMParallelFor((size_t)numPairs, 1, numThreads, tasks); // each pair writes only its own alpha and rho
+        failed=tasks.failed;
+    }
+    
+    // build the model as svm_train() does
+    int total_sv=0;
+    int *nz_start=NULL;
+    char *nonzero=NULL;
+    if (!failed) {
+        model->param=*param;
+        model->free_sv=0;
+        model->nr_class=nr_class;
+        model->label=Malloc(int, nr_class);
+        model->rho=Malloc(double, numPairs>0 ? numPairs : 1);
+        model->nSV=Malloc(int, nr_class);
+        nz_start=Malloc(int, nr_class);
+        nonzero=(char *)calloc(l, sizeof(char));
+        failed=model->label == NULL || model->rho == NULL || model->nSV == NULL || nz_start == NULL || nonzero == NULL;
+    }
+    if (!failed) {
+        for (int i=0; i<nr_class; i++) {
+            model->label[i]=groups.label[i];
+        }
+        for (int p=0; p<numPairs; p++) {
+            model->rho[p]=rho[p];
+            int i=pairI[p];
+            int j=pairJ[p];
+            for (int k=0; k<groups.count[i]; k++) {
+                if (fabs(alpha[p][k])>0) {
+                    nonzero[groups.start[i]+k]=1;
+                }
+            }
+            for (int k=0; k<groups.count[j]; k++) {
+                if (fabs(alpha[p][groups.count[i]+k])>0) {
+                    nonzero[groups.start[j]+k]=1;
+                }
+            }
+        }
+        model->probA=NULL;
+        model->probB=NULL;
+        
+        for (int i=0; i<nr_class; i++) {
+            int nSV=0;
+            for (int j=0; j<groups.count[i]; j++) {
+                if (nonzero[groups.start[i]+j]) {
+                    ++nSV;
+                    ++total_sv;
+                }
+            }
+            model->nSV[i]=nSV;
+        }
+        nz_start[0]=0;
+        for (int i=1; i<nr_class; i++) {
+            nz_start[i]=nz_start[i-1]+model->nSV[i-1];
+        }
+        
+        model->l=total_sv;
+        model->SV=Malloc(struct svm_node *, total_sv>0 ? total_sv : 1);
+        model->sv_indices=Malloc(int, total_sv>0 ? total_sv : 1);
+        model->sv_coef=(double **)calloc(nr_class>1 ? nr_class-1 : 1, sizeof(double *));
+        failed=model->SV == NULL || model->sv_indices == NULL || model->sv_coef == NULL;
+        for (int i=0; i<nr_class-1 && !failed; i++) {
+            model->sv_coef[i]=Malloc(double, total_sv>0 ? total_sv : 1);
+            failed=model->sv_coef[i] == NULL;
+        }
+    }
+    if (!failed) {
+        int p=0;
+        for (int i=0; i<l; i++) {
+            if (nonzero[i]) {
+                model->SV[p]=x[i];
+                model->sv_indices[p++]=groups.perm[i]+1;
+            }
+        }
+        
+        p=0;
+        for (int i=0; i<nr_class; i++) {
+            for (int j=i+1; j<nr_class; j++) {
+                // classifier (i,j): coefficients with i are in sv_coef[j-1][nz_start[i]...], with j in sv_coef[i][nz_start[j]...]
+                int si=groups.start[i];
+                int sj=groups.start[j];
+                int ci=groups.count[i];
+                int cj=groups.count[j];
+                
+                int q=nz_start[i];
+                for (int k=0; k<ci; k++) {
+                    if (nonzero[si+k]) {
+                        model->sv_coef[j-1][q++]=alpha[p][k];
+                    }
+                }
+                q=nz_start[j];
+                for (int k=0; k<cj; k++) {
+                    if (nonzero[sj+k]) {
+                        model->sv_coef[i][q++]=alpha[p][ci+k];
+                    }
+                }
+                ++p;
+            }
+        }
+    }
+    
+    if (failed && model != NULL) {
+        model->free_sv=0;
+        svm_free_and_destroy_model(&model); // frees whatever was allocated (all NULL otherwise), the support vectors belong to prob
+        model=NULL;
+    }
+    
+    if (alpha != NULL) {
+        for (int p=0; p<numPairs; p++) {
+            free(alpha[p]);
+        }
+    }
+    free(alpha);
+    free(rho);
+    free(x);
+    free(weighted_C);
+    free(pairI);
+    free(pairJ);
+    free(nz_start);
+    free(nonzero);
+    freeClassGroups(&groups);
+    return model;
+}
+
+/*
+ helper function, fits the sigmoid 1/(1+exp(A*f+B)) to the decision values f of l samples with labels (+1/-1), same as sigmoid_train() in svm.cpp (Platt's method with Lin's improvements). Returns -1 if memory runs out.
+ */
+
+static int sigmoidTrain(int l, const double *dec_values, const double *labels, double *A, double *B){
+    double prior1=0;
+    double prior0=0;
+    for (int i=0; i<l; i++) {
+        if (labels[i]>0) {
+            prior1+=1;
+        }
+        else{
+            prior0+=1;
+        }
+    }
+    
+    int max_iter=100; // maximal number of iterations
+    double min_step=1e-10; // minimal step taken in line search
+    double sigma=1e-12; // for numerically strict PD of Hessian
+    double eps=1e-5;
+    double hiTarget=(prior1+1.0)/(prior1+2.0);
+    double loTarget=1/(prior0+2.0);
+    double *t=Malloc(double, l>0 ? l : 1);
+    if (t == NULL) {
+        return -1;
+    }
+    
+    // initial point and initial function value
+    *A=0.0;
+    *B=log((prior0+1.0)/(prior1+1.0));
+    double fval=0.0;
+    for (int i=0; i<l; i++) {
+        t[i]=labels[i]>0 ? hiTarget : loTarget;
+        double fApB=dec_values[i]**A+*B;
+        if (fApB >= 0) {
+            fval+=t[i]*fApB+log(1+exp(-fApB));
+        }
+        else{
+            fval+=(t[i]-1)*fApB+log(1+exp(fApB));
+        }
+    }
+    for (int iter=0; iter<max_iter; iter++) {
+        // update gradient and Hessian (use H' = H + sigma I)
+        double h11=sigma;
+        double h22=sigma;
+        double h21=0.0;
+        double g1=0.0;
+        double g2=0.0;
+        for (int i=0; i<l; i++) {
+            double fApB=dec_values[i]**A+*B;
+            double p;
+            double q;
+            if (fApB >= 0) {
+                p=exp(-fApB)/(1.0+exp(-fApB));
+                q=1.0/(1.0+exp(-fApB));
+            }
+            else{
+                p=1.0/(1.0+exp(fApB));
+                q=exp(fApB)/(1.0+exp(fApB));
+            }
+            double d2=p*q;
+            h11+=dec_values[i]*dec_values[i]*d2;
+            h22+=d2;
+            h21+=dec_values[i]*d2;
+            double d1=t[i]-p;
+            g1+=dec_values[i]*d1;
+            g2+=d1;
+        }
+        
+        if (fabs(g1)<eps && fabs(g2)<eps) { // stopping criteria
+            break;
+        }
+        
+        // finding Newton direction: -inv(H') * g
+        double det=h11*h22-h21*h21;
+        double dA=-(h22*g1-h21*g2)/det;
+        double dB=-(-h21*g1+h11*g2)/det;
+        double gd=g1*dA+g2*dB;
+        
+        double stepsize=1; // line search
+        while (stepsize >= min_step) {
+            double newA=*A+stepsize*dA;
+            double newB=*B+stepsize*dB;
+            double newf=0.0;
+            for (int i=0; i<l; i++) {
+                double fApB=dec_values[i]*newA+newB;
+                if (fApB >= 0) {
+                    newf+=t[i]*fApB+log(1+exp(-fApB));
+                }
+                else{
+                    newf+=(t[i]-1)*fApB+log(1+exp(fApB));
+                }
+            }
+            if (newf<fval+0.0001*stepsize*gd) { // check sufficient decrease
+                *A=newA;
+                *B=newB;
+                fval=newf;
+                break;
+            }
+            stepsize=stepsize/2.0;
+        }
+        if (stepsize<min_step) { // line search fails, libSVM gives up here as well
+            break;
+        }
+    }
+    free(t);
+    return 0;
+}
+
+/*
+ helper function, the scale of the Laplace distribution libSVM assumes for the errors of a regression model, from the residuals (target-prediction) of l samples. Same as the end of svm_svr_probability() in svm.cpp.
+ */
+
+static double laplaceScale(int l, const double *residuals){
+    double mae=0;
+    for (int i=0; i<l; i++) {
+        mae+=fabs(residuals[i]);
+    }
+    mae/=l;
+    double std=sqrt(2*mae*mae);
+    int count=0;
+    mae=0;
+    for (int i=0; i<l; i++) {
+        if (fabs(residuals[i])>5*std) { // outliers are left out
+            count=count+1;
+        }
+        else{
+            mae+=fabs(residuals[i]);
+        }
+    }
+    return mae/(l-count);
+}
+
+// the internal cross validation of the probability model, one fold of one pair of classes per task, shared by all workers of SVMParallelFor()
+struct PlattFolds {
+    struct svm_parameter param; // cache_size is the share of one worker, C and the weights are set per pair
+    const struct svm_problem *prob;
+    const struct SVMClassGroups *groups;
+    const double *weighted_C;
+    const int *pairI; // classes of each pair
+    const int *pairJ;
+    int **perm; // per pair, the shuffled positions in the binary problem of the pair (class i first, then class j)
+    double **decValues; // per pair, the decision value of each position when it was left out
+    const struct SVMKernelSamples *samples; // NULL: svm_train() on the nodes of prob, otherwise solveDual() on these with the kernel rows on rowThreads threads
+    int rowThreads;
+    std::atomic<int> failed;
+    
+    void operator()(size_t begin, size_t end, int){
+        for (size_t t=begin; t<end; t++) {
+            if (trainFold((int)(t/SVM_PROBABILITY_FOLDS), (int)(t%SVM_PROBABILITY_FOLDS))) {
+                failed=1;
+            }
+        }
+    }
+    
+    /*
+     one iteration of the loop in svm_binary_svc_probability(): trains the binary problem of pair p without fold and predicts the left out samples.
+     */
+    int trainFold(int p, int fold){
+        int ci=groups->count[pairI[p]];
+        int n=ci+groups->count[pairJ[p]];
+        int begin=(int)((long long)fold*n/SVM_PROBABILITY_FOLDS);
+        int end=(int)((long long)(fold+1)*n/SVM_PROBABILITY_FOLDS);
+        
+        struct svm_problem subprob;
+        subprob.l=n-(end-begin);
+        subprob.x=Malloc(struct svm_node *, subprob.l>0 ? subprob.l : 1);
+        subprob.y=Malloc(double, subprob.l>0 ? subprob.l : 1);
+        int *index=samples != NULL ? Malloc(int, n) : NULL; // solveDual(): the columns of the training samples, then of the left out ones
+        if (subprob.x == NULL || subprob.y == NULL || (samples != NULL && index == NULL)) {
+            free(subprob.x);
+            free(subprob.y);
+            free(index);
+            return -1;
+        }
+        
+        int k=0;
+        int p_count=0;
+        int n_count=0;
+        for (int j=0; j<n; j++) {
+            if (j >= begin && j<end) { // the left out fold
+                if (index != NULL) {
+                    index[subprob.l+j-begin]=sampleColumn(samples, sample(p, perm[p][j]));
+                }
+                continue;
+            }
+            int position=perm[p][j];
+            subprob.x[k]=prob->x != NULL ? prob->x[sample(p, position)] : NULL;
+            if (index != NULL) {
+                index[k]=sampleColumn(samples, sample(p, position));
+            }
+            subprob.y[k]=position<ci ? +1 : -1;
+            if (position<ci) {
+                p_count++;
+            }
+            else{
+                n_count++;
+            }
+            k++;
+        }
+        
+        int err=0;
+        if (p_count == 0 || n_count == 0) { // only one class left, no need to train
+            double value=p_count>0 ? 1 : (n_count>0 ? -1 : 0);
+            for (int j=begin; j<end; j++) {
+                decValues[p][perm[p][j]]=value;
+            }
+        }
+        else if (samples != NULL) { // class i is +1, no need to flip
+            struct SVMKernelSamples train={samples->x, samples->dense, index, subprob.l};
+            struct SVMKernelSamples leftOut={samples->x, samples->dense, index+subprob.l, end-begin};
+            double *coef=Malloc(double, subprob.l);
+            double *values=Malloc(double, end-begin>0 ? end-begin : 1);
+            double rho=0;
+            err=coef == NULL || values == NULL || solveDual(&train, subprob.y, &param, weighted_C[pairI[p]], weighted_C[pairJ[p]], rowThreads, coef, &rho) || kernelDecisionValues(&train, coef, rho, &param, &leftOut, rowThreads, values) ? -1 : 0;
+            for (int j=begin; j<end && !err; j++) {
+                decValues[p][perm[p][j]]=values[j-begin];
+            }
+            free(coef);
+            free(values);
+        }
+        else{
+            int weight_label[2]={+1, -1};
+            double weight[2]={weighted_C[pairI[p]], weighted_C[pairJ[p]]};
+            struct svm_parameter subparam=param;
+            subparam.probability=0;
+            subparam.C=1.0;
+            subparam.nr_weight=2;
+            subparam.weight_label=weight_label;
+            subparam.weight=weight;
+            struct svm_model *submodel=svm_train(&subprob, &subparam);
+            for (int j=begin; j<end; j++) {
+                double *value=&decValues[p][perm[p][j]];
+                svm_predict_values(submodel, prob->x[sample(p, perm[p][j])], value);
+                *value*=submodel->label[0]; // ensure +1 -1 order
+            }
+            svm_free_and_destroy_model(&submodel);
+        }
+        free(subprob.x);
+        free(subprob.y);
+        free(index);
+        return err;
+    }
+    
+    // the sample of prob at position of the binary problem of pair p
+    int sample(int p, int position){
+        int ci=groups->count[pairI[p]];
+        if (position<ci) {
+            return groups->perm[groups->start[pairI[p]]+position];
+        }
+        return groups->perm[groups->start[pairJ[p]]+position-ci];
+    }
+};
+
+// fits the sigmoid of one pair of classes per task, shared by all workers of SVMParallelFor()
+struct PairSigmoids {
+    double **decValues; // per pair, the decision values of the samples of class i followed by those of class j
+    const int *count; // per pair, number of samples
+    const int *positives; // per pair, number of samples of class i (+1)
+    double *probA;
+    double *probB;
+    std::atomic<int> failed;
+    
+    void operator()(size_t begin, size_t end, int){
+        for (size_t p=begin; p<end; p++) {
+            double *labels=Malloc(double, count[p]>0 ? count[p] : 1);
+            if (labels == NULL) {
+                failed=1;
+                continue;
+            }
+            for (int k=0; k<count[p]; k++) {
+                labels[k]=k<positives[p] ? +1 : -1;
+            }
+            if (sigmoidTrain(count[p], decValues[p], labels, &probA[p], &probB[p])) {
+                failed=1;
+            }
+            free(labels);
+        }
+    }
+};
+
+// decision values of the samples of a problem, shared by all workers of SVMParallelFor()
+struct DecisionValueRows {
+    const struct svm_model *model;
+    const struct svm_problem *prob;
+    int numDecisionValues;
+    double *decValues; // prob->l x numDecisionValues, row-major
+    
+    void operator()(size_t begin, size_t end, int){
+        for (size_t i=begin; i<end; i++) {
+            svm_predict_values(model, prob->x[i], decValues+i*numDecisionValues);
+        }
+    }
+};
+
+/*
+ helper function, replaces the probability information of model (probA, probB) and marks it as probability model
+ */
+
+static void setProbabilityModel(struct svm_model *model, double *probA, double *probB){
+    free(model->probA);
+    free(model->probB);
+    model->probA=probA;
+    model->probB=probB;
+    model->param.probability=1;
+}
+
+/*
+ helper function, nr_fold cross validation of a regression problem with solveDual() on the samples of prob, as parallelCrossValidation() with the same folds: target receives the prediction for each sample. The folds are trained one after the other, the kernel rows on numThreads threads and cached in param->cache_size MB.
+ Returns -1 if memory runs out.
+ */
+
+static int solverRegressionFolds(const struct svm_problem *prob, const struct SVMKernelSamples *samples, const struct svm_parameter *param, int nr_fold, unsigned int seed, int numThreads, double *target){
+    int l=prob->l;
+    if (nr_fold>l) {
+        nr_fold=l;
+    }
+    if (nr_fold<1) {
+        return -1;
+    }
+    int *perm=Malloc(int, l);
+    int *fold_start=Malloc(int, nr_fold+1);
+    int *index=Malloc(int, l); // the columns of the training samples, then of the left out ones
+    double *y=Malloc(double, l);
+    double *coef=Malloc(double, l);
+    int failed=perm == NULL || fold_start == NULL || index == NULL || y == NULL || coef == NULL || crossValidationFolds(prob, param, nr_fold, seed, perm, fold_start);
+    
+    for (int fold=0; fold<nr_fold && !failed; fold++) {
+        int foldBegin=fold_start[fold];
+        int foldEnd=fold_start[fold+1];
+        int n=l-(foldEnd-foldBegin);
+        int k=0;
+        for (int j=0; j<l; j++) {
+            if (j >= foldBegin && j<foldEnd) {
+                index[n+j-foldBegin]=sampleColumn(samples, perm[j]);
+            }
+            else{
+                index[k]=sampleColumn(samples, perm[j]);
+                y[k++]=prob->y[perm[j]];
+            }
+        }
+        struct SVMKernelSamples train={samples->x, samples->dense, index, n};
+        struct SVMKernelSamples leftOut={samples->x, samples->dense, index+n, foldEnd-foldBegin};
+        double rho=0;
+        failed=solveDual(&train, y, param, param->C, param->C, numThreads, coef, &rho) || kernelDecisionValues(&train, coef, rho, param, &leftOut, numThreads, y);
+        for (int j=foldBegin; j<foldEnd && !failed; j++) { // the decision value is the prediction
+            target[perm[j]]=y[j-foldBegin];
+        }
+    }
+    
+    free(perm);
+    free(fold_start);
+    free(index);
+    free(y);
+    free(coef);
+    return failed ? -1 : 0;
+}
+
+/*
+ helper function, the probability information of a model trained on prob, computed as svm_train() does it with an internal 5-fold cross validation per pair of classes (svm_binary_svc_probability()) or for regression (svm_svr_probability()).
+ The folds are drawn from seed instead of rand(), and all pairs and folds are trained concurrently on up to numThreads workers, so the result only depends on seed. Returns -1 if memory runs out.
+ With samples set the folds are solved with solveDual() on them instead, one after the other with the kernel rows computed on numThreads threads and cached in cacheBudget MB, prob->x may be NULL.
+ */
+
+static int addProbabilityModel(const struct svm_problem *prob, const struct SVMKernelSamples *samples, const struct svm_parameter *param, unsigned int seed, int numThreads, double cacheBudget, struct svm_model *model){
+    struct svm_parameter cvParam=*param;
+    cvParam.probability=0;
+    
+    if (param->svm_type == EPSILON_SVR || param->svm_type == NU_SVR) {
+        double *probA=Malloc(double, 1);
+        double *residuals=Malloc(double, prob->l);
+        cvParam.cache_size=cacheBudget;
+        if (probA == NULL || residuals == NULL || (samples != NULL ? solverRegressionFolds(prob, samples, &cvParam, SVM_PROBABILITY_FOLDS, seed, numThreads, residuals) : parallelCrossValidation(prob, &cvParam, 0, SVM_PROBABILITY_FOLDS, seed, numThreads, cacheBudget, residuals))) {
+            free(probA);
+            free(residuals);
+            return -1;
+        }
+        for (int i=0; i<prob->l; i++) {
+            residuals[i]=prob->y[i]-residuals[i];
+        }
+        probA[0]=laplaceScale(prob->l, residuals);
+        free(residuals);
+        setProbabilityModel(model, probA, NULL);
+        return 0;
+    }
+    
+    struct SVMClassGroups groups;
+    if (groupClasses(prob, &groups)) {
+        return -1;
+    }
+    int nr_class=groups.nr_class;
+    int numPairs=nr_class*(nr_class-1)/2;
+    
+    double *weighted_C=Malloc(double, nr_class);
+    int *pairI=Malloc(int, numPairs>0 ? numPairs : 1);
+    int *pairJ=Malloc(int, numPairs>0 ? numPairs : 1);
+    int **perm=(int **)calloc(numPairs>0 ? numPairs : 1, sizeof(int *));
+    double **decValues=(double **)calloc(numPairs>0 ? numPairs : 1, sizeof(double *));
+    double *probA=Malloc(double, numPairs>0 ? numPairs : 1);
+    double *probB=Malloc(double, numPairs>0 ? numPairs : 1);
+    int *count=Malloc(int, numPairs>0 ? numPairs : 1);
+    int *positives=Malloc(int, numPairs>0 ? numPairs : 1);
+    int failed=weighted_C == NULL || pairI == NULL || pairJ == NULL || perm == NULL || decValues == NULL || probA == NULL || probB == NULL || count == NULL || positives == NULL;
+    
+    if (!failed) {
+        weightedC(param, &groups, weighted_C);
+        int p=0;
+        for (int i=0; i<nr_class; i++) {
+            for (int j=i+1; j<nr_class; j++) {
+                pairI[p]=i;
+                pairJ[p]=j;
+                int n=groups.count[i]+groups.count[j];
+                count[p]=n;
+                positives[p]=groups.count[i];
+                perm[p]=Malloc(int, n);
+                decValues[p]=Malloc(double, n);
+                if (perm[p] == NULL || decValues[p] == NULL) {
+                    failed=1;
+                }
+                else{
+                    uint64_t state=randomState(seed+(unsigned int)p); // each pair is shuffled on its own, as in svm_binary_svc_probability()
+                    for (int k=0; k<n; k++) {
+                        perm[p][k]=k;
+                    }
+                    for (int k=0; k<n; k++) {
+                        int j=k+(int)(nextRandom(&state)%(uint32_t)(n-k));
+                        int tmp=perm[p][k];
+                        perm[p][k]=perm[p][j];
+                        perm[p][j]=tmp;
+                    }
+                }
+                p++;
+            }
+        }
+    }
+    
+    if (!failed) {
+        PlattFolds folds;
+        folds.param=cvParam;
+        folds.samples=samples;
+        folds.rowThreads=SVMNumberOfThreads(numThreads, SVM_MAX_THREADS);
+        numThreads=samples != NULL ? 1 : SVMNumberOfThreads(numThreads, (size_t)numPairs*SVM_PROBABILITY_FOLDS); // with samples the threads work on the kernel rows
+        folds.param.cache_size=workerCacheSize(cacheBudget, numThreads);
+        folds.prob=prob;
+        folds.groups=&groups;
+        folds.weighted_C=weighted_C;
+        folds.pairI=pairI;
+        folds.pairJ=pairJ;
+        folds.perm=perm;
+        folds.decValues=decValues;
+        folds.failed=0;
+        SVMParallelFor((size_t)numPairs*SVM_PROBABILITY_FOLDS, 1, numThreads, folds); // each fold writes only the decision values of its own samples
+        failed=folds.failed;
+    }
+    
+    if (!failed) {
+        PairSigmoids sigmoids;
+        sigmoids.decValues=decValues;
+        sigmoids.count=count;
+        sigmoids.positives=positives;
+        sigmoids.probA=probA;
+        sigmoids.probB=probB;
+        sigmoids.failed=0;
+        SVMParallelFor((size_t)numPairs, 1, SVMNumberOfThreads(numThreads, (size_t)numPairs), sigmoids);
+        failed=sigmoids.failed;
+    }
+    
+    if (!failed) {
+        setProbabilityModel(model, probA, probB);
+    }
+    else{
+        free(probA);
+        free(probB);
+    }
+    
+    for (int p=0; p<numPairs; p++) {
+        if (perm != NULL) {
+            free(perm[p]);
+        }
+        if (decValues != NULL) {
+            free(decValues[p]);
+        }
+    }
+    free(perm);
+    free(decValues);
+    free(weighted_C);
+    free(pairI);
+    free(pairJ);
+    free(count);
+    free(positives);
+    freeClassGroups(&groups);
+    return failed ? -1 : 0;
+}
+
+/*
+ svm_train() with the one-vs-one problems of multi-class C_SVC and NU_SVC models trained on up to numThreads workers, see oneVsOneTrain(). cacheBudget (MB) is split between the workers.
+ For probability models the decision functions are trained first, then the internal cross validation that fits the probability model is run with folds drawn from seed, all pairs and folds concurrently (see addProbabilityModel()). Returns NULL if memory runs out.
+ */
+
+struct svm_model *parallelTrain(const struct svm_problem *prob, const struct svm_parameter *param, unsigned int seed, int numThreads, double cacheBudget){
+    if (!param->probability || (param->svm_type != C_SVC && param->svm_type != NU_SVC && param->svm_type != EPSILON_SVR && param->svm_type != NU_SVR)) {
+        return oneVsOneTrain(prob, param, numThreads, cacheBudget, 0, 0, NULL);
+    }
+    
+    struct svm_parameter decisionParam=*param;
+    decisionParam.probability=0; // the decision functions don't depend on the probability model
+    struct svm_model *model=oneVsOneTrain(prob, &decisionParam, numThreads, cacheBudget, 0, 0, NULL);
+    if (model != NULL && addProbabilityModel(prob, NULL, param, seed, numThreads, cacheBudget, model)) {
+        svm_free_and_destroy_model(&model);
+        model=NULL;
+    }
+    return model;
+}
+
+/*
+ helper function, the model of a single decision function (ONE_CLASS and regression) with one coefficient per sample of prob, put together as svm_train() does: the samples with nonzero coefficient are the support vectors. coef and rho are copied. Returns NULL if memory runs out.
+ */
+
+static struct svm_model *singleFunctionModel(const struct svm_problem *prob, const struct svm_parameter *param, const double *coef, double rho){
+    int l=prob->l;
+    struct svm_model *model=(struct svm_model *)calloc(1, sizeof(struct svm_model));
+    int failed=model == NULL;
+    
+    if (!failed) {
+        model->param=*param;
+        model->free_sv=0;
+        model->nr_class=2;
+        model->label=NULL;
+        model->nSV=NULL;
+        model->probA=NULL;
+        model->probB=NULL;
+        int nSV=0;
+        for (int i=0; i<l; i++) {
+            if (fabs(coef[i])>0) {
+                ++nSV;
+            }
+        }
+        model->l=nSV;
+        model->rho=Malloc(double, 1);
+        model->SV=Malloc(struct svm_node *, nSV>0 ? nSV : 1);
+        model->sv_indices=Malloc(int, nSV>0 ? nSV : 1);
+        model->sv_coef=(double **)calloc(1, sizeof(double *));
+        failed=model->rho == NULL || model->SV == NULL || model->sv_indices == NULL || model->sv_coef == NULL;
+        if (!failed) {
+            model->sv_coef[0]=Malloc(double, nSV>0 ? nSV : 1);
+            failed=model->sv_coef[0] == NULL;
+        }
+    }
+    if (!failed) {
+        model->rho[0]=rho;
+        int j=0;
+        for (int i=0; i<l; i++) {
+            if (fabs(coef[i])>0) {
+                model->SV[j]=prob->x != NULL ? prob->x[i] : NULL;
+                model->sv_coef[0][j]=coef[i];
+                model->sv_indices[j]=i+1;
+                ++j;
+            }
+        }
+    }
+    
+    if (failed && model != NULL) {
+        svm_free_and_destroy_model(&model); // free_sv is 0, the support vectors belong to prob
+        model=NULL;
+    }
+    return model;
+}
+
+/*
+ helper function, EPSILON_SVR with linearRegressionDual(), the model is put together as svm_train() does for regression (see singleFunctionModel()). Returns NULL if memory runs out.
+ */
+
+static struct svm_model *linearRegressionTrain(const struct svm_problem *prob, const struct svm_parameter *param, int loss){
+    int l=prob->l;
+    double *beta=Malloc(double, l>0 ? l : 1);
+    double bias=0;
+    struct svm_model *model=NULL;
+    if (beta != NULL && linearRegressionDual(prob->x, prob->y, l, param->C, param->p, loss, param->eps, beta, &bias) == 0) {
+        model=singleFunctionModel(prob, param, beta, -bias);
+    }
+    free(beta);
+    return model;
+}
+
+/*
+ trains a LINEAR C_SVC or EPSILON_SVR model with the dual coordinate descent solvers of SVMLinear.cpp instead of svm_train(), with the L1 or L2 loss (SVM_LINEAR_L1LOSS, SVM_LINEAR_L2LOSS) and param->eps as stopping tolerance. Classes are split one-vs-one as libSVM does, the pairs are trained on up to numThreads workers.
+ The result is an ordinary LINEAR libSVM model (support vectors point into prob), it is used and saved like any other. param->probability is ignored. Returns NULL if memory runs out.
+ */
+
+struct svm_model *linearTrain(const struct svm_problem *prob, const struct svm_parameter *param, int loss, int numThreads){
+    struct svm_parameter linearParam=*param;
+    linearParam.probability=0;
+    if (param->svm_type == EPSILON_SVR) {
+        return linearRegressionTrain(prob, &linearParam, loss);
+    }
+    return oneVsOneTrain(prob, &linearParam, numThreads, param->cache_size, loss, 0, NULL);
+}
+
+/*
+ svm_train() with every problem solved by solveDual() (SVMSolver.cpp) instead of libSVM's solver: each kernel row is computed on numThreads threads (<1: one per core) and the rows are cached in cacheBudget MB, no kernel matrix is built. The pairs of multi-class models are solved one after the other and the model is put together as in svm_train().
+ Probability models are fitted afterwards as in parallelTrain(), with folds drawn from seed. The support vectors point into prob. Not for PRECOMPUTED kernels. Returns NULL if memory runs out.
+ samples replaces the nodes of prob if set, sample i of prob is sample i of samples and prob->x may be NULL: the probability folds are solved with solveDual() as well, and the support vectors of the model are NULL, sv_indices tells the caller which samples they are.
+ */
+
+struct svm_model *solverTrain(const struct svm_problem *prob, const struct SVMKernelSamples *samples, const struct svm_parameter *param, unsigned int seed, int numThreads, double cacheBudget){
+    int rowThreads=SVMNumberOfThreads(numThreads, SVM_MAX_THREADS);
+    int probability=param->probability && param->svm_type != ONE_CLASS;
+    struct svm_parameter decisionParam=*param;
+    decisionParam.cache_size=cacheBudget;
+    if (probability) {
+        decisionParam.probability=0; // the decision functions don't depend on the probability model
+    }
+    
+    struct SVMKernelSamples nodes={prob->x, NULL, NULL, prob->l}; // the probability folds are solved on the nodes unless samples replaces them
+    struct svm_model *model=NULL;
+    if (param->svm_type == C_SVC || param->svm_type == NU_SVC) {
+        model=oneVsOneTrain(prob, &decisionParam, 1, cacheBudget, 0, rowThreads, samples);
+    }
+    else{
+        double *coef=Malloc(double, prob->l>0 ? prob->l : 1);
+        double rho=0;
+        if (coef != NULL && solveDual(samples != NULL ? samples : &nodes, prob->y, &decisionParam, param->C, param->C, rowThreads, coef, &rho) == 0) {
+            model=singleFunctionModel(prob, &decisionParam, coef, rho);
+        }
+        free(coef);
+    }
+    
+    if (model != NULL && probability && addProbabilityModel(prob, samples != NULL ? samples : &nodes, param, seed, numThreads, cacheBudget, model)) {
+        svm_free_and_destroy_model(&model);
+        model=NULL;
+    }
+    return model;
+}
+
+/*
+ fits the probability model of model to the held out samples heldOut instead of an internal cross validation: one sigmoid per pair of classes from the decision values of the samples of the two classes, or the Laplace scale of the residuals for regression.
+ Samples with labels that are no class of the model are ignored. The decision values are computed on up to numThreads workers. Returns 1 if there is nothing to fit: no held out sample of a class of the model (none at all for regression), or a model without classes (ONE_CLASS). Returns -1 if memory runs out.
+ */
+
+int heldOutProbabilityModel(struct svm_model *model, const struct svm_problem *heldOut, int numThreads){
+    int l=heldOut->l;
+    int regression=model->param.svm_type == EPSILON_SVR || model->param.svm_type == NU_SVR;
+    int nr_class=model->nr_class;
+    int numPairs=regression ? 1 : nr_class*(nr_class-1)/2;
+    if (l<1 || (!regression && model->label == NULL)) {
+        return 1;
+    }
+    
+    DecisionValueRows rows;
+    rows.model=model;
+    rows.prob=heldOut;
+    rows.numDecisionValues=numPairs>0 ? numPairs : 1;
+    rows.decValues=Malloc(double, (size_t)(l>0 ? l : 1)*rows.numDecisionValues);
+    if (rows.decValues == NULL) {
+        return -1;
+    }
+    SVMParallelFor((size_t)l, 64, SVMNumberOfThreads(numThreads, (size_t)l), rows);
+    
+    if (regression) {
+        double *probA=Malloc(double, 1);
+        if (probA == NULL) {
+            free(rows.decValues);
+            return -1;
+        }
+        for (int i=0; i<l; i++) {
+            rows.decValues[i]=heldOut->y[i]-rows.decValues[i]; // the decision value is the prediction
+        }
+        probA[0]=laplaceScale(l, rows.decValues);
+        setProbabilityModel(model, probA, NULL);
+        free(rows.decValues);
+        return 0;
+    }
+    
+    int *classIndex=Malloc(int, l>0 ? l : 1);
+    double **decValues=(double **)calloc(numPairs>0 ? numPairs : 1, sizeof(double *));
+    int *count=(int *)calloc(numPairs>0 ? numPairs : 1, sizeof(int));
+    int *positives=(int *)calloc(numPairs>0 ? numPairs : 1, sizeof(int));
+    double *probA=Malloc(double, numPairs>0 ? numPairs : 1);
+    double *probB=Malloc(double, numPairs>0 ? numPairs : 1);
+    int failed=classIndex == NULL || decValues == NULL || count == NULL || positives == NULL || probA == NULL || probB == NULL;
+    int empty=1; // no held out sample of a class of the model
+    
+    if (!failed) {
+        for (int i=0; i<l; i++) {
+            classIndex[i]=-1;
+            for (int c=0; c<nr_class; c++) {
+                if ((int)heldOut->y[i] == model->label[c]) {
+                    classIndex[i]=c;
+                    empty=0;
+                    break;
+                }
+            }
+        }
+        
+        int p=0;
+        for (int i=0; i<nr_class && !failed; i++) {
+            for (int j=i+1; j<nr_class && !failed; j++) { // the decision values of pair p, samples of class i (+1) first
+                for (int k=0; k<l; k++) {
+                    if (classIndex[k] == i) {
+                        positives[p]++;
+                    }
+                    else if (classIndex[k] == j) {
+                        count[p]++;
+                    }
+                }
+                count[p]+=positives[p];
+                decValues[p]=Malloc(double, count[p]>0 ? count[p] : 1);
+                if (decValues[p] == NULL) {
+                    failed=1;
+                    break;
+                }
+                int first=0;
+                int second=positives[p];
+                for (int k=0; k<l; k++) {
+                    if (classIndex[k] == i) {
+                        decValues[p][first++]=rows.decValues[(size_t)k*numPairs+p];
+                    }
+                    else if (classIndex[k] == j) {
+                        decValues[p][second++]=rows.decValues[(size_t)k*numPairs+p];
+                    }
+                }
+                p++;
+            }
+        }
+    }
+    
+    if (!failed && !empty) {
+        PairSigmoids sigmoids;
+        sigmoids.decValues=decValues;
+        sigmoids.count=count;
+        sigmoids.positives=positives;
+        sigmoids.probA=probA;
+        sigmoids.probB=probB;
+        sigmoids.failed=0;
+        SVMParallelFor((size_t)numPairs, 1, SVMNumberOfThreads(numThreads, (size_t)numPairs), sigmoids);
+        failed=sigmoids.failed;
+    }
+    
+    if (!failed && !empty) {
+        setProbabilityModel(model, probA, probB);
+    }
+    else{
+        free(probA);
+        free(probB);
+    }
+    if (decValues != NULL) {
+        for (int p=0; p<numPairs; p++) {
+            free(decValues[p]);
+        }
+    }
+    free(decValues);
+    free(count);
+    free(positives);
+    free(classIndex);
+    free(rows.decValues);
+    if (failed) {
+        return -1;
+    }
+    return empty ? 1 : 0;
+}
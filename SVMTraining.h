@@ -0,0 +1,45 @@
+/*
+	SVMTraining.h -- parallel training helpers for SVM XOP that drive libSVM's svm_train()
+*/
+
+#ifndef SVM_TRAINING_H
+#define SVM_TRAINING_H
+
+#include <stdint.h>
+#include "libSVM/svm.h"
+#include "SVMSolver.h"
+
+// the samples of a problem grouped by class, same as svm_group_classes() in svm.cpp
+struct SVMClassGroups {
+    int nr_class;
+    int *label; // label of each class, in order of first appearance (-1/+1 swapped for two classes, as libSVM does)
+    int *start; // first entry of each class in perm
+    int *count; // number of samples of each class
+    int *perm; // sample indices, grouped by class
+};
+
+// one point of a parameter grid
+struct SVMGridPoint {
+    double C;
+    double gamma;
+    double nu;
+    int valid; // 0 if svm_check_parameter() rejects the point, it is skipped
+};
+
+uint32_t nextRandom(uint64_t *state);
+uint64_t randomState(unsigned int seed);
+int groupClasses(const struct svm_problem *prob, struct SVMClassGroups *groups);
+void freeClassGroups(struct SVMClassGroups *groups);
+int subsetProblem(const struct svm_problem *prob, const int *set, int n, struct svm_problem *sub);
+int crossValidationFolds(const struct svm_problem *prob, const struct svm_parameter *param, int nr_fold, unsigned int seed, int *perm, int *fold_start);
+int crossValidationFold(const struct svm_problem *prob, const struct svm_parameter *param, int linearLoss, int rowThreads, unsigned int seed, const int *perm, const int *fold_start, int fold, double *target);
+int parallelCrossValidation(const struct svm_problem *prob, const struct svm_parameter *param, int linearLoss, int nr_fold, unsigned int seed, int numThreads, double cacheBudget, double *target);
+int solverCrossValidation(const struct svm_problem *prob, const struct svm_parameter *param, int nr_fold, unsigned int seed, int numThreads, double cacheBudget, double *target);
+struct svm_model *parallelTrain(const struct svm_problem *prob, const struct svm_parameter *param, unsigned int seed, int numThreads, double cacheBudget);
+struct svm_model *solverTrain(const struct svm_problem *prob, const struct SVMKernelSamples *samples, const struct svm_parameter *param, unsigned int seed, int numThreads, double cacheBudget);
+struct svm_model *linearTrain(const struct svm_problem *prob, const struct svm_parameter *param, int loss, int numThreads);
+int heldOutProbabilityModel(struct svm_model *model, const struct svm_problem *heldOut, int numThreads);
+int parallelGridSearch(const struct svm_problem *prob, const struct svm_parameter *param, const struct SVMGridPoint *points, int numPoints, int nr_fold, unsigned int seed, int numThreads, double cacheBudget, double *scores);
+int solverGridSearch(const struct svm_problem *prob, const struct svm_parameter *param, const struct SVMGridPoint *points, int numPoints, int nr_fold, unsigned int seed, int numThreads, double cacheBudget, double *scores);
+
+#endif
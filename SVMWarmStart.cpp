@@ -0,0 +1,315 @@
+/*	SVMWarmStart.cpp -- warm started training for SVM XOP
+
+	svm_train() always starts the solver from all-zero coefficients and has no way to be given a starting point. When
+	a model is retrained on a few more samples, or with a larger C, most samples that were no support vectors before
+	stay none. warmStartTrain() trains on the samples that were support vectors of the earlier model first, then checks
+	the optimality conditions (KKT) of all other samples against that model: with a coefficient of 0, a sample of a
+	C_SVC model needs y*f(x) >= 1 for each decision function it belongs to, a sample of an EPSILON_SVR model
+	|y-f(x)| <= p, both within the tolerance eps of the solver. The samples that violate them are added and the
+	model is trained again, until there are none. A solution on a part of the samples that all other samples agree
+	with is a solution of the complete problem, so the model is the one of a cold start within the tolerance, it
+	just needs far fewer kernel evaluations.
+	dualObjective() gives the value of the dual problem of a model, to compare a warm started model with a cold one.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <map>
+#include "SVMWarmStart.h"
+#include "SVMKernel.h"
+#include "SVMTraining.h"
+#include "SVMThreads.h"
+
+#define Malloc(type,n) (type *)malloc((n)*sizeof(type)) //from libSVM
+
+enum {
+    SVM_WARM_MAX_ROUNDS=20 // rounds of adding violating samples, the complete problem is trained after that
+};
+
+/*
+ helper function, FNV-1a hash of the nodes of a sample
+ */
+
+static uint64_t nodeHash(const struct svm_node *x){
+    uint64_t hash=14695981039346656037ULL;
+    for (; x->index != -1; x++) {
+        uint64_t bits;
+        memcpy(&bits, &x->value, sizeof(bits));
+        hash=(hash^(uint64_t)(uint32_t)x->index)*1099511628211ULL;
+        hash=(hash^bits)*1099511628211ULL;
+    }
+    return hash;
+}
+
+/*
+ helper function, 1 if the samples a and b have the same nodes
+ */
+
+static int sameNodes(const struct svm_node *a, const struct svm_node *b){
+    while (a->index != -1 && a->index == b->index && a->value == b->value) {
+        a++;
+        b++;
+    }
+    return a->index == -1 && b->index == -1;
+}
+
+/*
+ helper function, marks the samples of prob that are support vectors of previous in inSet and returns their number. Samples are matched by their nodes, PRECOMPUTED samples by their serial number (the samples of the earlier training keep their rows).
+ Returns -1 if memory runs out.
+ */
+
+static int seedSamples(const struct svm_problem *prob, const struct svm_model *previous, char *inSet){
+    int l=prob->l;
+    int numSeeds=0;
+
+    if (previous->param.kernel_type == PRECOMPUTED) {
+        for (int i=0; i<previous->l; i++) {
+            int serial=(int)previous->SV[i][0].value;
+            if (serial >= 1 && serial <= l && !inSet[serial-1]) {
+                inSet[serial-1]=1;
+                numSeeds++;
+            }
+        }
+        return numSeeds;
+    }
+
+    try {
+        std::map<uint64_t, int> rows; // first sample of each hash
+        for (int i=0; i<l; i++) {
+            rows.insert(std::make_pair(nodeHash(prob->x[i]), i));
+        }
+        for (int i=0; i<previous->l; i++) {
+            std::map<uint64_t, int>::iterator it=rows.find(nodeHash(previous->SV[i]));
+            if (it != rows.end() && sameNodes(prob->x[it->second], previous->SV[i]) && !inSet[it->second]) {
+                inSet[it->second]=1;
+                numSeeds++;
+            }
+        }
+    } catch (...) { // out of memory
+        return -1;
+    }
+    return numSeeds;
+}
+
+/*
+ helper function, index of the class with label y in model, -1 if the model doesn't know it
+ */
+
+static int classIndex(const struct svm_model *model, double y){
+    for (int i=0; i<model->nr_class; i++) {
+        if (model->label[i] == (int)y) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// checks the optimality conditions of the samples that were not trained, shared by all workers of SVMParallelFor()
+struct KKTViolations {
+    const struct svm_model *model;
+    const struct svm_problem *prob;
+    const char *inSet;
+    char *violates; // receives 1 for each sample that would change the solution
+    int numPairs;
+    double *decValues; // numPairs per worker
+    double tolerance;
+
+    void operator()(size_t begin, size_t end, int thread){
+        double *dec=decValues+(size_t)thread*numPairs;
+        for (size_t i=begin; i<end; i++) {
+            violates[i]=0;
+            if (inSet[i]) {
+                continue;
+            }
+            double y=prob->y[i];
+            svm_predict_values(model, prob->x[i], dec);
+            if (model->param.svm_type == EPSILON_SVR) {
+                violates[i]=fabs(y-dec[0])>model->param.p+tolerance;
+                continue;
+            }
+
+            int c=classIndex(model, y);
+            if (c<0) { // a class the model hasn't seen yet
+                violates[i]=1;
+                continue;
+            }
+            int p=0;
+            for (int a=0; a<model->nr_class && !violates[i]; a++) {
+                for (int b=a+1; b<model->nr_class; b++, p++) { // same order of the pairs as in svm_predict_values()
+                    if ((c == a && dec[p]<1-tolerance) || (c == b && dec[p]>tolerance-1)) {
+                        violates[i]=1;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+};
+
+/*
+ trains prob warm started from the support vectors of previous, a model trained on a part of the samples or with other parameters (e.g. a smaller C). Training starts with the samples of prob that are support vectors of previous and adds the samples that violate the optimality conditions of the model, until there are none (see above). *rounds receives the number of trainings.
+ Each round is trained with gramTrain() on numThreads threads, gramBudget MB for the kernel rows (0 for none), cacheBudget (MB) split between the workers. The support vectors point into prob and sv_indices refer to prob, as for svm_train().
+ Only for C_SVC and EPSILON_SVR, the problems of the other types change with the number of samples. Train with probability=0 and use heldOutProbabilityModel(). If no sample of prob is a support vector of previous this is just gramTrain(). Returns NULL if memory runs out.
+ */
+
+struct svm_model *warmStartTrain(const struct svm_problem *prob, const struct svm_parameter *param, const struct svm_model *previous, unsigned int seed, int numThreads, double cacheBudget, double gramBudget, int *rounds){
+    int l=prob->l;
+    *rounds=1;
+    char *inSet=(char *)calloc(l>0 ? l : 1, 1);
+    char *violates=Malloc(char, l>0 ? l : 1);
+    int *set=Malloc(int, l>0 ? l : 1);
+    int workers=SVMNumberOfThreads(numThreads, (size_t)l);
+    int numSeeds=-1;
+    if (inSet == NULL || violates == NULL || set == NULL || (numSeeds=seedSamples(prob, previous, inSet))<0) {
+        free(inSet);
+        free(violates);
+        free(set);
+        return NULL;
+    }
+    if (numSeeds == 0) {
+        free(inSet);
+        free(violates);
+        free(set);
+        return gramTrain(prob, param, seed, numThreads, cacheBudget, gramBudget);
+    }
+
+    struct svm_model *model=NULL;
+    for (int round=0; ; round++) {
+        int n=0;
+        for (int i=0; i<l; i++) {
+            if (inSet[i]) {
+                set[n++]=i;
+            }
+        }
+        struct svm_problem sub;
+        if (subsetProblem(prob, set, n, &sub)) {
+            break;
+        }
+        model=gramTrain(&sub, param, seed, numThreads, cacheBudget, gramBudget); // the support vectors point into prob, sub only holds pointers
+        free(sub.y);
+        free(sub.x);
+        if (model == NULL) {
+            break;
+        }
+        for (int i=0; i<model->l; i++) { // refer to prob instead of the set
+            model->sv_indices[i]=set[model->sv_indices[i]-1]+1;
+        }
+        *rounds=round+1;
+        if (n == l) {
+            break;
+        }
+
+        KKTViolations check;
+        check.model=model;
+        check.prob=prob;
+        check.inSet=inSet;
+        check.violates=violates;
+        check.numPairs=model->nr_class>1 ? model->nr_class*(model->nr_class-1)/2 : 1;
+        check.decValues=Malloc(double, (size_t)workers*check.numPairs);
+        check.tolerance=param->eps;
+        if (check.decValues == NULL) {
+            svm_free_and_destroy_model(&model);
+            break;
+        }
+        SVMParallelFor((size_t)l, 256, workers, check);
+        free(check.decValues);
+
+        int numViolations=0;
+        for (int i=0; i<l; i++) {
+            if (violates[i]) {
+                inSet[i]=1;
+                numViolations++;
+            }
+        }
+        if (numViolations == 0) {
+            break;
+        }
+        if (round+1 >= SVM_WARM_MAX_ROUNDS) { // doesn't settle, train all of it
+            memset(inSet, 1, l);
+        }
+        svm_free_and_destroy_model(&model);
+    }
+
+    free(inSet);
+    free(violates);
+    free(set);
+    return model;
+}
+
+// decision values of the support vectors of a model, shared by all workers of SVMParallelFor()
+struct SupportVectorDecisions {
+    const struct svm_model *model;
+    const struct svm_problem *prob;
+    int numPairs;
+    double *decValues; // model->l x numPairs, row-major
+
+    void operator()(size_t begin, size_t end, int){
+        for (size_t i=begin; i<end; i++) {
+            svm_predict_values(model, prob->x[model->sv_indices[i]-1], decValues+i*numPairs); // the samples, PRECOMPUTED support vectors may only have their serial number
+        }
+    }
+};
+
+/*
+ the value of the dual problem the solver minimizes for model, summed over the decision functions: 0.5*a'Qa-sum(a) for C_SVC, 0.5*b'Kb+p*sum(|b|)-y'b for EPSILON_SVR. The kernel sums come from the decision values of the support vectors (computed on numThreads threads), prob has to be the training problem of the model (sv_indices).
+ NAN for other types, or if memory runs out.
+ */
+
+double dualObjective(const struct svm_model *model, const struct svm_problem *prob, int numThreads){
+    int regression=model->param.svm_type == EPSILON_SVR;
+    if (!regression && model->param.svm_type != C_SVC) {
+        return NAN;
+    }
+    int l=model->l;
+    int nr_class=model->nr_class;
+
+    SupportVectorDecisions rows;
+    rows.model=model;
+    rows.prob=prob;
+    rows.numPairs=regression || nr_class<2 ? 1 : nr_class*(nr_class-1)/2;
+    rows.decValues=Malloc(double, (size_t)(l>0 ? l : 1)*rows.numPairs);
+    if (rows.decValues == NULL) {
+        return NAN;
+    }
+    SVMParallelFor((size_t)l, 64, SVMNumberOfThreads(numThreads, (size_t)l), rows);
+
+    double objective=0;
+    if (regression) {
+        for (int i=0; i<l; i++) {
+            double b=model->sv_coef[0][i];
+            double Kb=rows.decValues[i]+model->rho[0]; // f(x)=sum(b*K)-rho
+            objective+=0.5*b*Kb+model->param.p*fabs(b)-prob->y[model->sv_indices[i]-1]*b;
+        }
+        free(rows.decValues);
+        return objective;
+    }
+
+    int *start=Malloc(int, nr_class>0 ? nr_class : 1);
+    if (start == NULL) {
+        free(rows.decValues);
+        return NAN;
+    }
+    if (nr_class>0) {
+        start[0]=0;
+    }
+    for (int i=1; i<nr_class; i++) {
+        start[i]=start[i-1]+model->nSV[i-1];
+    }
+    int p=0;
+    for (int a=0; a<nr_class; a++) {
+        for (int b=a+1; b<nr_class; b++, p++) { // the support vectors of class a have their coefficient for this pair in sv_coef[b-1], those of b in sv_coef[a]
+            for (int k=start[a]; k<start[a]+model->nSV[a]; k++) {
+                double coef=model->sv_coef[b-1][k];
+                objective+=0.5*coef*(rows.decValues[(size_t)k*rows.numPairs+p]+model->rho[p])-fabs(coef);
+            }
+            for (int k=start[b]; k<start[b]+model->nSV[b]; k++) {
+                double coef=model->sv_coef[a][k];
+                objective+=0.5*coef*(rows.decValues[(size_t)k*rows.numPairs+p]+model->rho[p])-fabs(coef);
+            }
+        }
+    }
+    free(start);
+    free(rows.decValues);
+    return objective;
+}
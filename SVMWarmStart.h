@@ -0,0 +1,13 @@
+/*
+	SVMWarmStart.h -- retraining seeded with the support vectors of an earlier model
+*/
+
+#ifndef SVM_WARM_START_H
+#define SVM_WARM_START_H
+
+#include "libSVM/svm.h"
+
+struct svm_model *warmStartTrain(const struct svm_problem *prob, const struct svm_parameter *param, const struct svm_model *previous, unsigned int seed, int numThreads, double cacheBudget, double gramBudget, int *rounds);
+double dualObjective(const struct svm_model *model, const struct svm_problem *prob, int numThreads);
+
+#endif
@@ -0,0 +1,419 @@
+/*	SVMWaveData.h -- host independent conversion of numeric data blocks into libSVM nodes
+
+	Igor stores waves column-major: the point at (row, column) of a rows x columns matrix lives at
+	data[row + column*rows]. The templates below read such a block directly, one loop per numeric type,
+	instead of going through MDGetNumericWavePointValue for every point. Nothing in here calls back into Igor,
+	so it can be compiled and exercised without the host.
+*/
+
+#ifndef SVM_WAVE_DATA_H
+#define SVM_WAVE_DATA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "libSVM/svm.h"
+
+// numeric types of a data block, translated from the Igor NT_ codes by the caller
+enum SVMDataType {
+    SVM_DATA_FLOAT32,
+    SVM_DATA_FLOAT64,
+    SVM_DATA_INT8,
+    SVM_DATA_UINT8,
+    SVM_DATA_INT16,
+    SVM_DATA_UINT16,
+    SVM_DATA_INT32,
+    SVM_DATA_UINT32,
+    SVM_DATA_INT64,
+    SVM_DATA_UINT64,
+    SVM_DATA_UNSUPPORTED
+};
+
+/*
+ describes a block of samples. Point (row, column) is at data[(row*rowStride + column*columnStride)*complexStride].
+ For an Igor matrix rowStride is 1 and columnStride the number of rows, complexStride is 2 for complex waves (only the real part is used).
+ */
+struct SVMDataBlock {
+    const void *data;
+    int type; // one of SVMDataType
+    int complexStride;
+    size_t rows; // number of samples
+    int columns; // number of data points per sample
+    size_t rowStride;
+    size_t columnStride;
+};
+
+enum {
+    SVM_ROW_BLOCK=64, // rows converted per pass, keeps the nodes of one block in cache while the columns are read sequentially
+    SVM_NODE_BLOCK_BYTES=8192 // nodes written per pass, fewer rows than SVM_ROW_BLOCK for wide samples
+};
+
+/*
+ rows per pass for samples of rowLength nodes: as many as fit into SVM_NODE_BLOCK_BYTES, between 4 and SVM_ROW_BLOCK. With 64 rows of a few hundred points the nodes of a block no longer stay in cache and the conversion takes twice as long.
+ */
+inline size_t SVMNodeBlockRows(size_t rowLength){
+    size_t rows=SVM_NODE_BLOCK_BYTES/(rowLength*sizeof(svm_node));
+    return rows<4 ? 4 : (rows>SVM_ROW_BLOCK ? (size_t)SVM_ROW_BLOCK : rows);
+}
+
+/*
+ converts rows [firstRow, firstRow+numRows) of a block into nodes, columns+1 nodes per row (including the -1 terminator), indices are one based.
+ The rows are processed in blocks of SVMNodeBlockRows(), within a block the data is read column by column, i.e. sequentially for column-major data.
+ */
+template <typename T>
+void SVMCopyRowsToNodes(const T *data, const SVMDataBlock &block, size_t firstRow, size_t numRows, svm_node *buffer){
+    const size_t rowLength=(size_t)block.columns+1;
+    const size_t rowStep=block.rowStride*block.complexStride;
+    const size_t columnStep=block.columnStride*block.complexStride;
+    const size_t passRows=SVMNodeBlockRows(rowLength);
+
+    for (size_t blockStart=0; blockStart<numRows; blockStart+=passRows) {
+        size_t blockRows=numRows-blockStart<passRows ? numRows-blockStart : passRows;
+        svm_node *blockNodes=buffer+blockStart*rowLength;
+        const T *blockData=data+(firstRow+blockStart)*rowStep;
+
+        for (int j=0; j<block.columns; j++) {
+            const T *column=blockData+j*columnStep;
+            svm_node *node=blockNodes+j;
+            for (size_t i=0; i<blockRows; i++) {
+                node->index=j+1;
+                node->value=(double)column[i*rowStep];
+                node+=rowLength;
+            }
+        }
+        for (size_t i=0; i<blockRows; i++) {
+            blockNodes[i*rowLength+block.columns].index=-1; // terminator
+        }
+    }
+}
+
+/*
+ counts the points of rows [firstRow, firstRow+numRows) with |value| > threshold, i.e. the nodes of the sparse representation (without terminator).
+ */
+template <typename T>
+void SVMCountRowsNonZero(const T *data, const SVMDataBlock &block, size_t firstRow, size_t numRows, double threshold, size_t *counts){
+    const size_t rowStep=block.rowStride*block.complexStride;
+    const size_t columnStep=block.columnStride*block.complexStride;
+    
+    for (size_t i=0; i<numRows; i++) {
+        counts[i]=0;
+    }
+    for (size_t blockStart=0; blockStart<numRows; blockStart+=SVM_ROW_BLOCK) {
+        size_t blockRows=numRows-blockStart<SVM_ROW_BLOCK ? numRows-blockStart : (size_t)SVM_ROW_BLOCK;
+        const T *blockData=data+(firstRow+blockStart)*rowStep;
+        size_t *blockCounts=counts+blockStart;
+        
+        for (int j=0; j<block.columns; j++) {
+            const T *column=blockData+j*columnStep;
+            for (size_t i=0; i<blockRows; i++) {
+                double value=(double)column[i*rowStep];
+                blockCounts[i]+=(value > threshold || value < -threshold);
+            }
+        }
+    }
+}
+
+/*
+ sparse version of SVMCopyRowsToNodes: only points with |value| > threshold become nodes. The nodes of row i are written starting at cursor[i], cursor[i] is advanced past the last node and the row terminated with index -1.
+ Columns are visited in ascending order, so the indices within a row are ascending as libSVM expects.
+ */
+template <typename T>
+void SVMCopyRowsToSparseNodes(const T *data, const SVMDataBlock &block, size_t firstRow, size_t numRows, double threshold, svm_node **cursor){
+    const size_t rowStep=block.rowStride*block.complexStride;
+    const size_t columnStep=block.columnStride*block.complexStride;
+    const size_t passRows=SVMNodeBlockRows((size_t)block.columns+1); // at most that many nodes per row
+    
+    for (size_t blockStart=0; blockStart<numRows; blockStart+=passRows) {
+        size_t blockRows=numRows-blockStart<passRows ? numRows-blockStart : passRows;
+        const T *blockData=data+(firstRow+blockStart)*rowStep;
+        svm_node **blockCursor=cursor+blockStart;
+        
+        for (int j=0; j<block.columns; j++) {
+            const T *column=blockData+j*columnStep;
+            for (size_t i=0; i<blockRows; i++) {
+                double value=(double)column[i*rowStep];
+                if (value > threshold || value < -threshold) {
+                    blockCursor[i]->index=j+1;
+                    blockCursor[i]->value=value;
+                    blockCursor[i]++;
+                }
+            }
+        }
+        for (size_t i=0; i<blockRows; i++) {
+            blockCursor[i]->index=-1; // terminator
+        }
+    }
+}
+
+/*
+ converts rows [firstRow, firstRow+numRows) of a one column block into doubles, used for the labels.
+ */
+template <typename T>
+void SVMCopyRowsToDoubles(const T *data, const SVMDataBlock &block, size_t firstRow, size_t numRows, double *values){
+    const size_t rowStep=block.rowStride*block.complexStride;
+    const T *column=data+firstRow*rowStep;
+    for (size_t i=0; i<numRows; i++) {
+        values[i]=(double)column[i*rowStep];
+    }
+}
+
+/*
+ converts rows [firstRow, firstRow+numRows) of a block into a row-major matrix of doubles, columns values per row. Used by the batch prediction engine (SVMBatch.h).
+ */
+template <typename T>
+void SVMCopyRowsToMatrix(const T *data, const SVMDataBlock &block, size_t firstRow, size_t numRows, double *values){
+    const size_t rowStep=block.rowStride*block.complexStride;
+    const size_t columnStep=block.columnStride*block.complexStride;
+    const T *blockData=data+firstRow*rowStep;
+    
+    for (int j=0; j<block.columns; j++) {
+        const T *column=blockData+j*columnStep;
+        for (size_t i=0; i<numRows; i++) {
+            values[i*block.columns+j]=(double)column[i*rowStep];
+        }
+    }
+}
+
+/*
+ converts a block into a feature-major matrix (columns x rows, the layout of an Igor matrix): point (row, column) goes to values[column*rows+row]. Used for dense training samples (SVMDense.h), U is float or double.
+ */
+template <typename T, typename U>
+void SVMCopyBlockToFeatures(const T *data, const SVMDataBlock &block, U *values){
+    const size_t rowStep=block.rowStride*block.complexStride;
+    const size_t columnStep=block.columnStride*block.complexStride;
+    
+    for (int j=0; j<block.columns; j++) {
+        const T *column=data+j*columnStep;
+        U *feature=values+(size_t)j*block.rows;
+        for (size_t i=0; i<block.rows; i++) {
+            feature[i]=(U)column[i*rowStep];
+        }
+    }
+}
+
+/*
+ calls op(typedPointer) with the data pointer of the block cast to its numeric type. Returns -1 for unsupported types, 0 otherwise.
+ */
+template <class Op>
+int SVMDispatchDataType(const SVMDataBlock &block, Op &op){
+    switch (block.type) {
+        case SVM_DATA_FLOAT32:
+            op((const float*)block.data);
+            break;
+        case SVM_DATA_FLOAT64:
+            op((const double*)block.data);
+            break;
+        case SVM_DATA_INT8:
+            op((const int8_t*)block.data);
+            break;
+        case SVM_DATA_UINT8:
+            op((const uint8_t*)block.data);
+            break;
+        case SVM_DATA_INT16:
+            op((const int16_t*)block.data);
+            break;
+        case SVM_DATA_UINT16:
+            op((const uint16_t*)block.data);
+            break;
+        case SVM_DATA_INT32:
+            op((const int32_t*)block.data);
+            break;
+        case SVM_DATA_UINT32:
+            op((const uint32_t*)block.data);
+            break;
+        case SVM_DATA_INT64:
+            op((const int64_t*)block.data);
+            break;
+        case SVM_DATA_UINT64:
+            op((const uint64_t*)block.data);
+            break;
+        default:
+            return -1;
+    }
+    return 0;
+}
+
+// functor for SVMDispatchDataType, fills nodes for a range of rows
+struct SVMRowsToNodes {
+    const SVMDataBlock &block;
+    size_t firstRow;
+    size_t numRows;
+    svm_node *buffer;
+    SVMRowsToNodes(const SVMDataBlock &b, size_t first, size_t num, svm_node *nodes):block(b),firstRow(first),numRows(num),buffer(nodes){}
+    template <typename T> void operator()(const T *data){
+        SVMCopyRowsToNodes(data, block, firstRow, numRows, buffer);
+    }
+};
+
+// functor for SVMDispatchDataType, reads a range of rows of the first column as doubles
+struct SVMRowsToDoubles {
+    const SVMDataBlock &block;
+    size_t firstRow;
+    size_t numRows;
+    double *values;
+    SVMRowsToDoubles(const SVMDataBlock &b, size_t first, size_t num, double *v):block(b),firstRow(first),numRows(num),values(v){}
+    template <typename T> void operator()(const T *data){
+        SVMCopyRowsToDoubles(data, block, firstRow, numRows, values);
+    }
+};
+
+// functor for SVMDispatchDataType, reads a range of rows into a row-major matrix of doubles
+struct SVMRowsToMatrix {
+    const SVMDataBlock &block;
+    size_t firstRow;
+    size_t numRows;
+    double *values;
+    SVMRowsToMatrix(const SVMDataBlock &b, size_t first, size_t num, double *v):block(b),firstRow(first),numRows(num),values(v){}
+    template <typename T> void operator()(const T *data){
+        SVMCopyRowsToMatrix(data, block, firstRow, numRows, values);
+    }
+};
+
+// functor for SVMDispatchDataType, reads the whole block into a feature-major matrix of floats or doubles
+template <typename U>
+struct SVMBlockFeatures {
+    const SVMDataBlock &block;
+    U *values;
+    SVMBlockFeatures(const SVMDataBlock &b, U *v):block(b),values(v){}
+    template <typename T> void operator()(const T *data){
+        SVMCopyBlockToFeatures(data, block, values);
+    }
+};
+
+// functor for SVMDispatchDataType, counts the non zero points of a range of rows
+struct SVMRowsCountNonZero {
+    const SVMDataBlock &block;
+    size_t firstRow;
+    size_t numRows;
+    double threshold;
+    size_t *counts;
+    SVMRowsCountNonZero(const SVMDataBlock &b, size_t first, size_t num, double t, size_t *c):block(b),firstRow(first),numRows(num),threshold(t),counts(c){}
+    template <typename T> void operator()(const T *data){
+        SVMCountRowsNonZero(data, block, firstRow, numRows, threshold, counts);
+    }
+};
+
+// functor for SVMDispatchDataType, fills sparse nodes for a range of rows
+struct SVMRowsToSparseNodes {
+    const SVMDataBlock &block;
+    size_t firstRow;
+    size_t numRows;
+    double threshold;
+    svm_node **cursor;
+    SVMRowsToSparseNodes(const SVMDataBlock &b, size_t first, size_t num, double t, svm_node **c):block(b),firstRow(first),numRows(num),threshold(t),cursor(c){}
+    template <typename T> void operator()(const T *data){
+        SVMCopyRowsToSparseNodes(data, block, firstRow, numRows, threshold, cursor);
+    }
+};
+
+/*
+ fills nodes for rows [firstRow, firstRow+numRows), columns+1 nodes per row. Returns -1 if the type of the block is not supported.
+ */
+inline int SVMBlockToNodes(const SVMDataBlock &block, size_t firstRow, size_t numRows, svm_node *buffer){
+    SVMRowsToNodes op(block, firstRow, numRows, buffer);
+    return SVMDispatchDataType(block, op);
+}
+
+/*
+ reads rows [firstRow, firstRow+numRows) of the first column as doubles. Returns -1 if the type of the block is not supported.
+ */
+inline int SVMBlockToDoubles(const SVMDataBlock &block, size_t firstRow, size_t numRows, double *values){
+    SVMRowsToDoubles op(block, firstRow, numRows, values);
+    return SVMDispatchDataType(block, op);
+}
+
+/*
+ reads rows [firstRow, firstRow+numRows) as a row-major matrix of doubles, columns values per row. Returns -1 if the type of the block is not supported.
+ */
+inline int SVMBlockToMatrix(const SVMDataBlock &block, size_t firstRow, size_t numRows, double *values){
+    SVMRowsToMatrix op(block, firstRow, numRows, values);
+    return SVMDispatchDataType(block, op);
+}
+
+/*
+ reads the block as feature-major matrix of floats or doubles, see SVMCopyBlockToFeatures(). Returns -1 if the type of the block is not supported.
+ */
+template <typename U>
+int SVMBlockToFeatures(const SVMDataBlock &block, U *values){
+    SVMBlockFeatures<U> op(block, values);
+    return SVMDispatchDataType(block, op);
+}
+
+/*
+ counts the points with |value| > threshold of rows [firstRow, firstRow+numRows). Returns -1 if the type of the block is not supported.
+ */
+inline int SVMBlockCountNonZero(const SVMDataBlock &block, size_t firstRow, size_t numRows, double threshold, size_t *counts){
+    SVMRowsCountNonZero op(block, firstRow, numRows, threshold, counts);
+    return SVMDispatchDataType(block, op);
+}
+
+/*
+ fills sparse nodes for rows [firstRow, firstRow+numRows), the nodes of row i are written from cursor[i] on. Returns -1 if the type of the block is not supported.
+ */
+inline int SVMBlockToSparseNodes(const SVMDataBlock &block, size_t firstRow, size_t numRows, double threshold, svm_node **cursor){
+    SVMRowsToSparseNodes op(block, firstRow, numRows, threshold, cursor);
+    return SVMDispatchDataType(block, op);
+}
+
+/*
+ the samples to classify: a dense block that is converted row by row, optionally dropping points with |value| <= threshold, or rows that were converted beforehand (x, e.g. from triplets).
+ */
+struct SVMSampleSource {
+    SVMDataBlock data;
+    int sparse;
+    double threshold;
+    svm_node **x;
+    size_t rows;
+    int precomputed; // the rows are kernel values K(sample, training sample j) for a PRECOMPUTED model
+};
+
+/*
+ returns the nodes of sample row. buffer needs to hold columns+1 nodes (columns+2 for precomputed sources) and is only used for dense blocks.
+ PRECOMPUTED models look the kernel values up by position, so node j holds column j-1 and node 0 only takes the place of the serial number.
+ */
+inline const svm_node *SVMSampleNodes(const SVMSampleSource &source, size_t row, svm_node *buffer){
+    if (source.x != NULL) {
+        return source.x[row];
+    }
+    if (source.precomputed) {
+        buffer[0].index=0;
+        buffer[0].value=0;
+        SVMBlockToNodes(source.data, row, 1, buffer+1);
+    }
+    else if (source.sparse) {
+        svm_node *cursor=buffer;
+        SVMBlockToSparseNodes(source.data, row, 1, source.threshold, &cursor);
+    }
+    else{
+        SVMBlockToNodes(source.data, row, 1, buffer);
+    }
+    return buffer;
+}
+
+/*
+ a single or double precision output matrix, written column-major like the input: point (row, column) is at data[row + column*rows].
+ */
+struct SVMOutputBlock {
+    void *data;
+    int isDouble;
+    size_t rows;
+};
+
+/*
+ writes count values as row of an output block.
+ */
+inline void SVMStoreRow(const SVMOutputBlock &block, size_t row, const double *values, int count){
+    if (block.isDouble) {
+        double *data=(double*)block.data+row;
+        for (int n=0; n<count; n++) {
+            data[n*block.rows]=values[n];
+        }
+    }
+    else{
+        float *data=(float*)block.data+row;
+        for (int n=0; n<count; n++) {
+            data[n*block.rows]=(float)values[n];
+        }
+    }
+}
+
+#endif
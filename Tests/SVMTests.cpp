@@ -0,0 +1,155 @@
+/*	SVMTests.cpp -- runs the standalone checks of SVM XOP
+
+	SVMTests [bench]
+	Prints each failed check and the number of failures, exits with 1 if there were any.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include "SVMTests.h"
+
+static int failures=0;
+static int benchmark=0;
+
+static const struct {
+    const char *name;
+    void (*run)(void);
+} tests[]={
+    {"wave data conversion", testWaveData},
+    {"binary model files", testBinaryModel},
+    {"batch prediction", testBatch},
+    {"linear solver", testLinear},
+    {"RBF feature maps", testFeatureMap},
+    {"cascade training", testCascade},
+    {"reduced-set models", testReduce},
+};
+
+/*
+ counts and reports a failed check, returns passed
+ */
+
+int svmCheck(int passed, const char *condition, const char *file, int line){
+    if (!passed) {
+        failures++;
+        printf("%s:%d: check failed: %s\n", file, line, condition);
+    }
+    return passed;
+}
+
+/*
+ whether the benchmarks should be timed and printed
+ */
+
+int svmBenchmark(void){
+    return benchmark;
+}
+
+/*
+ wall clock time in seconds, for the benchmarks
+ */
+
+double svmSeconds(void){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+ uniform random number in [0, 1), xorshift64 so the test data is the same everywhere
+ */
+
+double testRandom(uint64_t *state){
+    *state^=*state<<13;
+    *state^=*state>>7;
+    *state^=*state<<17;
+    return (double)(*state>>11)*(1.0/9007199254740992.0);
+}
+
+/*
+ l dense samples of dim features, uniform in [-1, 1]. classes>1 labels them by spherical shells around the origin (1...classes, -1/1 for two classes), so the classes are not linearly separable; classes 0 gives a smooth regression target.
+ The nodes are one block, prob->x[0]. Returns -1 if memory runs out.
+ */
+
+int makeTestProblem(int l, int dim, int classes, unsigned int seed, struct svm_problem *prob){
+    uint64_t state=0x9E3779B97F4A7C15ull^seed;
+    prob->l=l;
+    prob->y=Malloc(double, l);
+    prob->x=Malloc(struct svm_node *, l);
+    struct svm_node *nodes=Malloc(struct svm_node, (size_t)l*(dim+1));
+    if (prob->y == NULL || prob->x == NULL || nodes == NULL) {
+        free(prob->y);
+        free(prob->x);
+        free(nodes);
+        return -1;
+    }
+    
+    for (int i=0; i<l; i++) {
+        struct svm_node *x=nodes+(size_t)i*(dim+1);
+        double radius=0;
+        for (int k=0; k<dim; k++) {
+            x[k].index=k+1;
+            x[k].value=2*testRandom(&state)-1;
+            radius+=x[k].value*x[k].value;
+        }
+        x[dim].index=-1;
+        prob->x[i]=x;
+        
+        if (classes>1) {
+            int shell=(int)(radius*1.5*classes/dim); // the mean of radius is dim/3
+            shell=shell<classes ? shell : classes-1;
+            prob->y[i]=classes == 2 ? (shell ? 1 : -1) : shell+1;
+        }
+        else{
+            prob->y[i]=sin(3*x[0].value)+(dim>1 ? x[1].value*x[1].value : 0);
+        }
+    }
+    return 0;
+}
+
+void freeTestProblem(struct svm_problem *prob){
+    if (prob->x != NULL) {
+        free(prob->x[0]);
+    }
+    free(prob->x);
+    free(prob->y);
+    prob->x=NULL;
+    prob->y=NULL;
+}
+
+/*
+ the parameters SVMTrain uses by default, gamma 1/dim
+ */
+
+void testParameter(int svm_type, int kernel_type, int dim, struct svm_parameter *param){
+    memset(param, 0, sizeof(struct svm_parameter));
+    param->svm_type=svm_type;
+    param->kernel_type=kernel_type;
+    param->degree=3;
+    param->gamma=1.0/dim;
+    param->coef0=0;
+    param->nu=0.5;
+    param->cache_size=100;
+    param->C=1;
+    param->eps=1e-3;
+    param->p=0.1;
+    param->shrinking=1;
+}
+
+static void printNull(const char *){}
+
+int main(int argc, char *argv[]){
+    benchmark=argc>1 && strcmp(argv[1], "bench") == 0;
+    svm_set_print_string_function(printNull);
+    
+    for (size_t i=0; i<sizeof(tests)/sizeof(tests[0]); i++) {
+        int before=failures;
+        printf("%s\n", tests[i].name);
+        tests[i].run();
+        if (failures>before) {
+            printf("%s: %d failed\n", tests[i].name, failures-before);
+        }
+    }
+    printf(failures ? "%d checks failed\n" : "all checks passed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,35 @@
+/*	SVMTests.h -- standalone checks of the host independent parts of SVM XOP
+
+	Each Test*.cpp checks one part against a reference result: libSVM itself, or a straightforward
+	implementation of what the optimized code replaces. Run with the argument bench, the tests also time
+	both and print the result. Nothing here needs Igor, see the Makefile.
+*/
+
+#ifndef SVM_TESTS_H
+#define SVM_TESTS_H
+
+#include <stdint.h>
+#include "libSVM/svm.h"
+
+#define Malloc(type,n) (type *)malloc((n)*sizeof(type)) //from libSVM
+
+// counts a failed check and prints where it failed
+#define SVMCheck(condition) svmCheck((condition) ? 1 : 0, #condition, __FILE__, __LINE__)
+
+int svmCheck(int passed, const char *condition, const char *file, int line);
+int svmBenchmark(void);
+double svmSeconds(void);
+double testRandom(uint64_t *state);
+int makeTestProblem(int l, int dim, int classes, unsigned int seed, struct svm_problem *prob);
+void freeTestProblem(struct svm_problem *prob);
+void testParameter(int svm_type, int kernel_type, int dim, struct svm_parameter *param);
+
+void testWaveData(void);
+void testBinaryModel(void);
+void testBatch(void);
+void testLinear(void);
+void testFeatureMap(void);
+void testCascade(void);
+void testReduce(void);
+
+#endif
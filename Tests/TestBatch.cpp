@@ -0,0 +1,200 @@
+/*	TestBatch.cpp -- checks the batch prediction engine of SVMBatch.cpp against svm_predict_values()
+
+	Models of every kernel the engine supports and every libSVM model type predict samples in batches of
+	denseBatchRows(), from a dense row-major matrix as SVMClassify reads it. The labels have to be those of
+	svm_predict_values() and the decision values the same up to rounding.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "SVMTests.h"
+#include "SVMBatch.h"
+
+/*
+ helper function, the samples of prob as row-major matrix of columns values each, features beyond columns are left out
+ */
+
+static double *denseSamples(const svm_problem *prob, int columns){
+    double *samples=(double *)calloc((size_t)prob->l*columns, sizeof(double));
+    for (int i=0; i<prob->l && samples != NULL; i++) {
+        for (const svm_node *x=prob->x[i]; x->index != -1; x++) {
+            if (x->index <= columns) {
+                samples[(size_t)i*columns+x->index-1]=x->value;
+            }
+        }
+    }
+    return samples;
+}
+
+/*
+ helper function, predicts the samples (row-major, columns values each) of test with the engine. labels and dec (numDecisionValues per sample) receive the results. Returns -1 if memory runs out.
+ */
+
+static int batchPredict(const SVMDenseModel *dense, const double *samples, int numSamples, int columns, double *labels, double *dec){
+    size_t batchRows=denseBatchRows(dense);
+    double *kvalues=dense->w == NULL ? Malloc(double, batchRows*dense->l) : NULL;
+    int *vote=Malloc(int, dense->model->nr_class>1 ? dense->model->nr_class : 1);
+    if ((dense->w == NULL && kvalues == NULL) || vote == NULL) {
+        free(kvalues);
+        free(vote);
+        return -1;
+    }
+    
+    for (size_t batch=0; batch<(size_t)numSamples; batch+=batchRows) {
+        size_t count=numSamples-batch<batchRows ? numSamples-batch : batchRows;
+        const double *batchSamples=samples+batch*columns;
+        if (dense->w == NULL) {
+            denseKernelValues(dense, batchSamples, count, columns, kvalues);
+        }
+        for (size_t i=0; i<count; i++) {
+            double *sampleDec=dec+(batch+i)*dense->numDecisionValues;
+            if (dense->w != NULL) {
+                labels[batch+i]=linearDecisionValues(dense, batchSamples+i*columns, columns, sampleDec, vote);
+            }
+            else{
+                labels[batch+i]=denseDecisionValues(dense, kvalues+i*dense->l, sampleDec, vote);
+            }
+        }
+    }
+    free(kvalues);
+    free(vote);
+    return 0;
+}
+
+/*
+ helper function, trains a model of svm_type and kernel_type on prob and compares the engine with svm_predict_values() on test, with all columns and with the last feature left out
+ */
+
+static void checkModel(const svm_problem *prob, const svm_problem *test, int dim, int svm_type, int kernel_type){
+    svm_parameter param;
+    testParameter(svm_type, kernel_type, dim, &param);
+    if (kernel_type == SIGMOID) {
+        param.gamma=0.1/dim; // keeps tanh out of saturation, so the decision values are not all the same
+    }
+    svm_model *model=svm_train(prob, &param);
+    SVMDenseModel *dense=NULL;
+    if (!SVMCheck(model != NULL && makeDenseModel(model, &dense) == 0)) {
+        svm_free_and_destroy_model(&model);
+        return;
+    }
+    
+    const int numDec=dense->numDecisionValues;
+    double *labels=Malloc(double, test->l);
+    double *dec=Malloc(double, (size_t)test->l*numDec);
+    double *reference=Malloc(double, numDec);
+    svm_node *truncated=Malloc(svm_node, dim+1);
+    for (int columns=dim; columns >= dim-1; columns--) {
+        double *samples=denseSamples(test, columns);
+        if (!SVMCheck(samples != NULL && labels != NULL && dec != NULL && reference != NULL && truncated != NULL) || !SVMCheck(batchPredict(dense, samples, test->l, columns, labels, dec) == 0)) {
+            free(samples);
+            break;
+        }
+        
+        int sameLabels=1;
+        double maxError=0;
+        for (int i=0; i<test->l; i++) {
+            int n=0;
+            for (const svm_node *x=test->x[i]; x->index != -1; x++) {
+                if (x->index <= columns) {
+                    truncated[n++]=*x;
+                }
+            }
+            truncated[n].index=-1;
+            double label=svm_predict_values(model, truncated, reference);
+            if (svm_type == EPSILON_SVR || svm_type == NU_SVR) { // the label is the decision value
+                sameLabels&=fabs(label-labels[i]) <= 1e-9*(1+fabs(label));
+            }
+            else{
+                sameLabels&=label == labels[i];
+            }
+            for (int p=0; p<numDec; p++) {
+                double error=fabs(dec[(size_t)i*numDec+p]-reference[p])/(1+fabs(reference[p]));
+                maxError=error>maxError ? error : maxError;
+            }
+        }
+        SVMCheck(sameLabels);
+        SVMCheck(maxError<1e-9); // LINEAR models are collapsed to weight vectors, which rounds differently
+        free(samples);
+    }
+    
+    free(labels);
+    free(dec);
+    free(reference);
+    free(truncated);
+    freeDenseModel(dense);
+    svm_free_and_destroy_model(&model);
+}
+
+/*
+ helper function, times svm_predict_values() against the engine for an RBF model of prob on numSamples samples
+ */
+
+static void benchmarkPrediction(const svm_problem *prob, int dim, int numSamples){
+    svm_problem test;
+    if (makeTestProblem(numSamples, dim, 2, 99, &test)) {
+        return;
+    }
+    svm_parameter param;
+    testParameter(C_SVC, RBF, dim, &param);
+    svm_model *model=svm_train(prob, &param);
+    SVMDenseModel *dense=NULL;
+    double *samples=denseSamples(&test, dim);
+    double *labels=Malloc(double, numSamples);
+    double *dec=Malloc(double, numSamples);
+    if (model != NULL && makeDenseModel(model, &dense) == 0 && samples != NULL && labels != NULL && dec != NULL) {
+        double start=svmSeconds();
+        for (int i=0; i<numSamples; i++) {
+            labels[i]=svm_predict_values(model, test.x[i], dec+i);
+        }
+        double nodes=svmSeconds()-start;
+        start=svmSeconds();
+        batchPredict(dense, samples, numSamples, dim, labels, dec);
+        double batch=svmSeconds()-start;
+        printf("  RBF, %d SVs x %d features: svm_predict_values %.0f samples/s, batch engine %.0f samples/s\n", model->l, dim, numSamples/nodes, numSamples/batch);
+    }
+    freeDenseModel(dense);
+    svm_free_and_destroy_model(&model);
+    free(samples);
+    free(labels);
+    free(dec);
+    freeTestProblem(&test);
+}
+
+void testBatch(void){
+    const int dim=6;
+    svm_problem prob[3]; // binary, three classes, regression
+    svm_problem test;
+    int classes[3]={2, 3, 0};
+    for (int i=0; i<3; i++) {
+        if (!SVMCheck(makeTestProblem(400, dim, classes[i], 11+i, prob+i) == 0)) {
+            return;
+        }
+    }
+    if (!SVMCheck(makeTestProblem(1000, dim, 2, 21, &test) == 0)) {
+        return;
+    }
+    
+    const int kernels[]={LINEAR, POLY, RBF, SIGMOID};
+    for (int k=0; k<4; k++) {
+        checkModel(prob, &test, dim, C_SVC, kernels[k]);
+        checkModel(prob+1, &test, dim, C_SVC, kernels[k]);
+        checkModel(prob+1, &test, dim, NU_SVC, kernels[k]);
+        checkModel(prob, &test, dim, ONE_CLASS, kernels[k]);
+        checkModel(prob+2, &test, dim, EPSILON_SVR, kernels[k]);
+        checkModel(prob+2, &test, dim, NU_SVR, kernels[k]);
+    }
+    
+    if (svmBenchmark()) {
+        svm_problem large;
+        if (makeTestProblem(4000, 50, 2, 31, &large) == 0) {
+            benchmarkPrediction(&large, 50, 20000);
+            freeTestProblem(&large);
+        }
+    }
+    for (int i=0; i<3; i++) {
+        freeTestProblem(prob+i);
+    }
+    freeTestProblem(&test);
+}
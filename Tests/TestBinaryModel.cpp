@@ -0,0 +1,274 @@
+/*	TestBinaryModel.cpp -- checks the binary model files of SVMBinaryModel.cpp against the text format
+
+	A model written with saveBinaryModel() and mapped again has to be the same model, value for value, for every
+	type of libSVM model and with a feature map. A model loaded from the text format of svm_save_model() has to
+	survive the binary round trip unchanged as well, and truncated files have to be rejected.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SVMTests.h"
+#include "SVMBinaryModel.h"
+#include "SVMFeatureMap.h"
+
+#define TEXT_PATH "SVMTests_model.txt"
+#define BINARY_PATH "SVMTests_model.svmb"
+#define TRUNCATED_PATH "SVMTests_truncated.svmb"
+
+/*
+ helper function, whether n values of a and b are the same, both NULL counts as the same
+ */
+
+static int sameValues(const double *a, const double *b, int n){
+    if (a == NULL || b == NULL) {
+        return a == b;
+    }
+    return n == 0 || memcmp(a, b, n*sizeof(double)) == 0;
+}
+
+static int sameInts(const int *a, const int *b, int n){
+    if (a == NULL || b == NULL) {
+        return a == b;
+    }
+    return n == 0 || memcmp(a, b, n*sizeof(int)) == 0;
+}
+
+/*
+ helper function, whether the models are the same: parameters the prediction uses, all arrays and every node
+ */
+
+static int sameModel(const svm_model *a, const svm_model *b){
+    if (a->param.svm_type != b->param.svm_type || a->param.kernel_type != b->param.kernel_type || a->param.degree != b->param.degree || a->param.gamma != b->param.gamma || a->param.coef0 != b->param.coef0) {
+        return 0;
+    }
+    if (a->nr_class != b->nr_class || a->l != b->l) {
+        return 0;
+    }
+    const int pairs=a->nr_class*(a->nr_class-1)/2;
+    if (!sameValues(a->rho, b->rho, pairs) || !sameInts(a->label, b->label, a->nr_class) || !sameInts(a->nSV, b->nSV, a->nr_class)) {
+        return 0;
+    }
+    if (!sameValues(a->probA, b->probA, pairs) || !sameValues(a->probB, b->probB, pairs)) {
+        return 0;
+    }
+    for (int k=0; k<a->nr_class-1; k++) {
+        if (!sameValues(a->sv_coef[k], b->sv_coef[k], a->l)) {
+            return 0;
+        }
+    }
+    for (int i=0; i<a->l; i++) {
+        const svm_node *x=a->SV[i];
+        const svm_node *y=b->SV[i];
+        for (; x->index != -1; x++, y++) {
+            if (x->index != y->index || x->value != y->value) {
+                return 0;
+            }
+        }
+        if (y->index != -1) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ helper function, whether the decision values of both models are identical for the samples of prob
+ */
+
+static int samePredictions(const svm_model *a, const svm_model *b, const svm_problem *prob){
+    const int pairs=a->nr_class>1 ? a->nr_class*(a->nr_class-1)/2 : 1;
+    double *decA=Malloc(double, pairs);
+    double *decB=Malloc(double, pairs);
+    int same=decA != NULL && decB != NULL;
+    for (int i=0; i<prob->l && same; i++) {
+        same=svm_predict_values(a, prob->x[i], decA) == svm_predict_values(b, prob->x[i], decB) && memcmp(decA, decB, pairs*sizeof(double)) == 0;
+    }
+    free(decA);
+    free(decB);
+    return same;
+}
+
+/*
+ helper function, writes model as binary file, maps it and compares it with model. The text round trip is checked on the way: the model loaded from text has to come back unchanged as well.
+ */
+
+static void checkRoundTrip(const svm_model *model, const svm_problem *prob){
+    SVMMappedModel mapped;
+    SVMCheck(saveBinaryModel(BINARY_PATH, model, NULL) == 0);
+    SVMCheck(isBinaryModelFile(BINARY_PATH) && !isBinaryModelFile(TEXT_PATH));
+    if (SVMCheck(mapBinaryModel(BINARY_PATH, &mapped) == 0)) {
+        SVMCheck(mapped.featureMap == NULL);
+        SVMCheck(sameModel(model, mapped.model));
+        SVMCheck(samePredictions(model, mapped.model, prob));
+        unmapBinaryModel(&mapped);
+    }
+    
+    SVMCheck(svm_save_model(TEXT_PATH, model) == 0);
+    svm_model *text=svm_load_model(TEXT_PATH);
+    if (!SVMCheck(text != NULL)) {
+        return;
+    }
+    SVMCheck(saveBinaryModel(BINARY_PATH, text, NULL) == 0);
+    if (SVMCheck(mapBinaryModel(BINARY_PATH, &mapped) == 0)) {
+        SVMCheck(sameModel(text, mapped.model));
+        SVMCheck(samePredictions(text, mapped.model, prob));
+        unmapBinaryModel(&mapped);
+    }
+    svm_free_and_destroy_model(&text);
+}
+
+/*
+ helper function, every prefix of the binary file of model, in steps of a 16th, has to be rejected
+ */
+
+static void checkTruncated(const svm_model *model){
+    size_t size=0;
+    SVMCheck(saveBinaryModel(BINARY_PATH, model, NULL) == 0);
+    void *file=mapFile(BINARY_PATH, &size);
+    if (!SVMCheck(file != NULL)) {
+        return;
+    }
+    
+    for (int part=1; part<16; part++) {
+        FILE *truncated=fopen(TRUNCATED_PATH, "wb");
+        if (!SVMCheck(truncated != NULL)) {
+            break;
+        }
+        fwrite(file, 1, size*part/16, truncated);
+        fclose(truncated);
+        SVMMappedModel mapped;
+        SVMCheck(mapBinaryModel(TRUNCATED_PATH, &mapped) == -1);
+    }
+    unmapFile(file, size);
+    remove(TRUNCATED_PATH);
+}
+
+/*
+ helper function, a model with a feature map: the mapped copy of the map has to map every sample to the same nodes
+ */
+
+static void checkFeatureMap(const svm_problem *prob, int type){
+    svm_parameter param;
+    testParameter(C_SVC, LINEAR, 1, &param);
+    SVMFeatureMap *map=NULL;
+    svm_node *buffer=NULL;
+    svm_problem mappedProblem;
+    if (!SVMCheck(makeFeatureMap(prob, type, 32, 0.5, 1, 1, &map) == 0 && mapProblem(map, prob, 1, &buffer, &mappedProblem) == 0)) {
+        freeFeatureMap(map);
+        return;
+    }
+    svm_model *model=svm_train(&mappedProblem, &param);
+    
+    SVMMappedModel mapped;
+    SVMCheck(saveBinaryModel(BINARY_PATH, model, map) == 0);
+    if (SVMCheck(mapBinaryModel(BINARY_PATH, &mapped) == 0)) {
+        SVMCheck(sameModel(model, mapped.model));
+        if (SVMCheck(mapped.featureMap != NULL)) {
+            SVMCheck(mapped.featureMap->type == map->type && mapped.featureMap->inputDim == map->inputDim && mapped.featureMap->numBasis == map->numBasis && mapped.featureMap->outputDim == map->outputDim && mapped.featureMap->gamma == map->gamma);
+            svm_node *again=NULL;
+            svm_problem mappedAgain;
+            if (SVMCheck(mapProblem(mapped.featureMap, prob, 1, &again, &mappedAgain) == 0)) {
+                int same=1;
+                for (int i=0; i<prob->l; i++) {
+                    for (const svm_node *x=mappedProblem.x[i], *y=mappedAgain.x[i]; same && (x->index != -1 || y->index != -1); x++, y++) {
+                        same=x->index == y->index && x->value == y->value;
+                    }
+                }
+                SVMCheck(same);
+                free(again);
+                free(mappedAgain.x);
+                free(mappedAgain.y);
+            }
+        }
+        unmapBinaryModel(&mapped);
+    }
+    
+    svm_free_and_destroy_model(&model);
+    free(buffer);
+    free(mappedProblem.x);
+    free(mappedProblem.y);
+    freeFeatureMap(map);
+}
+
+/*
+ helper function, times loading a model of l support vectors with dim features from text and from a binary file
+ */
+
+static void benchmarkLoad(int l, int dim){
+    svm_problem prob;
+    if (makeTestProblem(l, dim, 2, 7, &prob)) {
+        return;
+    }
+    svm_model model;
+    memset(&model, 0, sizeof(model));
+    testParameter(C_SVC, RBF, dim, &model.param);
+    int label[2]={1, -1};
+    int nSV[2]={l/2, l-l/2};
+    double rho=0.1;
+    model.nr_class=2;
+    model.l=l;
+    model.SV=prob.x;
+    model.sv_coef=&prob.y; // any coefficients will do
+    model.rho=&rho;
+    model.label=label;
+    model.nSV=nSV;
+    
+    if (svm_save_model(TEXT_PATH, &model) == 0 && saveBinaryModel(BINARY_PATH, &model, NULL) == 0) {
+        double start=svmSeconds();
+        svm_model *text=svm_load_model(TEXT_PATH);
+        double textTime=svmSeconds()-start;
+        start=svmSeconds();
+        SVMMappedModel mapped;
+        int err=mapBinaryModel(BINARY_PATH, &mapped);
+        double binaryTime=svmSeconds()-start;
+        printf("  %d SVs x %d features: svm_load_model %.3f s, mapBinaryModel %.4f s\n", l, dim, textTime, binaryTime);
+        svm_free_and_destroy_model(&text);
+        if (err == 0) {
+            unmapBinaryModel(&mapped);
+        }
+    }
+    freeTestProblem(&prob);
+}
+
+void testBinaryModel(void){
+    svm_problem prob;
+    if (!SVMCheck(makeTestProblem(300, 5, 3, 1, &prob) == 0)) {
+        return;
+    }
+    svm_problem regression;
+    if (!SVMCheck(makeTestProblem(300, 5, 0, 2, &regression) == 0)) {
+        freeTestProblem(&prob);
+        return;
+    }
+    
+    SVMCheck(isBinaryModelPath("model.svmb") && isBinaryModelPath("MODEL.SVMB") && !isBinaryModelPath("model.svm") && !isBinaryModelPath("svmb"));
+    
+    const int types[][2]={{C_SVC, RBF}, {NU_SVC, POLY}, {ONE_CLASS, RBF}, {EPSILON_SVR, SIGMOID}, {NU_SVR, LINEAR}};
+    for (int t=0; t<5; t++) {
+        for (int probability=0; probability<2; probability++) {
+            const svm_problem *p=types[t][0] >= EPSILON_SVR ? &regression : &prob;
+            svm_parameter param;
+            testParameter(types[t][0], types[t][1], 5, &param);
+            param.probability=probability && types[t][0] != ONE_CLASS;
+            svm_model *model=svm_train(p, &param);
+            if (SVMCheck(model != NULL)) {
+                checkRoundTrip(model, p);
+                if (t == 0 && probability) {
+                    checkTruncated(model);
+                }
+            }
+            svm_free_and_destroy_model(&model);
+        }
+    }
+    checkFeatureMap(&prob, SVM_FEATURE_MAP_RFF);
+    checkFeatureMap(&prob, SVM_FEATURE_MAP_NYSTROEM);
+    
+    freeTestProblem(&prob);
+    freeTestProblem(&regression);
+    if (svmBenchmark()) {
+        benchmarkLoad(20000, 100);
+    }
+    remove(TEXT_PATH);
+    remove(BINARY_PATH);
+}
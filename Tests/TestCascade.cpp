@@ -0,0 +1,169 @@
+/*	TestCascade.cpp -- checks the cascade training of SVMCascade.cpp against a direct svm_train()
+
+	A cascade whose feedback passes converged has the support vectors of the complete problem, so its model has
+	to be the one of a direct training run up to the stopping tolerance of the solver. Without feedback it is an
+	approximation that still has to come close in accuracy. cascadeReport() has to agree with predictions
+	counted here, and the model must not depend on the number of threads.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "SVMTests.h"
+#include "SVMCascade.h"
+
+/*
+ helper function, whether both models have the same support vectors (sv_indices, in the order of the classes)
+ */
+
+static int sameSupportVectors(const svm_model *a, const svm_model *b){
+    if (a->l != b->l || a->sv_indices == NULL || b->sv_indices == NULL) {
+        return 0;
+    }
+    return memcmp(a->sv_indices, b->sv_indices, a->l*sizeof(int)) == 0;
+}
+
+/*
+ helper function, largest difference of the decision values of both models on the samples of prob, relative to 1+|value|
+ */
+
+static double decisionDifference(const svm_model *a, const svm_model *b, const svm_problem *prob){
+    const int pairs=a->nr_class>1 ? a->nr_class*(a->nr_class-1)/2 : 1;
+    double *decA=Malloc(double, pairs);
+    double *decB=Malloc(double, pairs);
+    double largest=decA != NULL && decB != NULL ? 0 : INFINITY;
+    for (int i=0; i<prob->l && decA != NULL && decB != NULL; i++) {
+        svm_predict_values(a, prob->x[i], decA);
+        svm_predict_values(b, prob->x[i], decB);
+        for (int p=0; p<pairs; p++) {
+            double difference=fabs(decA[p]-decB[p])/(1+fabs(decB[p]));
+            largest=difference>largest ? difference : largest;
+        }
+    }
+    free(decA);
+    free(decB);
+    return largest;
+}
+
+/*
+ helper function, accuracy in % or mean squared error of model on prob, as cascadeReport() scores it
+ */
+
+static double trainingScore(const svm_model *model, const svm_problem *prob){
+    double sum=0;
+    for (int i=0; i<prob->l; i++) {
+        double predicted=svm_predict(model, prob->x[i]);
+        if (model->param.svm_type == EPSILON_SVR || model->param.svm_type == NU_SVR) {
+            sum+=(predicted-prob->y[i])*(predicted-prob->y[i]);
+        }
+        else{
+            sum+=predicted == prob->y[i];
+        }
+    }
+    return model->param.svm_type == EPSILON_SVR || model->param.svm_type == NU_SVR ? sum/prob->l : 100*sum/prob->l;
+}
+
+/*
+ helper function, cascades of prob against the direct model: converged with feedback, approximate without, and the same for 1 and 4 threads
+ */
+
+static void checkCascade(const svm_problem *prob, int svm_type){
+    svm_parameter param;
+    testParameter(svm_type, RBF, 5, &param);
+    param.C=4;
+    const int regression=svm_type == EPSILON_SVR;
+    svm_model *direct=svm_train(prob, &param);
+    int passes=0;
+    svm_model *converged=cascadeTrain(prob, &param, 8, 20, 1, 1, 100, 0, &passes);
+    svm_model *threaded=cascadeTrain(prob, &param, 8, 20, 1, 4, 100, 0, &passes);
+    int approximatePasses=0;
+    svm_model *approximate=cascadeTrain(prob, &param, 8, 0, 1, 1, 100, 0, &approximatePasses);
+    if (!SVMCheck(direct != NULL && converged != NULL && threaded != NULL && approximate != NULL)) {
+        svm_free_and_destroy_model(&direct);
+        svm_free_and_destroy_model(&converged);
+        svm_free_and_destroy_model(&threaded);
+        svm_free_and_destroy_model(&approximate);
+        return;
+    }
+    
+    SVMCheck(passes<20 && approximatePasses == 0);
+    SVMCheck(abs(converged->l-direct->l) <= direct->l/50+1); // bound support vectors at the stopping tolerance may come and go
+    SVMCheck(decisionDifference(converged, direct, prob)<1e-2);
+    SVMCheck(sameSupportVectors(converged, threaded) && decisionDifference(converged, threaded, prob) == 0);
+    
+    SVMCascadeReport report;
+    if (SVMCheck(cascadeReport(approximate, direct, prob, 2, &report) == 0)) {
+        SVMCheck(fabs(report.cascadeScore-trainingScore(approximate, prob)) <= 1e-9*(1+report.cascadeScore));
+        SVMCheck(fabs(report.directScore-trainingScore(direct, prob)) <= 1e-9*(1+report.directScore));
+        if (regression) { // errors and differences against the variance of the labels
+            double mean=0;
+            double variance=0;
+            for (int i=0; i<prob->l; i++) {
+                mean+=prob->y[i]/prob->l;
+            }
+            for (int i=0; i<prob->l; i++) {
+                variance+=(prob->y[i]-mean)*(prob->y[i]-mean)/prob->l;
+            }
+            SVMCheck(report.cascadeScore <= report.directScore+0.01*variance);
+            SVMCheck(report.difference <= 0.01*variance);
+        }
+        else{
+            SVMCheck(report.cascadeScore >= report.directScore-2);
+            SVMCheck(report.difference <= 5);
+        }
+    }
+    if (SVMCheck(cascadeReport(converged, direct, prob, 2, &report) == 0) && !regression) {
+        SVMCheck(report.difference <= 1);
+    }
+    
+    svm_free_and_destroy_model(&direct);
+    svm_free_and_destroy_model(&converged);
+    svm_free_and_destroy_model(&threaded);
+    svm_free_and_destroy_model(&approximate);
+}
+
+/*
+ helper function, times svm_train() against cascades with and without feedback on l samples, with the report of each
+ */
+
+static void benchmarkCascade(int l, int dim, int numThreads){
+    svm_problem prob;
+    if (makeTestProblem(l, dim, 2, 91, &prob)) {
+        return;
+    }
+    svm_parameter param;
+    testParameter(C_SVC, RBF, dim, &param);
+    double start=svmSeconds();
+    svm_model *direct=svm_train(&prob, &param);
+    printf("  %d x %d, direct: %d SVs, %.2f s\n", l, dim, direct != NULL ? direct->l : 0, svmSeconds()-start);
+    for (int feedback=0; feedback <= SVM_CASCADE_FEEDBACK && direct != NULL; feedback+=SVM_CASCADE_FEEDBACK) {
+        int passes=0;
+        start=svmSeconds();
+        svm_model *cascade=cascadeTrain(&prob, &param, SVM_CASCADE_PARTITIONS, feedback, 1, numThreads, 100, 0, &passes);
+        double seconds=svmSeconds()-start;
+        SVMCascadeReport report;
+        if (cascade != NULL && cascadeReport(cascade, direct, &prob, numThreads, &report) == 0) {
+            printf("  cascade, %d feedback passes, %d threads: %d SVs, %.2f s, accuracy %.2f%% (direct %.2f%%), %.2f%% predicted differently\n", passes, numThreads, cascade->l, seconds, report.cascadeScore, report.directScore, report.difference);
+        }
+        svm_free_and_destroy_model(&cascade);
+    }
+    svm_free_and_destroy_model(&direct);
+    freeTestProblem(&prob);
+}
+
+void testCascade(void){
+    svm_problem prob;
+    if (SVMCheck(makeTestProblem(1200, 5, 3, 92, &prob) == 0)) {
+        checkCascade(&prob, C_SVC);
+        freeTestProblem(&prob);
+    }
+    if (SVMCheck(makeTestProblem(800, 5, 0, 93, &prob) == 0)) {
+        checkCascade(&prob, EPSILON_SVR);
+        freeTestProblem(&prob);
+    }
+    
+    if (svmBenchmark()) {
+        benchmarkCascade(10000, 10, 0);
+    }
+}
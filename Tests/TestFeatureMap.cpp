@@ -0,0 +1,213 @@
+/*	TestFeatureMap.cpp -- checks the RBF feature maps of SVMFeatureMap.cpp against the exact kernel
+
+	The dot products of mapped samples have to approximate the RBF kernel: exactly for a Nyström map whose
+	landmarks are all samples, with an error that shrinks with the dimension for random Fourier features.
+	Dense samples (classification) and nodes (training) have to map to the same features, and a linear
+	model on 256 features has to come close to the accuracy of the exact RBF model of svm_train().
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "SVMTests.h"
+#include "SVMFeatureMap.h"
+#include "SVMKernel.h"
+#include "SVMTraining.h"
+#include "SVMLinear.h"
+
+/*
+ helper function, largest and mean absolute difference between the dot products of the mapped samples and the RBF kernel over all pairs of samples of prob
+ */
+
+static void kernelError(const SVMFeatureMap *map, const svm_problem *prob, double gamma, double *maxError, double *meanError){
+    svm_node *buffer=NULL;
+    svm_problem mapped;
+    *maxError=INFINITY;
+    *meanError=INFINITY;
+    if (mapProblem(map, prob, 1, &buffer, &mapped)) {
+        return;
+    }
+    double sum=0;
+    double largest=0;
+    for (int i=0; i<prob->l; i++) {
+        for (int j=0; j<prob->l; j++) {
+            double xx=sparseDot(prob->x[i], prob->x[i]);
+            double yy=sparseDot(prob->x[j], prob->x[j]);
+            double kernel=exp(-gamma*(xx+yy-2*sparseDot(prob->x[i], prob->x[j])));
+            double error=fabs(sparseDot(mapped.x[i], mapped.x[j])-kernel);
+            sum+=error;
+            largest=error>largest ? error : largest;
+        }
+    }
+    *maxError=largest;
+    *meanError=sum/((double)prob->l*prob->l);
+    free(buffer);
+    free(mapped.x);
+    free(mapped.y);
+}
+
+/*
+ helper function, whether mapDenseSamples() gives the features of mapNodes() for the samples of prob (dense with dim columns)
+ */
+
+static int sameDenseFeatures(const SVMFeatureMap *map, const svm_problem *prob, int dim){
+    double *samples=(double *)calloc((size_t)prob->l*dim, sizeof(double));
+    double *dots=Malloc(double, (size_t)prob->l*map->numBasis+map->outputDim);
+    double *features=Malloc(double, (size_t)prob->l*map->outputDim);
+    svm_node *nodes=Malloc(svm_node, map->outputDim+1);
+    int same=samples != NULL && dots != NULL && features != NULL && nodes != NULL;
+    if (same) {
+        for (int i=0; i<prob->l; i++) {
+            for (const svm_node *x=prob->x[i]; x->index != -1; x++) {
+                samples[(size_t)i*dim+x->index-1]=x->value;
+            }
+        }
+        mapDenseSamples(map, samples, prob->l, dim, dots, features);
+        for (int i=0; i<prob->l && same; i++) {
+            mapNodes(map, prob->x[i], dots, nodes);
+            for (int k=0; k<map->outputDim; k++) {
+                same&=nodes[k].index == k+1 && fabs(nodes[k].value-features[(size_t)i*map->outputDim+k]) <= 1e-12;
+            }
+            same&=nodes[map->outputDim].index == -1;
+        }
+    }
+    free(samples);
+    free(dots);
+    free(features);
+    free(nodes);
+    return same;
+}
+
+/*
+ helper function, held out accuracy of a linear model trained on prob mapped with a map of type and dimension, -1 if that fails. seconds receives the time for the map and the training.
+ */
+
+static double mappedAccuracy(const svm_problem *prob, const svm_problem *test, int type, int dimension, double gamma, double *seconds){
+    double start=svmSeconds();
+    SVMFeatureMap *map=NULL;
+    svm_node *buffer=NULL;
+    svm_node *testBuffer=NULL;
+    svm_problem mapped;
+    svm_problem mappedTest;
+    if (makeFeatureMap(prob, type, dimension, gamma, 1, 1, &map) || mapProblem(map, prob, 1, &buffer, &mapped)) {
+        freeFeatureMap(map);
+        return -1;
+    }
+    svm_parameter param;
+    testParameter(C_SVC, LINEAR, 1, &param);
+    param.eps=SVM_LINEAR_EPS;
+    svm_model *model=linearTrain(&mapped, &param, SVM_LINEAR_L2LOSS, 1);
+    *seconds=svmSeconds()-start;
+    
+    double accuracy=-1;
+    if (model != NULL && mapProblem(map, test, 1, &testBuffer, &mappedTest) == 0) {
+        int correct=0;
+        for (int i=0; i<test->l; i++) {
+            correct+=svm_predict(model, mappedTest.x[i]) == test->y[i];
+        }
+        accuracy=(double)correct/test->l;
+        free(testBuffer);
+        free(mappedTest.x);
+        free(mappedTest.y);
+    }
+    svm_free_and_destroy_model(&model);
+    free(buffer);
+    free(mapped.x);
+    free(mapped.y);
+    freeFeatureMap(map);
+    return accuracy;
+}
+
+/*
+ helper function, held out accuracy of the exact RBF model of svm_train()
+ */
+
+static double exactAccuracy(const svm_problem *prob, const svm_problem *test, double gamma, double *seconds){
+    svm_parameter param;
+    testParameter(C_SVC, RBF, 1, &param);
+    param.gamma=gamma;
+    double start=svmSeconds();
+    svm_model *model=svm_train(prob, &param);
+    *seconds=svmSeconds()-start;
+    if (model == NULL) {
+        return -1;
+    }
+    int correct=0;
+    for (int i=0; i<test->l; i++) {
+        correct+=svm_predict(model, test->x[i]) == test->y[i];
+    }
+    svm_free_and_destroy_model(&model);
+    return (double)correct/test->l;
+}
+
+/*
+ helper function, accuracy against dimension and time of both maps, next to exact RBF training, on l samples
+ */
+
+static void benchmarkFeatureMaps(int l, int dim, double gamma){
+    svm_problem prob;
+    svm_problem test;
+    if (makeTestProblem(l, dim, 2, 81, &prob) || makeTestProblem(5000, dim, 2, 82, &test)) {
+        return;
+    }
+    double seconds;
+    double accuracy=exactAccuracy(&prob, &test, gamma, &seconds);
+    printf("  %d x %d, exact RBF: accuracy %.4f, %.2f s\n", l, dim, accuracy, seconds);
+    for (int type=SVM_FEATURE_MAP_RFF; type <= SVM_FEATURE_MAP_NYSTROEM; type++) {
+        for (int dimension=32; dimension <= 512; dimension*=4) {
+            accuracy=mappedAccuracy(&prob, &test, type, dimension, gamma, &seconds);
+            printf("  %s %4d: accuracy %.4f, %.2f s\n", type == SVM_FEATURE_MAP_RFF ? "RFF     " : "Nystroem", dimension, accuracy, seconds);
+        }
+    }
+    freeTestProblem(&prob);
+    freeTestProblem(&test);
+}
+
+void testFeatureMap(void){
+    const int dim=4;
+    const double gamma=0.5;
+    svm_problem small;
+    if (!SVMCheck(makeTestProblem(60, dim, 2, 71, &small) == 0)) {
+        return;
+    }
+    
+    SVMFeatureMap *map=NULL;
+    double maxError;
+    double meanError;
+    if (SVMCheck(makeFeatureMap(&small, SVM_FEATURE_MAP_NYSTROEM, small.l, gamma, 1, 1, &map) == 0)) { // every sample is a landmark
+        kernelError(map, &small, gamma, &maxError, &meanError);
+        SVMCheck(maxError<1e-6);
+        SVMCheck(sameDenseFeatures(map, &small, dim));
+        freeFeatureMap(map);
+    }
+    double lastError=INFINITY;
+    for (int dimension=64; dimension <= 4096; dimension*=8) {
+        if (SVMCheck(makeFeatureMap(&small, SVM_FEATURE_MAP_RFF, dimension, gamma, 1, 1, &map) == 0)) {
+            kernelError(map, &small, gamma, &maxError, &meanError);
+            SVMCheck(meanError<lastError);
+            lastError=meanError;
+            if (dimension == 64) {
+                SVMCheck(sameDenseFeatures(map, &small, dim));
+            }
+            freeFeatureMap(map);
+        }
+    }
+    SVMCheck(lastError<0.02);
+    freeTestProblem(&small);
+    
+    svm_problem prob;
+    svm_problem test;
+    if (SVMCheck(makeTestProblem(1000, dim, 2, 72, &prob) == 0 && makeTestProblem(2000, dim, 2, 73, &test) == 0)) {
+        double seconds;
+        double exact=exactAccuracy(&prob, &test, gamma, &seconds);
+        SVMCheck(mappedAccuracy(&prob, &test, SVM_FEATURE_MAP_RFF, 256, gamma, &seconds) >= exact-0.03);
+        SVMCheck(mappedAccuracy(&prob, &test, SVM_FEATURE_MAP_NYSTROEM, 256, gamma, &seconds) >= exact-0.03);
+        freeTestProblem(&prob);
+        freeTestProblem(&test);
+    }
+    
+    if (svmBenchmark()) {
+        benchmarkFeatureMaps(10000, dim, gamma);
+    }
+}
@@ -0,0 +1,230 @@
+/*	TestLinear.cpp -- checks the dual coordinate descent solvers of SVMLinear.cpp against svm_train()
+
+	On linearly separable data with label noise, linearTrain() has to find the solution of the LINEAR SMO solver
+	of libSVM up to its stopping tolerance: about the same primal objective (the bias is regularized in DCD,
+	so it can't be lower than the one of SMO), the same held out accuracy or error, and mostly the same
+	predictions. Multi-class models have to be the same for any number of threads.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "SVMTests.h"
+#include "SVMTraining.h"
+#include "SVMLinear.h"
+
+/*
+ helper function, replaces the labels of prob by a linear function of the first three features: -1/1 for two classes, thirds of its range for three classes, the value itself (plus noise) for regression. 5% of the class labels are flipped.
+ */
+
+static void linearLabels(svm_problem *prob, int classes, unsigned int seed){
+    uint64_t state=0xD1B54A32D192ED03ull^seed;
+    for (int i=0; i<prob->l; i++) {
+        const svm_node *x=prob->x[i];
+        double f=x[0].value+0.5*x[1].value-0.3*x[2].value;
+        double noise=testRandom(&state);
+        if (classes == 0) {
+            prob->y[i]=f+0.1*(noise-0.5);
+        }
+        else if (classes == 2) {
+            prob->y[i]=(f>0) == (noise<0.95) ? 1 : -1;
+        }
+        else{
+            int c=f<-0.4 ? 0 : (f<0.4 ? 1 : 2);
+            prob->y[i]=noise<0.95 ? c+1 : (c+1)%3+1;
+        }
+    }
+}
+
+/*
+ helper function, w·x-rho of a binary LINEAR model, the decision value svm_predict_values() computes
+ */
+
+static double decisionValue(const svm_model *model, const svm_node *x){
+    double value=-model->rho[0];
+    for (int s=0; s<model->l; s++) {
+        double dot=0;
+        for (const svm_node *a=model->SV[s], *b=x; a->index != -1 && b->index != -1;) {
+            if (a->index == b->index) {
+                dot+=(a++)->value*(b++)->value;
+            }
+            else if (a->index<b->index) {
+                a++;
+            }
+            else{
+                b++;
+            }
+        }
+        value+=model->sv_coef[0][s]*dot;
+    }
+    return value;
+}
+
+/*
+ helper function, primal objective of a binary C_SVC model with the hinge loss, as SMO minimizes it: 0.5*|w|^2 + C*sum(max(0, 1-y*f(x))), the bias not regularized
+ */
+
+static double primalObjective(const svm_model *model, const svm_problem *prob, double C){
+    double ww=0;
+    for (int s=0; s<model->l; s++) { // |w|^2 = sum over pairs coef_s*coef_t*x_s·x_t = sum coef_s*(f(x_s)+rho)
+        ww+=model->sv_coef[0][s]*(decisionValue(model, model->SV[s])+model->rho[0]);
+    }
+    double sign=model->label[0] == 1 ? 1 : -1; // positive decision values are label[0]
+    double loss=0;
+    for (int i=0; i<prob->l; i++) {
+        double margin=1-prob->y[i]*sign*decisionValue(model, prob->x[i]);
+        loss+=margin>0 ? margin : 0;
+    }
+    return 0.5*ww+C*loss;
+}
+
+/*
+ helper function, fraction of the samples of test predicted correctly, or the mean squared error for regression. agreement receives the fraction of samples that both models predict the same (classification only).
+ */
+
+static double score(const svm_model *model, const svm_model *reference, const svm_problem *test, double *agreement){
+    double sum=0;
+    int same=0;
+    for (int i=0; i<test->l; i++) {
+        double predicted=svm_predict(model, test->x[i]);
+        if (model->param.svm_type == EPSILON_SVR) {
+            sum+=(predicted-test->y[i])*(predicted-test->y[i]);
+        }
+        else{
+            sum+=predicted == test->y[i];
+            same+=predicted == svm_predict(reference, test->x[i]);
+        }
+    }
+    *agreement=(double)same/test->l;
+    return sum/test->l;
+}
+
+/*
+ helper function, trains prob with svm_train() and linearTrain() with loss and compares them on test
+ */
+
+static void checkSolver(const svm_problem *prob, const svm_problem *test, int svm_type, int loss){
+    svm_parameter param;
+    testParameter(svm_type, LINEAR, 1, &param);
+    svm_model *smo=svm_train(prob, &param);
+    param.eps=SVM_LINEAR_EPS;
+    svm_model *dcd=linearTrain(prob, &param, loss, 1);
+    if (!SVMCheck(smo != NULL && dcd != NULL)) {
+        svm_free_and_destroy_model(&smo);
+        svm_free_and_destroy_model(&dcd);
+        return;
+    }
+    SVMCheck(dcd->param.kernel_type == LINEAR && dcd->nr_class == smo->nr_class);
+    
+    double agreement;
+    double smoScore=score(smo, smo, test, &agreement);
+    double dcdScore=score(dcd, smo, test, &agreement);
+    if (svm_type == EPSILON_SVR) {
+        double mean=0;
+        double variance=0;
+        for (int i=0; i<test->l; i++) {
+            mean+=test->y[i]/test->l;
+        }
+        for (int i=0; i<test->l; i++) {
+            variance+=(test->y[i]-mean)*(test->y[i]-mean)/test->l;
+        }
+        SVMCheck(dcdScore <= smoScore+0.01*variance); // mean squared errors, DCD stops earlier and regularizes the bias
+    }
+    else{
+        SVMCheck(fabs(dcdScore-smoScore) <= 0.02); // accuracy
+        SVMCheck(agreement >= 0.95);
+    }
+    if (svm_type == C_SVC && smo->nr_class == 2 && loss == SVM_LINEAR_L1LOSS) {
+        double smoObjective=primalObjective(smo, prob, param.C);
+        double dcdObjective=primalObjective(dcd, prob, param.C);
+        SVMCheck(dcdObjective >= smoObjective*(1-1e-3) && dcdObjective <= smoObjective*1.05);
+    }
+    svm_free_and_destroy_model(&smo);
+    svm_free_and_destroy_model(&dcd);
+}
+
+/*
+ helper function, whether two models have the same support vectors, coefficients and rho
+ */
+
+static int sameSolution(const svm_model *a, const svm_model *b){
+    if (a->l != b->l || a->nr_class != b->nr_class) {
+        return 0;
+    }
+    for (int p=0; p<a->nr_class*(a->nr_class-1)/2; p++) {
+        if (a->rho[p] != b->rho[p]) {
+            return 0;
+        }
+    }
+    for (int s=0; s<a->l; s++) {
+        if (a->SV[s] != b->SV[s]) {
+            return 0;
+        }
+        for (int k=0; k<a->nr_class-1; k++) {
+            if (a->sv_coef[k][s] != b->sv_coef[k][s]) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/*
+ helper function, times svm_train() against linearTrain() on l samples of dim features
+ */
+
+static void benchmarkLinear(int l, int dim){
+    svm_problem prob;
+    if (makeTestProblem(l, dim, 2, 41, &prob)) {
+        return;
+    }
+    linearLabels(&prob, 2, 41);
+    svm_parameter param;
+    testParameter(C_SVC, LINEAR, dim, &param);
+    double start=svmSeconds();
+    svm_model *smo=svm_train(&prob, &param);
+    double smoTime=svmSeconds()-start;
+    param.eps=SVM_LINEAR_EPS;
+    start=svmSeconds();
+    svm_model *dcd=linearTrain(&prob, &param, SVM_LINEAR_L1LOSS, 1);
+    double dcdTime=svmSeconds()-start;
+    printf("  %d x %d, LINEAR C_SVC: svm_train %.2f s, linearTrain %.3f s\n", l, dim, smoTime, dcdTime);
+    svm_free_and_destroy_model(&smo);
+    svm_free_and_destroy_model(&dcd);
+    freeTestProblem(&prob);
+}
+
+void testLinear(void){
+    const int classes[]={2, 3, 0};
+    for (int c=0; c<3; c++) {
+        svm_problem prob;
+        svm_problem test;
+        if (!SVMCheck(makeTestProblem(1000, 10, classes[c], 51+c, &prob) == 0 && makeTestProblem(2000, 10, classes[c], 61+c, &test) == 0)) {
+            return;
+        }
+        linearLabels(&prob, classes[c], 51+c);
+        linearLabels(&test, classes[c], 61+c);
+        
+        int svm_type=classes[c] ? C_SVC : EPSILON_SVR;
+        checkSolver(&prob, &test, svm_type, SVM_LINEAR_L1LOSS);
+        checkSolver(&prob, &test, svm_type, SVM_LINEAR_L2LOSS);
+        
+        if (classes[c] == 3) {
+            svm_parameter param;
+            testParameter(C_SVC, LINEAR, 1, &param);
+            param.eps=SVM_LINEAR_EPS;
+            svm_model *single=linearTrain(&prob, &param, SVM_LINEAR_L1LOSS, 1);
+            svm_model *threaded=linearTrain(&prob, &param, SVM_LINEAR_L1LOSS, 3);
+            SVMCheck(single != NULL && threaded != NULL && sameSolution(single, threaded));
+            svm_free_and_destroy_model(&single);
+            svm_free_and_destroy_model(&threaded);
+        }
+        freeTestProblem(&prob);
+        freeTestProblem(&test);
+    }
+    
+    if (svmBenchmark()) {
+        benchmarkLinear(20000, 50);
+    }
+}
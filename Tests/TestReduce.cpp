@@ -0,0 +1,199 @@
+/*	TestReduce.cpp -- checks the reduced-set models of SVMReduce.cpp against the original models
+
+	Keeping every support vector has to give back the decision functions of the model. With fewer, the change of
+	the decision values at the support vectors has to be what reduceModel() reports, an error bound has to be
+	met, and the reduced model has to survive svm_save_model() and svm_load_model() like any other model.
+	reductionReport() has to agree with predictions counted here.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "SVMTests.h"
+#include "SVMReduce.h"
+
+#define REDUCED_PATH "SVMTests_reduced.txt"
+
+/*
+ helper function, largest change of the decision values from original to reduced at the support vectors of original, the error reduceModel() reports
+ */
+
+static double supportVectorError(const svm_model *reduced, const svm_model *original){
+    const int pairs=original->nr_class>1 ? original->nr_class*(original->nr_class-1)/2 : 1;
+    double *decReduced=Malloc(double, pairs);
+    double *decOriginal=Malloc(double, pairs);
+    double largest=decReduced != NULL && decOriginal != NULL ? 0 : INFINITY;
+    for (int s=0; s<original->l && decReduced != NULL && decOriginal != NULL; s++) {
+        svm_predict_values(reduced, original->SV[s], decReduced);
+        svm_predict_values(original, original->SV[s], decOriginal);
+        for (int p=0; p<pairs; p++) {
+            double change=fabs(decReduced[p]-decOriginal[p]);
+            largest=change>largest ? change : largest;
+        }
+    }
+    free(decReduced);
+    free(decOriginal);
+    return largest;
+}
+
+/*
+ helper function, % of the samples of test both models predict differently, or the mean squared difference of the predictions for regression, as reductionReport() compares them
+ */
+
+static double predictionDifference(const svm_model *a, const svm_model *b, const svm_problem *test){
+    const int regression=a->param.svm_type == EPSILON_SVR || a->param.svm_type == NU_SVR;
+    double difference=0;
+    for (int i=0; i<test->l; i++) {
+        double predictedA=svm_predict(a, test->x[i]);
+        double predictedB=svm_predict(b, test->x[i]);
+        difference+=regression ? (predictedA-predictedB)*(predictedA-predictedB) : predictedA != predictedB;
+    }
+    return difference*(regression ? 1.0 : 100.0)/test->l;
+}
+
+/*
+ helper function, the samples of test as column-major double matrix, the layout of an Igor wave, for reductionReport()
+ */
+
+static double *sampleBlock(const svm_problem *test, int dim, SVMDataBlock *block){
+    double *data=(double *)calloc((size_t)test->l*dim, sizeof(double));
+    if (data == NULL) {
+        return NULL;
+    }
+    for (int i=0; i<test->l; i++) {
+        for (const svm_node *x=test->x[i]; x->index != -1; x++) {
+            data[i+(size_t)(x->index-1)*test->l]=x->value;
+        }
+    }
+    block->data=data;
+    block->type=SVM_DATA_FLOAT64;
+    block->complexStride=1;
+    block->rows=test->l;
+    block->columns=dim;
+    block->rowStride=1;
+    block->columnStride=test->l;
+    return data;
+}
+
+/*
+ helper function, reduces a model of prob (svm_type, RBF) to all, half and a tenth of its support vectors and within an error bound, and compares each with the model
+ */
+
+static void checkReduction(const svm_problem *prob, const svm_problem *test, int dim, int svm_type){
+    svm_parameter param;
+    testParameter(svm_type, RBF, dim, &param);
+    svm_model *model=svm_train(prob, &param);
+    if (!SVMCheck(model != NULL && model->l>20)) {
+        svm_free_and_destroy_model(&model);
+        return;
+    }
+    
+    svm_model *reduced=NULL;
+    double maxError=0;
+    if (SVMCheck(reduceModel(model, model->l, 0, 1, &reduced, &maxError) == 0)) { // all support vectors: the projection is the model itself
+        SVMCheck(reduced->l == model->l && maxError<1e-6);
+        SVMCheck(predictionDifference(reduced, model, test)<1e-12);
+        svm_free_and_destroy_model(&reduced);
+    }
+    
+    double lastError=0;
+    for (int divisor=2; divisor <= 10; divisor+=8) {
+        int target=model->l/divisor;
+        if (!SVMCheck(reduceModel(model, target, 0, 2, &reduced, &maxError) == 0)) {
+            continue;
+        }
+        SVMCheck(reduced->l == target && reduced->free_sv);
+        SVMCheck(fabs(supportVectorError(reduced, model)-maxError) <= 1e-9*(1+maxError));
+        SVMCheck(maxError >= lastError);
+        lastError=maxError;
+        
+        if (divisor == 2) {
+            SVMCheck(svm_save_model(REDUCED_PATH, reduced) == 0);
+            svm_model *loaded=svm_load_model(REDUCED_PATH);
+            if (SVMCheck(loaded != NULL)) {
+                SVMCheck(loaded->l == reduced->l && predictionDifference(loaded, reduced, test) <= (svm_type == EPSILON_SVR ? 1e-10 : 0.5)); // the text format rounds the support vectors to 8 digits
+                svm_free_and_destroy_model(&loaded);
+            }
+            remove(REDUCED_PATH);
+            
+            SVMDataBlock block;
+            SVMReductionReport report;
+            double *data=sampleBlock(test, dim, &block);
+            if (SVMCheck(data != NULL && reductionReport(reduced, model, &block, 2, &report) == 0)) {
+                SVMCheck(fabs(report.difference-predictionDifference(reduced, model, test)) <= 1e-9*(1+report.difference));
+            }
+            free(data);
+        }
+        svm_free_and_destroy_model(&reduced);
+    }
+    
+    double bound=lastError/2; // between the errors of a tenth and all support vectors
+    if (SVMCheck(reduceModel(model, 0, bound, 1, &reduced, &maxError) == 0)) {
+        SVMCheck(maxError <= bound && reduced->l<model->l);
+        SVMCheck(supportVectorError(reduced, model) <= bound*(1+1e-9));
+        svm_free_and_destroy_model(&reduced);
+    }
+    svm_free_and_destroy_model(&model);
+}
+
+/*
+ helper function, speed against agreement of reduced models of a noisy problem with many support vectors
+ */
+
+static void benchmarkReduction(int l, int dim){
+    svm_problem prob;
+    svm_problem test;
+    if (makeTestProblem(l, dim, 2, 111, &prob) || makeTestProblem(20000, dim, 2, 112, &test)) {
+        return;
+    }
+    uint64_t state=113;
+    for (int i=0; i<l; i++) { // 10% label noise, most samples end up as support vectors
+        if (testRandom(&state)<0.1) {
+            prob.y[i]=-prob.y[i];
+        }
+    }
+    svm_parameter param;
+    testParameter(C_SVC, RBF, dim, &param);
+    svm_model *model=svm_train(&prob, &param);
+    double *data=NULL;
+    SVMDataBlock block;
+    if (model != NULL && (data=sampleBlock(&test, dim, &block)) != NULL) {
+        printf("  %d x %d with 10%% label noise: %d SVs\n", l, dim, model->l);
+        const int percents[]={5, 10, 25, 50};
+        for (int k=0; k<4; k++) {
+            const int percent=percents[k];
+            svm_model *reduced=NULL;
+            double maxError;
+            SVMReductionReport report;
+            if (reduceModel(model, model->l*percent/100, 0, 0, &reduced, &maxError) == 0 && reductionReport(reduced, model, &block, 1, &report) == 0) {
+                printf("  %2d%% of the SVs: %.1f times faster, %.2f%% predicted differently\n", percent, report.originalSeconds/report.reducedSeconds, report.difference);
+            }
+            svm_free_and_destroy_model(&reduced);
+        }
+    }
+    free(data);
+    svm_free_and_destroy_model(&model);
+    freeTestProblem(&prob);
+    freeTestProblem(&test);
+}
+
+void testReduce(void){
+    const int dim=5;
+    const int classes[]={2, 3, 0};
+    const int types[]={C_SVC, C_SVC, EPSILON_SVR};
+    for (int c=0; c<3; c++) {
+        svm_problem prob;
+        svm_problem test;
+        if (!SVMCheck(makeTestProblem(600, dim, classes[c], 101+c, &prob) == 0 && makeTestProblem(1000, dim, classes[c], 104+c, &test) == 0)) {
+            return;
+        }
+        checkReduction(&prob, &test, dim, types[c]);
+        freeTestProblem(&prob);
+        freeTestProblem(&test);
+    }
+    
+    if (svmBenchmark()) {
+        benchmarkReduction(5000, 10);
+    }
+}
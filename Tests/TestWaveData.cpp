@@ -0,0 +1,230 @@
+/*	TestWaveData.cpp -- checks the block conversions of SVMWaveData.h
+
+	The reference reads one point at a time through a switch on the numeric type, as the conversion did with
+	MDGetNumericWavePointValue before. Every numeric type, complex data, transposed strides, sparse nodes and
+	conversions that start in the middle of the block have to give exactly the same values.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SVMTests.h"
+#include "SVMWaveData.h"
+
+static const size_t typeSizes[]={4, 8, 1, 1, 2, 2, 4, 4, 8, 8};
+
+/*
+ helper function, point (row, column) of block, read and converted one at a time
+ */
+
+static double referenceValue(const SVMDataBlock &block, size_t row, size_t column){
+    size_t offset=(row*block.rowStride+column*block.columnStride)*block.complexStride;
+    switch (block.type) {
+        case SVM_DATA_FLOAT32: return ((const float *)block.data)[offset];
+        case SVM_DATA_FLOAT64: return ((const double *)block.data)[offset];
+        case SVM_DATA_INT8: return ((const int8_t *)block.data)[offset];
+        case SVM_DATA_UINT8: return ((const uint8_t *)block.data)[offset];
+        case SVM_DATA_INT16: return ((const int16_t *)block.data)[offset];
+        case SVM_DATA_UINT16: return ((const uint16_t *)block.data)[offset];
+        case SVM_DATA_INT32: return ((const int32_t *)block.data)[offset];
+        case SVM_DATA_UINT32: return ((const uint32_t *)block.data)[offset];
+        case SVM_DATA_INT64: return (double)((const int64_t *)block.data)[offset];
+        case SVM_DATA_UINT64: return (double)((const uint64_t *)block.data)[offset];
+        default: return 0;
+    }
+}
+
+/*
+ helper function, writes value at point offset of a block of type
+ */
+
+static void storeValue(void *data, int type, size_t offset, int value){
+    switch (type) {
+        case SVM_DATA_FLOAT32: ((float *)data)[offset]=(float)value*0.25f; break;
+        case SVM_DATA_FLOAT64: ((double *)data)[offset]=value*0.25; break;
+        case SVM_DATA_INT8: ((int8_t *)data)[offset]=(int8_t)value; break;
+        case SVM_DATA_UINT8: ((uint8_t *)data)[offset]=(uint8_t)(value+100); break;
+        case SVM_DATA_INT16: ((int16_t *)data)[offset]=(int16_t)(value*100); break;
+        case SVM_DATA_UINT16: ((uint16_t *)data)[offset]=(uint16_t)(value+100); break;
+        case SVM_DATA_INT32: ((int32_t *)data)[offset]=value*10000; break;
+        case SVM_DATA_UINT32: ((uint32_t *)data)[offset]=(uint32_t)(value+100); break;
+        case SVM_DATA_INT64: ((int64_t *)data)[offset]=(int64_t)value*((int64_t)1<<40); break;
+        case SVM_DATA_UINT64: ((uint64_t *)data)[offset]=(uint64_t)(value+100); break;
+    }
+}
+
+/*
+ helper function, a rows x columns block of type with small values, a third of them 0. transposed stores it row-major, complexStride 2 fills the imaginary parts with garbage.
+ */
+
+static void *makeBlock(int type, size_t rows, int columns, int transposed, int complexStride, SVMDataBlock *block){
+    void *data=calloc(rows*columns*complexStride, typeSizes[type]);
+    if (data == NULL) {
+        return NULL;
+    }
+    block->data=data;
+    block->type=type;
+    block->complexStride=complexStride;
+    block->rows=rows;
+    block->columns=columns;
+    block->rowStride=transposed ? (size_t)columns : 1;
+    block->columnStride=transposed ? 1 : rows;
+    
+    uint64_t state=12345+type;
+    for (size_t i=0; i<rows; i++) {
+        for (int j=0; j<columns; j++) {
+            size_t offset=(i*block->rowStride+j*block->columnStride)*complexStride;
+            int value=testRandom(&state)<1.0/3 ? 0 : (int)(testRandom(&state)*200)-100;
+            storeValue(data, type, offset, value);
+            if (complexStride == 2) {
+                storeValue(data, type, offset+1, 77);
+            }
+        }
+    }
+    return data;
+}
+
+/*
+ helper function, converts the rows of block in pieces starting at odd rows and compares every node, the labels and the row-major matrix with referenceValue()
+ */
+
+static void checkDense(const SVMDataBlock &block){
+    const size_t rowLength=(size_t)block.columns+1;
+    svm_node *nodes=Malloc(svm_node, block.rows*rowLength);
+    double *values=Malloc(double, block.rows*block.columns);
+    double *labels=Malloc(double, block.rows);
+    if (!SVMCheck(nodes != NULL && values != NULL && labels != NULL)) {
+        free(nodes);
+        free(values);
+        free(labels);
+        return;
+    }
+    
+    for (size_t first=0; first<block.rows; first+=37) {
+        size_t count=block.rows-first<37 ? block.rows-first : 37;
+        SVMCheck(SVMBlockToNodes(block, first, count, nodes+first*rowLength) == 0);
+        SVMCheck(SVMBlockToMatrix(block, first, count, values+first*block.columns) == 0);
+        SVMCheck(SVMBlockToDoubles(block, first, count, labels+first) == 0);
+    }
+    
+    int same=1;
+    for (size_t i=0; i<block.rows; i++) {
+        for (int j=0; j<block.columns; j++) {
+            double value=referenceValue(block, i, j);
+            same&=nodes[i*rowLength+j].index == j+1 && nodes[i*rowLength+j].value == value && values[i*block.columns+j] == value;
+        }
+        same&=nodes[i*rowLength+block.columns].index == -1 && labels[i] == referenceValue(block, i, 0);
+    }
+    SVMCheck(same);
+    
+    free(nodes);
+    free(values);
+    free(labels);
+}
+
+/*
+ helper function, sparse nodes of all rows with |value| > threshold against referenceValue()
+ */
+
+static void checkSparse(const SVMDataBlock &block, double threshold){
+    size_t *counts=Malloc(size_t, block.rows);
+    svm_node **cursor=Malloc(svm_node *, block.rows);
+    svm_node *nodes=Malloc(svm_node, block.rows*((size_t)block.columns+1));
+    if (!SVMCheck(counts != NULL && cursor != NULL && nodes != NULL)) {
+        free(counts);
+        free(cursor);
+        free(nodes);
+        return;
+    }
+    
+    SVMCheck(SVMBlockCountNonZero(block, 0, block.rows, threshold, counts) == 0);
+    svm_node *next=nodes;
+    for (size_t i=0; i<block.rows; i++) {
+        cursor[i]=next;
+        next+=counts[i]+1;
+    }
+    SVMCheck(SVMBlockToSparseNodes(block, 0, block.rows, threshold, cursor) == 0);
+    
+    int same=1;
+    svm_node *node=nodes;
+    for (size_t i=0; i<block.rows; i++) {
+        size_t count=0;
+        for (int j=0; j<block.columns; j++) {
+            double value=referenceValue(block, i, j);
+            if (value>threshold || value<-threshold) {
+                same&=node->index == j+1 && node->value == value;
+                node++;
+                count++;
+            }
+        }
+        same&=count == counts[i] && node->index == -1 && cursor[i] == node;
+        node++;
+    }
+    SVMCheck(same);
+    
+    free(counts);
+    free(cursor);
+    free(nodes);
+}
+
+/*
+ helper function, times the per point reference against SVMBlockToNodes() for a samples x features single precision matrix
+ */
+
+static void benchmarkConversion(size_t rows, int columns){
+    SVMDataBlock block;
+    void *data=makeBlock(SVM_DATA_FLOAT32, rows, columns, 0, 1, &block);
+    svm_node *nodes=Malloc(svm_node, rows*((size_t)columns+1));
+    if (data == NULL || nodes == NULL) {
+        free(data);
+        free(nodes);
+        return;
+    }
+    
+    double start=svmSeconds();
+    for (size_t i=0; i<rows; i++) {
+        svm_node *row=nodes+i*(columns+1);
+        for (int j=0; j<columns; j++) {
+            row[j].index=j+1;
+            row[j].value=referenceValue(block, i, j);
+        }
+        row[columns].index=-1;
+    }
+    double reference=svmSeconds()-start;
+    
+    start=svmSeconds();
+    SVMBlockToNodes(block, 0, rows, nodes);
+    double blocked=svmSeconds()-start;
+    
+    double points=(double)rows*columns;
+    printf("  %zu x %d FP32: per point %.1f Mpoints/s, SVMBlockToNodes %.1f Mpoints/s\n", rows, columns, points/reference*1e-6, points/blocked*1e-6);
+    free(data);
+    free(nodes);
+}
+
+void testWaveData(void){
+    for (int type=SVM_DATA_FLOAT32; type<SVM_DATA_UNSUPPORTED; type++) {
+        for (int layout=0; layout<3; layout++) { // column-major, row-major, complex
+            SVMDataBlock block;
+            void *data=makeBlock(type, 301, layout == 0 ? 7 : 130, layout == 1, layout == 2 ? 2 : 1, &block);
+            if (!SVMCheck(data != NULL)) {
+                continue;
+            }
+            checkDense(block);
+            checkSparse(block, 0);
+            checkSparse(block, referenceValue(block, 0, 0) > 0 ? referenceValue(block, 0, 0) : 1);
+            free(data);
+        }
+    }
+    
+    SVMDataBlock unsupported;
+    memset(&unsupported, 0, sizeof(unsupported));
+    unsupported.type=SVM_DATA_UNSUPPORTED;
+    svm_node node;
+    SVMCheck(SVMBlockToNodes(unsupported, 0, 0, &node) == -1);
+    
+    if (svmBenchmark()) {
+        benchmarkConversion(20000, 500);
+        benchmarkConversion(200000, 20);
+    }
+}
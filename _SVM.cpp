@@ -2,15 +2,48 @@
 */
 
 #include "XOPStandardHeaders.h"			// Include ANSI headers, Mac headers, IgorXOP.h, XOP.h and XOPSupport.h
+#include <algorithm>
 #include "_SVM.h"
 #include "libSVM/svm.h"
+#include "SVMWaveData.h"
+#include "SVMPredict.h"
+#include "SVMModels.h"
+#include "SVMThreads.h"
+#include "SVMBatch.h"
+#include "SVMTraining.h"
+#include "SVMCascade.h"
+#include "SVMWarmStart.h"
+#include "SVMKernel.h"
+#include "SVMLinear.h"
+#include "SVMFeatureMap.h"
+#include "SVMDense.h"
+#include "SVMQuantize.h"
+#include "SVMReduce.h"
+#include "SVMDataFile.h"
 
 #define Malloc(type,n) (type *)malloc((n)*sizeof(type)) //from libSVM
 
 // Helper Function Definitions
-svm_problem makeProblem(waveHndl inputWave, waveHndl inputClasses, svm_node *buffer);
+int dataTypeFromNumType(int numType);
+int getDataBlock(waveHndl wave, SVMDataBlock *block);
+int makeNodes(const SVMDataBlock *data, int sparse, double threshold, svm_node **buffer, svm_node **x);
+int makeTripletNodes(waveHndl rowWave, waveHndl columnWave, waveHndl valueWave, int sparse, double threshold, size_t *numRows, svm_node **buffer, svm_node ***x);
+int makeProblem(const SVMDataBlock *data, const SVMDataBlock *classes, int sparse, double threshold, svm_node **buffer, svm_problem *problem);
+int makePrecomputedNodes(const SVMDataBlock *data, svm_node **buffer, svm_node **x);
+static int makeLabels(const SVMDataBlock *classes, svm_problem *problem);
+int kernelMatrixColumns(int kernel_type, waveHndl inputWave);
+int precomputedColumns(const svm_model *model);
+int makeTripletProblem(waveHndl rowWave, waveHndl columnWave, waveHndl valueWave, const SVMDataBlock *classes, int sparse, double threshold, svm_node **buffer, svm_problem *problem);
+int makeProblemFromWaves(waveHndl inputWave, waveHndl classWave, waveHndl rowWave, waveHndl columnWave, waveHndl valueWave, int kernelColumns, int sparse, double threshold, svm_node **buffer, svm_problem *problem);
+int makeDenseProblemFromWaves(waveHndl inputWave, waveHndl classWave, SVMDenseSamples *samples, svm_problem *problem);
+int getDataFilePath(Handle fileName, char *fullPath);
+int makeProblemFromFile(const char *path, int raw, int rawType, int rawColumns, waveHndl classWave, int precomputed, int sparse, double threshold, int numThreads, SVMDenseSamples *denseSamples, svm_node **buffer, svm_problem *problem);
 void addWeights(waveHndl weights, struct svm_parameter *params);
-double classifyNodes(svm_node *nodes, svm_model *model,int predict_probability, double *prob_estimates, int calculateDecisionValues, double* decisionValues);
+int getModelPath(int pathEncountered, const char *pathName, Handle modelName, char *fullPath);
+double classifyNodes(const svm_node *nodes, svm_model *model,int predict_probability, double *prob_estimates, int calculateDecisionValues, double* decisionValues, double *probScratch);
+void copyImageScaling(waveHndl stack, waveHndl image);
+
+static void print_null(const char *){} // libSVM must not call into Igor from a worker thread
 
 static void print_string_Igor(const char *s){ // optional output funtion for libSVM to report progress, prints to Igor Pro's Console
     XOPNotice(s);
@@ -19,7 +52,7 @@ static void print_string_Igor(const char *s){ // optional output funtion for lib
 
 
 
-// Operation template: SVMTrain /TYPE=number:svm_type /K=number:kernel_type /D=number:degree /Y=number:gamma /CF=number:coef0 /C=number:C /NU=number:nu /SHRINK /PROB outputPath=name:outPutPath, inputWave=wave:inPutWave, inputClasses=wave:inputClasses
+// Operation template: SVMTrain /TYPE=number:svm_type /K=number:kernel_type /D=number:degree /Y=number:gamma /CF=number:coef0 /C=number:C /NU=number:nu /SHRINK /PROB /SPARSE[=number:sparseThreshold] /KEEP /BIN /THREADS[=number:numThreads] /CACHE=number:cacheSize /SEED=number:seed /GRAM[=number:gramMemory] /HOLDOUT={wave:holdoutWave, wave:holdoutClasses} /LINEAR[=number:linearLoss] /APPROX={number:approxType, number:approxDim} /CASCADE[=number:partitions] /FEEDBACK[=number:feedbackPasses] /COMPARE /WARM=number:warmModelID /DENSE /RAW={number:rawType, number:rawColumns} outputPath=name:outPutPath, inputWave=wave:inPutWave, inputClasses=wave:inputClasses, sparseInput={wave:rowWave, wave:columnWave, wave:valueWave}, inputFile=string:inputFile
 
 // Runtime param structure for SVMTrain operation.
 #pragma pack(2)    // All structures passed to Igor are two-byte aligned.
@@ -89,6 +122,83 @@ struct SVMTrainRuntimeParams {
     int PROBFlagEncountered;
     // There are no fields for this group because it has no parameters.
     
+    // Parameters for /SPARSE flag group. skip points with |value| <= threshold (default 0) when building the nodes.
+    int SPARSEFlagEncountered;
+    double sparseThreshold;                    // Optional parameter.
+    int SPARSEFlagParamsSet[1];
+    
+    // Parameters for /KEEP flag group. keep the trained model resident (V_SVMModelID), it is only saved if /P and modelName are given.
+    int KEEPFlagEncountered;
+    // There are no fields for this group because it has no parameters.
+    
+    // Parameters for /BIN flag group. save the model as binary model file (SVMBinaryModel.h), which loads without parsing.
+    int BINFlagEncountered;
+    // There are no fields for this group because it has no parameters.
+    
+    // Parameters for /THREADS flag group. train the cross validation folds or the one-vs-one problems on this many threads, one per core if no number is given; with more than one thread the kernel rows are computed on the threads left over, by the solver of SVMSolver.cpp instead of libSVM's (same models)
+    int THREADSFlagEncountered;
+    double numThreads;                    // Optional parameter.
+    int THREADSFlagParamsSet[1];
+    
+    // Parameters for /CACHE flag group. kernel cache in MB (cache_size in svm_parameter in svm.h), split between the threads
+    int CACHEFlagEncountered;
+    double cacheSize;
+    int CACHEFlagParamsSet[1];
+    
+    // Parameters for /SEED flag group. seed for the fold assignment of the cross validation and of the internal folds of probability models, the same seed gives the same folds
+    int SEEDFlagEncountered;
+    double seed;
+    int SEEDFlagParamsSet[1];
+    
+    // Parameters for /GRAM flag group. train with the kernel rows computed on the /THREADS threads and cached in gramMemory MB (1024 if no number is given), also on one thread; /V splits the cache between the folds
+    int GRAMFlagEncountered;
+    double gramMemory;                    // Optional parameter.
+    int GRAMFlagParamsSet[1];
+    
+    // Parameters for /HOLDOUT flag group. held out samples and their labels (same layout as inputWave and inputClasses), the probability model is fitted to them instead of an internal cross validation. Implies /PROB
+    int HOLDOUTFlagEncountered;
+    waveHndl holdoutWave;
+    waveHndl holdoutClasses;
+    int HOLDOUTFlagParamsSet[2];
+    
+    // Parameters for /LINEAR flag group. train /K=0 models of /TYPE=0 or 3 with the linear dual coordinate descent solver (SVMLinear.h), loss 1 (hinge) or 2 (squared hinge, if no number is given)
+    int LINEARFlagEncountered;
+    double linearLoss;                    // Optional parameter.
+    int LINEARFlagParamsSet[1];
+    
+    // Parameters for /APPROX flag group. train /K=2 models on an explicit feature map of approxDim dimensions that approximates the RBF kernel (SVMFeatureMap.h), approxType 1: random Fourier features, 2: Nyström. The map is saved with the model, /V builds the map of each fold from its training samples only
+    int APPROXFlagEncountered;
+    double approxType;
+    double approxDim;
+    int APPROXFlagParamsSet[2];
+    
+    // Parameters for /CASCADE flag group. train as a cascade (SVMCascade.h): sub-SVMs on partitions (8 if no number is given) trained concurrently, merged by their support vectors until one set is left
+    int CASCADEFlagEncountered;
+    double partitions;                    // Optional parameter.
+    int CASCADEFlagParamsSet[1];
+    
+    // Parameters for /FEEDBACK flag group. feed the support vectors of the cascade back to the partitions until they don't change, at most feedbackPasses times (3 if no number is given)
+    int FEEDBACKFlagEncountered;
+    double feedbackPasses;                    // Optional parameter.
+    int FEEDBACKFlagParamsSet[1];
+    
+    // Parameters for /COMPARE flag group. train directly (cold) as well and report how the /CASCADE model differs on the training samples, or how the objective of the /WARM model differs
+    int COMPAREFlagEncountered;
+    
+    // Parameters for /WARM flag group. start from the support vectors of the resident model warmModelID (SVMTrain /KEEP or SVMModelLoad) and add the samples that violate the optimality conditions (SVMWarmStart.h), /TYPE=0 or 3 only
+    int WARMFlagEncountered;
+    double warmModelID;
+    int WARMFlagParamsSet[1];
+    
+    // Parameters for /DENSE flag group. keep the samples as dense single precision matrix and train with kernel rows computed on it and cached in the /GRAM memory or /CACHE (SVMDense.h), nodes only for the support vectors
+    int DENSEFlagEncountered;
+    
+    // Parameters for /RAW flag group. inputFile is a raw binary matrix, rawColumns values of the Igor number type rawType per sample, instead of a text file in libSVM format
+    int RAWFlagEncountered;
+    double rawType;
+    double rawColumns;
+    int RAWFlagParamsSet[2];
+    
     // Main parameters.
     
     // Parameters for modelName keyword group. Filename of the mdoel outputfile, in combination with /p for the folder URL.
@@ -111,6 +221,18 @@ struct SVMTrainRuntimeParams {
     waveHndl inputWeights;
     int weightsParamsSet[1];
     
+    // Parameters for sparseInput keyword group. Inputdata as row/column/value triplets (zero based row and column), replaces inputWave
+    int sparseInputEncountered;
+    waveHndl rowWave;
+    waveHndl columnWave;
+    waveHndl valueWave;
+    int sparseInputParamsSet[3];
+    
+    // Parameters for inputFile keyword group. full path of a file with the samples (SVMDataFile.h), replaces inputWave: text in libSVM format with the labels, or a raw matrix (/RAW) with the labels in inputClasses. Only the nodes are held in memory, and the offset of each line of a text file (8 bytes per sample)
+    int inputFileEncountered;
+    Handle inputFile;
+    int inputFileParamsSet[1];
+    
     // These are postamble fields that Igor sets.
     int calledFromFunction;                    // 1 if called from a user function, 0 otherwise.
     int calledFromMacro;                    // 1 if called from a macro, 0 otherwise.
@@ -131,6 +253,7 @@ ExecuteSVMTrain(SVMTrainRuntimeParamsPtr p)
     params.eps=0.001; //standard values from libSVM (https://github.com/cjlin1/libsvm)
     char outPutPath[MAX_PATH_LEN+1]="model.svm"; //default file name
     int validationMode=0;
+    int saveModelFile=0;
     int err = 0;
     struct svm_problem problem={0};
     
@@ -202,11 +325,112 @@ ExecuteSVMTrain(SVMTrainRuntimeParamsPtr p)
     if (p->PROBFlagEncountered) {
         params.probability=1;
     }
+    
+    int heldOut=p->HOLDOUTFlagEncountered;
+    if (heldOut) { // probability model from held out samples
+        if (p->holdoutWave == NULL || p->holdoutClasses == NULL) {
+            return NULL_WAVE_OP;
+        }
+        if (params.svm_type == ONE_CLASS) { // no classes to fit a probability model to
+            return INCOMPATIBLE_FLAGS;
+        }
+        params.probability=1;
+    }
     if (p->VFlagEncountered) {
         // Parameter: p->numValidation
         validationMode=(int)p->numValidation;
     }
     
+    int numThreads=1;
+    if (p->THREADSFlagEncountered) {
+        numThreads=p->THREADSFlagParamsSet[0] ? (int)p->numThreads : 0; // 0: one thread per core
+    }
+    
+    if (p->CACHEFlagEncountered) {
+        if (p->cacheSize<1) {
+            return EXPECT_POS_NUM;
+        }
+        params.cache_size=p->cacheSize; // the total for all threads
+    }
+    
+    unsigned int seed=1;
+    if (p->SEEDFlagEncountered) {
+        seed=(unsigned int)p->seed;
+    }
+    
+    double gramMemory=0; // kernel rows in the /CACHE only
+    if (p->GRAMFlagEncountered) {
+        gramMemory=p->GRAMFlagParamsSet[0] ? p->gramMemory : SVM_GRAM_MEMORY;
+    }
+    
+    int linearLoss=0; // 0: svm_train()
+    if (p->LINEARFlagEncountered) { // linear solver, no kernel matrix or cache, the probability model only from held out samples
+        linearLoss=p->LINEARFlagParamsSet[0] ? (int)p->linearLoss : SVM_LINEAR_L2LOSS;
+        if ((linearLoss != SVM_LINEAR_L1LOSS && linearLoss != SVM_LINEAR_L2LOSS) || (params.kernel_type != LINEAR && !p->APPROXFlagEncountered) || (params.svm_type != C_SVC && params.svm_type != EPSILON_SVR) || (params.probability && !heldOut)) {
+            return INCOMPATIBLE_FLAGS;
+        }
+        if (!p->TERMFlagEncountered) {
+            params.eps=SVM_LINEAR_EPS;
+        }
+    }
+    
+    int approxType=0; // 0: the exact kernel
+    int approxDim=0;
+    if (p->APPROXFlagEncountered) { // RBF approximated by a feature map, trained with the linear solver (loss 2 unless /LINEAR says otherwise)
+        approxType=(int)p->approxType;
+        approxDim=(int)p->approxDim;
+        if ((approxType != SVM_FEATURE_MAP_RFF && approxType != SVM_FEATURE_MAP_NYSTROEM) || params.kernel_type != RBF || (params.svm_type != C_SVC && params.svm_type != EPSILON_SVR) || (params.probability && !heldOut)) {
+            return INCOMPATIBLE_FLAGS;
+        }
+        if (approxDim<1) {
+            return EXPECT_POS_NUM;
+        }
+        if (!linearLoss) {
+            linearLoss=SVM_LINEAR_L2LOSS;
+            if (!p->TERMFlagEncountered) {
+                params.eps=SVM_LINEAR_EPS;
+            }
+        }
+    }
+    
+    int partitions=0; // 0: no cascade
+    int feedbackPasses=0;
+    if (p->CASCADEFlagEncountered) { // the probability model only from held out samples, cross validation trains the folds directly
+        partitions=p->CASCADEFlagParamsSet[0] ? (int)p->partitions : SVM_CASCADE_PARTITIONS;
+        if (linearLoss || validationMode>0 || (params.probability && !heldOut)) {
+            return INCOMPATIBLE_FLAGS;
+        }
+        if (partitions<1) {
+            return EXPECT_POS_NUM;
+        }
+        if (p->FEEDBACKFlagEncountered) {
+            feedbackPasses=p->FEEDBACKFlagParamsSet[0] ? (int)p->feedbackPasses : SVM_CASCADE_FEEDBACK;
+        }
+    }
+    else if (p->FEEDBACKFlagEncountered || (p->COMPAREFlagEncountered && !p->WARMFlagEncountered)) {
+        return INCOMPATIBLE_FLAGS;
+    }
+    
+    struct svm_model *warmModel=NULL; // NULL: cold start
+    if (p->WARMFlagEncountered) { // seeded with the support vectors of a resident model, the probability model only from held out samples
+        warmModel=modelForID((int)p->warmModelID);
+        if (warmModel == NULL) {
+            return UNKNOWN_MODEL_ID;
+        }
+        if ((warmModel=nodeModelForID((int)p->warmModelID)) == NULL) { // the nodes of a quantized model are rebuilt
+            return NOMEM;
+        }
+        if (linearLoss || partitions || validationMode>0 || (params.svm_type != C_SVC && params.svm_type != EPSILON_SVR) || (params.probability && !heldOut)) {
+            return INCOMPATIBLE_FLAGS;
+        }
+    }
+    
+    int dense=p->DENSEFlagEncountered;
+    if (dense) { // the kernel rows are computed from the dense samples, only the solver of svm_train()
+        if (params.kernel_type == PRECOMPUTED || p->SPARSEFlagEncountered || linearLoss || partitions || warmModel != NULL) {
+            return INCOMPATIBLE_FLAGS;
+        }
+    }
     
     // Main parameters.
     
@@ -215,62 +439,118 @@ ExecuteSVMTrain(SVMTrainRuntimeParamsPtr p)
         char fileName[256];
         GetCStringFromHandle(p->modelName, fileName, sizeof(fileName));
         GetFullPathFromSymbolicPathAndFilePath(p->outputPath, fileName, outPutPath);
-        
+        saveModelFile=1;
     }
-    else if (validationMode<1){
-        if(XOPSaveFileDialog("Select where to save the model file", "", NULL, "", "svm", outPutPath) != 0){ // let the user select an output file
+    else if (validationMode<1 && !p->KEEPFlagEncountered){ // a resident model doesn't need a file
+        if(XOPSaveFileDialog("Select where to save the model file", "", NULL, "", p->BINFlagEncountered ? "svmb" : "svm", outPutPath) != 0){ // let the user select an output file
             return FILE_NOT_FOUND;
         }
+        saveModelFile=1;
     }
     
    
     
-    if (p->inputWaveEncountered && p->inPutWave != NULL) {
+    int sparse=0;
+    double sparseThreshold=0;
+    if (p->SPARSEFlagEncountered) { // drop points with |value| <= threshold from the nodes
+        sparse=1;
+        if (p->SPARSEFlagParamsSet[0]) {
+            sparseThreshold=fabs(p->sparseThreshold);
+        }
+    }
+    
+    int tripletInput=p->sparseInputEncountered && p->rowWave != NULL && p->columnWave != NULL && p->valueWave != NULL;
+    if (dense && tripletInput) {
+        return INCOMPATIBLE_FLAGS;
+    }
+    int fileInput=p->inputFileEncountered;
+    if ((fileInput && ((p->inputWaveEncountered && p->inPutWave != NULL) || tripletInput)) || (p->RAWFlagEncountered && !fileInput)) { // the samples come from one place
+        return INCOMPATIBLE_FLAGS;
+    }
+    
+    if ((p->inputWaveEncountered && p->inPutWave != NULL) || tripletInput || fileInput) {
         // Parameter: p->inPutWave (test for NULL handle before using)
-        if (p->inputClassesEncountered && p->inputClasses != NULL) {
+        if ((p->inputClassesEncountered && p->inputClasses != NULL) || (fileInput && !p->RAWFlagEncountered)) { // a text file brings its labels
             // Parameter: p->inputClasses (test for NULL handle before using)
             svm_set_print_string_function(&print_string_Igor); //use the Igor Console instead of StdOut
             
-            int numDimensionsInputWave;
-            int numDimensionsClassesWave;
-            
-            CountInt dimensionSizesClassesWave[MAX_DIMENSIONS+1];
-            CountInt dimensionSizesInputWave[MAX_DIMENSIONS+1];
+            struct svm_node *buffer=NULL; // holds all the sample data, allocated by makeProblemFromWaves
+            struct SVMDenseSamples denseSamples={0}; // with /DENSE the sample data instead, problem only holds the labels
             
-            int resultClassesWave=MDGetWaveDimensions(p->inPutWave, &numDimensionsInputWave, dimensionSizesInputWave);
-            int resultInPutWave=MDGetWaveDimensions(p->inputClasses, &numDimensionsClassesWave, dimensionSizesClassesWave);
-            
-            if (resultInPutWave || resultClassesWave){
-                return resultInPutWave; //probably needs a proper error code
+            if (fileInput) {
+                char inputPath[MAX_PATH_LEN+1];
+                if ((err=getDataFilePath(p->inputFile, inputPath)) == 0) {
+                    err=makeProblemFromFile(inputPath, p->RAWFlagEncountered, (int)p->rawType, (int)p->rawColumns, p->inputClassesEncountered ? p->inputClasses : NULL, params.kernel_type == PRECOMPUTED, sparse, sparseThreshold, numThreads, dense ? &denseSamples : NULL, &buffer, &problem);
+                }
             }
-            else if(numDimensionsInputWave<1){
-                return EXPECT_MATRIX;
+            else if (dense) {
+                err=makeDenseProblemFromWaves(p->inPutWave, p->inputClasses, &denseSamples, &problem);
             }
-            else if (dimensionSizesClassesWave[0] != dimensionSizesInputWave[0]){
-                return WAVE_LENGTH_MISMATCH;
+            else{
+                err=makeProblemFromWaves(tripletInput ? NULL : p->inPutWave, p->inputClasses, p->rowWave, p->columnWave, p->valueWave, kernelMatrixColumns(params.kernel_type, tripletInput ? NULL : p->inPutWave), sparse, sparseThreshold, &buffer, &problem);
             }
-            
-            else{ // above code checks of the input & label data exists and has the right length and dimensions
-                
-                int instances=(int)dimensionSizesClassesWave[0]; //number of sample
-                int elements=(int)dimensionSizesInputWave[1]; //  number of sample points
-                int numPnts=instances*(elements+1); //total number of points + one extra point per sample (for terminator)
-                
-                struct svm_node *buffer=Malloc(struct svm_node, numPnts); // allocate a buffer svm_node to hold all the sample and label data
-                
-                problem=makeProblem(p->inPutWave, p->inputClasses, buffer); //populate the buffer in a helper function
+            if (err) {
+                return err;
+            }
+            else{ // the input & label data exists, has the right length and dimensions and is converted to problem
                 
                 if (p->weightsEncountered && p->inputWeights != NULL) { // add weights is specified so
                     addWeights(p->inputWeights, &params);
                 }
                 
                 const char *parameterError=svm_check_parameter(&problem,&params); // use libSVM svm_check_parameter to check for invalid parameters, report output (if any) to user
+                struct SVMFeatureMap *featureMap=NULL;
+                
+                if (parameterError == NULL && approxType && validationMode<1) { // replace the samples by their mapped features, the model is LINEAR in them. Cross validation maps each fold on its own
+                    struct svm_node *mappedBuffer=NULL;
+                    struct svm_problem mappedProblem={0};
+                    if (makeFeatureMap(&problem, approxType, approxDim, params.gamma, seed, numThreads, &featureMap) || mapProblem(featureMap, &problem, numThreads, &mappedBuffer, &mappedProblem)) {
+                        freeFeatureMap(featureMap);
+                        free(problem.y);
+                        free(problem.x);
+                        free(buffer);
+                        svm_destroy_param(&params);
+                        return NOMEM;
+                    }
+                    free(problem.x);
+                    free(buffer);
+                    free(mappedProblem.y); // same labels
+                    problem.x=mappedProblem.x;
+                    buffer=mappedBuffer;
+                    params.kernel_type=LINEAR;
+                }
                 
                 if (parameterError == NULL) { // no error, proceed training
                     if(validationMode>0){ //validation, don't save model
                         double *target = Malloc(double,problem.l); // a bufer that holds the result from the validation runs,
                         int total_correct = 0;
-                        svm_cross_validation(&problem,&params,validationMode,target); // run validation
+                        if (numThreads != 1) {
+                            svm_set_print_string_function(&print_null); // no console output from the workers
+                        }
+                        int validationErr=target == NULL;
+                        if (!validationErr) { // run validation, folds drawn with seed and trained concurrently, with more than one thread or /GRAM by the row-parallel solver
+                            if (dense) {
+                                validationErr=denseCrossValidation(&denseSamples, &problem, &params, validationMode, seed, numThreads, params.cache_size, gramMemory, target);
+                            }
+                            else if (approxType) { // the map of each fold from its training samples only
+                                validationErr=featureMapCrossValidation(&problem, &params, linearLoss, approxType, approxDim, validationMode, seed, numThreads, target);
+                            }
+                            else{
+                                validationErr=linearLoss ? parallelCrossValidation(&problem, &params, linearLoss, validationMode, seed, numThreads, params.cache_size, target) : gramCrossValidation(&problem, &params, validationMode, seed, numThreads, params.cache_size, gramMemory, target);
+                            }
+                        }
+                        freeDenseSamples(&denseSamples);
+                        if (validationErr) {
+                            svm_set_print_string_function(&print_string_Igor);
+                            free(target);
+                            freeFeatureMap(featureMap);
+                            free(problem.y);
+                            free(problem.x);
+                            free(buffer);
+                            svm_destroy_param(&params);
+                            return NOMEM;
+                        }
+                        svm_set_print_string_function(&print_string_Igor);
                         if(params.svm_type == ONE_CLASS){
                             for(int i=0;i<problem.l;i++){ // analyze validation result
                                 if(target[i] > 0){ // check of class of validation is in input (known) data, if yes increment correct counter
@@ -298,25 +578,167 @@ ExecuteSVMTrain(SVMTrainRuntimeParamsPtr p)
                         
                     }
                     else{
-                        struct svm_model *model=svm_train(&problem, &params); // actual training
+                        if (numThreads != 1) {
+                            svm_set_print_string_function(&print_null); // no console output from the workers
+                        }
+                        struct svm_parameter trainParams=params;
+                        if (heldOut) {
+                            trainParams.probability=0; // the probability model is fitted to the held out samples below
+                        }
+                        struct svm_model *model=NULL;
+                        if (linearLoss) {
+                            model=linearTrain(&problem, &trainParams, linearLoss, numThreads); // dual coordinate descent, the one-vs-one problems are trained concurrently
+                        }
+                        else if (partitions) {
+                            int passes;
+                            model=cascadeTrain(&problem, &trainParams, partitions, feedbackPasses, seed, numThreads, params.cache_size, gramMemory, &passes); // sub-SVMs of each layer trained concurrently, the final set as below
+                            if (model != NULL) {
+                                SetOperationNumVar("V_SVMCascadePasses", passes);
+                            }
+                            if (model != NULL && p->COMPAREFlagEncountered) { // the same problem trained directly, for the report
+                                struct svm_model *direct=gramTrain(&problem, &trainParams, seed, numThreads, params.cache_size, gramMemory);
+                                struct SVMCascadeReport report;
+                                if (direct == NULL || cascadeReport(model, direct, &problem, numThreads, &report)) { // only the report is lost, the cascade model is saved as usual
+                                    XOPNotice("Cascade: not enough memory to compare with direct training\n");
+                                }
+                                else{
+                                    char notice[1024];
+                                    snprintf(notice,1024, "Cascade: %d support vectors, score %g; direct: %d support vectors, score %g; difference %g\n", model->l, report.cascadeScore, direct->l, report.directScore, report.difference);
+                                    XOPNotice(notice);
+                                    SetOperationNumVar("V_SVMDirectSupportVectors", direct->l);
+                                    SetOperationNumVar("V_SVMCascadeScore", report.cascadeScore);
+                                    SetOperationNumVar("V_SVMDirectScore", report.directScore);
+                                    SetOperationNumVar("V_SVMCascadeDifference", report.difference);
+                                }
+                                svm_free_and_destroy_model(&direct);
+                            }
+                        }
+                        else if (warmModel != NULL) {
+                            int rounds;
+                            model=warmStartTrain(&problem, &trainParams, warmModel, seed, numThreads, params.cache_size, gramMemory, &rounds); // each round as below
+                            if (model != NULL) {
+                                SetOperationNumVar("V_SVMWarmRounds", rounds);
+                            }
+                            if (model != NULL && p->COMPAREFlagEncountered) { // the same problem from a cold start, same objective within the tolerance
+                                struct svm_model *cold=gramTrain(&problem, &trainParams, seed, numThreads, params.cache_size, gramMemory);
+                                double warmObjective=dualObjective(model, &problem, numThreads);
+                                double coldObjective=cold != NULL ? dualObjective(cold, &problem, numThreads) : NAN;
+                                if (cold == NULL || isnan(warmObjective) || isnan(coldObjective)) { // only the report is lost, the warm started model is saved as usual
+                                    XOPNotice("Warm start: not enough memory to compare with a cold start\n");
+                                }
+                                else{
+                                    char notice[1024];
+                                    snprintf(notice,1024, "Warm start: %d rounds, %d support vectors, objective %.10g; cold start: %d support vectors, objective %.10g\n", rounds, model->l, warmObjective, cold->l, coldObjective);
+                                    XOPNotice(notice);
+                                    SetOperationNumVar("V_SVMDirectSupportVectors", cold->l);
+                                    SetOperationNumVar("V_SVMWarmObjective", warmObjective);
+                                    SetOperationNumVar("V_SVMColdObjective", coldObjective);
+                                }
+                                svm_free_and_destroy_model(&cold);
+                            }
+                        }
+                        else if (dense) {
+                            model=denseTrain(&denseSamples, &problem, &trainParams, seed, numThreads, params.cache_size, gramMemory); // kernel rows from the dense samples, the support vectors get their own nodes
+                            freeDenseSamples(&denseSamples);
+                        }
+                        else{
+                            model=gramTrain(&problem, &trainParams, seed, numThreads, params.cache_size, gramMemory); // actual training, the one-vs-one problems of multi-class models and the folds of probability models are trained concurrently, with more than one thread or /GRAM from kernel rows computed on the threads left over
+                        }
+                        svm_set_print_string_function(&print_string_Igor);
+                        if (model != NULL) {
+                            SetOperationNumVar("V_SVMNumSupportVectors", model->l);
+                        }
+                        if (model != NULL && featureMap != NULL) { // one weight vector per decision function instead of the mapped training samples
+                            struct svm_model *weights=weightVectorModel(model);
+                            svm_free_and_destroy_model(&model);
+                            model=weights;
+                        }
+                        if (model != NULL && heldOut) {
+                            struct svm_node *heldOutBuffer=NULL;
+                            struct svm_problem heldOutProblem={0};
+                            err=makeProblemFromWaves(p->holdoutWave, p->holdoutClasses, NULL, NULL, NULL, params.kernel_type == PRECOMPUTED ? problem.l : 0, sparse, sparseThreshold, &heldOutBuffer, &heldOutProblem);
+                            if (err == 0 && featureMap != NULL) { // the held out samples are mapped as well
+                                struct svm_node *mappedBuffer=NULL;
+                                struct svm_problem mappedProblem={0};
+                                if (mapProblem(featureMap, &heldOutProblem, numThreads, &mappedBuffer, &mappedProblem)) {
+                                    err=NOMEM;
+                                }
+                                else{
+                                    free(heldOutProblem.x);
+                                    free(heldOutBuffer);
+                                    free(mappedProblem.y);
+                                    heldOutProblem.x=mappedProblem.x;
+                                    heldOutBuffer=mappedBuffer;
+                                }
+                            }
+                            if (err == 0) {
+                                int fitted=heldOutProbabilityModel(model, &heldOutProblem, numThreads);
+                                if (fitted<0) {
+                                    err=NOMEM;
+                                }
+                                else if (fitted>0) {
+                                    err=EMPTY_HOLDOUT;
+                                }
+                            }
+                            free(heldOutProblem.y);
+                            free(heldOutProblem.x);
+                            free(heldOutBuffer);
+                            if (err) {
+                                svm_free_and_destroy_model(&model);
+                                freeFeatureMap(featureMap);
+                                free(problem.y);
+                                free(problem.x);
+                                free(buffer);
+                                svm_destroy_param(&params);
+                                return err;
+                            }
+                        }
+                        if (model == NULL) {
+                            freeFeatureMap(featureMap);
+                            free(problem.y);
+                            free(problem.x);
+                            free(buffer);
+                            svm_destroy_param(&params);
+                            return NOMEM;
+                        }
+                        
+                        if (saveModelFile) {
 #ifdef MACIGOR
-                        HFSToPosixPath(outPutPath, outPutPath, 0); //convert fileURL to posix (on mac)
+                            HFSToPosixPath(outPutPath, outPutPath, 0); //convert fileURL to posix (on mac)
 #endif
-                        if(svm_save_model(outPutPath,model)){ // save model
-                            fprintf(stderr, "can't save model to file %s\n", outPutPath);
+                            if(saveModel(outPutPath,model,featureMap,p->BINFlagEncountered)){ // save model, always binary with a feature map
+                                err=FILE_WRITE_ERROR;
+                            }
+                            else{
+                                SetOperationStrVar("S_fileName",outPutPath); //report outputpath to igor
+                                
+                                char notice[1024];
+                                snprintf(notice,1024, "Model saved to %s\n",outPutPath); //report outputpath to igor console
+                                XOPNotice(notice);
+                            }
                         }
                         
-                        svm_free_and_destroy_model(&model); //free model memory
-                        SetOperationStrVar("S_fileName",outPutPath); //report outputpath to igor
+                        if (p->KEEPFlagEncountered) { // the model stays resident for SVMClassify /ID, no need to read it back from a file
+                            int modelID;
+                            if (ownSupportVectors(model)) { // the support vectors still point into our buffer, which is freed below
+                                svm_free_and_destroy_model(&model);
+                                err=NOMEM;
+                            }
+                            else{
+                                registerModel(model, featureMap, NULL, &modelID);
+                                featureMap=NULL; // belongs to the registry now
+                                SetOperationNumVar("V_SVMModelID", modelID);
+                            }
+                        }
+                        else{
+                            svm_free_and_destroy_model(&model); //free model memory
+                        }
                         svm_set_print_string_function(NULL);
-                        
-                        char notice[1024];
-                        snprintf(notice,1024, "Model saved to %s\n",outPutPath); //report outputpath to igor console
-                        XOPNotice(notice);
                     }
   
                 }
                 else{//cleanup in parameter error case
+                    freeDenseSamples(&denseSamples);
                     free(problem.y);
                     free(problem.x);
                     free(buffer);
@@ -324,6 +746,7 @@ ExecuteSVMTrain(SVMTrainRuntimeParamsPtr p)
                     XOPNotice(parameterError);
                     return EXPECTED_XOP_PARAM;
                 }//cleanup after training, checked for leaks using xcode's instruments
+                freeFeatureMap(featureMap);
                 free(problem.y);
                 free(problem.x);
                 free(buffer);
@@ -342,6 +765,246 @@ ExecuteSVMTrain(SVMTrainRuntimeParamsPtr p)
 }
 
 
+/*
+ helper function, the kernel values each sample needs for a PRECOMPUTED model: one per training sample up to the largest serial number of the support vectors. 0 for other kernels.
+ */
+
+int precomputedColumns(const svm_model *model){
+    int columns=0;
+    if (model->param.kernel_type != PRECOMPUTED) {
+        return 0;
+    }
+    for (int i=0; i<model->l; i++) {
+        if ((int)model->SV[i][0].value>columns) {
+            columns=(int)model->SV[i][0].value;
+        }
+    }
+    return columns>0 ? columns : 1;
+}
+
+/*
+ helper function, the kernel values each row of the training input needs: one per training sample (row) for PRECOMPUTED kernels, 0 for other kernels.
+ */
+
+int kernelMatrixColumns(int kernel_type, waveHndl inputWave){
+    int numDimensions;
+    CountInt dimensionSizes[MAX_DIMENSIONS+1];
+    if (kernel_type != PRECOMPUTED) {
+        return 0;
+    }
+    if (inputWave == NULL || MDGetWaveDimensions(inputWave, &numDimensions, dimensionSizes) || dimensionSizes[0]<1) {
+        return 1; // triplets or no samples, rejected by makeProblemFromWaves
+    }
+    return (int)dimensionSizes[0];
+}
+
+/*
+ helper function to check the input waves of SVMTrain and SVMGridSearch and build the training problem: samples from the matrix inputWave, or from row/column/value triplets if inputWave is NULL, labels from classWave.
+ With kernelColumns>0 inputWave holds the values of a PRECOMPUTED kernel instead, each row needs at least kernelColumns of them (one per training sample).
+ */
+
+int makeProblemFromWaves(waveHndl inputWave, waveHndl classWave, waveHndl rowWave, waveHndl columnWave, waveHndl valueWave, int kernelColumns, int sparse, double threshold, svm_node **buffer, svm_problem *problem){
+    int err=0;
+    int numDimensionsInputWave=0;
+    int numDimensionsClassesWave;
+    
+    CountInt dimensionSizesClassesWave[MAX_DIMENSIONS+1];
+    CountInt dimensionSizesInputWave[MAX_DIMENSIONS+1];
+    
+    int tripletInput=inputWave == NULL;
+    int resultInPutWave=tripletInput ? 0 : MDGetWaveDimensions(inputWave, &numDimensionsInputWave, dimensionSizesInputWave); // the triplets are checked in makeTripletProblem
+    int resultClassesWave=MDGetWaveDimensions(classWave, &numDimensionsClassesWave, dimensionSizesClassesWave);
+    
+    if (resultInPutWave || resultClassesWave){
+        return resultInPutWave ? resultInPutWave : resultClassesWave;
+    }
+    else if(!tripletInput && numDimensionsInputWave<1){
+        return EXPECT_MATRIX;
+    }
+    else if (!tripletInput && dimensionSizesClassesWave[0] != dimensionSizesInputWave[0]){
+        return WAVE_LENGTH_MISMATCH;
+    }
+    
+    SVMDataBlock classes;
+    if ((err=getDataBlock(classWave, &classes))) { // direct access to the wave data, fails for text waves
+        return err;
+    }
+    
+    if (kernelColumns>0) { // PRECOMPUTED kernel values, all of them are needed in place
+        SVMDataBlock data;
+        if (tripletInput) {
+            err=INCOMPATIBLE_FLAGS;
+        }
+        else if ((err=getDataBlock(inputWave, &data)) == 0 && (err=makeLabels(&classes, problem)) == 0) {
+            if (data.columns<kernelColumns) {
+                err=KERNEL_MATRIX_SIZE;
+            }
+            else{
+                problem->x=Malloc(struct svm_node *, problem->l > 0 ? problem->l : 1);
+                err=problem->x == NULL ? NOMEM : makePrecomputedNodes(&data, buffer, problem->x);
+            }
+            if (err) {
+                free(problem->y);
+                free(problem->x);
+                problem->y=NULL;
+                problem->x=NULL;
+            }
+        }
+    }
+    else if (tripletInput) {
+        err=makeTripletProblem(rowWave, columnWave, valueWave, &classes, sparse, threshold, buffer, problem);
+    }
+    else{
+        SVMDataBlock data;
+        if ((err=getDataBlock(inputWave, &data)) == 0) {
+            err=makeProblem(&data, &classes, sparse, threshold, buffer, problem); //populate the buffer in a helper function
+        }
+    }
+    return err;
+}
+
+
+/*
+ helper function, makeProblemFromWaves() for SVMTrain /DENSE: the samples of the matrix inputWave are read into dense samples (see SVMDense.h), problem only gets the labels of classWave, problem->x is NULL.
+ */
+
+int makeDenseProblemFromWaves(waveHndl inputWave, waveHndl classWave, SVMDenseSamples *samples, svm_problem *problem){
+    int err=0;
+    int numDimensionsInputWave;
+    int numDimensionsClassesWave;
+    
+    CountInt dimensionSizesClassesWave[MAX_DIMENSIONS+1];
+    CountInt dimensionSizesInputWave[MAX_DIMENSIONS+1];
+    
+    if ((err=MDGetWaveDimensions(inputWave, &numDimensionsInputWave, dimensionSizesInputWave)) || (err=MDGetWaveDimensions(classWave, &numDimensionsClassesWave, dimensionSizesClassesWave))) {
+        return err;
+    }
+    else if (numDimensionsInputWave<1){
+        return EXPECT_MATRIX;
+    }
+    else if (dimensionSizesClassesWave[0] != dimensionSizesInputWave[0]){
+        return WAVE_LENGTH_MISMATCH;
+    }
+    
+    SVMDataBlock classes;
+    SVMDataBlock data;
+    if ((err=getDataBlock(classWave, &classes)) || (err=getDataBlock(inputWave, &data))) { // direct access to the wave data, fails for text waves
+        return err;
+    }
+    if ((err=makeLabels(&classes, problem))) {
+        return err;
+    }
+    problem->x=NULL;
+    if (makeDenseSamples(&data, samples)) {
+        free(problem->y);
+        problem->y=NULL;
+        return NOMEM;
+    }
+    return 0;
+}
+
+
+/*
+ helper function, the native path of a data file from its full path (as Igor gives it). Without a name, the user selects the file in a dialog.
+ */
+
+int getDataFilePath(Handle fileName, char *fullPath){
+    if (fileName != NULL && GetHandleSize(fileName)>0) {
+        GetCStringFromHandle(fileName, fullPath, MAX_PATH_LEN);
+    }
+    else if(XOPOpenFileDialog("Select the data file", "", NULL, "", fullPath) != 0){//prompt user
+        return FILE_NOT_FOUND;
+    }
+#ifdef MACIGOR
+    HFSToPosixPath(fullPath, fullPath, 0); //platform specific URL conversion
+#endif
+    return 0;
+}
+
+/*
+ helper function, makeProblemFromWaves() for samples in a file (SVMDataFile.h): a text file in the format of libSVM brings its labels, a raw matrix (rawColumns values of the Igor number type rawType per sample) takes them from classWave. The file is only mapped while the nodes are made, they are the one copy of the samples in memory.
+ With precomputed set the samples are rows of a PRECOMPUTED kernel, one value per training sample (a text file has the serial number as index 0, as for svm-train). With denseSamples (SVMTrain /DENSE, raw matrices only) the samples are read into them instead and problem->x is NULL.
+ */
+
+int makeProblemFromFile(const char *path, int raw, int rawType, int rawColumns, waveHndl classWave, int precomputed, int sparse, double threshold, int numThreads, SVMDenseSamples *denseSamples, svm_node **buffer, svm_problem *problem){
+    int err=0;
+    struct SVMDataFile file;
+    *buffer=NULL;
+    problem->y=NULL;
+    problem->x=NULL;
+    
+    if (!raw) {
+        if (classWave != NULL || denseSamples != NULL) { // the labels are in the file, the samples are sparse
+            return INCOMPATIBLE_FLAGS;
+        }
+        if ((err=mapTextDataFile(path, numThreads, &file))) {
+            return err<0 ? FILE_OPEN_ERROR : DATA_FILE_FORMAT;
+        }
+        if (file.rows>INT_MAX) { // libSVM counts the samples of a problem in an int
+            unmapDataFile(&file);
+            return TOO_MANY_SAMPLES;
+        }
+        problem->l=(int)file.rows;
+        problem->y=Malloc(double, file.rows);
+        problem->x=Malloc(struct svm_node *, file.rows);
+        if (precomputed && file.columns<(int)file.rows) {
+            err=KERNEL_MATRIX_SIZE;
+        }
+        else if (problem->y == NULL || problem->x == NULL || textFileNodes(&file, 0, file.rows, sparse && !precomputed, threshold, numThreads, buffer, problem->x, problem->y)) {
+            err=NOMEM;
+        }
+    }
+    else{
+        int numDimensions;
+        CountInt dimensionSizes[MAX_DIMENSIONS+1];
+        SVMDataBlock classes;
+        if (classWave == NULL) {
+            return NULL_WAVE_OP;
+        }
+        if ((err=MDGetWaveDimensions(classWave, &numDimensions, dimensionSizes)) || (err=getDataBlock(classWave, &classes))) {
+            return err;
+        }
+        if ((err=mapRawDataFile(path, dataTypeFromNumType(rawType), rawColumns, &file))) {
+            return err<0 ? FILE_OPEN_ERROR : DATA_FILE_FORMAT;
+        }
+        if (file.rows>INT_MAX) {
+            err=TOO_MANY_SAMPLES;
+        }
+        else if ((size_t)dimensionSizes[0] != file.rows) {
+            err=WAVE_LENGTH_MISMATCH;
+        }
+        else if (precomputed && file.columns<(int)file.rows) {
+            err=KERNEL_MATRIX_SIZE;
+        }
+        else if (denseSamples != NULL) {
+            if ((err=makeLabels(&classes, problem)) == 0 && makeDenseSamples(&file.block, denseSamples)) {
+                err=NOMEM;
+            }
+        }
+        else if (precomputed) {
+            if ((err=makeLabels(&classes, problem)) == 0) {
+                problem->x=Malloc(struct svm_node *, problem->l > 0 ? problem->l : 1);
+                err=problem->x == NULL ? NOMEM : makePrecomputedNodes(&file.block, buffer, problem->x);
+            }
+        }
+        else{
+            err=makeProblem(&file.block, &classes, sparse, threshold, buffer, problem); // straight from the mapping into the nodes
+        }
+    }
+    
+    unmapDataFile(&file);
+    if (err) {
+        free(problem->y);
+        free(problem->x);
+        free(*buffer);
+        problem->y=NULL;
+        problem->x=NULL;
+        *buffer=NULL;
+    }
+    return err;
+}
+
+
 /*
   helper function to populate svm_parameter with a weights wave. Presumably, the buffer will get deallocated by svm_destroy_param(), if I read the source in svm.cpp correctly.
  */
@@ -381,81 +1044,393 @@ void addWeights(waveHndl weights, struct svm_parameter *params){
 }
 
 /*
- helper function to populate svm_problem. The buffers are to be managed by ourselves.
+ helper function, the SVMDataType of an Igor number type (without NT_CMPLX), SVM_DATA_UNSUPPORTED for text and other types
  */
 
-svm_problem makeProblem(waveHndl inputWave, waveHndl inputClasses, svm_node *buffer){
-    svm_problem problem={0};
-    
-    int numDimensionsInputWave;
-    int numDimensionsClassesWave;
-    
-    CountInt dimensionSizesClassesWave[MAX_DIMENSIONS+1];
-    CountInt dimensionSizesInputWave[MAX_DIMENSIONS+1];
-    
-    MDGetWaveDimensions(inputWave, &numDimensionsInputWave, dimensionSizesInputWave);
-    MDGetWaveDimensions(inputClasses, &numDimensionsClassesWave, dimensionSizesClassesWave);
-    
-    int elements=(int)dimensionSizesInputWave[1]; // number of data points per sample, number of columns in inputWave
-    problem.l=(int)dimensionSizesClassesWave[0]; //number of samples, should be the same as dimensionSizesInputWave[0] number of rows in inputWave or inputClasses
-    
-    problem.y=Malloc(double, problem.l); //buffer  for the labels
-    problem.x=Malloc(struct svm_node *,problem.l); //buffer for the data
-    
-    double value[2]; // a two-point array, since values can be complex in principle, the real part is at value[0]
-    
-    IndexInt classIndices[MAX_DIMENSIONS]={0}; //structs to address the data in the input matrices
-    IndexInt dataIndices[MAX_DIMENSIONS]={0};
-    int counter=0;
-    
-    for (int i=0; i<problem.l; i++) {
-        
-        problem.x[i]=&buffer[counter]; // assign the address of the current node to the problem
-    
-        classIndices[0]=i; // we want the point at row (sample) i
-        
-        MDGetNumericWavePointValue(inputClasses, classIndices, value); // get label at i
-        
-        problem.y[i]=value[0]; // label node at i
-        
-        for (int j=0; j<elements; j++) {// get the sample data by iterating over all data points
-            dataIndices[0]=i;// sample number
-            dataIndices[1]=j;// data point number
-            MDGetNumericWavePointValue(inputWave, dataIndices, value);//get data point
-            buffer[counter].index=j+1; // data point index, of current node,one based
-            buffer[counter].value=value[0]; //data point valu of current node
-            counter++;
-            
-        }
-        buffer[counter++].index=-1; // after writing all the data, add a terminator node with index -1
+int dataTypeFromNumType(int numType){
+    switch (numType) {
+        case NT_FP32:
+            return SVM_DATA_FLOAT32;
+        case NT_FP64:
+            return SVM_DATA_FLOAT64;
+        case NT_I8:
+            return SVM_DATA_INT8;
+        case NT_I8 | NT_UNSIGNED:
+            return SVM_DATA_UINT8;
+        case NT_I16:
+            return SVM_DATA_INT16;
+        case NT_I16 | NT_UNSIGNED:
+            return SVM_DATA_UINT16;
+        case NT_I32:
+            return SVM_DATA_INT32;
+        case NT_I32 | NT_UNSIGNED:
+            return SVM_DATA_UINT32;
+#ifdef NT_I64
+        case NT_I64:
+            return SVM_DATA_INT64;
+        case NT_I64 | NT_UNSIGNED:
+            return SVM_DATA_UINT64;
+#endif
+        default:
+            return SVM_DATA_UNSUPPORTED;
     }
-    
-    return problem;
 }
 
+/*
+ helper function to describe the data of a numeric wave as a SVMDataBlock (see SVMWaveData.h), so that it can be read without a callback per point. Rows are samples, columns the data points per sample.
+ */
 
-
-
-// Operation template: SVMClassify /PROB /DEC /P=name:pathName modelName=string:modelname, inputWave=wave:inPutWave
-// Structure to hold the parameters for svm classification
-
-// Runtime param structure for SVMClassify operation.
-#pragma pack(2)    // All structures passed to Igor are two-byte aligned.
-struct SVMClassifyRuntimeParams {
-    // Flag parameters.
+int getDataBlock(waveHndl wave, SVMDataBlock *block){
+    int numDimensions;
+    CountInt dimensionSizes[MAX_DIMENSIONS+1];
+    int err=MDGetWaveDimensions(wave, &numDimensions, dimensionSizes);
+    if (err) {
+        return err;
+    }
     
-    // Parameters for /PROB flag group. report probability values, if the trained model permits.
-    int PROBFlagEncountered;
-    // There are no fields for this group because it has no parameters.
+    int waveType=WaveType(wave);
+    block->type=dataTypeFromNumType(waveType & ~NT_CMPLX);
+    if (block->type == SVM_DATA_UNSUPPORTED) {
+        return NUMERIC_ACCESS_ON_TEXT_WAVE; // text or wave reference waves
+    }
     
-    // Parameters for /DEC flag group. report decision values
-    int DECFlagEncountered;
+    block->data=WaveData(wave);
+    block->complexStride=(waveType & NT_CMPLX) ? 2 : 1; // only the real part is used
+    block->rows=(size_t)dimensionSizes[0];
+    block->columns=numDimensions>1 ? (int)dimensionSizes[1] : 1;
+    block->rowStride=1; // Igor waves are column-major
+    block->columnStride=(size_t)dimensionSizes[0];
+    
+    return 0;
+}
+
+/*
+ helper function to convert a dense data block into nodes, one row per sample. *buffer is allocated here, x needs to hold one pointer per row and receives the address of the first node of each sample.
+ With sparse set, points with |value| <= threshold are skipped, so the buffer only holds the non zero points (libSVM's sparse representation). Otherwise every point becomes a node.
+ */
+
+int makeNodes(const SVMDataBlock *data, int sparse, double threshold, svm_node **buffer, svm_node **x){
+    size_t rows=data->rows;
+    *buffer=NULL;
+    
+    if (sparse) {
+        size_t *counts=Malloc(size_t, rows); // non zero points per row, counted in a first pass
+        if (counts == NULL) {
+            return NOMEM;
+        }
+        if (SVMBlockCountNonZero(*data, 0, rows, threshold, counts)) {
+            free(counts);
+            return NUMERIC_ACCESS_ON_TEXT_WAVE;
+        }
+        size_t numPnts=0;
+        for (size_t i=0; i<rows; i++) {
+            numPnts+=counts[i]+1; // one extra point per sample (for terminator)
+        }
+        *buffer=Malloc(struct svm_node, numPnts);
+        if (*buffer == NULL) {
+            free(counts);
+            return NOMEM;
+        }
+        size_t offset=0;
+        for (size_t i=0; i<rows; i++) {
+            x[i]=*buffer+offset;
+            offset+=counts[i]+1;
+        }
+        free(counts);
+        
+        svm_node **cursor=Malloc(struct svm_node *, rows); // write position of each sample, advanced by SVMBlockToSparseNodes
+        if (cursor == NULL) {
+            free(*buffer);
+            *buffer=NULL;
+            return NOMEM;
+        }
+        memcpy(cursor, x, rows*sizeof(struct svm_node *));
+        SVMBlockToSparseNodes(*data, 0, rows, threshold, cursor);
+        free(cursor);
+    }
+    else{
+        size_t rowLength=(size_t)data->columns+1; //number of points + one extra point per sample (for terminator)
+        *buffer=Malloc(struct svm_node, rows*rowLength);
+        if (*buffer == NULL) {
+            return NOMEM;
+        }
+        if (SVMBlockToNodes(*data, 0, rows, *buffer)) { // read sample data straight from the wave data, one typed loop per number type
+            free(*buffer);
+            *buffer=NULL;
+            return NUMERIC_ACCESS_ON_TEXT_WAVE;
+        }
+        for (size_t i=0; i<rows; i++) {
+            x[i]=*buffer+i*rowLength; // assign the address of the first node of sample i, each sample is terminated with index -1
+        }
+    }
+    return 0;
+}
+
+/*
+ helper function to convert rows of PRECOMPUTED kernel values into nodes, columns+2 per row: the serial number of the sample (index 0, 1 based), the kernel value of training sample j at node j+1 and the terminator. libSVM looks the values up by position.
+ *buffer is allocated here, x needs to hold one pointer per row.
+ */
+
+int makePrecomputedNodes(const SVMDataBlock *data, svm_node **buffer, svm_node **x){
+    size_t rows=data->rows;
+    size_t rowLength=(size_t)data->columns+2;
+    *buffer=Malloc(struct svm_node, rows*rowLength>0 ? rows*rowLength : 1);
+    if (*buffer == NULL) {
+        return NOMEM;
+    }
+    for (size_t i=0; i<rows; i++) {
+        x[i]=*buffer+i*rowLength;
+        x[i][0].index=0;
+        x[i][0].value=(double)(i+1);
+        if (SVMBlockToNodes(*data, i, 1, x[i]+1)) {
+            free(*buffer);
+            *buffer=NULL;
+            return NUMERIC_ACCESS_ON_TEXT_WAVE;
+        }
+    }
+    return 0;
+}
+
+static bool compareNodeIndex(const svm_node &a, const svm_node &b){
+    return a.index<b.index;
+}
+
+/*
+ helper function to convert row/column/value triplets (zero based row and column indices, as in a coordinate list) into nodes. Triplets can be given in any order, the nodes of each row are sorted by column and duplicate entries are summed.
+ If *numRows is 0, the number of rows is taken from the largest row index, otherwise all row indices need to be smaller than *numRows. *buffer and *x are allocated here.
+ Indices that are negative, NaN, not integral or too large (row indices from INT_MAX on, column indices from INT_MAX on) return INDEX_OUT_OF_RANGE.
+ */
+
+int makeTripletNodes(waveHndl rowWave, waveHndl columnWave, waveHndl valueWave, int sparse, double threshold, size_t *numRows, svm_node **buffer, svm_node ***x){
+    SVMDataBlock rowBlock;
+    SVMDataBlock columnBlock;
+    SVMDataBlock valueBlock;
+    int err;
+    
+    *buffer=NULL;
+    *x=NULL;
+    
+    if ((err=getDataBlock(rowWave, &rowBlock)) || (err=getDataBlock(columnWave, &columnBlock)) || (err=getDataBlock(valueWave, &valueBlock))) {
+        return err;
+    }
+    if (rowBlock.rows != columnBlock.rows || rowBlock.rows != valueBlock.rows) {
+        return WAVE_LENGTH_MISMATCH;
+    }
+    
+    size_t numTriplets=rowBlock.rows;
+    double *rows=Malloc(double, numTriplets);
+    double *columns=Malloc(double, numTriplets);
+    double *values=Malloc(double, numTriplets);
+    size_t *counts=NULL;
+    
+    if (rows == NULL || columns == NULL || values == NULL) {
+        err=NOMEM;
+    }
+    else{
+        SVMBlockToDoubles(rowBlock, 0, numTriplets, rows);
+        SVMBlockToDoubles(columnBlock, 0, numTriplets, columns);
+        SVMBlockToDoubles(valueBlock, 0, numTriplets, values);
+        
+        size_t maxRow=0;
+        const double rowLimit=*numRows>0 ? (double)*numRows : (double)INT_MAX; // libSVM counts the samples in an int
+        for (size_t k=0; k<numTriplets && err == 0; k++) {
+            if (!(rows[k] >= 0 && rows[k]<rowLimit) || !(columns[k] >= 0 && columns[k]<INT_MAX) || rows[k] != floor(rows[k]) || columns[k] != floor(columns[k])) { // also catches NaN, checked before any cast
+                err=INDEX_OUT_OF_RANGE;
+            }
+            else if ((size_t)rows[k]>maxRow) {
+                maxRow=(size_t)rows[k];
+            }
+        }
+        if (err == 0 && *numRows == 0) {
+            *numRows=numTriplets>0 ? maxRow+1 : 0;
+        }
+    }
+    
+    if (err == 0) {
+        size_t l=*numRows;
+        counts=(size_t*)calloc(l > 0 ? l : 1, sizeof(size_t)); // nodes per row
+        *x=Malloc(struct svm_node *, l > 0 ? l : 1);
+        if (counts == NULL || *x == NULL) {
+            err=NOMEM;
+        }
+        else{
+            size_t numPnts=l; // one terminator per row
+            for (size_t k=0; k<numTriplets; k++) {
+                if (!sparse || fabs(values[k]) > threshold) {
+                    counts[(size_t)rows[k]]++;
+                    numPnts++;
+                }
+            }
+            *buffer=Malloc(struct svm_node, numPnts);
+            if (*buffer == NULL) {
+                err=NOMEM;
+            }
+            else{
+                size_t offset=0;
+                for (size_t i=0; i<l; i++) {
+                    (*x)[i]=*buffer+offset;
+                    offset+=counts[i]+1;
+                    counts[i]=0; // reused as fill counter
+                }
+                for (size_t k=0; k<numTriplets; k++) {
+                    if (!sparse || fabs(values[k]) > threshold) {
+                        size_t row=(size_t)rows[k];
+                        svm_node *node=(*x)[row]+counts[row]++;
+                        node->index=(int)columns[k]+1; // one based
+                        node->value=values[k];
+                    }
+                }
+                for (size_t i=0; i<l; i++) { // sort each row by index, sum duplicates, terminate
+                    svm_node *row=(*x)[i];
+                    std::sort(row, row+counts[i], compareNodeIndex);
+                    size_t n=0;
+                    for (size_t k=0; k<counts[i]; k++) {
+                        if (n>0 && row[n-1].index == row[k].index) {
+                            row[n-1].value+=row[k].value;
+                        }
+                        else{
+                            row[n++]=row[k];
+                        }
+                    }
+                    row[n].index=-1;
+                }
+            }
+        }
+    }
+    
+    free(rows);
+    free(columns);
+    free(values);
+    free(counts);
+    if (err) {
+        free(*buffer);
+        free(*x);
+        *buffer=NULL;
+        *x=NULL;
+    }
+    return err;
+}
+
+/*
+ helper function to read the labels of a problem. problem->y is allocated here.
+ */
+
+static int makeLabels(const SVMDataBlock *classes, svm_problem *problem){
+    problem->l=(int)classes->rows; //number of samples, should be the same as the number of rows in inputWave or inputClasses
+    problem->y=Malloc(double, problem->l > 0 ? problem->l : 1); //buffer  for the labels
+    if (problem->y == NULL) {
+        return NOMEM;
+    }
+    if (SVMBlockToDoubles(*classes, 0, problem->l, problem->y)) {
+        free(problem->y);
+        problem->y=NULL;
+        return NUMERIC_ACCESS_ON_TEXT_WAVE;
+    }
+    return 0;
+}
+
+/*
+ helper function to populate svm_problem. The buffers are to be managed by ourselves, *buffer holds the nodes and is allocated here (see makeNodes()).
+ */
+
+int makeProblem(const SVMDataBlock *data, const SVMDataBlock *classes, int sparse, double threshold, svm_node **buffer, svm_problem *problem){
+    int err;
+    
+    *buffer=NULL;
+    if ((err=makeLabels(classes, problem))) {
+        return err;
+    }
+    problem->x=Malloc(struct svm_node *, problem->l > 0 ? problem->l : 1); //buffer for the data
+    if (problem->x == NULL) {
+        err=NOMEM;
+    }
+    else{
+        err=makeNodes(data, sparse, threshold, buffer, problem->x);
+    }
+    if (err) {
+        free(problem->y);
+        free(problem->x);
+        problem->y=NULL;
+        problem->x=NULL;
+    }
+    return err;
+}
+
+/*
+ helper function to populate svm_problem from row/column/value triplets, one row per label (see makeTripletNodes()).
+ */
+
+int makeTripletProblem(waveHndl rowWave, waveHndl columnWave, waveHndl valueWave, const SVMDataBlock *classes, int sparse, double threshold, svm_node **buffer, svm_problem *problem){
+    int err;
+    
+    *buffer=NULL;
+    if ((err=makeLabels(classes, problem))) {
+        return err;
+    }
+    size_t numRows=problem->l;
+    if (numRows == 0) {
+        free(problem->y);
+        problem->y=NULL;
+        return WAVE_LENGTH_MISMATCH;
+    }
+    if ((err=makeTripletNodes(rowWave, columnWave, valueWave, sparse, threshold, &numRows, buffer, &problem->x))) {
+        free(problem->y);
+        problem->y=NULL;
+    }
+    return err;
+}
+
+
+
+
+// Operation template: SVMClassify /PROB /DEC /DP /SPARSE[=number:sparseThreshold] /THREADS[=number:numThreads] /ID=number:modelID /P=name:pathName /RAW={number:rawType, number:rawColumns} /DENSE modelName=string:modelname, inputWave=wave:inPutWave, sparseInput={wave:rowWave, wave:columnWave, wave:valueWave}, inputFile=string:inputFile
+// Structure to hold the parameters for svm classification
+
+// Runtime param structure for SVMClassify operation.
+#pragma pack(2)    // All structures passed to Igor are two-byte aligned.
+struct SVMClassifyRuntimeParams {
+    // Flag parameters.
+    
+    // Parameters for /PROB flag group. report probability values, if the trained model permits.
+    int PROBFlagEncountered;
+    // There are no fields for this group because it has no parameters.
+    
+    // Parameters for /DEC flag group. report decision values
+    int DECFlagEncountered;
+    // There are no fields for this group because it has no parameters.
+    
+    // Parameters for /DP flag group. create the output waves in double precision
+    int DPFlagEncountered;
     // There are no fields for this group because it has no parameters.
     
+    // Parameters for /SPARSE flag group. skip points with |value| <= threshold (default 0), same as for training
+    int SPARSEFlagEncountered;
+    double sparseThreshold;                    // Optional parameter.
+    int SPARSEFlagParamsSet[1];
+    
+    // Parameters for /THREADS flag group. classify the rows of a matrix on this many threads, one per core if no number is given
+    int THREADSFlagEncountered;
+    double numThreads;                    // Optional parameter.
+    int THREADSFlagParamsSet[1];
+    
+    // Parameters for /ID flag group. ID of a resident model (SVMModelLoad), replaces modelName
+    int IDFlagEncountered;
+    double modelID;
+    int IDFlagParamsSet[1];
+    
     // Parameters for /P flag group. // url for the folder holding the model
     int PFlagEncountered;
     char pathName[MAX_OBJ_NAME+1];
     int PFlagParamsSet[1];
+    
+    // Parameters for /RAW flag group. inputFile is a raw binary matrix, same as for training
+    int RAWFlagEncountered;
+    double rawType;
+    double rawColumns;
+    int RAWFlagParamsSet[2];
+    
+    // Parameters for /DENSE flag group. classify the rows of a matrix wave, image stack or raw file with the batch engine only (SVMBatch.h): a batch of rows at a time is read from the single precision or integer data into a dense block, no node per data point. Fails for models the engine doesn't support instead of falling back to the nodes, a 1D wave is one sample and classified as without /DENSE
+    int DENSEFlagEncountered;
     // Main parameters.
     
     // Parameters for modelName keyword group. filename of model
@@ -463,11 +1438,23 @@ struct SVMClassifyRuntimeParams {
     Handle modelname;
     int modelNameParamsSet[1];
     
-    // Parameters for inputWave keyword group. inputdata to classify, same format as for training
+    // Parameters for inputWave keyword group. inputdata to classify, same format as for training, or a 3D image stack: each pixel is classified on its layers and the results are images
     int inputWaveEncountered;
     waveHndl inPutWave;
     int inputWaveParamsSet[1];
     
+    // Parameters for sparseInput keyword group. inputdata as row/column/value triplets, same format as for training, replaces inputWave
+    int sparseInputEncountered;
+    waveHndl rowWave;
+    waveHndl columnWave;
+    waveHndl valueWave;
+    int sparseInputParamsSet[3];
+    
+    // Parameters for inputFile keyword group. full path of a file with the samples, same format as for training, replaces inputWave. Text files are classified a chunk at a time, only the line offsets and a node pointer per sample (16 bytes) stay resident, the labels in the file are ignored
+    int inputFileEncountered;
+    Handle inputFile;
+    int inputFileParamsSet[1];
+    
     // These are postamble fields that Igor sets.
     int calledFromFunction;                    // 1 if called from a user function, 0 otherwise.
     int calledFromMacro;                    // 1 if called from a macro, 0 otherwise.
@@ -476,6 +1463,137 @@ typedef struct SVMClassifyRuntimeParams SVMClassifyRuntimeParams;
 typedef struct SVMClassifyRuntimeParams* SVMClassifyRuntimeParamsPtr;
 #pragma pack()    // Reset structure alignment to default.
 
+/*
+ classifies a range of rows of a sample matrix, one instance is shared by all workers of SVMParallelFor(). Each worker has its own node, probability and decision value buffers (thread selects them), the model is only read.
+ The results go straight into the output blocks, every row is written by exactly one worker.
+ */
+
+struct ClassifyRows {
+    SVMSampleSource source;
+    svm_model *model;
+    int predict_probability;
+    int calculateDecisionValues;
+    int numClasses;
+    int numberOfDecisionValues;
+    SVMOutputBlock resultBlock;
+    SVMOutputBlock probBlock;
+    SVMOutputBlock decBlock;
+    svm_node *nodes; // points+1 nodes per worker, SVM_ROW_BLOCK times that with blockNodes
+    size_t nodesPerThread;
+    int blockNodes; // dense samples are converted SVM_ROW_BLOCK rows at a time, reading each column (the layer of an image stack) sequentially
+    double *prob_estimates; // numClasses per worker
+    double *decisionValues; // numberOfDecisionValues per worker
+    double *probScratch; // probabilityScratchSize(numClasses) per worker, for the pairwise coupling of the probabilities
+    const SVMDenseModel *dense; // batch prediction engine (SVMBatch.h), NULL to classify the nodes with libSVM
+    int denseInput; // samples are read as a dense matrix for the engine, otherwise as nodes (collapsed LINEAR models only)
+    size_t batchRows; // samples per batch of the engine
+    double *samples; // batchRows*columns per worker
+    double *kvalues; // batchRows*l kernel values per worker, not used for collapsed LINEAR models
+    int *vote; // numClasses per worker
+    const SVMFeatureMap *featureMap; // approximate RBF models (SVMFeatureMap.h): the samples are mapped before they are classified, NULL otherwise
+    double *mapBuffer; // mapBufferSize per worker: dot products and features of the mapped samples
+    size_t mapBufferSize;
+    svm_node *mappedNodes; // outputDim+1 per worker
+    
+    void operator()(size_t begin, size_t end, int thread){
+        svm_node *threadNodes=nodes+thread*nodesPerThread;
+        double *threadProb=prob_estimates+thread*numClasses;
+        double *threadDec=decisionValues+thread*numberOfDecisionValues;
+        double *threadScratch=probScratch+thread*probabilityScratchSize(numClasses);
+        
+        if (dense != NULL && denseInput) {
+            classifyBatches(begin, end, thread, threadProb, threadDec, threadScratch);
+            return;
+        }
+        
+        for (size_t j=begin; j<end; j++) {
+            const svm_node *sample;
+            if (blockNodes) {
+                size_t k=(j-begin)%SVM_ROW_BLOCK;
+                if (k == 0) {
+                    SVMBlockToNodes(source.data, j, end-j<SVM_ROW_BLOCK ? end-j : (size_t)SVM_ROW_BLOCK, threadNodes);
+                }
+                sample=threadNodes+k*((size_t)source.data.columns+1);
+            }
+            else{
+                sample=SVMSampleNodes(source, j, threadNodes); //populate the input buffer with one sample, read straight from the wave data (see makeProblem())
+            }
+            if (featureMap != NULL) {
+                svm_node *mapped=mappedNodes+thread*(size_t)(featureMap->outputDim+1);
+                mapNodes(featureMap, sample, mapBuffer+thread*mapBufferSize, mapped);
+                sample=mapped;
+            }
+            
+            double result;
+            if (dense != NULL) { // w·x for each decision function
+                result=linearNodeDecisionValues(dense, sample, threadDec, vote+thread*numClasses);
+                result=probabilityFromDenseResult(result, threadDec, threadProb, threadScratch);
+            }
+            else{
+                result=classifyNodes(sample, model, predict_probability, threadProb, calculateDecisionValues, threadDec, threadScratch); //classify sample with probability estimates
+            }
+            storeRow(j, result, threadProb, threadDec);
+        }
+    }
+    
+    // same results as above, the kernel values of batchRows samples at a time come from the dense engine
+    void classifyBatches(size_t begin, size_t end, int thread, double *threadProb, double *threadDec, double *threadScratch){
+        const int columns=source.data.columns;
+        double *threadSamples=samples+thread*batchRows*columns;
+        double *threadKValues=kvalues != NULL ? kvalues+thread*batchRows*dense->l : NULL;
+        int *threadVote=vote+thread*numClasses;
+        
+        for (size_t batch=begin; batch<end; batch+=batchRows) {
+            size_t numSamples=end-batch<batchRows ? end-batch : batchRows;
+            SVMBlockToMatrix(source.data, batch, numSamples, threadSamples);
+            const double *features=threadSamples;
+            int featureColumns=columns;
+            if (featureMap != NULL) { // the mapped samples go to the collapsed LINEAR model
+                double *threadMap=mapBuffer+thread*mapBufferSize;
+                mapDenseSamples(featureMap, threadSamples, numSamples, columns, threadMap, threadMap+batchRows*featureMap->numBasis);
+                features=threadMap+batchRows*featureMap->numBasis;
+                featureColumns=featureMap->outputDim;
+            }
+            if (dense->w == NULL) {
+                denseKernelValues(dense, threadSamples, numSamples, columns, threadKValues);
+            }
+            
+            for (size_t i=0; i<numSamples; i++) {
+                double result;
+                if (dense->w != NULL) {
+                    result=linearDecisionValues(dense, features+i*featureColumns, featureColumns, threadDec, threadVote);
+                }
+                else{
+                    result=denseDecisionValues(dense, threadKValues+i*dense->l, threadDec, threadVote);
+                }
+                result=probabilityFromDenseResult(result, threadDec, threadProb, threadScratch);
+                storeRow(batch+i, result, threadProb, threadDec);
+            }
+        }
+    }
+    
+    // the engine only computes decision values, the probabilities are derived from them as in classifyNodes()
+    double probabilityFromDenseResult(double result, const double *threadDec, double *threadProb, double *threadScratch){
+        int svm_type=svm_get_svm_type(model);
+        if (predict_probability && (svm_type == C_SVC || svm_type == NU_SVC)) {
+            return probabilityFromDecisionValues(model, threadDec, threadProb, threadScratch);
+        }
+        return result;
+    }
+    
+    void storeRow(size_t j, double result, const double *threadProb, const double *threadDec){
+        SVMStoreRow(resultBlock, j, &result, 1); //write data back to igor
+        
+        if (probBlock.data != NULL) {
+            SVMStoreRow(probBlock, j, threadProb, numClasses); // the probability estimate of each class
+        }
+        
+        if (decBlock.data != NULL) {
+            SVMStoreRow(decBlock, j, threadDec, numberOfDecisionValues);
+        }
+    }
+};
+
 /*
  ExecuteSVMClassify load the model and runs classification / regression of the input data.
  */
@@ -486,9 +1604,11 @@ ExecuteSVMClassify(SVMClassifyRuntimeParamsPtr p)
     int err = 0;
     char inPutPath[MAX_PATH_LEN+1]="";
     struct svm_model *model=NULL;
+    int modelID=0;
     struct svm_node *nodes=NULL;
     int predict_probability=0;
     int calculateDecisionValues=0;
+    int outputType=NT_FP32;
     
     if (p->PROBFlagEncountered) { // we want probability values in the output
         predict_probability=1;
@@ -498,35 +1618,60 @@ ExecuteSVMClassify(SVMClassifyRuntimeParamsPtr p)
         calculateDecisionValues=1;
     }
     
-    
-    //locating the model an building the model fileURL
-    if (p->PFlagEncountered && p->modelNameEncountered && p->modelname != NULL) {
-        // Parameter: p->modelPath
-        char fileName[256];
-        GetCStringFromHandle(p->modelname, fileName, sizeof(fileName));
-        GetFullPathFromSymbolicPathAndFilePath(p->pathName, fileName, inPutPath);
+    if (p->DPFlagEncountered) { // double precision output waves
+        outputType=NT_FP64;
     }
-    else if(XOPOpenFileDialog("Select the model file", "", NULL, "", inPutPath) != 0){//prompt user
-        return FILE_NOT_FOUND;
+    
+    int sparse=0;
+    double sparseThreshold=0;
+    if (p->SPARSEFlagEncountered) { // drop points with |value| <= threshold from the nodes
+        sparse=1;
+        if (p->SPARSEFlagParamsSet[0]) {
+            sparseThreshold=fabs(p->sparseThreshold);
+        }
     }
-#ifdef MACIGOR
-    HFSToPosixPath(inPutPath, inPutPath, 0); //platform specific URL conversion
-#endif
     
-    model=svm_load_model(inPutPath); // actually load the model
+    int tripletInput=p->sparseInputEncountered && p->rowWave != NULL && p->columnWave != NULL && p->valueWave != NULL;
+    int fileInput=p->inputFileEncountered;
+    if ((fileInput && ((p->inputWaveEncountered && p->inPutWave != NULL) || tripletInput)) || (p->RAWFlagEncountered && !fileInput)) { // the samples come from one place
+        return INCOMPATIBLE_FLAGS;
+    }
+    int denseOnly=p->DENSEFlagEncountered; // the rows go to the batch engine, no nodes
+    if (denseOnly && (tripletInput || sparse || (fileInput && !p->RAWFlagEncountered))) { // nodes are the only form of sparse samples and text files
+        return INCOMPATIBLE_FLAGS;
+    }
     
-    if (model == NULL) {
-        return FILE_OPEN_ERROR; // if we failed to load the model, abort
+    if (p->IDFlagEncountered) { // use a resident model, no file access at all
+        modelID=(int)p->modelID;
+        model=modelForID(modelID);
+        if (model == NULL) {
+            return UNKNOWN_MODEL_ID;
+        }
+    }
+    else{
+        //locating the model an building the model fileURL
+        if ((err=getModelPath(p->PFlagEncountered, p->pathName, p->modelNameEncountered ? p->modelname : NULL, inPutPath))) {
+            return err;
+        }
+        
+        if (loadModel(inPutPath, &modelID)) { // actually load the model, or reuse it if the file was loaded before and hasn't changed
+            return FILE_OPEN_ERROR; // if we failed to load the model, abort
+        }
+        model=modelForID(modelID);
+    }
+    const SVMFeatureMap *featureMap=featureMapForID(modelID); // NULL unless the model was trained on an approximate RBF map
+    const size_t mapSize=featureMap != NULL ? (size_t)featureMap->numBasis+featureMap->outputDim : 0;
+    if (denseOnly && denseModelForID(modelID) == NULL) { // PRECOMPUTED kernels or sparse support vectors
+        return NOT_DENSE_MODEL;
     }
 
-    if (p->inputWaveEncountered) {
-        if (p->inPutWave != NULL) {//check if our input data is not NULL
+    if (p->inputWaveEncountered || tripletInput || fileInput) {
+        if (p->inPutWave != NULL || tripletInput || fileInput) {//check if our input data is not NULL
             
             svm_set_print_string_function(&print_string_Igor); // print from libSVM to the igor console
             
-            int numDimensionsInputWave;
-            CountInt dimensionSizesInputWave[MAX_DIMENSIONS+1];
-            MDGetWaveDimensions(p->inPutWave, &numDimensionsInputWave, dimensionSizesInputWave); // get size of input data
+            int numDimensionsInputWave=2; // triplets always describe a matrix of samples
+            CountInt dimensionSizesInputWave[MAX_DIMENSIONS+1]={0};
             
             waveHndl probWave=NULL;
             waveHndl decWave=NULL;
@@ -539,28 +1684,99 @@ ExecuteSVMClassify(SVMClassifyRuntimeParamsPtr p)
             double *prob_estimates=(double *) malloc(numClasses*sizeof(double)); //buffer to hold prob estimates
             double *decisionValues=(double *) malloc(numberOfDecisionValues*sizeof(double)); //buffer to hold prob estimates
             
+            SVMSampleSource source={}; // where the samples come from, see SVMSampleNodes()
+            struct svm_node *tripletBuffer=NULL;
+            struct SVMDataFile dataFile={}; // mapped input file, see SVMDataFile.h
+            
+            if (tripletInput) { // the triplets are converted to nodes up front, the number of samples is given by the largest row index
+                err=makeTripletNodes(p->rowWave, p->columnWave, p->valueWave, sparse, sparseThreshold, &source.rows, &tripletBuffer, &source.x);
+                dimensionSizesInputWave[0]=(CountInt)source.rows;
+            }
+            else if (fileInput) { // a raw matrix is read from the mapping like a wave, the lines of a text file are converted to nodes chunk by chunk below
+                char dataPath[MAX_PATH_LEN+1];
+                if ((err=getDataFilePath(p->inputFile, dataPath)) == 0) {
+                    int mapErr=p->RAWFlagEncountered ? mapRawDataFile(dataPath, dataTypeFromNumType((int)p->rawType), (int)p->rawColumns, &dataFile) : mapTextDataFile(dataPath, p->THREADSFlagEncountered ? (p->THREADSFlagParamsSet[0] ? (int)p->numThreads : 0) : 1, &dataFile);
+                    err=mapErr<0 ? FILE_OPEN_ERROR : (mapErr>0 ? DATA_FILE_FORMAT : 0);
+                }
+                if (err == 0 && p->RAWFlagEncountered) {
+                    source.data=dataFile.block;
+                    source.sparse=sparse;
+                    source.threshold=sparseThreshold;
+                }
+                else if (err == 0 && (source.x=Malloc(struct svm_node *, dataFile.rows)) == NULL) { // one pointer per sample, the nodes of the current chunk
+                    err=NOMEM;
+                }
+                source.rows=dataFile.rows;
+                dimensionSizesInputWave[0]=(CountInt)dataFile.rows;
+            }
+            else if ((err=MDGetWaveDimensions(p->inPutWave, &numDimensionsInputWave, dimensionSizesInputWave)) == 0) { // get size of input data
+                err=getDataBlock(p->inPutWave, &source.data); // direct access to the wave data, fails for text waves
+                if (err == 0 && numDimensionsInputWave == 3) { // image stack: pixel (row, column) is sample row+column*rows, its layers are the points, read in place one layer apart
+                    source.data.rows=(size_t)dimensionSizesInputWave[0]*dimensionSizesInputWave[1];
+                    source.data.columns=(int)dimensionSizesInputWave[2];
+                    source.data.columnStride=source.data.rows;
+                }
+                else if (err == 0 && numDimensionsInputWave>3) {
+                    err=NEEDS_1D_2D_OR_3D_WAVE;
+                }
+                source.rows=source.data.rows;
+                source.sparse=sparse;
+                source.threshold=sparseThreshold;
+            }
+            int kernelColumns=precomputedColumns(model); // 0 unless the model has a PRECOMPUTED kernel
+            if (err == 0 && kernelColumns>0) { // each sample is a row of kernel values against the training samples
+                if (tripletInput) {
+                    err=INCOMPATIBLE_FLAGS;
+                }
+                else if (dataFile.lines != NULL) {
+                    if (dataFile.columns<kernelColumns) { // node j holds column j-1, as for svm-predict
+                        err=KERNEL_MATRIX_SIZE;
+                    }
+                }
+                else if ((numDimensionsInputWave>1 ? source.data.columns : (int)dimensionSizesInputWave[0])<kernelColumns) {
+                    err=KERNEL_MATRIX_SIZE;
+                }
+                source.precomputed=1;
+                source.sparse=0; // the values are looked up by position
+            }
+            if (err) {
+                free(tripletBuffer);
+                free(source.x);
+                unmapDataFile(&dataFile);
+                free(prob_estimates);
+                free(decisionValues);
+                return err;
+            }
+            
             if (numDimensionsInputWave>1) { //classify a matrux of sample vectors
                 
-                elements=(int)dimensionSizesInputWave[0];
-                points=(int)dimensionSizesInputWave[1];
+                elements=(int)source.rows; // pixels of an image stack
+                points=source.data.columns; // 0 for triplets and text files, the nodes are taken from source.x
+                int image=numDimensionsInputWave == 3; // the results of an image stack are images, the outputs get a dimension for the pixel columns
+                int outputDimension=image ? 2 : 1; // classes and decision values
                 
                 waveHndl outWave; // hold the classification result
                 
                 if (predict_probability) { // we want probability data, allocate the requires structures
                     if(svm_check_probability_model(model)){// the model supports probability data
                         CountInt probSize[MAX_DIMENSIONS+1]={0};
-                        probSize[0]=elements;//probability output matrix. same number of rows as our input data
-                        probSize[1]=numClasses;//probability output matrix. one columns per class
-                        MDMakeWave(&probWave, "M_SVMProb", NULL, probSize, NT_FP32, 1);// make a wave (igor pro buffer) with the correct dimensions
+                        probSize[0]=dimensionSizesInputWave[0];//probability output matrix. same number of rows as our input data
+                        probSize[1]=image ? dimensionSizesInputWave[1] : numClasses;//probability output matrix. one columns per class, one layer per class for images
+                        probSize[2]=image ? numClasses : 0;
+                        if ((err=MDMakeWave(&probWave, "M_SVMProb", NULL, probSize, outputType, 1))) {// make a wave (igor pro buffer) with the correct dimensions
+                            probWave=NULL;
+                        }
                         
                         //properly label each column with the sample class
-                        int *labels=Malloc(int, numClasses);
-                        svm_get_labels(model, labels);
+                        int *labels=err == 0 ? Malloc(int, numClasses) : NULL;
+                        if (labels != NULL) {
+                            svm_get_labels(model, labels);
+                        }
                         int bLength=snprintf(NULL, 0, "%d",INT_MAX);
                         char *buffer=(char*)malloc(bLength+1);
-                        for (int i=0; i<numClasses; i++) {
+                        for (int i=0; labels != NULL && buffer != NULL && i<numClasses; i++) {
                             snprintf(buffer,bLength+1, "%d",labels[i]);
-                            MDSetDimensionLabel(probWave, 1, i, buffer);
+                            MDSetDimensionLabel(probWave, outputDimension, i, buffer);
                         }
                         free(buffer);
                         free(labels);
@@ -572,22 +1788,27 @@ ExecuteSVMClassify(SVMClassifyRuntimeParamsPtr p)
                     }
                 }
                 
-                if (calculateDecisionValues) {
+                if (calculateDecisionValues && err == 0) {
                     CountInt decSize[MAX_DIMENSIONS+1]={0};
-                    decSize[0]=elements;
-                    decSize[1]=numberOfDecisionValues;
-                    MDMakeWave(&decWave, "M_SVMDec", NULL, decSize, NT_FP32, 1);// make a wave (igor pro buffer) with the correct dimensions
+                    decSize[0]=dimensionSizesInputWave[0];
+                    decSize[1]=image ? dimensionSizesInputWave[1] : numberOfDecisionValues;
+                    decSize[2]=image ? numberOfDecisionValues : 0;
+                    if ((err=MDMakeWave(&decWave, "M_SVMDec", NULL, decSize, outputType, 1))) {// make a wave (igor pro buffer) with the correct dimensions
+                        decWave=NULL;
+                    }
                     
-                    int *labels=Malloc(int, numClasses);
-                    svm_get_labels(model, labels);
+                    int *labels=err == 0 ? Malloc(int, numClasses) : NULL;
+                    if (labels != NULL) {
+                        svm_get_labels(model, labels);
+                    }
                     int bLength=snprintf(NULL, 0, "Dec %d-%d",INT_MAX,INT_MAX);
                     char *buffer=(char*)malloc(bLength+1);
                     
                     int p=0;
-                    for (int i=0; i<numClasses; i++) {
+                    for (int i=0; labels != NULL && buffer != NULL && i<numClasses; i++) {
                         for (int j=i+1; j<numClasses; j++) {
                             snprintf(buffer,bLength+1, "Dec %d-%d",labels[i],labels[j]);
-                            MDSetDimensionLabel(decWave, 1, p, buffer);
+                            MDSetDimensionLabel(decWave, outputDimension, p, buffer);
                             p++;
                         }
                     }
@@ -596,78 +1817,196 @@ ExecuteSVMClassify(SVMClassifyRuntimeParamsPtr p)
                     
                 }
                 
-                MakeWave(&outWave, "W_SVMResult", elements, NT_FP32, 1); // data structure to hold the classification result
+                if (err == 0 && image) { // label image, same layout as one layer of the stack
+                    CountInt imageSize[MAX_DIMENSIONS+1]={0};
+                    imageSize[0]=dimensionSizesInputWave[0];
+                    imageSize[1]=dimensionSizesInputWave[1];
+                    if ((err=MDMakeWave(&outWave, "W_SVMResult", NULL, imageSize, outputType, 1)) == 0) {
+                        copyImageScaling(p->inPutWave, outWave);
+                        copyImageScaling(p->inPutWave, probWave);
+                        copyImageScaling(p->inPutWave, decWave);
+                    }
+                }
+                else if (err == 0) {
+                    err=MakeWave(&outWave, "W_SVMResult", elements, outputType, 1); // data structure to hold the classification result
+                }
+                if (err) { // out of memory or a name conflict, nothing to write to
+                    free(prob_estimates);
+                    free(decisionValues);
+                    free(tripletBuffer);
+                    free(source.x);
+                    unmapDataFile(&dataFile);
+                    return err;
+                }
                 
-                double result[2]={0}; // holds the classification result. to hand it over to igor, it has to be a 2 point array, since data could be complex
+                // the output waves are written through their data pointers, column-major (see SVMWaveData.h). Pixel j of an image is point j of a layer, so images are written as matrices with one row per pixel
+                SVMOutputBlock resultBlock={WaveData(outWave), outputType == NT_FP64, (size_t)elements};
+                SVMOutputBlock probBlock={probWave != NULL ? WaveData(probWave) : NULL, outputType == NT_FP64, (size_t)elements};
+                SVMOutputBlock decBlock={decWave != NULL ? WaveData(decWave) : NULL, outputType == NT_FP64, (size_t)elements};
                 
-                nodes=Malloc(struct svm_node,points+1); // a buffer to hold the data to classify
-                //structs to locate the data in the data to classify
-                IndexInt dataIndices[MAX_DIMENSIONS]={0};
-                IndexInt outIndices[MAX_DIMENSIONS]={0};
+                int numThreads=1;
+                if (p->THREADSFlagEncountered) { // rows are independent, split them across workers
+                    numThreads=SVMNumberOfThreads(p->THREADSFlagParamsSet[0] ? (int)p->numThreads : 0, (size_t)elements);
+                }
                 
+                ClassifyRows classify;
+                classify.source=source;
+                classify.model=model;
+                classify.predict_probability=predict_probability && probWave != NULL;
+                classify.calculateDecisionValues=calculateDecisionValues;
+                classify.numClasses=numClasses;
+                classify.numberOfDecisionValues=numberOfDecisionValues;
+                classify.resultBlock=resultBlock;
+                classify.probBlock=probBlock;
+                classify.decBlock=decBlock;
+                classify.blockNodes=source.x == NULL && !source.sparse && !source.precomputed && points <= 4096; // the nodes of a block stay within a few MB
+                classify.nodesPerThread=classify.blockNodes ? SVM_ROW_BLOCK*((size_t)points+1) : (size_t)points+(source.precomputed ? 2 : 1);
+                classify.nodes=denseOnly ? NULL : Malloc(struct svm_node, classify.nodesPerThread*numThreads); // a buffer per worker to hold the data to classify
+                classify.prob_estimates=Malloc(double, (size_t)numClasses*numThreads);
+                classify.decisionValues=Malloc(double, (size_t)(numberOfDecisionValues>0 ? numberOfDecisionValues : 1)*numThreads);
+                classify.probScratch=Malloc(double, probabilityScratchSize(numClasses)*numThreads);
+                classify.dense=denseModelForID(modelID);
+                classify.denseInput=!tripletInput && !sparse && points>0; // dense samples, use the blocked kernel evaluation if the model allows
+                classify.samples=NULL;
+                classify.kvalues=NULL;
+                classify.vote=NULL;
+                classify.featureMap=featureMap;
+                classify.mapBuffer=NULL;
+                classify.mapBufferSize=0;
+                classify.mappedNodes=NULL;
+                if (classify.dense != NULL && classify.dense->w == NULL && !classify.denseInput) { // kernel values need dense samples, only the collapsed LINEAR models work on nodes
+                    classify.dense=NULL;
+                }
+                if (classify.dense != NULL) {
+                    classify.batchRows=denseBatchRows(classify.dense);
+                    classify.vote=Malloc(int, (size_t)numClasses*numThreads);
+                    if (classify.denseInput) {
+                        classify.samples=Malloc(double, classify.batchRows*points*numThreads);
+                    }
+                    if (classify.dense->w == NULL) {
+                        classify.kvalues=Malloc(double, classify.batchRows*classify.dense->l*numThreads);
+                    }
+                    if (classify.vote == NULL || (classify.denseInput && classify.samples == NULL) || (classify.dense->w == NULL && classify.kvalues == NULL)) { // not enough memory for the engine, classify the nodes
+                        classify.dense=NULL;
+                    }
+                }
+                if (denseOnly && classify.dense == NULL) { // no nodes to fall back to
+                    err=NOMEM;
+                }
+                else if (classify.dense == NULL && nodeModelForID(modelID) == NULL) { // libSVM predicts with the nodes of the support vectors, quantized models rebuild them
+                    err=NOMEM;
+                }
+                if (featureMap != NULL) { // a batch of mapped samples for the engine, otherwise one sample at a time
+                    classify.mapBufferSize=classify.dense != NULL && classify.denseInput ? classify.batchRows*mapSize : mapSize;
+                    classify.mapBuffer=Malloc(double, classify.mapBufferSize*numThreads);
+                    classify.mappedNodes=Malloc(struct svm_node, ((size_t)featureMap->outputDim+1)*numThreads);
+                }
                 
-                double value[2]={0};
-                for (int j=0; j<elements; j++) {
-                    for (int i=0; i<points; i++) {
-                        dataIndices[1]=i;
-                        dataIndices[0]=j;
-                        MDGetNumericWavePointValue(p->inPutWave, dataIndices, value);
-                        nodes[i].index=i+1;
-                        nodes[i].value=value[0];
+                if (err || (classify.nodes == NULL && !denseOnly) || classify.prob_estimates == NULL || classify.decisionValues == NULL || classify.probScratch == NULL || (featureMap != NULL && (classify.mapBuffer == NULL || classify.mappedNodes == NULL))) {
+                    err=NOMEM;
+                }
+                else{
+                    if (numThreads>1) {
+                        svm_set_print_string_function(&print_null); // no console output from the workers
                     }
-                    nodes[points].index=-1; //populate the input buffer with one sample (see makeProblem())
-                    
-                    result[0]=classifyNodes(nodes, model, predict_probability, prob_estimates,calculateDecisionValues,decisionValues); //classify sample with probability estimates
-                    outIndices[0]=j;// set igor output index (row number)
-                    MDSetNumericWavePointValue(outWave, outIndices, result); //write data back to igor
-                    
-                    if (predict_probability && probWave != NULL) {
-                        IndexInt probIndices[MAX_DIMENSIONS]={0};
-                        double v[2]={0};// holds the probability estimate
-                        for (int n=0; n<numClasses; n++) { // iterate over the probability estimate of each class and write it into the igor matrix
-                            probIndices[0]=j;
-                            probIndices[1]=n;
-                            v[0]=prob_estimates[n];
-                            MDSetNumericWavePointValue(probWave, probIndices, v);
+                    if (dataFile.lines != NULL) { // text file: the nodes of about SVM_FILE_CHUNK bytes of lines at a time, their results go to the output waves before the next chunk is read
+                        for (size_t first=0; first<dataFile.rows && err == 0; ) {
+                            size_t chunkRows=textChunkRows(&dataFile, first);
+                            struct svm_node *chunkBuffer=NULL;
+                            if (textFileNodes(&dataFile, first, chunkRows, sparse && !source.precomputed, sparseThreshold, numThreads, &chunkBuffer, source.x+first, NULL)) {
+                                err=NOMEM;
+                            }
+                            else{
+                                SVMParallelForRange(first, chunkRows, SVM_ROW_BLOCK, numThreads, classify);
+                            }
+                            free(chunkBuffer);
+                            first+=chunkRows;
                         }
                     }
-                    
-                    if (calculateDecisionValues == 1 && decWave != NULL) {
-                        IndexInt decIndices[MAX_DIMENSIONS]={0};
-                        double v[2]={0};// holds the decision value estimate
-                        for (int n=0; n<numberOfDecisionValues; n++) {
-                            decIndices[0]=j;
-                            decIndices[1]=n;
-                            v[0]=decisionValues[n];
-                            MDSetNumericWavePointValue(decWave, decIndices, v);
-                        }
+                    else{
+                        SVMParallelFor((size_t)elements, SVM_ROW_BLOCK, numThreads, classify); // same results as one row after the other, each row is written by one worker
                     }
+                    svm_set_print_string_function(&print_string_Igor);
                 }
-                free(nodes);
+                free(classify.nodes);
+                free(classify.prob_estimates);
+                free(classify.decisionValues);
+                free(classify.probScratch);
+                free(classify.samples);
+                free(classify.kvalues);
+                free(classify.vote);
+                free(classify.mapBuffer);
+                free(classify.mappedNodes);
                 
+                WaveHandleModified(outWave); // we wrote to the waves directly, let Igor know
+                if (probWave != NULL) {
+                    WaveHandleModified(probWave);
+                }
+                if (decWave != NULL) {
+                    WaveHandleModified(decWave);
+                }
                 
             }
             else{// classify only one sample vector, report in a variable in igor
                 points=(int)dimensionSizesInputWave[0];
-                nodes=Malloc(struct svm_node,points+1);
-                IndexInt dataIndices[MAX_DIMENSIONS]={0};
-                double value[2]={0};
-                for (int i=0; i<points; i++) {
-                    dataIndices[0]=i;
-                    MDGetNumericWavePointValue(p->inPutWave, dataIndices, value);
-                    nodes[i].index=i+1;
-                    nodes[i].value=value[0];
-                }
-                nodes[points].index=-1;
-                double *prob_estimates=NULL;
-                double result=classifyNodes(nodes, model, predict_probability, prob_estimates,calculateDecisionValues,decisionValues);
+                nodes=Malloc(struct svm_node,points+(source.precomputed ? 2 : 1));
+                double *probScratch=Malloc(double, probabilityScratchSize(numClasses));
+                if (nodes == NULL || probScratch == NULL || prob_estimates == NULL || decisionValues == NULL || nodeModelForID(modelID) == NULL) { // libSVM predicts with the nodes of the support vectors
+                    free(probScratch);
+                    free(nodes);
+                    free(prob_estimates);
+                    free(decisionValues);
+                    free(tripletBuffer);
+                    free(source.x);
+                    unmapDataFile(&dataFile);
+                    return NOMEM;
+                }
+                source.data.rows=1; // the wave holds one sample, its points are the columns
+                source.data.columns=points;
+                source.data.columnStride=1;
+                const svm_node *sample=SVMSampleNodes(source, 0, nodes);
+                double *mapBuffer=NULL;
+                struct svm_node *mappedNodes=NULL;
+                if (featureMap != NULL) { // classify the mapped sample
+                    mapBuffer=Malloc(double, mapSize);
+                    mappedNodes=Malloc(struct svm_node, featureMap->outputDim+1);
+                    if (mapBuffer == NULL || mappedNodes == NULL) {
+                        free(mapBuffer);
+                        free(mappedNodes);
+                        free(probScratch);
+                        free(nodes);
+                        free(prob_estimates);
+                        free(decisionValues);
+                        free(tripletBuffer);
+                        free(source.x);
+                        return NOMEM;
+                    }
+                    mapNodes(featureMap, sample, mapBuffer, mappedNodes);
+                    sample=mappedNodes;
+                }
+                int probabilityModel=predict_probability && svm_check_probability_model(model);
+                double result=classifyNodes(sample, model, probabilityModel, prob_estimates,calculateDecisionValues,decisionValues,probScratch);
+                free(mapBuffer);
+                free(mappedNodes);
+                free(probScratch);
                 SetOperationNumVar("V_SVMClass",result);
+                if (probabilityModel) { // report the probability of the predicted class
+                    double maxProb=0;
+                    for (int n=0; n<numClasses; n++) {
+                        if (prob_estimates[n]>maxProb) {
+                            maxProb=prob_estimates[n];
+                        }
+                    }
+                    SetOperationNumVar("V_SVMProb",maxProb);
+                }
                 free(nodes);
             }
             svm_set_print_string_function(NULL);
-            svm_free_and_destroy_model(&model);
             free(prob_estimates);
             free(decisionValues);
+            free(tripletBuffer);
+            free(source.x);
+            unmapDataFile(&dataFile);
         }
         else{
             return NULL_WAVE_OP;
@@ -685,21 +2024,20 @@ ExecuteSVMClassify(SVMClassifyRuntimeParamsPtr p)
 }
 
 /*
- helper function to run the classification of sample vector *nodes with *model. optionally report probability estimates into *prob_estimates (needs to be allocated and appropriately sized)
+ helper function to run the classification of sample vector *nodes with *model. optionally report probability estimates into *prob_estimates (needs to be allocated and appropriately sized) and decision values into *decisionValues.
+ The sample is evaluated only once: the probability estimates are derived from the decision values, so decisionValues needs to be allocated whenever predict_probability is set, and probScratch (probabilityScratchSize() doubles, see SVMPredict.h) as well.
  */
 
-double classifyNodes(svm_node *nodes, svm_model *model,int predict_probability, double *prob_estimates, int calculateDecisionValues, double* decisionValues){
+double classifyNodes(const svm_node *nodes, svm_model *model,int predict_probability, double *prob_estimates, int calculateDecisionValues, double* decisionValues, double *probScratch){
     
     int svm_type=svm_get_svm_type(model);
     double predict_label;
-    //int nr_class=svm_get_nr_class(model);
-    //int j=0;
     
-    if (predict_probability && (svm_type==C_SVC || svm_type==NU_SVC)){ // only these types of models support prob estimates in the first place
-        predict_label = svm_predict_probability(model,nodes,prob_estimates); // predict with probability estimates
+    if (predict_probability && (svm_type==C_SVC || svm_type==NU_SVC) && svm_check_probability_model(model)){ // only these types of models support prob estimates in the first place
+        svm_predict_values(model, nodes, decisionValues);
+        predict_label = probabilityFromDecisionValues(model, decisionValues, prob_estimates, probScratch); // probability estimates from the decision values, same result as svm_predict_probability
     }
-    
-    if (calculateDecisionValues && decisionValues != NULL) {
+    else if (calculateDecisionValues && decisionValues != NULL) {
         predict_label = svm_predict_values(model, nodes, decisionValues);
     }
     else{
@@ -711,33 +2049,1268 @@ double classifyNodes(svm_node *nodes, svm_model *model,int predict_probability,
 
 
 /*
- Igor pro specific functions
+ helper function, the result images of an image stack get the scaling of its rows and columns. Does nothing if image is NULL.
  */
 
-static int
-RegisterSVMClassify(void)
-{
-    const char* cmdTemplate;
-    const char* runtimeNumVarList;
-    const char* runtimeStrVarList;
-    
-    // NOTE: If you change this template, you must change the SVMClassifyRuntimeParams structure as well.
-    cmdTemplate = "SVMClassify /PROB /DEC /P=name:pathName modelName=string:modelname, inputWave=wave:inPutWave";
-    runtimeNumVarList = "V_SVMClass;V_SVMProb";
-    runtimeStrVarList = "";
-    return RegisterOperation(cmdTemplate, runtimeNumVarList, runtimeStrVarList, sizeof(SVMClassifyRuntimeParams), (void*)ExecuteSVMClassify, 0);
+void copyImageScaling(waveHndl stack, waveHndl image){
+    if (image == NULL) {
+        return;
+    }
+    for (int dimension=0; dimension<2; dimension++) {
+        double sfA, sfB;
+        if (MDGetWaveScaling(stack, dimension, &sfA, &sfB) == 0) {
+            MDSetWaveScaling(image, dimension, &sfA, &sfB);
+        }
+    }
 }
 
-static int
-RegisterSVMTrain(void)
-{
-    const char* cmdTemplate;
-    const char* runtimeNumVarList;
-    const char* runtimeStrVarList;
+
+/*
+ helper function to build the native path of a model file from a symbolic path and a file name. Without both, the user selects the file in a dialog.
+ */
+
+int getModelPath(int pathEncountered, const char *pathName, Handle modelName, char *fullPath){
+    if (pathEncountered && modelName != NULL) {
+        char fileName[256];
+        GetCStringFromHandle(modelName, fileName, sizeof(fileName));
+        GetFullPathFromSymbolicPathAndFilePath(pathName, fileName, fullPath);
+    }
+    else if(XOPOpenFileDialog("Select the model file", "", NULL, "", fullPath) != 0){//prompt user
+        return FILE_NOT_FOUND;
+    }
+#ifdef MACIGOR
+    HFSToPosixPath(fullPath, fullPath, 0); //platform specific URL conversion
+#endif
+    return 0;
+}
+
+
+// Operation template: SVMModelLoad /P=name:pathName modelName=string:modelName
+
+// Runtime param structure for SVMModelLoad operation.
+#pragma pack(2)    // All structures passed to Igor are two-byte aligned.
+struct SVMModelLoadRuntimeParams {
+    // Flag parameters.
+    
+    // Parameters for /P flag group. url for the folder holding the model
+    int PFlagEncountered;
+    char pathName[MAX_OBJ_NAME+1];
+    int PFlagParamsSet[1];
+    
+    // Main parameters.
+    
+    // Parameters for modelName keyword group. filename of model
+    int modelNameEncountered;
+    Handle modelName;
+    int modelNameParamsSet[1];
+    
+    // These are postamble fields that Igor sets.
+    int calledFromFunction;                    // 1 if called from a user function, 0 otherwise.
+    int calledFromMacro;                    // 1 if called from a macro, 0 otherwise.
+};
+typedef struct SVMModelLoadRuntimeParams SVMModelLoadRuntimeParams;
+typedef struct SVMModelLoadRuntimeParams* SVMModelLoadRuntimeParamsPtr;
+#pragma pack()    // Reset structure alignment to default.
+
+/*
+ ExecuteSVMModelLoad loads a model file once and keeps it resident, SVMClassify /ID=V_SVMModelID uses it without touching the disk. Loading an unchanged file again returns the same ID.
+ */
+
+extern "C" int
+ExecuteSVMModelLoad(SVMModelLoadRuntimeParamsPtr p)
+{
+    int err = 0;
+    char inPutPath[MAX_PATH_LEN+1]="";
+    int modelID;
+    
+    if ((err=getModelPath(p->PFlagEncountered, p->pathName, p->modelNameEncountered ? p->modelName : NULL, inPutPath))) {
+        return err;
+    }
+    
+    if (loadModel(inPutPath, &modelID)) {
+        return FILE_OPEN_ERROR;
+    }
+    
+    SetOperationNumVar("V_SVMModelID", modelID);
+    SetOperationStrVar("S_fileName", inPutPath);
+    
+    return err;
+}
+
+
+// Operation template: SVMModelFree /A id=number:modelID
+
+// Runtime param structure for SVMModelFree operation.
+#pragma pack(2)    // All structures passed to Igor are two-byte aligned.
+struct SVMModelFreeRuntimeParams {
+    // Flag parameters.
+    
+    // Parameters for /A flag group. free all resident models
+    int AFlagEncountered;
+    // There are no fields for this group because it has no parameters.
+    
+    // Main parameters.
+    
+    // Parameters for id keyword group. ID of the model to free
+    int idEncountered;
+    double modelID;
+    int idParamsSet[1];
+    
+    // These are postamble fields that Igor sets.
+    int calledFromFunction;                    // 1 if called from a user function, 0 otherwise.
+    int calledFromMacro;                    // 1 if called from a macro, 0 otherwise.
+};
+typedef struct SVMModelFreeRuntimeParams SVMModelFreeRuntimeParams;
+typedef struct SVMModelFreeRuntimeParams* SVMModelFreeRuntimeParamsPtr;
+#pragma pack()    // Reset structure alignment to default.
+
+/*
+ ExecuteSVMModelFree releases resident models, including the ones SVMClassify cached for model files.
+ */
+
+extern "C" int
+ExecuteSVMModelFree(SVMModelFreeRuntimeParamsPtr p)
+{
+    if (p->AFlagEncountered) {
+        freeAllModels();
+    }
+    else if (p->idEncountered) {
+        if (freeModel((int)p->modelID)) {
+            return UNKNOWN_MODEL_ID;
+        }
+    }
+    else{
+        return EXPECTED_XOP_PARAM;
+    }
+    return 0;
+}
+
+
+// Operation template: SVMModelSave /P=name:pathName /BIN id=number:modelID, modelName=string:modelName
+
+// Runtime param structure for SVMModelSave operation.
+#pragma pack(2)    // All structures passed to Igor are two-byte aligned.
+struct SVMModelSaveRuntimeParams {
+    // Flag parameters.
+    
+    // Parameters for /P flag group. url for the folder of the model file
+    int PFlagEncountered;
+    char pathName[MAX_OBJ_NAME+1];
+    int PFlagParamsSet[1];
+    
+    // Parameters for /BIN flag group. save as binary model file (SVMBinaryModel.h), also used if the filename ends with .svmb
+    int BINFlagEncountered;
+    // There are no fields for this group because it has no parameters.
+    
+    // Main parameters.
+    
+    // Parameters for id keyword group. ID of the resident model to save
+    int idEncountered;
+    double modelID;
+    int idParamsSet[1];
+    
+    // Parameters for modelName keyword group. filename of model, in combination with /P for the folder URL.
+    int modelNameEncountered;
+    Handle modelName;
+    int modelNameParamsSet[1];
+    
+    // These are postamble fields that Igor sets.
+    int calledFromFunction;                    // 1 if called from a user function, 0 otherwise.
+    int calledFromMacro;                    // 1 if called from a macro, 0 otherwise.
+};
+typedef struct SVMModelSaveRuntimeParams SVMModelSaveRuntimeParams;
+typedef struct SVMModelSaveRuntimeParams* SVMModelSaveRuntimeParamsPtr;
+#pragma pack()    // Reset structure alignment to default.
+
+/*
+ ExecuteSVMModelSave writes a resident model (SVMTrain /KEEP or SVMModelLoad) to a model file.
+ */
+
+extern "C" int
+ExecuteSVMModelSave(SVMModelSaveRuntimeParamsPtr p)
+{
+    char outPutPath[MAX_PATH_LEN+1]="model.svm"; //default file name
+    
+    if (!p->idEncountered) {
+        return EXPECTED_XOP_PARAM;
+    }
+    struct svm_model *model=modelForID((int)p->modelID);
+    if (model == NULL) {
+        return UNKNOWN_MODEL_ID;
+    }
+    if ((model=nodeModelForID((int)p->modelID)) == NULL) { // the nodes of a quantized model are rebuilt
+        return NOMEM;
+    }
+    
+    if (p->PFlagEncountered && p->modelNameEncountered && p->modelName != NULL) { //build the output path using XOPSupport helper functions (platform independent macOS and Win)
+        char fileName[256];
+        GetCStringFromHandle(p->modelName, fileName, sizeof(fileName));
+        GetFullPathFromSymbolicPathAndFilePath(p->pathName, fileName, outPutPath);
+    }
+    else if(XOPSaveFileDialog("Select where to save the model file", "", NULL, "", p->BINFlagEncountered ? "svmb" : "svm", outPutPath) != 0){ // let the user select an output file
+        return FILE_NOT_FOUND;
+    }
+#ifdef MACIGOR
+    HFSToPosixPath(outPutPath, outPutPath, 0); //convert fileURL to posix (on mac)
+#endif
+    
+    if (saveModel(outPutPath, model, featureMapForID((int)p->modelID), p->BINFlagEncountered)) {
+        return FILE_WRITE_ERROR;
+    }
+    SetOperationStrVar("S_fileName", outPutPath);
+    
+    return 0;
+}
+
+
+// Operation template: SVMModelWeights id=number:modelID
+
+// Runtime param structure for SVMModelWeights operation.
+#pragma pack(2)    // All structures passed to Igor are two-byte aligned.
+struct SVMModelWeightsRuntimeParams {
+    // Main parameters.
+    
+    // Parameters for id keyword group. ID of a resident model with a linear kernel
+    int idEncountered;
+    double modelID;
+    int idParamsSet[1];
+    
+    // These are postamble fields that Igor sets.
+    int calledFromFunction;                    // 1 if called from a user function, 0 otherwise.
+    int calledFromMacro;                    // 1 if called from a macro, 0 otherwise.
+};
+typedef struct SVMModelWeightsRuntimeParams SVMModelWeightsRuntimeParams;
+typedef struct SVMModelWeightsRuntimeParams* SVMModelWeightsRuntimeParamsPtr;
+#pragma pack()    // Reset structure alignment to default.
+
+/*
+ ExecuteSVMModelWeights exports the collapsed weight vectors of a resident linear model: M_SVMWeights holds one column per decision function (labeled as the columns of M_SVMDec), one row per feature. W_SVMRho holds rho, the decision value is M_SVMWeights[][p]·x-W_SVMRho[p].
+ */
+
+extern "C" int
+ExecuteSVMModelWeights(SVMModelWeightsRuntimeParamsPtr p)
+{
+    int err=0;
+    
+    if (!p->idEncountered) {
+        return EXPECTED_XOP_PARAM;
+    }
+    struct svm_model *model=modelForID((int)p->modelID);
+    if (model == NULL) {
+        return UNKNOWN_MODEL_ID;
+    }
+    if (model->param.kernel_type != LINEAR) {
+        return NOT_LINEAR_MODEL;
+    }
+    const SVMDenseModel *dense=denseModelForID((int)p->modelID);
+    if (dense == NULL || dense->w == NULL) {
+        return NOMEM;
+    }
+    
+    waveHndl weightWave;
+    waveHndl rhoWave;
+    CountInt weightSize[MAX_DIMENSIONS+1]={0};
+    weightSize[0]=dense->dim;
+    weightSize[1]=dense->numDecisionValues;
+    if ((err=MDMakeWave(&weightWave, "M_SVMWeights", NULL, weightSize, NT_FP64, 1))) {
+        return err;
+    }
+    if ((err=MakeWave(&rhoWave, "W_SVMRho", dense->numDecisionValues, NT_FP64, 1))) {
+        return err;
+    }
+    
+    double *weights=(double*)WaveData(weightWave); // column-major, one decision function per column like dense->w
+    double *rho=(double*)WaveData(rhoWave);
+    for (int i=0; i<dense->numDecisionValues; i++) {
+        memcpy(weights+(size_t)i*dense->dim, dense->w+(size_t)i*dense->dim, dense->dim*sizeof(double));
+        rho[i]=model->rho[i];
+    }
+    
+    if (dense->numDecisionValues>1) { // classification, label the columns with the class pair
+        int numClasses=svm_get_nr_class(model);
+        int *labels=Malloc(int, numClasses);
+        svm_get_labels(model, labels);
+        int bLength=snprintf(NULL, 0, "Dec %d-%d",INT_MAX,INT_MAX);
+        char *buffer=(char*)malloc(bLength+1);
+        
+        int n=0;
+        for (int i=0; i<numClasses; i++) {
+            for (int j=i+1; j<numClasses; j++) {
+                snprintf(buffer,bLength+1, "Dec %d-%d",labels[i],labels[j]);
+                MDSetDimensionLabel(weightWave, 1, n, buffer);
+                MDSetDimensionLabel(rhoWave, 0, n, buffer);
+                n++;
+            }
+        }
+        free(buffer);
+        free(labels);
+    }
+    
+    WaveHandleModified(weightWave);
+    WaveHandleModified(rhoWave);
+    return 0;
+}
+
+
+// Operation template: SVMModelQuantize /BITS=number:bits /THREADS[=number:numThreads] id=number:modelID, validation={wave:validationWave, wave:validationClasses}
+
+// Runtime param structure for SVMModelQuantize operation.
+#pragma pack(2)    // All structures passed to Igor are two-byte aligned.
+struct SVMModelQuantizeRuntimeParams {
+    // Flag parameters.
+    
+    // Parameters for /BITS flag group. bits per support vector value: 16 (half floats, the default), 8 (8 bit integers) or 64 (back to full precision)
+    int BITSFlagEncountered;
+    double bits;
+    int BITSFlagParamsSet[1];
+    
+    // Parameters for /THREADS flag group. predict the validation samples on this many threads, one per core if no number is given
+    int THREADSFlagEncountered;
+    double numThreads;                    // Optional parameter.
+    int THREADSFlagParamsSet[1];
+    
+    // Main parameters.
+    
+    // Parameters for id keyword group. ID of a resident model with a POLY, RBF or SIGMOID kernel
+    int idEncountered;
+    double modelID;
+    int idParamsSet[1];
+    
+    // Parameters for validation keyword group. samples and labels (same layout as for SVMTrain) to compare the quantized model with the full precision model on
+    int validationEncountered;
+    waveHndl validationWave;
+    waveHndl validationClasses;
+    int validationParamsSet[2];
+    
+    // These are postamble fields that Igor sets.
+    int calledFromFunction;                    // 1 if called from a user function, 0 otherwise.
+    int calledFromMacro;                    // 1 if called from a macro, 0 otherwise.
+};
+typedef struct SVMModelQuantizeRuntimeParams SVMModelQuantizeRuntimeParams;
+typedef struct SVMModelQuantizeRuntimeParams* SVMModelQuantizeRuntimeParamsPtr;
+#pragma pack()    // Reset structure alignment to default.
+
+/*
+ ExecuteSVMModelQuantize stores the support vectors a resident model keeps for SVMClassify /ID as half floats or 8 bit integers (SVMQuantize.h), 4 or 8 times less memory than doubles. V_SVMQuantizedBytes and V_SVMFullBytes report the sizes of the dense support vectors.
+ The node support vectors are freed afterwards (releaseSupportVectors()), operations that need them rebuild them from the quantized values. V_SVMResidentBytesBefore and V_SVMResidentBytes report what the model holds for its support vectors, nodes and dense, before and after; models mapped from a binary model file keep their nodes in the mapping.
+ With validation the samples are predicted with the quantized and the full precision model: V_SVMQuantizedScore and V_SVMFullScore are the accuracies in % (mean squared errors for regression), V_SVMQuantizedDifference the % of changed labels (mean squared difference of the values for regression).
+ The model itself and its files are not changed, /BITS=64 restores the full precision.
+ */
+
+extern "C" int
+ExecuteSVMModelQuantize(SVMModelQuantizeRuntimeParamsPtr p)
+{
+    int err=0;
+    
+    if (!p->idEncountered) {
+        return EXPECTED_XOP_PARAM;
+    }
+    int modelID=(int)p->modelID;
+    struct svm_model *model=modelForID(modelID);
+    if (model == NULL) {
+        return UNKNOWN_MODEL_ID;
+    }
+    if ((model=nodeModelForID(modelID)) == NULL) { // quantized again: the nodes are rebuilt from the current support vectors
+        return NOMEM;
+    }
+    int kernel_type=model->param.kernel_type;
+    if (kernel_type != POLY && kernel_type != RBF && kernel_type != SIGMOID) {
+        return NOT_QUANTIZABLE_MODEL;
+    }
+    
+    int quantization=SVM_QUANTIZE_FLOAT16;
+    if (p->BITSFlagEncountered) {
+        switch ((int)p->bits) {
+            case 8:
+                quantization=SVM_QUANTIZE_INT8;
+                break;
+            case 16:
+                quantization=SVM_QUANTIZE_FLOAT16;
+                break;
+            case 64:
+                quantization=SVM_QUANTIZE_NONE;
+                break;
+            default:
+                return INCOMPATIBLE_FLAGS;
+        }
+    }
+    
+    int numThreads=1;
+    if (p->THREADSFlagEncountered) {
+        numThreads=p->THREADSFlagParamsSet[0] ? (int)p->numThreads : 0; // 0: one thread per core
+    }
+    
+    SVMDataBlock samples;
+    struct svm_problem labels={0};
+    int validation=p->validationEncountered;
+    if (validation) { // the same checks as for training data
+        int numDimensionsSamples;
+        int numDimensionsClasses;
+        CountInt dimensionSizesSamples[MAX_DIMENSIONS+1];
+        CountInt dimensionSizesClasses[MAX_DIMENSIONS+1];
+        if (p->validationWave == NULL || p->validationClasses == NULL) {
+            return NULL_WAVE_OP;
+        }
+        if ((err=MDGetWaveDimensions(p->validationWave, &numDimensionsSamples, dimensionSizesSamples)) || (err=MDGetWaveDimensions(p->validationClasses, &numDimensionsClasses, dimensionSizesClasses))) {
+            return err;
+        }
+        if (dimensionSizesSamples[0] != dimensionSizesClasses[0]) {
+            return WAVE_LENGTH_MISMATCH;
+        }
+        SVMDataBlock classes;
+        if ((err=getDataBlock(p->validationWave, &samples)) || (err=getDataBlock(p->validationClasses, &classes)) || (err=makeLabels(&classes, &labels))) {
+            return err;
+        }
+    }
+    
+    struct SVMDenseModel *quantized=NULL;
+    if (makeQuantizedModel(model, quantization, &quantized)) { // sparse support vectors are not stored densely
+        free(labels.y);
+        return NOT_QUANTIZABLE_MODEL;
+    }
+    
+    if (validation) {
+        struct SVMDenseModel *full=NULL;
+        struct SVMQuantizationReport report;
+        if (makeQuantizedModel(model, SVM_QUANTIZE_NONE, &full) || quantizationReport(quantized, full, &samples, labels.y, numThreads, &report)) {
+            err=NOMEM;
+        }
+        else{
+            char notice[1024];
+            snprintf(notice,1024, "Quantized: score %g; full precision: score %g; difference %g\n", report.quantizedScore, report.fullScore, report.difference);
+            XOPNotice(notice);
+            SetOperationNumVar("V_SVMQuantizedScore", report.quantizedScore);
+            SetOperationNumVar("V_SVMFullScore", report.fullScore);
+            SetOperationNumVar("V_SVMQuantizedDifference", report.difference);
+        }
+        freeDenseModel(full);
+        free(labels.y);
+        if (err) {
+            freeDenseModel(quantized);
+            return err;
+        }
+    }
+    
+    SetOperationNumVar("V_SVMQuantizedBytes", (double)supportVectorBytes(quantized));
+    SetOperationNumVar("V_SVMFullBytes", (double)quantized->dim*quantized->l*sizeof(double));
+    double residentBefore=(double)residentSupportVectorBytes(modelID);
+    replaceDenseModel(modelID, quantized); // SVMClassify /ID predicts with it from now on
+    releaseSupportVectors(modelID); // the nodes are rebuilt from it when they are needed
+    SetOperationNumVar("V_SVMResidentBytesBefore", residentBefore);
+    SetOperationNumVar("V_SVMResidentBytes", (double)residentSupportVectorBytes(modelID));
+    return 0;
+}
+
+// Operation template: SVMModelReduce /N=number:targetSV /E=number:errorBound /THREADS[=number:numThreads] id=number:modelID, validation=wave:validationWave
+
+// Runtime param structure for SVMModelReduce operation.
+#pragma pack(2)    // All structures passed to Igor are two-byte aligned.
+struct SVMModelReduceRuntimeParams {
+    // Flag parameters.
+    
+    // Parameters for /N flag group. number of support vectors to keep, with /E the most the search may keep
+    int NFlagEncountered;
+    double targetSV;
+    int NFlagParamsSet[1];
+    
+    // Parameters for /E flag group. largest change of a decision value at the support vectors the reduced model may have, keeps as few support vectors as possible within it
+    int EFlagEncountered;
+    double errorBound;
+    int EFlagParamsSet[1];
+    
+    // Parameters for /THREADS flag group. compute the kernels and predict the validation samples on this many threads, one per core if no number is given
+    int THREADSFlagEncountered;
+    double numThreads;                    // Optional parameter.
+    int THREADSFlagParamsSet[1];
+    
+    // Main parameters.
+    
+    // Parameters for id keyword group. ID of a resident model with a POLY, RBF or SIGMOID kernel
+    int idEncountered;
+    double modelID;
+    int idParamsSet[1];
+    
+    // Parameters for validation keyword group. samples (same layout as for SVMClassify) to compare the reduced model with the original model on
+    int validationEncountered;
+    waveHndl validationWave;
+    int validationParamsSet[1];
+    
+    // These are postamble fields that Igor sets.
+    int calledFromFunction;                    // 1 if called from a user function, 0 otherwise.
+    int calledFromMacro;                    // 1 if called from a macro, 0 otherwise.
+};
+typedef struct SVMModelReduceRuntimeParams SVMModelReduceRuntimeParams;
+typedef struct SVMModelReduceRuntimeParams* SVMModelReduceRuntimeParamsPtr;
+#pragma pack()    // Reset structure alignment to default.
+
+/*
+ ExecuteSVMModelReduce builds a model with fewer support vectors from a resident model (SVMReduce.h): /N keeps that many, /E as few as keep every decision value at the support vectors within the bound. The reduced model is resident as V_SVMModelID, SVMModelSave writes it as an ordinary model file that SVMClassify loads. V_SVMReducedSupportVectors and V_SVMReducedError report its size and the largest change of a decision value.
+ With validation the samples are predicted with both models: V_SVMReducedDifference is the % of changed labels (mean squared difference of the values for regression), V_SVMReducedSpeedup how many times faster the reduced model predicts them. The original model is not changed.
+ */
+
+extern "C" int
+ExecuteSVMModelReduce(SVMModelReduceRuntimeParamsPtr p)
+{
+    int err=0;
+    
+    if (!p->idEncountered) {
+        return EXPECTED_XOP_PARAM;
+    }
+    struct svm_model *model=modelForID((int)p->modelID);
+    if (model == NULL) {
+        return UNKNOWN_MODEL_ID;
+    }
+    if ((model=nodeModelForID((int)p->modelID)) == NULL) { // the nodes of a quantized model are rebuilt
+        return NOMEM;
+    }
+    int kernel_type=model->param.kernel_type;
+    if (kernel_type != POLY && kernel_type != RBF && kernel_type != SIGMOID) { // LINEAR models predict with one weight vector per decision function already
+        return NOT_REDUCIBLE_MODEL;
+    }
+    
+    int targetSV=p->NFlagEncountered ? (int)p->targetSV : 0;
+    double errorBound=p->EFlagEncountered ? p->errorBound : 0;
+    if (targetSV<1 && errorBound <= 0) {
+        return EXPECT_POS_NUM;
+    }
+    
+    int numThreads=1;
+    if (p->THREADSFlagEncountered) {
+        numThreads=p->THREADSFlagParamsSet[0] ? (int)p->numThreads : 0; // 0: one thread per core
+    }
+    
+    SVMDataBlock samples;
+    int validation=p->validationEncountered;
+    if (validation) {
+        if (p->validationWave == NULL) {
+            return NULL_WAVE_OP;
+        }
+        if ((err=getDataBlock(p->validationWave, &samples))) {
+            return err;
+        }
+    }
+    
+    double maxError=0;
+    struct svm_model *reduced=NULL;
+    if ((err=reduceModel(model, targetSV, errorBound, numThreads, &reduced, &maxError))) {
+        return err>0 ? NOT_REDUCIBLE_MODEL : NOMEM; // the kernel matrix of the kept support vectors can't be factored, e.g. SIGMOID
+    }
+    
+    if (validation) {
+        struct SVMReductionReport report;
+        if (reductionReport(reduced, model, &samples, numThreads, &report)) {
+            svm_free_and_destroy_model(&reduced);
+            return NOMEM;
+        }
+        double speedup=report.reducedSeconds>0 ? report.originalSeconds/report.reducedSeconds : 1;
+        char notice[1024];
+        snprintf(notice,1024, "Reduced from %d to %d support vectors: difference %g, %g times faster\n", model->l, reduced->l, report.difference, speedup);
+        XOPNotice(notice);
+        SetOperationNumVar("V_SVMReducedDifference", report.difference);
+        SetOperationNumVar("V_SVMReducedSpeedup", speedup);
+    }
+    
+    SetOperationNumVar("V_SVMReducedSupportVectors", reduced->l);
+    SetOperationNumVar("V_SVMReducedError", maxError);
+    int modelID;
+    registerModel(reduced, NULL, NULL, &modelID);
+    SetOperationNumVar("V_SVMModelID", modelID);
+    return 0;
+}
+
+// Operation template: SVMKernelMatrix /K=number:kernel_type /D=number:degree /Y=number:gamma /CF=number:coef0 /THREADS[=number:numThreads] inputWave=wave:inPutWave, trainWave=wave:trainWave
+
+// Runtime param structure for SVMKernelMatrix operation.
+#pragma pack(2)    // All structures passed to Igor are two-byte aligned.
+struct SVMKernelMatrixRuntimeParams {
+    // Flag parameters.
+    
+    // Parameters for /K flag group. kernel type as in SVMTrain (0-3), PRECOMPUTED is what this operation computes for
+    int KFlagEncountered;
+    double kernel_type;
+    int KFlagParamsSet[1];
+    
+    // Parameters for /D flag group.
+    int DFlagEncountered;
+    double degree;
+    int DFlagParamsSet[1];
+    
+    // Parameters for /Y flag group.
+    int YFlagEncountered;
+    double gamma;
+    int YFlagParamsSet[1];
+    
+    // Parameters for /CF flag group.
+    int CFFlagEncountered;
+    double coef0;
+    int CFFlagParamsSet[1];
+    
+    // Parameters for /THREADS flag group. compute the rows on this many threads, one per core if no number is given
+    int THREADSFlagEncountered;
+    double numThreads;                    // Optional parameter.
+    int THREADSFlagParamsSet[1];
+    
+    // Main parameters.
+    
+    // Parameters for inputWave keyword group. samples of the rows, one per row as for SVMTrain and SVMClassify
+    int inputWaveEncountered;
+    waveHndl inPutWave;
+    int inputWaveParamsSet[1];
+    
+    // Parameters for trainWave keyword group. training samples of the columns, inputWave itself if omitted
+    int trainWaveEncountered;
+    waveHndl trainWave;
+    int trainWaveParamsSet[1];
+    
+    // These are postamble fields that Igor sets.
+    int calledFromFunction;                    // 1 if called from a user function, 0 otherwise.
+    int calledFromMacro;                    // 1 if called from a macro, 0 otherwise.
+};
+typedef struct SVMKernelMatrixRuntimeParams SVMKernelMatrixRuntimeParams;
+typedef struct SVMKernelMatrixRuntimeParams* SVMKernelMatrixRuntimeParamsPtr;
+#pragma pack()    // Reset structure alignment to default.
+
+/*
+ ExecuteSVMKernelMatrix computes the kernel between the samples of inputWave (rows) and trainWave (columns) into the double precision matrix M_SVMKernel, blocks of rows on several threads.
+ The values are what SVMTrain /K=4 and SVMClassify need for a PRECOMPUTED kernel: the matrix of the training samples for training, test samples against training samples for classification. It can be changed or combined with other kernels in Igor before it is used, and reused for many trainings.
+ */
+
+extern "C" int
+ExecuteSVMKernelMatrix(SVMKernelMatrixRuntimeParamsPtr p)
+{
+    struct svm_parameter params={0};
+    int err=0;
+    
+    if (p->KFlagEncountered && p->kernel_type >= 0 && p->kernel_type<PRECOMPUTED) {
+        params.kernel_type=(int)p->kernel_type;
+    }
+    else{
+        return INCOMPATIBLE_FLAGS;
+    }
+    if (p->DFlagEncountered) {
+        params.degree=(int)p->degree;
+    }
+    if (p->YFlagEncountered) {
+        params.gamma=p->gamma;
+    }
+    if (p->CFFlagEncountered) {
+        params.coef0=p->coef0;
+    }
+    
+    int numThreads=1;
+    if (p->THREADSFlagEncountered) {
+        numThreads=p->THREADSFlagParamsSet[0] ? (int)p->numThreads : 0; // 0: one thread per core
+    }
+    
+    if (!p->inputWaveEncountered) {
+        return NOWAV;
+    }
+    if (p->inPutWave == NULL || (p->trainWaveEncountered && p->trainWave == NULL)) {
+        return NULL_WAVE_OP;
+    }
+    
+    SVMDataBlock data;
+    SVMDataBlock trainData;
+    if ((err=getDataBlock(p->inPutWave, &data))) {
+        return err;
+    }
+    int train=p->trainWaveEncountered;
+    if (train && (err=getDataBlock(p->trainWave, &trainData))) {
+        return err;
+    }
+    
+    // both sets of samples as sparse nodes, the kernel only needs the non zero points
+    struct svm_node *buffer=NULL;
+    struct svm_node *trainBuffer=NULL;
+    struct svm_node **x=Malloc(struct svm_node *, data.rows>0 ? data.rows : 1);
+    struct svm_node **y=train ? Malloc(struct svm_node *, trainData.rows>0 ? trainData.rows : 1) : x;
+    if (x == NULL || y == NULL) {
+        err=NOMEM;
+    }
+    else if ((err=makeNodes(&data, 1, 0, &buffer, x)) == 0 && train) {
+        err=makeNodes(&trainData, 1, 0, &trainBuffer, y);
+    }
+    
+    int m=(int)data.rows;
+    int n=train ? (int)trainData.rows : m;
+    waveHndl kernelWave=NULL;
+    if (err == 0) {
+        CountInt kernelSize[MAX_DIMENSIONS+1]={0};
+        kernelSize[0]=m;
+        kernelSize[1]=n;
+        err=MDMakeWave(&kernelWave, "M_SVMKernel", NULL, kernelSize, NT_FP64, 1);
+    }
+    if (err == 0) {
+        if (kernelMatrix(x, m, y, n, &params, numThreads, (double*)WaveData(kernelWave))) { // column-major like the wave
+            err=NOMEM;
+        }
+        WaveHandleModified(kernelWave);
+    }
+    
+    free(buffer);
+    free(trainBuffer);
+    if (y != x) {
+        free(y);
+    }
+    free(x);
+    return err;
+}
+
+
+// Operation template: SVMGridSearch /TYPE=number:svm_type /K=number:kernel_type /D=number:degree /CF=number:coef0 /V=number:numValidation /EPSILON=number:epsilon /TERM=number:eps_term /SHRINK /SPARSE[=number:sparseThreshold] /C={number:log2CBegin, number:log2CEnd, number:log2CStep} /Y={number:log2GammaBegin, number:log2GammaEnd, number:log2GammaStep} /NU={number:nuBegin, number:nuEnd, number:nuStep} /THREADS[=number:numThreads] /CACHE=number:cacheSize /SEED=number:seed /KEEP /GRAM[=number:gramMemory] inputWave=wave:inPutWave, inputClasses=wave:inputClasses, weights=wave:inputWeights, sparseInput={wave:rowWave, wave:columnWave, wave:valueWave}
+
+// Runtime param structure for SVMGridSearch operation.
+#pragma pack(2)    // All structures passed to Igor are two-byte aligned.
+struct SVMGridSearchRuntimeParams {
+    // Flag parameters.
+    
+    // Parameters for /TYPE flag group. Types are the same as in svm.h
+    int TYPEFlagEncountered;
+    double svm_type;
+    int TYPEFlagParamsSet[1];
+    
+    // Parameters for /K flag group. Kernel, same as in svm.h
+    int KFlagEncountered;
+    double kernel_type;
+    int KFlagParamsSet[1];
+    
+    // Parameters for /D flag group. Polynomial Degree in svm_parameter in svm.h
+    int DFlagEncountered;
+    double degree;
+    int DFlagParamsSet[1];
+    
+    // Parameters for /CF flag group. Coef0 in svm_parameter in svm.h
+    int CFFlagEncountered;
+    double coef0;
+    int CFFlagParamsSet[1];
+    
+    // Parameters for /V flag group. Number of cross-validation folds per grid point, 5 if not given
+    int VFlagEncountered;
+    double numValidation;
+    int VFlagParamsSet[1];
+    
+    // Parameters for /EPSILON flag group. p in svm_parameter in svm.h (for regression)
+    int EPSILONFlagEncountered;
+    double epsilon;
+    int EPSILONFlagParamsSet[1];
+    
+    // Parameters for /TERM flag group. Epsilon in svm_parameter in svm.h
+    int TERMFlagEncountered;
+    double eps_term;
+    int TERMFlagParamsSet[1];
+    
+    // Parameters for /SHRINK flag group. set shrinking in svm_parameter in svm.h to true or false.
+    int SHRINKFlagEncountered;
+    // There are no fields for this group because it has no parameters.
+    
+    // Parameters for /SPARSE flag group. skip points with |value| <= threshold (default 0) when building the nodes.
+    int SPARSEFlagEncountered;
+    double sparseThreshold;                    // Optional parameter.
+    int SPARSEFlagParamsSet[1];
+    
+    // Parameters for /C flag group. range of log2(C): begin, end, step. C=1 if not given
+    int CFlagEncountered;
+    double log2CBegin;
+    double log2CEnd;
+    double log2CStep;
+    int CFlagParamsSet[3];
+    
+    // Parameters for /Y flag group. range of log2(gamma): begin, end, step. gamma=1/number of features if not given, ignored for LINEAR and PRECOMPUTED kernels
+    int YFlagEncountered;
+    double log2GammaBegin;
+    double log2GammaEnd;
+    double log2GammaStep;
+    int YFlagParamsSet[3];
+    
+    // Parameters for /NU flag group. range of nu: begin, end, step. nu=0.5 if not given
+    int NUFlagEncountered;
+    double nuBegin;
+    double nuEnd;
+    double nuStep;
+    int NUFlagParamsSet[3];
+    
+    // Parameters for /THREADS flag group. evaluate the grid on this many threads, one per core if no number is given, the kernel rows computed on the threads left over by the solver of SVMSolver.cpp
+    int THREADSFlagEncountered;
+    double numThreads;                    // Optional parameter.
+    int THREADSFlagParamsSet[1];
+    
+    // Parameters for /CACHE flag group. kernel cache in MB, split between the threads
+    int CACHEFlagEncountered;
+    double cacheSize;
+    int CACHEFlagParamsSet[1];
+    
+    // Parameters for /SEED flag group. seed for the fold assignment, same folds as SVMTrain /V /SEED
+    int SEEDFlagEncountered;
+    double seed;
+    int SEEDFlagParamsSet[1];
+    
+    // Parameters for /KEEP flag group. train a model with the best parameters and keep it resident (V_SVMModelID)
+    int KEEPFlagEncountered;
+    // There are no fields for this group because it has no parameters.
+    
+    // Parameters for /GRAM flag group. cross validate with the kernel rows computed on the /THREADS threads and cached in gramMemory MB (1024 if no number is given), also on one thread
+    int GRAMFlagEncountered;
+    double gramMemory;                    // Optional parameter.
+    int GRAMFlagParamsSet[1];
+    
+    // Main parameters.
+    
+    // Parameters for inputWave keyword group. Inputdata, each row is a sample, same as for SVMTrain
+    int inputWaveEncountered;
+    waveHndl inPutWave;
+    int inputWaveParamsSet[1];
+    
+    // Parameters for inputClasses keyword group. Labels for the input data
+    int inputClassesEncountered;
+    waveHndl inputClasses;
+    int inputClassesParamsSet[1];
+    
+    // Parameters for weights keyword group. weights for the classes, same as for SVMTrain
+    int weightsEncountered;
+    waveHndl inputWeights;
+    int weightsParamsSet[1];
+    
+    // Parameters for sparseInput keyword group. Inputdata as row/column/value triplets, replaces inputWave
+    int sparseInputEncountered;
+    waveHndl rowWave;
+    waveHndl columnWave;
+    waveHndl valueWave;
+    int sparseInputParamsSet[3];
+    
+    // These are postamble fields that Igor sets.
+    int calledFromFunction;                    // 1 if called from a user function, 0 otherwise.
+    int calledFromMacro;                    // 1 if called from a macro, 0 otherwise.
+};
+typedef struct SVMGridSearchRuntimeParams SVMGridSearchRuntimeParams;
+typedef struct SVMGridSearchRuntimeParams* SVMGridSearchRuntimeParamsPtr;
+#pragma pack()    // Reset structure alignment to default.
+
+/*
+ helper function, number of values begin, begin+step, ... up to end of a grid axis (like range_f in libSVM's grid.py). 1 if step is 0.
+ */
+
+static int gridAxisCount(double begin, double end, double step){
+    if (step == 0 || (end-begin)/step<0) {
+        return 1;
+    }
+    return (int)floor((end-begin)/step+1e-9)+1;
+}
+
+/*
+ ExecuteSVMGridSearch runs a cross validation for every point of a C x gamma x nu grid. The problem is built once, all points use the same folds and the (point, fold) trainings run concurrently.
+ M_SVMGrid holds the accuracy (%) for classification or the mean squared error for regression, rows are C, columns gamma and layers nu. The row and column scaling are log2(C) and log2(gamma).
+ LINEAR and PRECOMPUTED kernels don't use gamma: the gamma axis is a single column, /Y is ignored and V_SVMBestGamma is NaN.
+ */
+
+extern "C" int
+ExecuteSVMGridSearch(SVMGridSearchRuntimeParamsPtr p)
+{
+    struct svm_parameter params={0};
+    params.cache_size=100; //standard values from libSVM (https://github.com/cjlin1/libsvm), 100 MB
+    params.C=1;
+    params.nu=0.5;
+    params.p=0.1;
+    int err=0;
+    struct svm_problem problem={0};
+    struct svm_node *buffer=NULL;
+    
+    if (p->TYPEFlagEncountered && p->svm_type<5) {
+        params.svm_type=(int)p->svm_type;
+    }
+    else{
+        return INCOMPATIBLE_FLAGS;
+    }
+    
+    if (p->KFlagEncountered && p->kernel_type<5) {
+        params.kernel_type=(int)p->kernel_type;
+    }
+    else{
+        return INCOMPATIBLE_FLAGS;
+    }
+    
+    if (p->DFlagEncountered) {
+        params.degree=(int)p->degree;
+    }
+    else{
+        params.degree=3;
+    }
+    
+    if (p->CFFlagEncountered) {
+        params.coef0=p->coef0;
+    }
+    
+    if (p->EPSILONFlagEncountered) {
+        params.p=p->epsilon;
+    }
+    
+    if (p->TERMFlagEncountered) {
+        params.eps=p->eps_term;
+    }
+    else{
+        params.eps=params.svm_type == NU_SVC ? 0.00001 : 0.001; //standard values from libSVM (https://github.com/cjlin1/libsvm), same as SVMTrain
+    }
+    
+    if (p->SHRINKFlagEncountered) {
+        params.shrinking=1;
+    }
+    
+    int numFolds=5;
+    if (p->VFlagEncountered) {
+        numFolds=(int)p->numValidation;
+        if (numFolds<2) {
+            return EXPECT_POS_NUM;
+        }
+    }
+    
+    int numThreads=1;
+    if (p->THREADSFlagEncountered) {
+        numThreads=p->THREADSFlagParamsSet[0] ? (int)p->numThreads : 0; // 0: one thread per core
+    }
+    
+    if (p->CACHEFlagEncountered) {
+        if (p->cacheSize<1) {
+            return EXPECT_POS_NUM;
+        }
+        params.cache_size=p->cacheSize;
+    }
+    
+    unsigned int seed=1;
+    if (p->SEEDFlagEncountered) {
+        seed=(unsigned int)p->seed;
+    }
+    
+    double gramMemory=0; // kernel rows in the /CACHE only
+    if (p->GRAMFlagEncountered) {
+        gramMemory=p->GRAMFlagParamsSet[0] ? p->gramMemory : SVM_GRAM_MEMORY;
+    }
+    
+    int sparse=0;
+    double sparseThreshold=0;
+    if (p->SPARSEFlagEncountered) {
+        sparse=1;
+        if (p->SPARSEFlagParamsSet[0]) {
+            sparseThreshold=fabs(p->sparseThreshold);
+        }
+    }
+    
+    int tripletInput=p->sparseInputEncountered && p->rowWave != NULL && p->columnWave != NULL && p->valueWave != NULL;
+    if (!(p->inputWaveEncountered && p->inPutWave != NULL) && !tripletInput) {
+        return NOWAV;
+    }
+    if (!p->inputClassesEncountered || p->inputClasses == NULL) {
+        return NULL_WAVE_OP;
+    }
+    
+    if ((err=makeProblemFromWaves(tripletInput ? NULL : p->inPutWave, p->inputClasses, p->rowWave, p->columnWave, p->valueWave, kernelMatrixColumns(params.kernel_type, tripletInput ? NULL : p->inPutWave), sparse, sparseThreshold, &buffer, &problem))) { // the data is converted once for the whole grid
+        return err;
+    }
+    
+    if (p->weightsEncountered && p->inputWeights != NULL) {
+        addWeights(p->inputWeights, &params);
+    }
+    
+    // the grid axes, C and gamma in log2 steps as in libSVM's grid.py
+    int maxIndex=0;
+    for (int i=0; i<problem.l; i++) {
+        for (const svm_node *node=problem.x[i]; node->index != -1; node++) {
+            if (node->index>maxIndex) {
+                maxIndex=node->index;
+            }
+        }
+    }
+    double log2C[3]={0, 0, 0};
+    double log2Gamma[3]={log2(maxIndex>0 ? 1.0/maxIndex : 1.0), 0, 0}; // default gamma of svm-train
+    double nu[3]={params.nu, 0, 0};
+    if (p->CFlagEncountered) {
+        log2C[0]=p->log2CBegin;
+        log2C[1]=p->log2CEnd;
+        log2C[2]=p->log2CStep;
+    }
+    if (p->YFlagEncountered) {
+        log2Gamma[0]=p->log2GammaBegin;
+        log2Gamma[1]=p->log2GammaEnd;
+        log2Gamma[2]=p->log2GammaStep;
+    }
+    if (p->NUFlagEncountered) {
+        nu[0]=p->nuBegin;
+        nu[1]=p->nuEnd;
+        nu[2]=p->nuStep;
+    }
+    int gammaKernel=params.kernel_type != LINEAR && params.kernel_type != PRECOMPUTED;
+    if (!gammaKernel) { // gamma doesn't enter the kernel, every column would train the same models again
+        log2Gamma[1]=log2Gamma[0];
+        log2Gamma[2]=0;
+    }
+    int numC=gridAxisCount(log2C[0], log2C[1], log2C[2]);
+    int numGamma=gridAxisCount(log2Gamma[0], log2Gamma[1], log2Gamma[2]);
+    int numNu=gridAxisCount(nu[0], nu[1], nu[2]);
+    int numPoints=numC*numGamma*numNu;
+    
+    SVMGridPoint *points=Malloc(SVMGridPoint, numPoints);
+    double *scores=Malloc(double, numPoints);
+    if (points == NULL || scores == NULL) {
+        err=NOMEM;
+    }
+    else{
+        int invalidPoints=0;
+        const char *parameterError=NULL;
+        for (int k=0; k<numNu; k++) {
+            for (int j=0; j<numGamma; j++) {
+                for (int i=0; i<numC; i++) {
+                    SVMGridPoint *point=points+i+j*numC+k*numC*numGamma; // column-major like M_SVMGrid
+                    point->C=pow(2.0, log2C[0]+i*log2C[2]);
+                    point->gamma=pow(2.0, log2Gamma[0]+j*log2Gamma[2]);
+                    point->nu=nu[0]+k*nu[2];
+                    
+                    struct svm_parameter pointParams=params;
+                    pointParams.C=point->C;
+                    pointParams.gamma=point->gamma;
+                    pointParams.nu=point->nu;
+                    const char *pointError=svm_check_parameter(&problem, &pointParams);
+                    point->valid=pointError == NULL; // e.g. infeasible nu, left out of the grid
+                    if (pointError != NULL) {
+                        parameterError=pointError;
+                        invalidPoints++;
+                    }
+                }
+            }
+        }
+        if (invalidPoints == numPoints) {
+            XOPNotice(parameterError);
+            err=EXPECTED_XOP_PARAM;
+        }
+    }
+    
+    if (err == 0) {
+        svm_set_print_string_function(&print_null); // no console output from the workers
+        if (gramGridSearch(&problem, &params, points, numPoints, numFolds, seed, numThreads, params.cache_size, gramMemory, scores)) { // with more than one thread or /GRAM the folds are trained by the row-parallel solver
+            err=NOMEM;
+        }
+        svm_set_print_string_function(&print_string_Igor);
+    }
+    
+    if (err == 0) {
+        waveHndl gridWave;
+        CountInt gridSize[MAX_DIMENSIONS+1]={0};
+        gridSize[0]=numC;
+        gridSize[1]=numGamma;
+        gridSize[2]=numNu>1 ? numNu : 0;
+        if ((err=MDMakeWave(&gridWave, "M_SVMGrid", NULL, gridSize, NT_FP64, 1)) == 0) {
+            double *gridData=(double*)WaveData(gridWave);
+            memcpy(gridData, scores, numPoints*sizeof(double));
+            double delta=log2C[2] != 0 ? log2C[2] : 1;
+            MDSetWaveScaling(gridWave, 0, &delta, &log2C[0]);
+            delta=log2Gamma[2] != 0 ? log2Gamma[2] : 1;
+            MDSetWaveScaling(gridWave, 1, &delta, &log2Gamma[0]);
+            if (numNu>1) {
+                MDSetWaveScaling(gridWave, 2, &nu[2], &nu[0]);
+            }
+            WaveHandleModified(gridWave);
+            
+            int regression=params.svm_type == EPSILON_SVR || params.svm_type == NU_SVR;
+            int best=-1;
+            for (int i=0; i<numPoints; i++) { // the first of equally good points wins
+                if (!points[i].valid) {
+                    continue;
+                }
+                if (best<0 || (regression ? scores[i]<scores[best] : scores[i]>scores[best])) {
+                    best=i;
+                }
+            }
+            
+            SetOperationNumVar("V_SVMValidation", scores[best]);
+            SetOperationNumVar("V_SVMBestC", points[best].C);
+            SetOperationNumVar("V_SVMBestGamma", gammaKernel ? points[best].gamma : NAN);
+            SetOperationNumVar("V_SVMBestNu", points[best].nu);
+            
+            char notice[1024];
+            if (gammaKernel) {
+                snprintf(notice,1024, "Best %s = %g at C = %g, gamma = %g, nu = %g\n", regression ? "Cross Validation Mean Squared Error" : "Cross Validation Accuracy", scores[best], points[best].C, points[best].gamma, points[best].nu);
+            }
+            else{
+                snprintf(notice,1024, "Best %s = %g at C = %g, nu = %g\n", regression ? "Cross Validation Mean Squared Error" : "Cross Validation Accuracy", scores[best], points[best].C, points[best].nu);
+            }
+            XOPNotice(notice);
+            
+            if (p->KEEPFlagEncountered) { // train the final model with the best parameters on the problem we already have
+                params.C=points[best].C;
+                params.gamma=points[best].gamma;
+                params.nu=points[best].nu;
+                if (numThreads != 1) {
+                    svm_set_print_string_function(&print_null);
+                }
+                struct svm_model *model=gramTrain(&problem, &params, seed, numThreads, params.cache_size, gramMemory);
+                svm_set_print_string_function(&print_string_Igor);
+                if (model == NULL) {
+                    err=NOMEM;
+                }
+                else{
+                    SetOperationNumVar("V_SVMNumSupportVectors", model->l);
+                    if (ownSupportVectors(model)) {
+                        svm_free_and_destroy_model(&model);
+                        err=NOMEM;
+                    }
+                    else{
+                        int modelID;
+                        registerModel(model, NULL, NULL, &modelID);
+                        SetOperationNumVar("V_SVMModelID", modelID);
+                    }
+                }
+            }
+        }
+    }
+    svm_set_print_string_function(NULL);
+    
+    free(points);
+    free(scores);
+    free(problem.y);
+    free(problem.x);
+    free(buffer);
+    svm_destroy_param(&params);
+    return err;
+}
+
+
+/*
+ Igor pro specific functions
+ */
+
+static int
+RegisterSVMClassify(void)
+{
+    const char* cmdTemplate;
+    const char* runtimeNumVarList;
+    const char* runtimeStrVarList;
+    
+    // NOTE: If you change this template, you must change the SVMClassifyRuntimeParams structure as well.
+    cmdTemplate = "SVMClassify /PROB /DEC /DP /SPARSE[=number:sparseThreshold] /THREADS[=number:numThreads] /ID=number:modelID /P=name:pathName /RAW={number:rawType, number:rawColumns} /DENSE modelName=string:modelname, inputWave=wave:inPutWave, sparseInput={wave:rowWave, wave:columnWave, wave:valueWave}, inputFile=string:inputFile";
+    runtimeNumVarList = "V_SVMClass;V_SVMProb";
+    runtimeStrVarList = "";
+    return RegisterOperation(cmdTemplate, runtimeNumVarList, runtimeStrVarList, sizeof(SVMClassifyRuntimeParams), (void*)ExecuteSVMClassify, 0);
+}
+
+static int
+RegisterSVMModelLoad(void)
+{
+    const char* cmdTemplate;
+    const char* runtimeNumVarList;
+    const char* runtimeStrVarList;
+    
+    // NOTE: If you change this template, you must change the SVMModelLoadRuntimeParams structure as well.
+    cmdTemplate = "SVMModelLoad /P=name:pathName modelName=string:modelName";
+    runtimeNumVarList = "V_SVMModelID";
+    runtimeStrVarList = "S_fileName";
+    return RegisterOperation(cmdTemplate, runtimeNumVarList, runtimeStrVarList, sizeof(SVMModelLoadRuntimeParams), (void*)ExecuteSVMModelLoad, 0);
+}
+
+static int
+RegisterSVMModelSave(void)
+{
+    const char* cmdTemplate;
+    const char* runtimeNumVarList;
+    const char* runtimeStrVarList;
+    
+    // NOTE: If you change this template, you must change the SVMModelSaveRuntimeParams structure as well.
+    cmdTemplate = "SVMModelSave /P=name:pathName /BIN id=number:modelID, modelName=string:modelName";
+    runtimeNumVarList = "";
+    runtimeStrVarList = "S_fileName";
+    return RegisterOperation(cmdTemplate, runtimeNumVarList, runtimeStrVarList, sizeof(SVMModelSaveRuntimeParams), (void*)ExecuteSVMModelSave, 0);
+}
+
+static int
+RegisterSVMModelFree(void)
+{
+    const char* cmdTemplate;
+    const char* runtimeNumVarList;
+    const char* runtimeStrVarList;
+    
+    // NOTE: If you change this template, you must change the SVMModelFreeRuntimeParams structure as well.
+    cmdTemplate = "SVMModelFree /A id=number:modelID";
+    runtimeNumVarList = "";
+    runtimeStrVarList = "";
+    return RegisterOperation(cmdTemplate, runtimeNumVarList, runtimeStrVarList, sizeof(SVMModelFreeRuntimeParams), (void*)ExecuteSVMModelFree, 0);
+}
+
+static int
+RegisterSVMModelWeights(void)
+{
+    const char* cmdTemplate;
+    const char* runtimeNumVarList;
+    const char* runtimeStrVarList;
+    
+    // NOTE: If you change this template, you must change the SVMModelWeightsRuntimeParams structure as well.
+    cmdTemplate = "SVMModelWeights id=number:modelID";
+    runtimeNumVarList = "";
+    runtimeStrVarList = "";
+    return RegisterOperation(cmdTemplate, runtimeNumVarList, runtimeStrVarList, sizeof(SVMModelWeightsRuntimeParams), (void*)ExecuteSVMModelWeights, 0);
+}
+
+static int
+RegisterSVMModelQuantize(void)
+{
+    const char* cmdTemplate;
+    const char* runtimeNumVarList;
+    const char* runtimeStrVarList;
+    
+    // NOTE: If you change this template, you must change the SVMModelQuantizeRuntimeParams structure as well.
+    cmdTemplate = "SVMModelQuantize /BITS=number:bits /THREADS[=number:numThreads] id=number:modelID, validation={wave:validationWave, wave:validationClasses}";
+    runtimeNumVarList = "V_SVMQuantizedBytes;V_SVMFullBytes;V_SVMQuantizedScore;V_SVMFullScore;V_SVMQuantizedDifference;V_SVMResidentBytesBefore;V_SVMResidentBytes";
+    runtimeStrVarList = "";
+    return RegisterOperation(cmdTemplate, runtimeNumVarList, runtimeStrVarList, sizeof(SVMModelQuantizeRuntimeParams), (void*)ExecuteSVMModelQuantize, 0);
+}
+
+static int
+RegisterSVMModelReduce(void)
+{
+    const char* cmdTemplate;
+    const char* runtimeNumVarList;
+    const char* runtimeStrVarList;
+    
+    // NOTE: If you change this template, you must change the SVMModelReduceRuntimeParams structure as well.
+    cmdTemplate = "SVMModelReduce /N=number:targetSV /E=number:errorBound /THREADS[=number:numThreads] id=number:modelID, validation=wave:validationWave";
+    runtimeNumVarList = "V_SVMModelID;V_SVMReducedSupportVectors;V_SVMReducedError;V_SVMReducedDifference;V_SVMReducedSpeedup";
+    runtimeStrVarList = "";
+    return RegisterOperation(cmdTemplate, runtimeNumVarList, runtimeStrVarList, sizeof(SVMModelReduceRuntimeParams), (void*)ExecuteSVMModelReduce, 0);
+}
+
+static int
+RegisterSVMKernelMatrix(void)
+{
+    const char* cmdTemplate;
+    const char* runtimeNumVarList;
+    const char* runtimeStrVarList;
+    
+    // NOTE: If you change this template, you must change the SVMKernelMatrixRuntimeParams structure as well.
+    cmdTemplate = "SVMKernelMatrix /K=number:kernel_type /D=number:degree /Y=number:gamma /CF=number:coef0 /THREADS[=number:numThreads] inputWave=wave:inPutWave, trainWave=wave:trainWave";
+    runtimeNumVarList = "";
+    runtimeStrVarList = "";
+    return RegisterOperation(cmdTemplate, runtimeNumVarList, runtimeStrVarList, sizeof(SVMKernelMatrixRuntimeParams), (void*)ExecuteSVMKernelMatrix, 0);
+}
+
+static int
+RegisterSVMGridSearch(void)
+{
+    const char* cmdTemplate;
+    const char* runtimeNumVarList;
+    const char* runtimeStrVarList;
+    
+    // NOTE: If you change this template, you must change the SVMGridSearchRuntimeParams structure as well.
+    cmdTemplate = "SVMGridSearch /TYPE=number:svm_type /K=number:kernel_type /D=number:degree /CF=number:coef0 /V=number:numValidation /EPSILON=number:epsilon /TERM=number:eps_term /SHRINK /SPARSE[=number:sparseThreshold] /C={number:log2CBegin, number:log2CEnd, number:log2CStep} /Y={number:log2GammaBegin, number:log2GammaEnd, number:log2GammaStep} /NU={number:nuBegin, number:nuEnd, number:nuStep} /THREADS[=number:numThreads] /CACHE=number:cacheSize /SEED=number:seed /KEEP /GRAM[=number:gramMemory] inputWave=wave:inPutWave, inputClasses=wave:inputClasses, weights=wave:inputWeights, sparseInput={wave:rowWave, wave:columnWave, wave:valueWave}";
+    runtimeNumVarList = "V_SVMValidation;V_SVMBestC;V_SVMBestGamma;V_SVMBestNu;V_SVMNumSupportVectors;V_SVMModelID";
+    runtimeStrVarList = "";
+    return RegisterOperation(cmdTemplate, runtimeNumVarList, runtimeStrVarList, sizeof(SVMGridSearchRuntimeParams), (void*)ExecuteSVMGridSearch, 0);
+}
+
+static int
+RegisterSVMTrain(void)
+{
+    const char* cmdTemplate;
+    const char* runtimeNumVarList;
+    const char* runtimeStrVarList;
     
     // NOTE: If you change this template, you must change the SVMTrainRuntimeParams structure as well.
-    cmdTemplate = "SVMTrain /TYPE=number:svm_type /K=number:kernel_type /D=number:degree /Y=number:gamma /CF=number:coef0 /V=number:numValidation /P=name:outputPath /EPSILON=number:epsilon /TERM=number:eps_term /C=number:C /NU=number:nu /SHRINK /PROB modelName=String:modelName, inputWave=wave:inPutWave, inputClasses=wave:inputClasses, weights=wave:inputWeights";
-    runtimeNumVarList = "V_SVMValidation;V_SVMNumSupportVectors";
+    cmdTemplate = "SVMTrain /TYPE=number:svm_type /K=number:kernel_type /D=number:degree /Y=number:gamma /CF=number:coef0 /V=number:numValidation /P=name:outputPath /EPSILON=number:epsilon /TERM=number:eps_term /C=number:C /NU=number:nu /SHRINK /PROB /SPARSE[=number:sparseThreshold] /KEEP /BIN /THREADS[=number:numThreads] /CACHE=number:cacheSize /SEED=number:seed /GRAM[=number:gramMemory] /HOLDOUT={wave:holdoutWave, wave:holdoutClasses} /LINEAR[=number:linearLoss] /APPROX={number:approxType, number:approxDim} /CASCADE[=number:partitions] /FEEDBACK[=number:feedbackPasses] /COMPARE /WARM=number:warmModelID /DENSE /RAW={number:rawType, number:rawColumns} modelName=String:modelName, inputWave=wave:inPutWave, inputClasses=wave:inputClasses, weights=wave:inputWeights, sparseInput={wave:rowWave, wave:columnWave, wave:valueWave}, inputFile=string:inputFile";
+    runtimeNumVarList = "V_SVMValidation;V_SVMNumSupportVectors;V_SVMModelID;V_SVMCascadePasses;V_SVMDirectSupportVectors;V_SVMCascadeScore;V_SVMDirectScore;V_SVMCascadeDifference;V_SVMWarmRounds;V_SVMWarmObjective;V_SVMColdObjective";
     runtimeStrVarList = "S_fileName";
     return RegisterOperation(cmdTemplate, runtimeNumVarList, runtimeStrVarList, sizeof(SVMTrainRuntimeParams), (void*)ExecuteSVMTrain, 0);
 }
@@ -780,6 +3353,10 @@ XOPEntry(void)
 		case FUNCADDRS:
 			result = RegisterFunction();
 			break;
+
+		case CLEANUP:						// Igor is about to unload the XOP, release the resident models
+			freeAllModels();
+			break;
 	}
 	SetXOPResult(result);
 }
@@ -804,14 +3381,48 @@ XOPMain(IORecHandle ioRecHandle)		// The use of XOPMain rather than main means t
 		SetXOPResult(OLD_IGOR);			// OLD_IGOR is defined in SVM.h and there are corresponding error strings in SVM.r and SVMWinCustom.rc.
 		return EXIT_FAILURE;
 	}
-    if (err = RegisterSVMTrain()) {
+    if ((err = RegisterSVMTrain())) {
+        SetXOPResult(err);
+        return EXIT_FAILURE;
+    }
+    if ((err = RegisterSVMClassify())) {
+        SetXOPResult(err);
+        return EXIT_FAILURE;
+    }
+    if ((err = RegisterSVMModelLoad())) {
+        SetXOPResult(err);
+        return EXIT_FAILURE;
+    }
+    if ((err = RegisterSVMModelFree())) {
         SetXOPResult(err);
         return EXIT_FAILURE;
     }
-    if (err = RegisterSVMClassify()) {
+    if ((err = RegisterSVMModelSave())) {
         SetXOPResult(err);
         return EXIT_FAILURE;
     }
+    if ((err = RegisterSVMModelWeights())) {
+        SetXOPResult(err);
+        return EXIT_FAILURE;
+    }
+    if ((err = RegisterSVMGridSearch())) {
+        SetXOPResult(err);
+        return EXIT_FAILURE;
+    }
+    if ((err = RegisterSVMKernelMatrix())) {
+        SetXOPResult(err);
+        return EXIT_FAILURE;
+    }
+    if ((err = RegisterSVMModelQuantize())) {
+        SetXOPResult(err);
+        return EXIT_FAILURE;
+    }
+    if ((err = RegisterSVMModelReduce())) {
+        SetXOPResult(err);
+        return EXIT_FAILURE;
+    }
+    
+    SetXOPType(RESIDENT);               // resident models (SVMModelLoad) live in the XOP between calls
     
 
 	SetXOPResult(0L);
@@ -5,6 +5,18 @@
 /* SVM custom error codes */
 
 #define OLD_IGOR 1 + FIRST_XOP_ERR
+#define NON_EXISTENT_WAVE 2 + FIRST_XOP_ERR
+#define NEEDS_3D_WAVE 3 + FIRST_XOP_ERR
+#define UNKNOWN_MODEL_ID 4 + FIRST_XOP_ERR
+#define NOT_LINEAR_MODEL 5 + FIRST_XOP_ERR
+#define KERNEL_MATRIX_SIZE 6 + FIRST_XOP_ERR
+#define NOT_QUANTIZABLE_MODEL 7 + FIRST_XOP_ERR
+#define NOT_REDUCIBLE_MODEL 8 + FIRST_XOP_ERR
+#define DATA_FILE_FORMAT 9 + FIRST_XOP_ERR
+#define EMPTY_HOLDOUT 10 + FIRST_XOP_ERR
+#define TOO_MANY_SAMPLES 11 + FIRST_XOP_ERR
+#define NEEDS_1D_2D_OR_3D_WAVE 12 + FIRST_XOP_ERR
+#define NOT_DENSE_MODEL 13 + FIRST_XOP_ERR
 /* Prototypes */
 HOST_IMPORT int XOPMain(IORecHandle ioRecHandle);
 